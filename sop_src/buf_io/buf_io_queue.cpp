@@ -44,7 +44,7 @@ BufIOQTransWithPayloadT* BufIOQueue_MallocWithPayload(
   const int numPayloadBytes, const void* const pPayload,
   BufIOQueue_TransactionCompleteCb cb, void* const pUserData) {
   BufIOQTransWithPayloadT* const p =
-    (BufIOQTransWithPayloadT*)OSALMALLOC(sizeof(BufIOQTransT) + numPayloadBytes);
+    (BufIOQTransWithPayloadT*)OSALMALLOC_NOZERO(sizeof(BufIOQTransT) + numPayloadBytes);
   if (p) {
     const BufIOQueue_TransactionCompleteCb fn =
       (cb) ? cb : _buf_ioqueue_tx_free;
@@ -63,16 +63,9 @@ BufIOQueue::BufIOQueue(CriticalSectionType criticalType)
   , mTxQueue()
   , mpRxCurr(NULL)
   , mRxQueue()
-  , mFreeQueue()
-  , mIsValidTag(0x87654321)
-  , mpEnterCritical(
-      (criticalType == CriticalSectionType::TaskCritical)
-        ? OSALEnterTaskCritical
-        : OSALEnterCritical)
-  , mpExitCritical(
-      (criticalType == CriticalSectionType::TaskCritical)
-        ? OSALExitTaskCritical
-        : OSALExitCritical) {
+  , mFreePool()
+  , mIsValidTag(0x87654321) {
+  OSALCsInit(&mCs, (criticalType == CriticalSectionType::Critical), OSAL_CS_LEVEL_BUFIO);
 }
 
 // //////////////////////////////////////////////////////////////////////////
@@ -81,18 +74,15 @@ BufIOQueue::~BufIOQueue() {
 }
 
 // //////////////////////////////////////////////////////////////////////////
-void BufIOQueue::AddFreeTransactions(BufIOQTransT arr[], const int arrLen) {
-  for (int i = 0; i < arrLen; i++) {
-    mFreeQueue.push_back(&arr[ i ].listNode);
-  }
+bool BufIOQueue::AddFreeTransactions(BufIOQTransT arr[], const int arrLen) {
+  return mFreePool.Adopt(arr, arrLen);
 }
 
 // //////////////////////////////////////////////////////////////////////////
 void BufIOQueue::FreeTransaction(BufIOQTransT*& pMsg) {
   if (0x87654321 != mIsValidTag)
     return;
-  CSLocker lock;
-  mFreeQueue.push_back(&pMsg->listNode);
+  mFreePool.Free(pMsg);
   pMsg = NULL;
 }
 
@@ -100,8 +90,12 @@ void BufIOQueue::FreeTransaction(BufIOQTransT*& pMsg) {
 BufIOQTransT* BufIOQueue::AllocTransaction() {
   if (0x87654321 != mIsValidTag)
     return nullptr;
-  CSLocker lock;
-  return (BufIOQTransT*)mFreeQueue.pop_front();
+  return mFreePool.Alloc();
+}
+
+// //////////////////////////////////////////////////////////////////////////
+void BufIOQueue::GetFreeTransactionStats(ObjectPoolStatsT* const pStats) const {
+  mFreePool.GetStats(pStats);
 }
 
 // //////////////////////////////////////////////////////////////////////////
@@ -225,7 +219,7 @@ void BufIOQueue::PurgeOldMessages(bool purgeAll, sll::list& list, sll::list& pur
   sll::list tmp;
   const uint32_t time = EXPIRY_TIME_MASK & OSALGetMS();
 
-  mpEnterCritical();
+  OSALCsEnter(&mCs);
   SLL_AppendListToBack(&tmp.sll, &list.sll);
   SLLNode* pIter = tmp.pop_front();
   while (pIter) {
@@ -242,7 +236,7 @@ void BufIOQueue::PurgeOldMessages(bool purgeAll, sll::list& list, sll::list& pur
     }
     pIter = tmp.pop_front();
   }
-  mpExitCritical();
+  OSALCsExit(&mCs);
 }
 
 // //////////////////////////////////////////////////////////////////////////
@@ -334,9 +328,9 @@ bool BufIOQueue::Queue(const Dir dir, BufIOQTransT* const pTrans, const uint32_t
         ? OSAL_WAIT_INFINITE
         : EXPIRY_TIME_MASK & (OSALGetMS() + timeout);
     sll::list& queue = (dir == TX) ? mTxQueue : mRxQueue;
-    mpEnterCritical();
+    OSALCsEnter(&mCs);
     queue.push_back(&pTrans->listNode);
-    mpExitCritical();
+    OSALCsExit(&mCs);
     rval = true;
   }
 
@@ -350,22 +344,22 @@ bool BufIOQueue::CommitTransaction(
   if (0x87654321 != mIsValidTag)
     return false;
   bool doCallCallbacks = false;
-  mpEnterCritical();
+  OSALCsEnter(&mCs);
   BufIOQTransT*& pCurr = (dir == TX) ? mpTxCurr : mpRxCurr;
   if (NULL == pCurr) {
-    mpExitCritical();
+    OSALCsExit(&mCs);
   } else {
     pCurr->transferredIdx += len;
     LOG_ASSERT(pCurr->transferredIdx <= pCurr->transactionLen);
 
     if (!((forceCompleted) ||
           (pCurr->transferredIdx >= pCurr->transactionLen))) {
-      mpExitCritical();
+      OSALCsExit(&mCs);
     } else {
       doCallCallbacks  = true;
       BufIOQTransT* pC = pCurr;
       pCurr            = NULL;
-      mpExitCritical();
+      OSALCsExit(&mCs);
 
       // Call the callbacks if the implementation thinks it's OK to do that.
       if (callCallbackIfCompleted) {
@@ -384,14 +378,14 @@ bool BufIOQueue::FlushActiveTransaction(const Dir dir) {
   if (0x87654321 != mIsValidTag)
     return false;
   bool rval = false;
-  mpEnterCritical();
+  OSALCsEnter(&mCs);
   BufIOQTransT*& pCurr = (dir == TX) ? mpTxCurr : mpRxCurr;
   if (NULL == pCurr) {
-    mpExitCritical();
+    OSALCsExit(&mCs);
   } else {
     BufIOQTransT* pC = pCurr;
     pCurr            = NULL;
-    mpExitCritical();
+    OSALCsExit(&mCs);
     LOG_ASSERT(pC->transferredIdx <= pC->transactionLen);
     rval = true;
     // Call the callbacks if the implementation thinks it's OK to do that.
@@ -410,7 +404,7 @@ BufIOQTransT*
   if (0x87654321 != mIsValidTag)
     return nullptr;
   sll::list& queue = (dir == TX) ? mTxQueue : mRxQueue;
-  mpEnterCritical();
+  OSALCsEnter(&mCs);
   BufIOQTransT*& pCurr = (dir == TX) ? mpTxCurr : mpRxCurr;
   if (NULL == pCurr) {
     pCurr = (BufIOQTransT*)queue.pop_front();
@@ -419,7 +413,7 @@ BufIOQTransT*
     }
   }
   if (NULL == pCurr) {
-    mpExitCritical();
+    OSALCsExit(&mCs);
   } else {
     if (ppBuf) {
       *ppBuf = &pCurr->pBuf8[ pCurr->transferredIdx ];
@@ -428,7 +422,7 @@ BufIOQTransT*
     len = pCurr->transactionLen - pCurr->transferredIdx;
     LOG_ASSERT((len >= 0) && (len <= pCurr->transactionLen));
     rval = pCurr;
-    mpExitCritical();
+    OSALCsExit(&mCs);
   }
   return rval;
 }
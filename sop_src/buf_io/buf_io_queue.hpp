@@ -104,7 +104,7 @@ typedef struct BufIOQTransTag {
 // Just do
 //  const int payloadSize = 200;
 //  BufIOQTransWithPayloadT *p =
-//      (BufIOQTransWithPayloadT *)OSALMALLOC(sizeof(BufIOQTransT) + payloadSize);
+//      (BufIOQTransWithPayloadT *)OSALMALLOC_NOZERO(sizeof(BufIOQTransT) + payloadSize);
 //  BufIOQueue_InitTransaction(&p->trans, p->payload, payloadSize, onReadComplete,
 //                             pThis);
 //  pNode->d.pAppIf->QueueRead(&p->trans);
@@ -150,8 +150,10 @@ bool BufIOQueue_InitTransaction(
 #ifdef __cplusplus
 #include "buf_io.hpp"
 #include "osal/cs_locker.hpp"
+#include "osal/cs_obj_locker.hpp"
 #include "osal/osal.h"
 #include "utils/helper_macros.h"
+#include "utils/object_pool.hpp"
 #include "utils/platform_log.h"
 #include "utils/sl_list.hpp"
 
@@ -184,12 +186,17 @@ public:
   // Adds an array of buffers which can be quickly allocated
   // and initialized using AllocAndInitTransaction.  This
   // avoids requiring mempools for queued transactions.
-  void AddFreeTransactions(BufIOQTransT arr[], const int arrLen);
+  // The free pool takes at most OBJECT_POOL_MAX_SEGS (8) arrays
+  // and fewer than 65535 transactions in all.  Returns false,
+  // adding none of arr, past either limit.
+  bool AddFreeTransactions(BufIOQTransT arr[], const int arrLen);
 
   // //////////////////////////////////////////////////////////////////////////
   // Frees a completed transaction.  The pointer pMsg will
   // be set to NULL upon completion of the call to indicate
-  // that the pointer is owned by the BufIOQueue.
+  // that the pointer is owned by the BufIOQueue.  pMsg must
+  // come from AllocTransaction(); anything else asserts and
+  // is leaked.
   void FreeTransaction(BufIOQTransT*& pMsg);
 
   // //////////////////////////////////////////////////////////////////////////
@@ -203,6 +210,10 @@ public:
     uint8_t* const pBuf, const int bufLen,
     BufIOQueue_TransactionCompleteCb cb, void* const pUserData);
 
+  // //////////////////////////////////////////////////////////////////////////
+  // Gets the statistics of the free transactions.
+  void GetFreeTransactionStats(ObjectPoolStatsT* const pStats) const;
+
   // //////////////////////////////////////////////////////////////////////////
   // Queries a transaction to see if it is expired.  Returns
   // true if expired, else false.
@@ -373,16 +384,15 @@ protected:
   sll::list mRxQueue;
 
   // Used only if the application wants to add some free
-  // transfers before calling the Alloc() functions.
-  sll::list mFreeQueue;
+  // transfers before calling the Alloc() functions.  Lock free where
+  // OSAL_ATOMIC_NATIVE, see ObjectPool for other targets.
+  ObjectPool<BufIOQTransT, 0> mFreePool;
 
   // Ensures that no functions are called after destruction.
   uint32_t mIsValidTag;
 
-  // Enter/ExitCritical
-  typedef void (*voidFunc)(void);
-  const voidFunc mpEnterCritical;
-  const voidFunc mpExitCritical;
+  // Protects the TX/RX queues and current transactions.
+  OSALCsT mCs;
 };
 
 // Malloc's a transaction with payload.
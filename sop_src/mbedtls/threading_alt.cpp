@@ -14,15 +14,12 @@ LOG_MODNAME("threading_alt.cpp")
 // ///////////////////////////////////////////////////////////////////////////////////
 // Define basic CS lockers so that mbedtls memory allocation routines can stop
 
-#include "utils/dl_list.hpp"
-#include "utils/helper_macros.h"
+#include "utils/object_pool.hpp"
 #include "mbedtls/threading.h"
 #include "mbedtls/platform.h"
-#include "osal/cs_task_locker.hpp"
 
-static mbedtls_threading_mutex_data_t mbedtls_mutexes[16] = { { { 0 } } };
-static dll::list mbedtls_freeMutexes;
-static dll::list mbedtls_usedMutexes;
+// Each mutex has its own OSALCsT.  The pool itself is lock free.
+static ObjectPool<mbedtls_threading_mutex_data_t, 16> mbedtls_mutexPool;
 
 #if defined(MBEDTLS_FS_IO)
 // Two globals that aren't actually used by mbedtls, but defined anyway.
@@ -33,12 +30,11 @@ mbedtls_threading_mutex_t mbedtls_threading_gmtime_mutex = nullptr;
 // ///////////////////////////////////////////////////////////////////////////////////
 static void mbedtls_mutex_init_fn(mbedtls_threading_mutex_t *mutex) {
   if (mutex) {
-    CSTaskLocker cs;
-    mbedtls_threading_mutex_data_t *pnode =
-      (mbedtls_threading_mutex_data_t *)mbedtls_freeMutexes.pop_front();
+    mbedtls_threading_mutex_data_t *pnode = mbedtls_mutexPool.Alloc();
     LOG_ASSERT(pnode);
     if (pnode) {
       pnode->isAValidMutex = true;
+      OSALCsInit(&pnode->cs, false, OSAL_CS_LEVEL_MBEDTLS);
       *mutex = pnode;
     }
   }
@@ -49,9 +45,7 @@ static void mbedtls_mutex_free_fn(mbedtls_threading_mutex_t *mutex) {
   if (mutex) {
     mbedtls_threading_mutex_data_t *pnode = *mutex;
     if (pnode) {
-      CSTaskLocker cs;
-      DLL_NodeUnlist(&pnode->listNode);
-      mbedtls_freeMutexes.push_back(&pnode->listNode);
+      mbedtls_mutexPool.Free(pnode);
     }
     *mutex = nullptr;
   }
@@ -63,7 +57,7 @@ static int  mbedtls_mutex_lock_fn(mbedtls_threading_mutex_t *mutex) {
     mbedtls_threading_mutex_data_t *pnode = *mutex;
     if (pnode) {
       if (pnode->isAValidMutex) {
-        OSALEnterTaskCritical();
+        OSALCsEnter(&pnode->cs);
       }
     }
   }
@@ -76,7 +70,7 @@ static int  mbedtls_mutex_unlock_fn(mbedtls_threading_mutex_t *mutex) {
     mbedtls_threading_mutex_data_t *pnode = *mutex;
     if (pnode) {
       if (pnode->isAValidMutex) {
-        OSALExitTaskCritical();
+        OSALCsExit(&pnode->cs);
       }
     }
   }
@@ -92,13 +86,6 @@ static void mempools_initMbedMutexes() {
     mbedtls_mutex_free = mbedtls_mutex_free_fn;
     mbedtls_mutex_lock = mbedtls_mutex_lock_fn;
     mbedtls_mutex_unlock = mbedtls_mutex_unlock_fn;
-
-    // Initialize list of free mutexes
-    for (int i = 0; i < ARRSZN(mbedtls_mutexes); i++) {
-      mbedtls_threading_mutex_data_t *pnode = &mbedtls_mutexes[i];
-      DLL_NodeInit(&pnode->listNode);
-      mbedtls_freeMutexes.push_back(&pnode->listNode);
-    }
   }
 }
 
@@ -112,11 +99,9 @@ void MbedInitThreadingAlt() {
   }
 
 #if defined(MBEDTLS_FS_IO)
-  mbedtls_threading_mutex_data_t *pnode
-    = (mbedtls_threading_mutex_data_t *)mbedtls_freeMutexes.pop_front();
+  mbedtls_threading_mutex_data_t *pnode = mbedtls_mutexPool.Alloc();
   // Set isValid to FALSE so that any attempts to lock won't actually block processing.
   pnode->isAValidMutex = false;
-  mbedtls_usedMutexes.push_back(&pnode->listNode);
 
   mbedtls_threading_readdir_mutex = pnode;
   mbedtls_threading_gmtime_mutex = pnode;
@@ -18,11 +18,10 @@
 
 /* You should define the mbedtls_threading_mutex_t type in your header */
 #include "osal/osal.h"
-#include "utils/dl_list.h"
 // Define the mutex type used by mbedtls to lock the mutex.
 typedef struct mbedtls_threading_mutex_data_tag {
-  DLLNode listNode;
   bool    isAValidMutex;
+  OSALCsT cs;
 } mbedtls_threading_mutex_data_t;
 
 typedef mbedtls_threading_mutex_data_t * mbedtls_threading_mutex_t;
@@ -9,21 +9,29 @@
 #include "buf_io/buf_io_queue.hpp"
 #include "utils/platform_log.h"
 #include "osal/osal.h"
+#include "osal/osal_atomic.h"
 #include "osal/platform_type.h"
 #include "socket_setup.hpp"
 
 #include <cstdio>
 #include <cstring>
 #include <queue>
-#include <thread>
 #include <mutex>          // std::mutex, std::unique_lock, std::defer_lock
 
+// Receives block for up to the socket's receive timeout, so they run on a
+// small pool instead of the caller's task.
+#define UDPCLIENT_RX_QUEUE_DEPTH 4
+#define UDPCLIENT_RX_STACK_SIZE (64 * 1024)
+
 class UdpClient: public BufIOQueue {
 
 public:
   UdpClient(const char *szAddr, const int port)
   : BufIOQueue(CriticalSectionType::Critical)
+  , mpAddrInfo(nullptr)
   , mSocket(INVALID_SOCKET)
+  , mpRxPool(OSALThreadPoolCreate(1, UDPCLIENT_RX_QUEUE_DEPTH, OSAL_PRIO_LOW, UDPCLIENT_RX_STACK_SIZE))
+  , mClosing(0)
   {
     SerSocket::inst().Init();
     struct addrinfo hints;
@@ -72,6 +80,12 @@ public:
   
   // //////////////////////////////////////////////////////////////////////////
   ~UdpClient(){
+    // Queued receives return at once, and shutting the socket down wakes the
+    // one blocked in recvfrom(), instead of each waiting out SO_RCVTIMEO.
+    OSALAtomicStoreU32(&mClosing, 1, OSAL_MO_RELEASE);
+    SerSocket::inst().sockShutdown(mSocket);
+    // Then wait for them, as they still use the socket.
+    OSALThreadPoolDelete(&mpRxPool);
     freeaddrinfo(mpAddrInfo);
     SerSocket::inst().sockClose(mSocket);
   }
@@ -115,19 +129,21 @@ public:
 #endif
     
     if (ok){
-      // Use thread to read from socket to prevent blocking.
-      std::thread t(ReadFromSocketThreadC, this);
-      t.detach();
+      // Read from the socket on the pool to prevent blocking.
+      if (!OSALThreadPoolSubmit(mpRxPool, ReadFromSocketThreadC, this)) {
+        LOG_TRACE(("Too many receives queued.\r\n"));
+      }
     }
     return true;
   }
   
 private:
   // //////////////////////////////////////////////////////////////////////////
-  // Use thread to read from socket to prevent blocking.
-  static void ReadFromSocketThreadC(void *pThis) {
+  // Runs on mpRxPool to read from socket to prevent blocking.
+  static void ReadFromSocketThreadC(void *const pThis) {
     UdpClient &th = *(UdpClient *)pThis;
     if (INVALID_SOCKET == th.mSocket) return;
+    if (OSALAtomicLoadU32(&th.mClosing, OSAL_MO_ACQUIRE)) return;
 
     uint8_t *pRxBuf = nullptr;
     int rxBufLen = 0;
@@ -155,6 +171,9 @@ private:
 
   struct addrinfo  *mpAddrInfo;
   SOCKET            mSocket;
+  OSALThreadPoolPtrT mpRxPool;
+  // Set by the destructor, so that queued receives do not start.
+  volatile uint32_t mClosing;
   
 };
 
@@ -34,17 +34,26 @@ SerSocket::~SerSocket() {
 }
 
 // ////////////////////////////////////////////////////////////////////////////
-// Close a socket.
+// Shut down both directions of a socket.
+int SerSocket::sockShutdown(const SOCKET sock) {
+  if (sock == INVALID_SOCKET) return 0;
+#ifdef _WIN32
+  return shutdown(sock, SD_BOTH);
+#else
+  return shutdown(sock, SHUT_RDWR);
+#endif
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Close a socket.  Closes it even if the shutdown fails, which it does for
+// sockets that were never connected (e.g. UDP.)
 int SerSocket::sockClose(const SOCKET sock) {
   if (sock == INVALID_SOCKET) return 0;
-  int status = 0;
+  (void)sockShutdown(sock);
 #ifdef _WIN32
-  status = shutdown(sock, SD_BOTH);
-  if (status == 0) { status = closesocket(sock); }
+  return closesocket(sock);
 #else
-  status = shutdown(sock, SHUT_RDWR);
-  if (status == 0) { status = close(sock); }
+  return close(sock);
 #endif
-  return status;
 }
 
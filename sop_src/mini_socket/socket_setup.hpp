@@ -47,6 +47,10 @@ public:
   // Destructor, deinit sockets.
   ~SerSocket();
 
+  // Shut down both directions of a socket.  Wakes up threads blocked on it
+  // (on POSIX, even for unconnected sockets, although it returns an error.)
+  int sockShutdown(const SOCKET sock);
+
   // Close a socket.
   int sockClose(const SOCKET sock);
 };
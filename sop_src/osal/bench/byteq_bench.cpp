@@ -0,0 +1,121 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        byteq_bench.cpp
+ * @brief       Compares a locked ByteQ with a single producer, single
+ *              consumer one.
+ *
+ * Usage: byteq_bench [--mb n]
+ *
+ * Streams n MB from a writer thread to a reader thread through each queue,
+ * in bursts of 1, 2, 3 and 4 KB in turn, and reports MB/s.  The reader
+ * checks what it gets against what was written.
+ */
+
+#include "osal/osal.h"
+#include "utils/byteq.h"
+#include "utils/helper_macros.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+typedef enum {
+  BQ_LOCKED,
+  BQ_SPSC,
+  BQ_NUM_MODES
+} BenchModeT;
+
+static const char* const bench_modeNames[ BQ_NUM_MODES ] = {
+  "locked", "SPSC"
+};
+
+typedef struct BenchDataTag {
+  ByteQ_t q;
+  bq_t qBuf[ 16 * 1024 ];
+  bq_t pattern[ 4096 + 256 ];
+  volatile bool ok;
+} BenchDataT;
+
+// ////////////////////////////////////////////////////////////////////////////
+// Writes totalBytes in bursts of 1-4 KB.
+static void bench_Writer(BenchDataT* const pData, const unsigned int totalBytes) {
+  unsigned int pos   = 0;
+  unsigned int burst = 0;
+  while (pos < totalBytes) {
+    const unsigned int len = MIN(1024 * (1 + (burst & 3)), totalBytes - pos);
+    if (ByteQWrite(&pData->q, &pData->pattern[ pos & 0xff ], len)) {
+      pos += len;
+      burst++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Reads whatever is there and checks it.
+static void bench_Reader(BenchDataT* const pData, const unsigned int totalBytes) {
+  bq_t rd[ 4096 ];
+  bool ok          = true;
+  unsigned int pos = 0;
+  while (pos < totalBytes) {
+    const unsigned int len = ByteQRead(&pData->q, rd, sizeof(rd));
+    if (len) {
+      ok &= (0 == memcmp(rd, &pData->pattern[ pos & 0xff ], len));
+      pos += len;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  pData->ok = ok;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv) {
+  unsigned int mb = 256;
+  for (int i = 1; i < argc; i++) {
+    if ((0 == strcmp(argv[ i ], "--mb")) && (i + 1 < argc)) {
+      mb = strtoul(argv[ ++i ], nullptr, 0);
+    } else {
+      fprintf(stderr, "Usage: %s [--mb n]\n", argv[ 0 ]);
+      return 1;
+    }
+  }
+  const unsigned int totalBytes = mb * 1024 * 1024;
+
+  OSALInit();
+  static BenchDataT data;
+  for (unsigned int i = 0; i < sizeof(data.pattern); i++) {
+    data.pattern[ i ] = (bq_t)i;
+  }
+
+  printf("%-8s %8s\n", "queue", "MB/s");
+  int rval = 0;
+  for (int mode = 0; mode < BQ_NUM_MODES; mode++) {
+    if (BQ_SPSC == mode) {
+      ByteQCreateSpsc(&data.q, data.qBuf, sizeof(data.qBuf));
+    } else {
+      ByteQCreate(&data.q, data.qBuf, sizeof(data.qBuf), true, true);
+    }
+    data.ok = false;
+
+    const uint64_t t0 = OSALGetUS();
+    std::thread wrThread(bench_Writer, &data, totalBytes);
+    std::thread rdThread(bench_Reader, &data, totalBytes);
+    wrThread.join();
+    rdThread.join();
+    const uint64_t elapsedUs = OSALGetUS() - t0;
+
+    const bool ok = (data.ok) && (0 == ByteQGetReadReady(&data.q));
+    ByteQDestroy(&data.q);
+    if (!ok) {
+      printf("%-8s failed\n", bench_modeNames[ mode ]);
+      rval = 1;
+      continue;
+    }
+    printf("%-8s %8d\n", bench_modeNames[ mode ], (int)(totalBytes / MAX(elapsedUs, (uint64_t)1)));
+  }
+  return rval;
+}
@@ -0,0 +1,842 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        mempools_bench.cpp
+ * @brief       Replays allocation traces against each allocator.
+ *
+ * Usage: mempools_bench [--ops n] [--heap-kb n] [--trace file]... [--micro name]...
+ *
+ * Without --trace, replays synthetic traces shaped like the platform's own
+ * users: scheduler one-shots, sstring growth, BufIO payloads and mbedTLS
+ * handshakes.  Recorded traces come from MemPoolsTraceRecordStart().
+ *
+ * Each trace is replayed against mempools, mbedTLS's buffer allocator on its
+ * own (mbedtls_calloc(), as used for mempools' large blocks) and the system
+ * malloc, each in a fresh process, and reports:
+ *   - ns per allocation or free,
+ *   - how much the peak RSS grew while replaying,
+ *   - for the fixed heap, at the point where the most bytes are live, the
+ *     largest free block and the fragmentation, 1 - largest free / free,
+ *   - how many allocations failed, when the heap is too small.
+ *
+ * --micro runs one of the micro benchmarks below instead, or all of them
+ * with --micro all.  Each also gets a fresh process.
+ */
+
+#include "osal/mempools.h"
+#include "osal/osal.h"
+#include "buf_io/buf_io_queue.hpp"
+#include "task_sched/task_sched.h"
+#include "utils/helper_macros.h"
+#include "utils/platform_log.h"
+#include "utils/simple_string.hpp"
+#include "mbedtls/memory_buffer_alloc.h"
+#include "mbedtls/platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+LOG_MODNAME("mempools_bench.cpp");
+
+// One allocation (bytes > 0) or free (bytes == 0) of the block in slot.
+typedef struct BenchOpTag {
+  uint32_t slot;
+  uint32_t bytes;
+} BenchOpT;
+
+typedef struct BenchTraceTag {
+  std::string name;
+  std::vector<BenchOpT> ops;
+  uint32_t numSlots;
+  // Ops replayed when the most bytes are live.
+  size_t peakOps;
+} BenchTraceT;
+
+typedef struct BenchAllocatorTag {
+  const char* szName;
+  void* (*pMalloc)(const size_t sz);
+  void (*pFree)(void* const p);
+  // Allocates from the mbedTLS heap, so the free blocks can be measured.
+  bool fixedHeap;
+} BenchAllocatorT;
+
+static size_t bench_heapBytes = 32 * 1024 * 1024;
+
+// ////////////////////////////////////////////////////////////////////////////
+static uint64_t bench_NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static void* bench_MemPoolsMalloc(const size_t sz) { return MemPoolsMallocNoZero(sz); }
+static void bench_MemPoolsFree(void* const p) { MemPoolsFree(p); }
+static void* bench_MbedMalloc(const size_t sz) { return mbedtls_calloc(1, sz); }
+static void bench_MbedFree(void* const p) { mbedtls_free(p); }
+static void* bench_SysMalloc(const size_t sz) { return malloc(sz); }
+static void bench_SysFree(void* const p) { free(p); }
+
+static const BenchAllocatorT bench_allocators[] = {
+  { "mempools", bench_MemPoolsMalloc, bench_MemPoolsFree, true },
+  { "mbedtls", bench_MbedMalloc, bench_MbedFree, true },
+  { "malloc", bench_SysMalloc, bench_SysFree, false },
+};
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// Builds a trace, handing out slots.
+class BenchTraceBuilder {
+public:
+  explicit BenchTraceBuilder(const uint32_t seed) : mSeed(seed) {}
+
+  uint32_t Alloc(const uint32_t bytes) {
+    uint32_t slot;
+    if (mFreeSlots.empty()) {
+      slot = (uint32_t)mNumSlots++;
+    } else {
+      slot = mFreeSlots.back();
+      mFreeSlots.pop_back();
+    }
+    BenchOpT op = { slot, MAX(bytes, 1u) };
+    mOps.push_back(op);
+    return slot;
+  }
+
+  void Free(const uint32_t slot) {
+    BenchOpT op = { slot, 0 };
+    mOps.push_back(op);
+    mFreeSlots.push_back(slot);
+  }
+
+  // Random in [0, n).
+  uint32_t Rand(const uint32_t n) {
+    mSeed = (mSeed * 1103515245u) + 12345u;
+    return (uint32_t)(((uint64_t)(mSeed >> 1) * n) >> 31);
+  }
+
+  // Random in [lo, hi], with small values as likely as big ones in log terms.
+  uint32_t RandLog(const uint32_t lo, const uint32_t hi) {
+    uint32_t bits = 0;
+    while ((hi >> bits) > lo) {
+      bits++;
+    }
+    const uint32_t v = lo << Rand(bits + 1);
+    return MIN(hi, v + Rand(v));
+  }
+
+  size_t NumOps() const { return mOps.size(); }
+
+  BenchTraceT Finish(const char* const szName) {
+    BenchTraceT trace;
+    trace.name = szName;
+    trace.ops.swap(mOps);
+    trace.numSlots = mNumSlots;
+    trace.peakOps = 0;
+    return trace;
+  }
+
+private:
+  uint32_t mSeed;
+  std::vector<BenchOpT> mOps;
+  std::vector<uint32_t> mFreeSlots;
+  uint32_t mNumSlots = 0;
+};
+
+// ////////////////////////////////////////////////////////////////////////////
+// TaskSchedScheduleFn(): small fixed size blocks, mostly freed in order.
+static BenchTraceT bench_SchedOneShots(const size_t ops) {
+  BenchTraceBuilder b(1);
+  const uint32_t sz = sizeof(TaskSchedulable) + (2 * sizeof(void*));
+  std::vector<uint32_t> pending;
+  size_t head = 0;
+  while (b.NumOps() < ops) {
+    const size_t n = pending.size() - head;
+    if ((0 == n) || ((n < 64) && (b.Rand(100) < 52))) {
+      pending.push_back(b.Alloc(sz));
+    } else if (b.Rand(8)) {
+      b.Free(pending[ head++ ]);
+    } else {
+      // A later one-shot fires first.
+      const size_t idx = head + b.Rand((uint32_t)n);
+      b.Free(pending[ idx ]);
+      pending[ idx ] = pending[ head++ ];
+    }
+  }
+  while (head < pending.size()) {
+    b.Free(pending[ head++ ]);
+  }
+  return b.Finish("sched_oneshot");
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// sstring appends: the buffer doubles until the string is built, and a few
+// finished strings stay live.
+static BenchTraceT bench_StringGrowth(const size_t ops) {
+  BenchTraceBuilder b(2);
+  std::vector<uint32_t> kept;
+  while (b.NumOps() < ops) {
+    const uint32_t finalLen = b.RandLog(16, 65536);
+    uint32_t cap = 16;
+    uint32_t slot = b.Alloc(cap);
+    while (cap < finalLen) {
+      cap *= 2;
+      const uint32_t bigger = b.Alloc(cap);
+      b.Free(slot);
+      slot = bigger;
+    }
+    kept.push_back(slot);
+    if (kept.size() > 8) {
+      b.Free(kept[ 0 ]);
+      kept.erase(kept.begin());
+    }
+  }
+  for (size_t i = 0; i < kept.size(); i++) {
+    b.Free(kept[ i ]);
+  }
+  return b.Finish("sstring_grow");
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// BufIOQueue_MallocWithPayload(): transactions with payloads up to a BLE
+// sized packet, replaced at random.
+static BenchTraceT bench_BufIOPayloads(const size_t ops) {
+  BenchTraceBuilder b(3);
+  static const uint32_t NUM_LIVE = 64;
+  uint32_t live[ NUM_LIVE ];
+  for (uint32_t i = 0; i < NUM_LIVE; i++) {
+    live[ i ] = UINT32_MAX;
+  }
+  while (b.NumOps() < ops) {
+    const uint32_t idx = b.Rand(NUM_LIVE);
+    if (UINT32_MAX != live[ idx ]) {
+      b.Free(live[ idx ]);
+    }
+    live[ idx ] = b.Alloc(sizeof(BufIOQTransT) + 16 + b.Rand(1548));
+  }
+  for (uint32_t i = 0; i < NUM_LIVE; i++) {
+    if (UINT32_MAX != live[ i ]) {
+      b.Free(live[ i ]);
+    }
+  }
+  return b.Finish("bufio_payload");
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// One mbedTLS handshake and the connection after it: record buffers and
+// contexts that live for the connection, parsed certificates, and heavy
+// churn of bignum limbs that grow as they are used.
+static BenchTraceT bench_OneHandshake(const uint32_t seed) {
+  BenchTraceBuilder b(seed);
+  const uint32_t ctx = b.Alloc(600);
+  const uint32_t inBuf = b.Alloc(4096 + 29);
+  const uint32_t outBuf = b.Alloc(4096 + 29);
+  uint32_t hashes[ 3 ];
+  for (int i = 0; i < 3; i++) {
+    hashes[ i ] = b.Alloc(220);
+  }
+  std::vector<uint32_t> certs;
+  for (int c = 0; c < 3; c++) {
+    certs.push_back(b.Alloc(900 + b.Rand(800)));
+    for (int n = 0; n < 20; n++) {
+      certs.push_back(b.Alloc(32 + b.Rand(64)));
+    }
+  }
+  uint32_t mpi[ 16 ];
+  uint32_t mpiLen[ 16 ];
+  for (int i = 0; i < 16; i++) {
+    mpiLen[ i ] = 0;
+  }
+  for (int op = 0; op < 400; op++) {
+    const uint32_t i = b.Rand(16);
+    if ((mpiLen[ i ]) && (b.Rand(4))) {
+      if ((mpiLen[ i ] < 512) && (0 == b.Rand(3))) {
+        // mbedtls_mpi_grow()
+        const uint32_t bigger = b.Alloc(mpiLen[ i ] * 2);
+        b.Free(mpi[ i ]);
+        mpi[ i ] = bigger;
+        mpiLen[ i ] *= 2;
+      } else {
+        b.Free(mpi[ i ]);
+        mpiLen[ i ] = 0;
+      }
+    } else if (0 == mpiLen[ i ]) {
+      mpiLen[ i ] = 8u << b.Rand(5);
+      mpi[ i ] = b.Alloc(mpiLen[ i ]);
+    }
+  }
+  for (int i = 0; i < 16; i++) {
+    if (mpiLen[ i ]) {
+      b.Free(mpi[ i ]);
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    b.Free(hashes[ i ]);
+  }
+  // The peer's certificate is kept; the rest of the chain goes.
+  for (size_t i = 21; i < certs.size(); i++) {
+    b.Free(certs[ i ]);
+  }
+  const uint32_t session = b.Alloc(150);
+  // Application data on the connection.
+  for (int i = 0; i < 50; i++) {
+    b.Free(b.Alloc(64 + b.Rand(1024)));
+  }
+  b.Free(session);
+  for (size_t i = 0; i < 21; i++) {
+    b.Free(certs[ i ]);
+  }
+  b.Free(outBuf);
+  b.Free(inBuf);
+  b.Free(ctx);
+  return b.Finish("handshake");
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Handshakes on 4 connections at once, interleaved at random.
+static BenchTraceT bench_TlsHandshakes(const size_t ops) {
+  static const int NUM_CONN = 4;
+  BenchTraceBuilder b(4);
+  std::vector<BenchOpT> conn[ NUM_CONN ];
+  size_t pos[ NUM_CONN ] = { 0 };
+  std::vector<uint32_t> toGlobal[ NUM_CONN ];
+  uint32_t handshakes = 0;
+  while (b.NumOps() < ops) {
+    const int c = (int)b.Rand(NUM_CONN);
+    if (pos[ c ] == conn[ c ].size()) {
+      BenchTraceT t = bench_OneHandshake(100 + handshakes++);
+      conn[ c ].swap(t.ops);
+      toGlobal[ c ].assign(t.numSlots, 0);
+      pos[ c ] = 0;
+    }
+    const BenchOpT& op = conn[ c ][ pos[ c ]++ ];
+    if (op.bytes) {
+      toGlobal[ c ][ op.slot ] = b.Alloc(op.bytes);
+    } else {
+      b.Free(toGlobal[ c ][ op.slot ]);
+    }
+  }
+  for (int c = 0; c < NUM_CONN; c++) {
+    for (; pos[ c ] < conn[ c ].size(); pos[ c ]++) {
+      const BenchOpT& op = conn[ c ][ pos[ c ] ];
+      if (op.bytes) {
+        toGlobal[ c ][ op.slot ] = b.Alloc(op.bytes);
+      } else {
+        b.Free(toGlobal[ c ][ op.slot ]);
+      }
+    }
+  }
+  return b.Finish("tls_handshake");
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Loads a trace written by MemPoolsTraceRecordStart().  Blocks allocated
+// before the recording started are left out, and blocks still live at the
+// end are freed.
+static bool bench_LoadTrace(const char* const szPath, BenchTraceT* const pTrace) {
+  FILE* const pFile = fopen(szPath, "r");
+  if (nullptr == pFile) {
+    fprintf(stderr, "Cannot open %s\n", szPath);
+    return false;
+  }
+  BenchTraceBuilder b(5);
+  std::map<std::string, uint32_t> live;
+  char line[ 128 ];
+  char addr[ 64 ];
+  char oldAddr[ 64 ];
+  unsigned long bytes;
+  while (fgets(line, sizeof(line), pFile)) {
+    if (3 == sscanf(line, "r %63s %63s %lu", oldAddr, addr, &bytes)) {
+      // Replayed as a free and an allocation, in place or not.
+      std::map<std::string, uint32_t>::iterator it = live.find(oldAddr);
+      if (it != live.end()) {
+        b.Free(it->second);
+        live.erase(it);
+      }
+      it = live.find(addr);
+      if (it != live.end()) {
+        b.Free(it->second);
+        live.erase(it);
+      }
+      live[ addr ] = b.Alloc((uint32_t)bytes);
+    } else if (2 == sscanf(line, "a %63s %lu", addr, &bytes)) {
+      std::map<std::string, uint32_t>::iterator it = live.find(addr);
+      if (it != live.end()) {
+        // Freed outside mempools' sight.
+        b.Free(it->second);
+        live.erase(it);
+      }
+      live[ addr ] = b.Alloc((uint32_t)bytes);
+    } else if (1 == sscanf(line, "f %63s", addr)) {
+      std::map<std::string, uint32_t>::iterator it = live.find(addr);
+      if (it != live.end()) {
+        b.Free(it->second);
+        live.erase(it);
+      }
+    }
+  }
+  fclose(pFile);
+  for (std::map<std::string, uint32_t>::iterator it = live.begin(); it != live.end(); ++it) {
+    b.Free(it->second);
+  }
+  *pTrace = b.Finish(szPath);
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Finds where the most requested bytes are live.
+static void bench_FindPeak(BenchTraceT* const pTrace) {
+  std::vector<uint32_t> sizes(pTrace->numSlots, 0);
+  uint64_t live = 0;
+  uint64_t peak = 0;
+  for (size_t i = 0; i < pTrace->ops.size(); i++) {
+    const BenchOpT& op = pTrace->ops[ i ];
+    if (op.bytes) {
+      sizes[ op.slot ] = op.bytes;
+      live += op.bytes;
+      if (live > peak) {
+        peak = live;
+        pTrace->peakOps = i + 1;
+      }
+    } else {
+      live -= sizes[ op.slot ];
+    }
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Replays ops [from, to), touching each new block as its user would.
+// Returns how many allocations failed.
+static uint32_t bench_Replay(
+  const BenchAllocatorT& alloc, const BenchTraceT& trace, void** const pp,
+  const size_t from, const size_t to)
+{
+  uint32_t failed = 0;
+  for (size_t i = from; i < to; i++) {
+    const BenchOpT& op = trace.ops[ i ];
+    if (op.bytes) {
+      uint8_t* const p = (uint8_t*)alloc.pMalloc(op.bytes);
+      if (p) {
+        p[ 0 ] = (uint8_t)i;
+        p[ op.bytes - 1 ] = (uint8_t)i;
+      } else {
+        failed++;
+      }
+      pp[ op.slot ] = p;
+    } else {
+      alloc.pFree(pp[ op.slot ]);
+      pp[ op.slot ] = nullptr;
+    }
+  }
+  return failed;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// The largest block mbedtls_calloc() can give right now.
+static size_t bench_LargestFree(const size_t upTo) {
+  size_t lo = 0;
+  size_t hi = upTo;
+  while (lo < hi) {
+    const size_t mid = lo + ((hi - lo + 1) / 2);
+    void* const p = mbedtls_calloc(1, mid);
+    if (p) {
+      mbedtls_free(p);
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Peak RSS of this process so far, in MB.
+static double bench_PeakRssMb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Builds a synthetic trace by name, or loads a recorded one.
+static bool bench_MakeTrace(const std::string& spec, const size_t ops, BenchTraceT* const pTrace) {
+  if (spec == "sched_oneshot") {
+    *pTrace = bench_SchedOneShots(ops);
+  } else if (spec == "sstring_grow") {
+    *pTrace = bench_StringGrowth(ops);
+  } else if (spec == "bufio_payload") {
+    *pTrace = bench_BufIOPayloads(ops);
+  } else if (spec == "tls_handshake") {
+    *pTrace = bench_TlsHandshakes(ops);
+  } else if (!bench_LoadTrace(spec.c_str(), pTrace)) {
+    return false;
+  }
+  bench_FindPeak(pTrace);
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Runs one trace on one allocator, in this process, and prints a row.
+static bool bench_Run(const BenchAllocatorT& alloc, const std::string& spec, const size_t ops) {
+  // Before mempools is set up, so that new takes the trace from the system
+  // heap instead of the heap being measured.
+  BenchTraceT trace;
+  if (!bench_MakeTrace(spec, ops, &trace)) {
+    return false;
+  }
+  MemPoolsInitialize(bench_heapBytes);
+  OSALInit();
+  // Not from mempools, which is being measured.
+  void** const ptrs = (void**)calloc(MAX(trace.numSlots, 1u), sizeof(void*));
+  const double rss0 = bench_PeakRssMb();
+
+  const uint64_t t0 = bench_NowNs();
+  const uint32_t failed = bench_Replay(alloc, trace, ptrs, 0, trace.ops.size());
+  const uint64_t t1 = bench_NowNs();
+  const double rssMb = bench_PeakRssMb() - rss0;
+
+  char szHeap[ 64 ] = "       -            -";
+  if (alloc.fixedHeap) {
+    bench_Replay(alloc, trace, ptrs, 0, trace.peakOps);
+    size_t used, blocks;
+    mbedtls_memory_buffer_alloc_cur_get(&used, &blocks);
+    const size_t freeBytes = bench_heapBytes - MIN(used, bench_heapBytes);
+    const size_t largest = bench_LargestFree(freeBytes);
+    const double frag = (freeBytes) ? 100.0 * (1.0 - ((double)largest / freeBytes)) : 0.0;
+    snprintf(szHeap, sizeof(szHeap), "%7.2f%% %9u KB", frag, (unsigned)(largest / 1024));
+    bench_Replay(alloc, trace, ptrs, trace.peakOps, trace.ops.size());
+  }
+
+  printf("%-16s %-9s %9.1f %9.1f %s %8u\n",
+    trace.name.c_str(), alloc.szName,
+    (double)(t1 - t0) / (double)MAX(trace.ops.size(), (size_t)1), rssMb, szHeap, failed);
+  free(ptrs);
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Fragments the pool with a mix of block sizes, then times small allocations
+// and frees against it.  Build with MEMPOOLS_SLAB_BYTES=0 to compare with the
+// buffer allocator alone.
+static void bench_SmallBlockChurn() {
+  static void* live[ 4096 ];
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < ARRSZ(live); i++) {
+    seed = (seed * 1103515245u) + 12345u;
+    const size_t sz = (0 == (i % 16)) ? (2048 + (seed % 4096)) : (8 + ((seed >> 8) % 1016));
+    live[ i ] = MemPoolsMalloc(sz);
+  }
+  for (size_t i = 0; i < ARRSZ(live); i += 2) {
+    MemPoolsFree(live[ i ]);
+    live[ i ] = nullptr;
+  }
+
+  const int rounds = 2000000;
+  const uint64_t t0 = bench_NowNs();
+  for (int r = 0; r < rounds; r++) {
+    seed = (seed * 1103515245u) + 12345u;
+    const size_t idx = ((seed >> 4) % (ARRSZ(live) / 2)) * 2;
+    if (live[ idx ]) {
+      MemPoolsFree(live[ idx ]);
+    }
+    live[ idx ] = MemPoolsMalloc(8 + ((seed >> 12) % 1016));
+  }
+  const uint64_t t1 = bench_NowNs();
+  printf("%-32s %9.1f ns/op\n", "small block malloc+free", (double)(t1 - t0) / rounds);
+
+  for (size_t i = 0; i < ARRSZ(live); i++) {
+    if (live[ i ]) {
+      MemPoolsFree(live[ i ]);
+    }
+  }
+}
+
+// Pointers from one thread to another.
+typedef struct BenchRingTag {
+  std::atomic<uint32_t> wr;
+  uint8_t pad0[ 60 ];
+  std::atomic<uint32_t> rd;
+  uint8_t pad1[ 60 ];
+  void* slots[ 256 ];
+} BenchRingT;
+
+// ////////////////////////////////////////////////////////////////////////////
+// Pairs of threads: one allocates, the other frees what it allocated, so
+// most frees go back to another thread's pages.  Throughput should grow with
+// the number of pairs, up to the number of cores.
+static void bench_CrossThreadFree() {
+  const int perThread = 1000000;
+  static BenchRingT rings[ 8 ];
+  for (int pairs = 1; pairs <= (int)ARRSZ(rings); pairs *= 2) {
+    std::vector<std::thread> threads;
+    const uint64_t t0 = bench_NowNs();
+    for (int i = 0; i < pairs; i++) {
+      BenchRingT* const pRing = &rings[ i ];
+      pRing->wr = 0;
+      pRing->rd = 0;
+      threads.push_back(std::thread([pRing, perThread]() {
+        uint32_t seed = (uint32_t)(uintptr_t)pRing;
+        for (int n = 0; n < perThread; n++) {
+          seed = (seed * 1103515245u) + 12345u;
+          void* const p = MemPoolsMalloc(16 + ((seed >> 8) % 496));
+          const uint32_t wr = pRing->wr.load(std::memory_order_relaxed);
+          while ((wr - pRing->rd.load(std::memory_order_acquire)) >= ARRSZ(pRing->slots)) {
+            std::this_thread::yield();
+          }
+          pRing->slots[ wr % ARRSZ(pRing->slots) ] = p;
+          pRing->wr.store(wr + 1, std::memory_order_release);
+        }
+      }));
+      threads.push_back(std::thread([pRing, perThread]() {
+        for (int n = 0; n < perThread; n++) {
+          const uint32_t rd = pRing->rd.load(std::memory_order_relaxed);
+          while (rd == pRing->wr.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+          }
+          MemPoolsFree(pRing->slots[ rd % ARRSZ(pRing->slots) ]);
+          pRing->rd.store(rd + 1, std::memory_order_release);
+        }
+      }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+      threads[ i ].join();
+    }
+    const uint64_t t1 = bench_NowNs();
+    char szLabel[ 64 ];
+    snprintf(szLabel, sizeof(szLabel), "cross thread free, %d pair%s", pairs, (1 == pairs) ? "" : "s");
+    printf("%-32s %9.1f allocs/us\n", szLabel, ((double)pairs * perThread * 1000) / (double)(t1 - t0));
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Builds a 1 MB string a line at a time, against growing it the way sstring
+// used to: a zeroed block, zeroed again, then the copy.
+static void bench_StringBuild() {
+  static const char line[] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde\n";
+  const int lines = (1024 * 1024) / (sizeof(line) - 1);
+  const int reps  = 20;
+
+  uint64_t t0 = bench_NowNs();
+  for (int r = 0; r < reps; r++) {
+    sstring str;
+    for (int i = 0; i < lines; i++) {
+      str.appendc(line, sizeof(line) - 1);
+    }
+  }
+  const uint64_t tNew = bench_NowNs() - t0;
+
+  t0 = bench_NowNs();
+  for (int r = 0; r < reps; r++) {
+    uint8_t* pBuf  = nullptr;
+    size_t maxSize = 0;
+    size_t len     = 0;
+    for (int i = 0; i < lines; i++) {
+      if (len + sizeof(line) > maxSize) {
+        const size_t newMax = sstring::nextPowerOfTwo(len + sizeof(line));
+        uint8_t* const pNew = (uint8_t*)MemPoolsMalloc(newMax);
+        memset(pNew, 0, newMax);
+        if (pBuf) {
+          memcpy(pNew, pBuf, len);
+          MemPoolsFree(pBuf);
+        }
+        pBuf    = pNew;
+        maxSize = newMax;
+      }
+      memcpy(&pBuf[ len ], line, sizeof(line) - 1);
+      len += sizeof(line) - 1;
+    }
+    MemPoolsFree(pBuf);
+  }
+  const uint64_t tOld = bench_NowNs() - t0;
+  printf("%-32s %9.1f us\n", "1 MB sstring build", (double)tNew / reps / 1000);
+  printf("%-32s %9.1f us\n", "1 MB build, zeroed growth", (double)tOld / reps / 1000);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Transaction sized blocks that are filled right after allocation, zeroed
+// and not.
+static void bench_PayloadChurn() {
+  static void* live[ 64 ];
+  const int rounds = 2000000;
+  for (int pass = 0; pass < 2; pass++) {
+    const bool zero   = (0 == pass);
+    uint32_t seed     = 12345;
+    const uint64_t t0 = bench_NowNs();
+    for (int r = 0; r < rounds; r++) {
+      seed = (seed * 1103515245u) + 12345u;
+      const size_t idx = (seed >> 4) % ARRSZ(live);
+      const size_t sz  = 64 + ((seed >> 12) % 1500);
+      if (live[ idx ]) {
+        MemPoolsFree(live[ idx ]);
+      }
+      live[ idx ] = (zero) ? MemPoolsMalloc(sz) : MemPoolsMallocNoZero(sz);
+      memset(live[ idx ], (int)r, sz);
+    }
+    const uint64_t t1 = bench_NowNs();
+    printf("%-32s %9.1f ns/op\n",
+      (zero) ? "payload churn, zeroed" : "payload churn, not zeroed", (double)(t1 - t0) / rounds);
+    for (size_t i = 0; i < ARRSZ(live); i++) {
+      if (live[ i ]) {
+        MemPoolsFree(live[ i ]);
+        live[ i ] = nullptr;
+      }
+    }
+  }
+}
+
+#if (MEMPOOLS_SAMPLE > 0)
+// ////////////////////////////////////////////////////////////////////////////
+// Small allocations and frees, with the sampling profiler off and on.
+static void bench_SamplingOverhead() {
+  static void* live[ 64 ];
+  const int rounds = 4000000;
+  for (int pass = 0; pass < 2; pass++) {
+    const bool sample = (1 == pass);
+    if (sample) {
+      MemPoolsSampleStart(0);
+    }
+    uint32_t seed     = 12345;
+    const uint64_t t0 = bench_NowNs();
+    for (int r = 0; r < rounds; r++) {
+      seed = (seed * 1103515245u) + 12345u;
+      const size_t idx = (seed >> 4) % ARRSZ(live);
+      if (live[ idx ]) {
+        MemPoolsFree(live[ idx ]);
+      }
+      live[ idx ] = MemPoolsMallocNoZero(16 + ((seed >> 12) % 256));
+    }
+    const uint64_t t1 = bench_NowNs();
+    MemPoolsSampleStop();
+    printf("%-32s %9.1f ns/op\n",
+      (sample) ? "malloc+free, sampled" : "malloc+free, not sampled", (double)(t1 - t0) / rounds);
+    for (size_t i = 0; i < ARRSZ(live); i++) {
+      if (live[ i ]) {
+        MemPoolsFree(live[ i ]);
+        live[ i ] = nullptr;
+      }
+    }
+  }
+}
+#endif
+
+typedef struct BenchMicroTag {
+  const char* szName;
+  void (*pFn)();
+} BenchMicroT;
+
+static const BenchMicroT bench_micros[] = {
+  { "small_churn", bench_SmallBlockChurn },
+  { "cross_thread_free", bench_CrossThreadFree },
+  { "string_build", bench_StringBuild },
+  { "payload_churn", bench_PayloadChurn },
+#if (MEMPOOLS_SAMPLE > 0)
+  { "sampling", bench_SamplingOverhead },
+#endif
+};
+
+// ////////////////////////////////////////////////////////////////////////////
+// Runs the micro benchmark called szName, or all of them for "all", each in
+// a fresh process.
+static bool bench_RunMicro(const char* const szName) {
+  bool found = false;
+  bool ok    = true;
+  for (size_t m = 0; m < ARRSZ(bench_micros); m++) {
+    if ((0 != strcmp(szName, "all")) && (0 != strcmp(szName, bench_micros[ m ].szName))) {
+      continue;
+    }
+    found = true;
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (0 == pid) {
+      MemPoolsInitialize(bench_heapBytes);
+      OSALInit();
+      bench_micros[ m ].pFn();
+      fflush(stdout);
+      _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if ((!WIFEXITED(status)) || (0 != WEXITSTATUS(status))) {
+      printf("%-32s failed\n", bench_micros[ m ].szName);
+      ok = false;
+    }
+  }
+  if (!found) {
+    fprintf(stderr, "No micro benchmark called %s\n", szName);
+  }
+  return (found) && (ok);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv) {
+  size_t ops = 2000000;
+  std::vector<std::string> traces;
+  std::vector<std::string> micros;
+  for (int i = 1; i < argc; i++) {
+    if ((0 == strcmp(argv[ i ], "--ops")) && (i + 1 < argc)) {
+      ops = strtoul(argv[ ++i ], nullptr, 0);
+    } else if ((0 == strcmp(argv[ i ], "--heap-kb")) && (i + 1 < argc)) {
+      bench_heapBytes = strtoul(argv[ ++i ], nullptr, 0) * 1024;
+    } else if ((0 == strcmp(argv[ i ], "--trace")) && (i + 1 < argc)) {
+      traces.push_back(argv[ ++i ]);
+    } else if ((0 == strcmp(argv[ i ], "--micro")) && (i + 1 < argc)) {
+      micros.push_back(argv[ ++i ]);
+    } else {
+      fprintf(stderr,
+        "Usage: %s [--ops n] [--heap-kb n] [--trace file]... [--micro name]...\n", argv[ 0 ]);
+      return 1;
+    }
+  }
+  int rval = 0;
+  for (size_t m = 0; m < micros.size(); m++) {
+    if (!bench_RunMicro(micros[ m ].c_str())) {
+      rval = 1;
+    }
+  }
+  if ((traces.empty()) && (micros.empty())) {
+    traces.push_back("sched_oneshot");
+    traces.push_back("sstring_grow");
+    traces.push_back("bufio_payload");
+    traces.push_back("tls_handshake");
+  }
+
+  if (traces.empty()) {
+    return rval;
+  }
+
+  printf("%-16s %-9s %9s %9s %8s %12s %8s\n",
+    "trace", "allocator", "ns/op", "RSS MB", "frag", "largest free", "failed");
+  for (size_t t = 0; t < traces.size(); t++) {
+    for (size_t a = 0; a < ARRSZ(bench_allocators); a++) {
+      // A fresh process each time, so the heap and RSS start clean.  The
+      // trace is built there too, to keep this process small.
+      fflush(stdout);
+      const pid_t pid = fork();
+      if (0 == pid) {
+        const bool ok = bench_Run(bench_allocators[ a ], traces[ t ], ops);
+        fflush(stdout);
+        _exit((ok) ? 0 : 1);
+      }
+      int status = 0;
+      waitpid(pid, &status, 0);
+      if ((!WIFEXITED(status)) || (0 != WEXITSTATUS(status))) {
+        printf("%-16s %-9s failed\n", traces[ t ].c_str(), bench_allocators[ a ].szName);
+        rval = 1;
+      }
+    }
+  }
+  return rval;
+}
@@ -0,0 +1,159 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        mpmc_q_bench.cpp
+ * @brief       Compares MpmcQ with a locked Q<T>.
+ *
+ * Usage: mpmc_q_bench [--items n]
+ *
+ * Moves n items through each queue with 1, 2, 4, 8 and 16 writer and reader
+ * pairs, and reports ns per item.  The locked Q<T> locks on reads and
+ * writes, and takes the global critical section around each call so that
+ * there can be more than one writer and reader.
+ */
+
+#include "osal/osal.h"
+#include "utils/helper_macros.h"
+#include "utils/mpmc_q.hpp"
+#include "utils/q.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define BENCH_QSZ 1024
+#define BENCH_MAX_THREADS 16
+
+typedef enum {
+  BQ_LOCKED,
+  BQ_MPMC,
+  BQ_MPMC_BATCH,
+  BQ_NUM_MODES
+} BenchModeT;
+
+static const char* const bench_modeNames[ BQ_NUM_MODES ] = {
+  "locked Q<T>", "MpmcQ", "MpmcQ, batches"
+};
+
+typedef MpmcQ<uint32_t, BENCH_QSZ> BenchMpmcQT;
+
+// ////////////////////////////////////////////////////////////////////////////
+// Moves perThread items from each writer to some reader.  Returns the sum of
+// what the readers got, for the caller to check.
+static uint32_t bench_Run(
+  const BenchModeT mode, const int numThreads, const uint32_t perThread,
+  BenchMpmcQT& mpmcQ, Q<uint32_t>& lockedQ) {
+  volatile uint32_t sums[ BENCH_MAX_THREADS ] = { 0 };
+
+  auto writer = [&](const int t) {
+    uint32_t batch[ 16 ];
+    uint32_t i = 0;
+    while (i < perThread) {
+      bool ok;
+      if (BQ_LOCKED == mode) {
+        const uint32_t v = t * perThread + i;
+        OSALEnterCritical();
+        ok = (0 != lockedQ.Write(v));
+        OSALExitCritical();
+        i += (ok) ? 1 : 0;
+      } else if (BQ_MPMC == mode) {
+        ok = mpmcQ.TryPush(t * perThread + i);
+        i += (ok) ? 1 : 0;
+      } else {
+        const int num = (int)MIN(ARRSZ(batch), perThread - i);
+        for (int j = 0; j < num; j++) {
+          batch[ j ] = t * perThread + i + j;
+        }
+        const int cnt = mpmcQ.TryPushBatch(batch, num);
+        ok = (cnt > 0);
+        i += cnt;
+      }
+      if (!ok) {
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  auto reader = [&](const int t) {
+    uint32_t batch[ 16 ];
+    uint32_t sum = 0;
+    uint32_t i   = 0;
+    while (i < perThread) {
+      int cnt = 0;
+      if (BQ_LOCKED == mode) {
+        OSALEnterCritical();
+        cnt = lockedQ.Read(batch, 1);
+        OSALExitCritical();
+      } else if (BQ_MPMC == mode) {
+        cnt = (mpmcQ.TryPop(batch[ 0 ])) ? 1 : 0;
+      } else {
+        cnt = mpmcQ.TryPopBatch(batch, (int)MIN(ARRSZ(batch), perThread - i));
+      }
+      for (int j = 0; j < cnt; j++) {
+        sum += batch[ j ];
+      }
+      i += cnt;
+      if (0 == cnt) {
+        std::this_thread::yield();
+      }
+    }
+    sums[ t ] = sum;
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; t++) {
+    threads.push_back(std::thread(writer, t));
+    threads.push_back(std::thread(reader, t));
+  }
+  for (size_t t = 0; t < threads.size(); t++) {
+    threads[ t ].join();
+  }
+  uint32_t sum = 0;
+  for (int t = 0; t < numThreads; t++) {
+    sum += sums[ t ];
+  }
+  return sum;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv) {
+  uint32_t items = 200000;
+  for (int i = 1; i < argc; i++) {
+    if ((0 == strcmp(argv[ i ], "--items")) && (i + 1 < argc)) {
+      items = strtoul(argv[ ++i ], nullptr, 0);
+    } else {
+      fprintf(stderr, "Usage: %s [--items n]\n", argv[ 0 ]);
+      return 1;
+    }
+  }
+
+  OSALInit();
+  static BenchMpmcQT mpmcQ;
+  static uint32_t qBuf[ BENCH_QSZ ];
+  Q<uint32_t> lockedQ(qBuf, BENCH_QSZ, true, true);
+
+  printf("%-16s %8s %8s\n", "queue", "threads", "ns/item");
+  int rval = 0;
+  for (int numThreads = 1; numThreads <= BENCH_MAX_THREADS; numThreads *= 2) {
+    for (int mode = 0; mode < BQ_NUM_MODES; mode++) {
+      const uint32_t perThread = items / numThreads;
+      const uint32_t n         = perThread * numThreads;
+      const uint64_t t0        = OSALGetUS();
+      const uint32_t sum =
+        bench_Run((BenchModeT)mode, numThreads, perThread, mpmcQ, lockedQ);
+      const uint64_t elapsedUs = OSALGetUS() - t0;
+      const bool ok = (sum == (uint32_t)(((uint64_t)n * (n - 1)) / 2)) &&
+        (0 == lockedQ.GetReadReady()) && (0 == mpmcQ.GetReadReady());
+      if (!ok) {
+        printf("%-16s %8d failed\n", bench_modeNames[ mode ], numThreads);
+        rval = 1;
+        continue;
+      }
+      printf("%-16s %8d %8d\n", bench_modeNames[ mode ], numThreads,
+        (int)((elapsedUs * 1000) / n));
+    }
+  }
+  return rval;
+}
@@ -0,0 +1,14 @@
+#include "cs_obj_locker.hpp"
+
+
+// //////////////////////////////////////////////////////////////////////////////////
+//  Never forget to exit the per-object critical section again!
+
+CSObjLocker::CSObjLocker(OSALCsT* pCs)
+  : mpCs(pCs) {
+  OSALCsEnter(mpCs);
+}
+
+CSObjLocker::~CSObjLocker() {
+  OSALCsExit(mpCs);
+}
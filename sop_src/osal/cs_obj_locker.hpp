@@ -0,0 +1,21 @@
+#ifndef CS_OBJLOCKER_HPP_
+#define CS_OBJLOCKER_HPP_
+#include "osal/osal.h"
+#ifdef __cplusplus
+// //////////////////////////////////////////////////////////////////////////////////
+//  Never forget to exit the per-object critical section.
+//  A NULL pCs locks the global critical section.
+class CSObjLocker {
+private:
+  CSObjLocker();
+  OSALCsT* const mpCs;
+
+public:
+  explicit CSObjLocker(OSALCsT* pCs);
+
+  ~CSObjLocker();
+};
+
+#endif
+
+#endif // CS_OBJLOCKER_HPP_
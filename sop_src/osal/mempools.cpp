@@ -7,6 +7,7 @@
 
 #if (!(NO_MEMPOOLS > 0))
 #include "osal.h"
+#include "osal/osal_atomic.h"
 #include "mbedtls/myconfig.h"
 #include "mbedtls/platform.h"
 #include "utils/helper_macros.h"
@@ -25,6 +26,28 @@ static bool mNewDeleteOverride = false;
 
 extern void MbedInitThreadingAlt();
 
+#if (MEMPOOLS_SAMPLE > 0)
+// In mempools_sample.cpp
+extern void mempools_SampleAlloc(
+  void* const pVoid, const size_t sz, const uint8_t id,
+  const char* const pF, const int line, const void* const pCaller);
+extern void mempools_SampleFree(void* const pVoid);
+#endif
+
+// Set by MemPoolsSetTraceHook().
+static MemPoolsTraceFnT volatile mempools_pTraceFn = nullptr;
+static void * volatile mempools_pTraceData = nullptr;
+
+// Return address of the current function, to tell call sites apart.
+#if defined(__GNUC__) || defined(__clang__)
+#define MEMPOOLS_CALLER() __builtin_return_address(0)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define MEMPOOLS_CALLER() _ReturnAddress()
+#else
+#define MEMPOOLS_CALLER() nullptr
+#endif
+
 #ifndef MEMPOOLS_HEAP_BYTES
 #if (PLATFORM_EMBEDDED > 0)
 #ifdef EVTLOG_TRACE
@@ -52,16 +75,194 @@ typedef uint32_t align_mask_t;
 static align_mask_t const MEMPOOLS_MAGIC = 0xBB81337B;
 #endif
 
-static uint8_t mempools_buf[MEMPOOLS_HEAP_BYTES];
-static align_mask_t mempools_buf_start =
-  (align_mask_t)&mempools_buf[0];
-static align_mask_t mempools_buf_end =
-  (align_mask_t)&mempools_buf[MEMPOOLS_HEAP_BYTES];
+// Host builds map the pools when MemPoolsInitialize() runs instead of
+// reserving them in BSS, and map more slab arenas as those fill up.
+#if (defined(__linux__) || defined(__APPLE__)) && !(PLATFORM_EMBEDDED > 0)
+#define MEMPOOLS_MMAP 1
+#include <sys/mman.h>
+#else
+#define MEMPOOLS_MMAP 0
+#endif
+
+// The buffer allocator's pool.
+#if (MEMPOOLS_MMAP > 0)
+static uint8_t* mempools_buf = nullptr;
+#else
+static uint8_t mempools_heapBuf[MEMPOOLS_HEAP_BYTES];
+static uint8_t* const mempools_buf = mempools_heapBuf;
+#endif
+static size_t mempools_heapBytes = 0;
+static align_mask_t mempools_buf_start = 0;
+static align_mask_t mempools_buf_end = 0;
 
 #if (MEMPOOLS_DEBUG > 0)
 dll::list mempools_allocatedList;
 #endif
 
+// Blocks of up to MEMPOOLS_SLAB_MAX bytes come from size-class slabs in
+// arenas of MEMPOOLS_SLAB_BYTES.  Allocating and freeing them is O(1), and
+// they do not fragment the mbedtls buffer allocator, which manages
+// mempools_buf and takes the larger blocks.  Set to 0 to send everything to
+// the buffer allocator.
+#ifndef MEMPOOLS_SLAB_BYTES
+#if (PLATFORM_EMBEDDED > 0)
+#define MEMPOOLS_SLAB_BYTES 0
+#else
+#define MEMPOOLS_SLAB_BYTES (2 * 1024 * 1024)
+#endif
+#endif
+
+#if (MEMPOOLS_SLAB_BYTES > 0)
+
+#ifndef MEMPOOLS_SLAB_PAGE
+#define MEMPOOLS_SLAB_PAGE 4096
+#endif
+
+#define MEMPOOLS_SLAB_MAX 1024
+#define MEMPOOLS_SLAB_QUANTUM 16
+// Pages per arena, including the ones holding the arena's page headers.
+#define MEMPOOLS_SLAB_PAGES (MEMPOOLS_SLAB_BYTES / MEMPOOLS_SLAB_PAGE)
+
+// Arenas there can be.  Without mmap there is one, in BSS.
+#ifndef MEMPOOLS_SLAB_ARENAS
+#if (MEMPOOLS_MMAP > 0)
+#define MEMPOOLS_SLAB_ARENAS 64
+#else
+#define MEMPOOLS_SLAB_ARENAS 1
+#endif
+#endif
+
+#if (MEMPOOLS_MMAP > 0)
+// Arenas are aligned to their size, so the arena holding an address is found
+// by hashing the address divided by the size.
+static_assert(0 == (MEMPOOLS_SLAB_BYTES & (MEMPOOLS_SLAB_BYTES - 1)), "MEMPOOLS_SLAB_BYTES must be a power of two");
+static_assert(0 == (MEMPOOLS_SLAB_ARENAS & (MEMPOOLS_SLAB_ARENAS - 1)), "MEMPOOLS_SLAB_ARENAS must be a power of two");
+#else
+#undef MEMPOOLS_SLAB_ARENAS
+#define MEMPOOLS_SLAB_ARENAS 1
+#endif
+
+// Each thread gets its own slab pages, so threads allocate and free small
+// blocks without taking a lock.  Blocks freed by another thread go back to
+// the page's owner.
+#ifndef MEMPOOLS_TCACHE
+#define MEMPOOLS_TCACHE 1
+#endif
+
+#if !(defined(__linux__) || defined(__APPLE__)) || defined(OSAL_SINGLE_TASK)
+#undef MEMPOOLS_TCACHE
+#define MEMPOOLS_TCACHE 0
+#endif
+
+// Size classes, at most 25% apart.
+static const uint16_t mempools_slabSizes[] = {
+  16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+  320, 384, 448, 512, 640, 768, 896, 1024 };
+
+#define MEMPOOLS_SLAB_CLASSES ARRSZ(mempools_slabSizes)
+
+#if (MEMPOOLS_TCACHE > 0)
+#include <pthread.h>
+
+// Threads that can have their own pages at once.  Others share the pages
+// that are not owned by any thread.
+#ifndef MEMPOOLS_TCACHE_MAX
+#define MEMPOOLS_TCACHE_MAX 64
+#endif
+
+// Usage change a thread accumulates before adding it to the totals.
+#define MEMPOOLS_TCACHE_FLUSH_BYTES (64 * 1024)
+
+struct MemTCacheTag;
+#endif
+
+// Bookkeeping for one page, kept outside of the page.
+typedef struct MemSlabPageTag {
+  DLLNode listNode; ///< On a list of pages with room, the free pages, or an owner's full pages
+  void* pFree;      ///< Freed blocks, linked through their first word
+  uint16_t used;    ///< Blocks allocated
+  uint16_t carved;  ///< Blocks ever taken from the page
+  uint8_t cls;
+  struct MemSlabArenaTag* pArena;
+#if (MEMPOOLS_TCACHE > 0)
+  struct MemTCacheTag* volatile pOwner; ///< Thread cache the page belongs to, or NULL
+  void* volatile pRemoteFree;           ///< Blocks freed by other threads, for the owner to collect
+#endif
+} MemSlabPage;
+
+// MEMPOOLS_SLAB_BYTES of slab pages.  The page headers take the first pages.
+typedef struct MemSlabArenaTag {
+  uint8_t* pBase;
+  MemSlabPage* pPages;  ///< Header for each page of the arena
+  uint32_t pagesCarved; ///< Pages given out since the arena was mapped or trimmed, with the headers' pages
+  uint32_t pagesUsed;   ///< Pages in use by a class
+} MemSlabArena;
+
+// Pages at the start of each arena that hold its page headers.
+static const uint32_t mempools_slabHdrPages =
+  ((MEMPOOLS_SLAB_PAGES * sizeof(MemSlabPage)) + MEMPOOLS_SLAB_PAGE - 1) / MEMPOOLS_SLAB_PAGE;
+
+// The pages of a class that are not owned by a thread.
+typedef struct MemSlabClassTag {
+  OSALCsT cs;
+  DLL pages;        ///< Pages with free blocks
+  uint16_t size;
+  uint16_t perPage;
+} MemSlabClass;
+
+#if (MEMPOOLS_TCACHE > 0)
+// One thread's pages of one class.  Only the owning thread touches these.
+typedef struct MemTCacheBinTag {
+  MemSlabPage* pCur; ///< Page allocations come from
+  DLL room;          ///< Other pages with free blocks
+  DLL full;          ///< Pages without free blocks, apart from ones other threads freed
+} MemTCacheBin;
+
+typedef struct MemTCacheTag {
+  MemTCacheBin bins[ MEMPOOLS_SLAB_CLASSES ];
+  volatile uint32_t remotePending; ///< Bit per class: another thread freed onto a full page
+  volatile uint32_t deltaUsed;     ///< Usage not yet added to the totals (signed)
+  volatile uint32_t deltaBlocks;
+  volatile bool inUse;
+} MemTCache;
+
+static_assert(MEMPOOLS_SLAB_CLASSES <= 32, "remotePending needs a bit per class");
+
+// For a thread that has no cache of its own.
+#define MEMPOOLS_TCACHE_NONE ((MemTCache*)1)
+
+static MemTCache mempools_tcaches[ MEMPOOLS_TCACHE_MAX ];
+static thread_local MemTCache* mempools_pTCache = nullptr;
+static pthread_key_t mempools_tcacheKey;
+#endif // #if (MEMPOOLS_TCACHE > 0)
+
+static MemSlabClass mempools_slabClasses[ MEMPOOLS_SLAB_CLASSES ];
+
+// Size class for each multiple of MEMPOOLS_SLAB_QUANTUM.
+static uint8_t mempools_slabClassOf[ (MEMPOOLS_SLAB_MAX / MEMPOOLS_SLAB_QUANTUM) + 1 ];
+
+// Arenas, and pages not in use by any class.
+static OSALCsT mempools_slabPagesCs = OSAL_CS_INIT(false, OSAL_CS_LEVEL_MEMPOOLS_PAGES);
+static DLL mempools_slabFreePages;
+static MemSlabArena mempools_slabArenas[ MEMPOOLS_SLAB_ARENAS ];
+static uint32_t mempools_slabNumArenas = 0;
+
+#if (MEMPOOLS_MMAP > 0)
+// Arenas by base address / MEMPOOLS_SLAB_BYTES, open addressed.  Never more
+// than half full, and entries are never removed.
+static MemSlabArena* volatile mempools_slabArenaTable[ 2 * MEMPOOLS_SLAB_ARENAS ];
+#else
+static uint8_t mempools_slabBuf[ MEMPOOLS_SLAB_BYTES ];
+#endif
+
+// Usage, for MemPoolsGetUsage().
+static volatile uint32_t mempools_slabCurUsed   = 0;
+static volatile uint32_t mempools_slabCurBlocks = 0;
+static volatile uint32_t mempools_slabMaxUsed   = 0;
+static volatile uint32_t mempools_slabMaxBlocks = 0;
+
+#endif // #if (MEMPOOLS_SLAB_BYTES > 0)
+
 
 #if (MEMPOOLS_DEBUG > 0)
 // We use a magic number to ensure that
@@ -85,25 +286,677 @@ typedef struct MemTag {
 #define Mem void
 #endif
 
+#if (MEMPOOLS_SLAB_BYTES > 0)
+#if (MEMPOOLS_TCACHE > 0)
+static void mempools_TCacheRelease(void* const pArg);
+#endif
+
+// ////////////////////////////////////////////////////////////////////////////
+static void mempools_SlabInit(void) {
+  size_t cls = 0;
+  for (size_t i = 0; i < ARRSZ(mempools_slabClassOf); i++) {
+    while (mempools_slabSizes[ cls ] < (i * MEMPOOLS_SLAB_QUANTUM)) {
+      cls++;
+    }
+    mempools_slabClassOf[ i ] = (uint8_t)cls;
+  }
+  for (size_t c = 0; c < MEMPOOLS_SLAB_CLASSES; c++) {
+    MemSlabClass* const pClass = &mempools_slabClasses[ c ];
+    OSALCsInit(&pClass->cs, false, OSAL_CS_LEVEL_MEMPOOLS);
+    DLL_Init(&pClass->pages);
+    pClass->size    = mempools_slabSizes[ c ];
+    pClass->perPage = MEMPOOLS_SLAB_PAGE / pClass->size;
+  }
+  DLL_Init(&mempools_slabFreePages);
+#if (MEMPOOLS_TCACHE > 0)
+  // Hands an exiting thread's pages back.
+  LOG_ASSERT_FN(0 == pthread_key_create(&mempools_tcacheKey, mempools_TCacheRelease));
+#endif
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Returns the arena holding pVoid, or nullptr if it is not in an arena.
+static inline MemSlabArena* mempools_SlabArenaOf(const void* const pVoid) {
+#if (MEMPOOLS_MMAP > 0)
+  const uintptr_t key   = (uintptr_t)pVoid / MEMPOOLS_SLAB_BYTES;
+  const uintptr_t mask  = ARRSZ(mempools_slabArenaTable) - 1;
+  MemSlabArena* pArena;
+  for (uintptr_t i = key & mask;; i = (i + 1) & mask) {
+    pArena = (MemSlabArena*)OSALAtomicLoadPtr((void* const volatile*)&mempools_slabArenaTable[ i ], OSAL_MO_ACQUIRE);
+    if ((nullptr == pArena) || (key == ((uintptr_t)pArena->pBase / MEMPOOLS_SLAB_BYTES))) {
+      break;
+    }
+  }
+  return pArena;
+#else
+  const uint8_t* const p8 = (const uint8_t*)pVoid;
+  return ((p8 >= mempools_slabBuf) && (p8 < &mempools_slabBuf[ MEMPOOLS_SLAB_BYTES ])) ? &mempools_slabArenas[ 0 ] : nullptr;
+#endif
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline MemSlabPage* mempools_SlabPageOf(MemSlabArena* const pArena, const void* const pVoid) {
+  return &pArena->pPages[ ((const uint8_t*)pVoid - pArena->pBase) / MEMPOOLS_SLAB_PAGE ];
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Maps another arena, or returns nullptr if there can be no more.  Call with
+// mempools_slabPagesCs.
+static MemSlabArena* mempools_SlabArenaAdd(void) {
+  if (mempools_slabNumArenas >= MEMPOOLS_SLAB_ARENAS) {
+    return nullptr;
+  }
+#if (MEMPOOLS_MMAP > 0)
+  // Map twice the size, and unmap what is outside of an aligned arena.
+  const size_t mapBytes = 2 * MEMPOOLS_SLAB_BYTES;
+  uint8_t* const pMap   = (uint8_t*)mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (MAP_FAILED == (void*)pMap) {
+    LOG_WARNING(("Could not map a slab arena.\r\n"));
+    return nullptr;
+  }
+  uint8_t* const pBase =
+    (uint8_t*)(((uintptr_t)pMap + MEMPOOLS_SLAB_BYTES - 1) & ~(uintptr_t)(MEMPOOLS_SLAB_BYTES - 1));
+  if (pBase > pMap) {
+    (void)munmap(pMap, pBase - pMap);
+  }
+  if (&pBase[ MEMPOOLS_SLAB_BYTES ] < &pMap[ mapBytes ]) {
+    (void)munmap(&pBase[ MEMPOOLS_SLAB_BYTES ], &pMap[ mapBytes ] - &pBase[ MEMPOOLS_SLAB_BYTES ]);
+  }
+#else
+  uint8_t* const pBase = mempools_slabBuf;
+#endif
+  MemSlabArena* const pArena = &mempools_slabArenas[ mempools_slabNumArenas++ ];
+  pArena->pBase       = pBase;
+  pArena->pPages      = (MemSlabPage*)pBase;
+  pArena->pagesCarved = mempools_slabHdrPages;
+  pArena->pagesUsed   = 0;
+#if (MEMPOOLS_MMAP > 0)
+  const uintptr_t mask = ARRSZ(mempools_slabArenaTable) - 1;
+  uintptr_t i          = ((uintptr_t)pBase / MEMPOOLS_SLAB_BYTES) & mask;
+  while (mempools_slabArenaTable[ i ]) {
+    i = (i + 1) & mask;
+  }
+  OSALAtomicStorePtr((void* volatile*)&mempools_slabArenaTable[ i ], pArena, OSAL_MO_RELEASE);
+#endif
+  return pArena;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static void mempools_SlabCount(const int32_t bytes, const int32_t blocks) {
+  const uint32_t used = OSALAtomicFetchAddU32(&mempools_slabCurUsed, (uint32_t)bytes, OSAL_MO_RELAXED) + bytes;
+  const uint32_t cnt  = OSALAtomicFetchAddU32(&mempools_slabCurBlocks, (uint32_t)blocks, OSAL_MO_RELAXED) + blocks;
+  if (bytes > 0) {
+    uint32_t max = OSALAtomicLoadU32(&mempools_slabMaxUsed, OSAL_MO_RELAXED);
+    while ((used > max) && (!OSALAtomicCasU32(&mempools_slabMaxUsed, &max, used, OSAL_MO_RELAXED))) {
+    }
+    max = OSALAtomicLoadU32(&mempools_slabMaxBlocks, OSAL_MO_RELAXED);
+    while ((cnt > max) && (!OSALAtomicCasU32(&mempools_slabMaxBlocks, &max, cnt, OSAL_MO_RELAXED))) {
+    }
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Current slab usage, including what threads have not added to the totals yet.
+static void mempools_SlabGetUsage(
+  uint32_t* const pCurUsed, uint32_t* const pCurBlocks, uint32_t* const pMaxUsed, uint32_t* const pMaxBlocks) {
+  uint32_t used = OSALAtomicLoadU32(&mempools_slabCurUsed, OSAL_MO_RELAXED);
+  uint32_t cnt  = OSALAtomicLoadU32(&mempools_slabCurBlocks, OSAL_MO_RELAXED);
+#if (MEMPOOLS_TCACHE > 0)
+  for (size_t i = 0; i < MEMPOOLS_TCACHE_MAX; i++) {
+    used += OSALAtomicLoadU32(&mempools_tcaches[ i ].deltaUsed, OSAL_MO_RELAXED);
+    cnt += OSALAtomicLoadU32(&mempools_tcaches[ i ].deltaBlocks, OSAL_MO_RELAXED);
+  }
+#endif
+  *pCurUsed   = used;
+  *pCurBlocks = cnt;
+  *pMaxUsed   = MAX(used, OSALAtomicLoadU32(&mempools_slabMaxUsed, OSAL_MO_RELAXED));
+  *pMaxBlocks = MAX(cnt, OSALAtomicLoadU32(&mempools_slabMaxBlocks, OSAL_MO_RELAXED));
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Takes a page that no class is using, or returns nullptr if there are none.
+static MemSlabPage* mempools_SlabPageGet(const uint8_t cls) {
+  OSALCsEnter(&mempools_slabPagesCs);
+  MemSlabPage* pPage = (MemSlabPage*)DLL_PopFront(&mempools_slabFreePages);
+  if (nullptr == pPage) {
+    // Carve a page from an arena that has some left, or from a new arena.
+    MemSlabArena* pArena = nullptr;
+    for (uint32_t i = 0; (nullptr == pArena) && (i < mempools_slabNumArenas); i++) {
+      if (mempools_slabArenas[ i ].pagesCarved < MEMPOOLS_SLAB_PAGES) {
+        pArena = &mempools_slabArenas[ i ];
+      }
+    }
+    if (nullptr == pArena) {
+      pArena = mempools_SlabArenaAdd();
+    }
+    if (pArena) {
+      pPage         = &pArena->pPages[ pArena->pagesCarved++ ];
+      pPage->pArena = pArena;
+    }
+  }
+  if (pPage) {
+    pPage->pArena->pagesUsed++;
+  }
+  OSALCsExit(&mempools_slabPagesCs);
+  if (pPage) {
+    DLL_NodeInit(&pPage->listNode);
+    pPage->pFree  = nullptr;
+    pPage->used   = 0;
+    pPage->carved = 0;
+    pPage->cls    = cls;
+#if (MEMPOOLS_TCACHE > 0)
+    pPage->pOwner      = nullptr;
+    pPage->pRemoteFree = nullptr;
+#endif
+  }
+  return pPage;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Gives back an empty, unlisted page.
+static void mempools_SlabPagePut(MemSlabPage* const pPage) {
+  OSALCsEnter(&mempools_slabPagesCs);
+  pPage->pArena->pagesUsed--;
+  DLL_PushFront(&mempools_slabFreePages, &pPage->listNode);
+  OSALCsExit(&mempools_slabPagesCs);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline bool mempools_SlabPageIsFull(const MemSlabPage* const pPage, const MemSlabClass* const pClass) {
+  return (nullptr == pPage->pFree) && (pPage->carved == pClass->perPage);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Takes a block from the page, or returns nullptr if it is full.  The caller
+// owns the page or holds its class's lock.
+static uint8_t* mempools_SlabPagePop(MemSlabPage* const pPage, const MemSlabClass* const pClass) {
+  uint8_t* pBlock = (uint8_t*)pPage->pFree;
+  if (pBlock) {
+    pPage->pFree = *(void**)pBlock;
+  } else if (pPage->carved < pClass->perPage) {
+    MemSlabArena* const pArena = pPage->pArena;
+    pBlock = pArena->pBase + ((size_t)(pPage - pArena->pPages) * MEMPOOLS_SLAB_PAGE) +
+             ((size_t)pPage->carved++ * pClass->size);
+  }
+  if (pBlock) {
+    pPage->used++;
+  }
+  return pBlock;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// After freeing onto a page that no thread owns: puts the page back on its
+// class's list if it was full.  Returns true if the page is now empty and
+// has been unlisted, for the caller to give back.  Call with the class's lock.
+static bool mempools_SlabRelist(MemSlabClass* const pClass, MemSlabPage* const pPage) {
+  bool release = false;
+  if (!DLL_NodeIsListed(&pPage->listNode)) {
+    DLL_PushFront(&pClass->pages, &pPage->listNode);
+  }
+  if (0 == pPage->used) {
+    // Give the page back, unless it's the only one the class has.
+    release = (DLL_GetFront(&pClass->pages) != DLL_GetBack(&pClass->pages));
+    if (release) {
+      DLL_NodeUnlist(&pPage->listNode);
+    }
+  }
+  return release;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Allocates from the pages that no thread owns.
+static uint8_t* mempools_SlabSharedAlloc(const uint8_t cls) {
+  MemSlabClass* const pClass = &mempools_slabClasses[ cls ];
+  uint8_t* pBlock = nullptr;
+
+  OSALCsEnter(&pClass->cs);
+  MemSlabPage* pPage = (MemSlabPage*)DLL_GetFront(&pClass->pages);
+  if (nullptr == pPage) {
+    pPage = mempools_SlabPageGet(cls);
+    if (pPage) {
+      DLL_PushBack(&pClass->pages, &pPage->listNode);
+    }
+  }
+  if (pPage) {
+    pBlock = mempools_SlabPagePop(pPage, pClass);
+    if (mempools_SlabPageIsFull(pPage, pClass)) {
+      DLL_NodeUnlist(&pPage->listNode);
+    }
+  }
+  OSALCsExit(&pClass->cs);
+  return pBlock;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Frees onto a page that no thread owns.  Returns false, without freeing, if
+// a thread has taken the page since the caller looked.
+static bool mempools_SlabSharedFree(MemSlabPage* const pPage, void* const pVoid) {
+  MemSlabClass* const pClass = &mempools_slabClasses[ pPage->cls ];
+  bool release = false;
+
+  OSALCsEnter(&pClass->cs);
+#if (MEMPOOLS_TCACHE > 0)
+  if (pPage->pOwner) {
+    OSALCsExit(&pClass->cs);
+    return false;
+  }
+#endif
+  LOG_ASSERT(pPage->used > 0);
+  *(void**)pVoid = pPage->pFree;
+  pPage->pFree   = pVoid;
+  pPage->used--;
+  release = mempools_SlabRelist(pClass, pPage);
+  OSALCsExit(&pClass->cs);
+
+  if (release) {
+    mempools_SlabPagePut(pPage);
+  }
+  return true;
+}
+
+#if (MEMPOOLS_TCACHE > 0)
+// ////////////////////////////////////////////////////////////////////////////
+// Moves the blocks other threads freed onto the page to its free list.  The
+// caller owns the page or holds its class's lock.  Returns how many there were.
+static uint32_t mempools_SlabPageCollect(MemSlabPage* const pPage) {
+  void* pList = OSALAtomicLoadPtr(&pPage->pRemoteFree, OSAL_MO_RELAXED);
+  while ((pList) && (!OSALAtomicCasPtr(&pPage->pRemoteFree, &pList, nullptr, OSAL_MO_SEQ_CST))) {
+  }
+  uint32_t n = 0;
+  if (pList) {
+    void* pTail = pList;
+    n           = 1;
+    while (*(void**)pTail) {
+      pTail = *(void**)pTail;
+      n++;
+    }
+    *(void**)pTail = pPage->pFree;
+    pPage->pFree   = pList;
+    LOG_ASSERT(pPage->used >= n);
+    pPage->used -= n;
+  }
+  return n;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline MemTCache* mempools_SlabPageOwner(const MemSlabPage* const pPage, const OSALMemOrderT mo) {
+  return (MemTCache*)OSALAtomicLoadPtr((void* const volatile*)&pPage->pOwner, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Gets the calling thread's cache, or MEMPOOLS_TCACHE_NONE if it has none.
+static MemTCache* mempools_TCache(void) {
+  MemTCache* pCache = mempools_pTCache;
+  if (nullptr == pCache) {
+    pCache = MEMPOOLS_TCACHE_NONE;
+    for (size_t i = 0; i < MEMPOOLS_TCACHE_MAX; i++) {
+      if (OSALTestAndSet(&mempools_tcaches[ i ].inUse)) {
+        pCache = &mempools_tcaches[ i ];
+        for (size_t c = 0; c < MEMPOOLS_SLAB_CLASSES; c++) {
+          pCache->bins[ c ].pCur = nullptr;
+          DLL_Init(&pCache->bins[ c ].room);
+          DLL_Init(&pCache->bins[ c ].full);
+        }
+        (void)pthread_setspecific(mempools_tcacheKey, pCache);
+        break;
+      }
+    }
+    mempools_pTCache = pCache;
+  }
+  return pCache;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Counts usage against the thread, and adds it to the totals once it is big
+// enough to matter.
+static void mempools_TCacheCount(MemTCache* const pCache, const int32_t bytes, const int32_t blocks) {
+  if (MEMPOOLS_TCACHE_NONE == pCache) {
+    mempools_SlabCount(bytes, blocks);
+    return;
+  }
+  const int32_t used = (int32_t)pCache->deltaUsed + bytes;
+  const int32_t cnt  = (int32_t)pCache->deltaBlocks + blocks;
+  if ((used > MEMPOOLS_TCACHE_FLUSH_BYTES) || (used < -MEMPOOLS_TCACHE_FLUSH_BYTES)) {
+    OSALAtomicStoreU32(&pCache->deltaUsed, 0, OSAL_MO_RELAXED);
+    OSALAtomicStoreU32(&pCache->deltaBlocks, 0, OSAL_MO_RELAXED);
+    mempools_SlabCount(used, cnt);
+  } else {
+    OSALAtomicStoreU32(&pCache->deltaUsed, (uint32_t)used, OSAL_MO_RELAXED);
+    OSALAtomicStoreU32(&pCache->deltaBlocks, (uint32_t)cnt, OSAL_MO_RELAXED);
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Gives up a page the thread owns.  Empty pages go back to the free pages,
+// others to the pages no thread owns.
+static void mempools_TCacheDisown(MemSlabPage* const pPage) {
+  MemSlabClass* const pClass = &mempools_slabClasses[ pPage->cls ];
+  bool release = false;
+  OSALCsEnter(&pClass->cs);
+  // Threads that free onto the page from now on see that nobody owns it and
+  // collect their own blocks.  Get the ones freed before that.
+  OSALAtomicStorePtr((void* volatile*)&pPage->pOwner, nullptr, OSAL_MO_SEQ_CST);
+  (void)mempools_SlabPageCollect(pPage);
+  if (0 == pPage->used) {
+    release = true;
+  } else if (!mempools_SlabPageIsFull(pPage, pClass)) {
+    DLL_PushBack(&pClass->pages, &pPage->listNode);
+  }
+  OSALCsExit(&pClass->cs);
+  if (release) {
+    mempools_SlabPagePut(pPage);
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Replaces the thread's full current page with one that has room: one of its
+// own that other threads freed onto, one that no thread owns, or a new one.
+// Returns false if there are no pages left.
+static bool mempools_TCacheRefill(MemTCache* const pCache, const uint8_t cls) {
+  MemSlabClass* const pClass = &mempools_slabClasses[ cls ];
+  MemTCacheBin* const pBin   = &pCache->bins[ cls ];
+  const uint32_t bit         = 1u << cls;
+
+  if (OSALAtomicFetchAndU32(&pCache->remotePending, ~bit, OSAL_MO_ACQUIRE) & bit) {
+    DLLNode* pIter       = DLL_Begin(&pBin->full);
+    DLLNode* const pEnd  = DLL_End(&pBin->full);
+    while (pIter != pEnd) {
+      MemSlabPage* const pPage = (MemSlabPage*)pIter;
+      pIter                    = pIter->pNext;
+      if (mempools_SlabPageCollect(pPage)) {
+        DLL_NodeUnlist(&pPage->listNode);
+        if (0 == pPage->used) {
+          mempools_SlabPagePut(pPage);
+        } else {
+          DLL_PushBack(&pBin->room, &pPage->listNode);
+        }
+      }
+    }
+  }
+  if (pBin->pCur) {
+    DLL_PushBack(&pBin->full, &pBin->pCur->listNode);
+  }
+
+  MemSlabPage* pPage = (MemSlabPage*)DLL_PopFront(&pBin->room);
+  if (nullptr == pPage) {
+    OSALCsEnter(&pClass->cs);
+    pPage = (MemSlabPage*)DLL_PopFront(&pClass->pages);
+    if (pPage) {
+      OSALAtomicStorePtr((void* volatile*)&pPage->pOwner, pCache, OSAL_MO_SEQ_CST);
+      (void)mempools_SlabPageCollect(pPage);
+    }
+    OSALCsExit(&pClass->cs);
+  }
+  if (nullptr == pPage) {
+    pPage = mempools_SlabPageGet(cls);
+    if (pPage) {
+      OSALAtomicStorePtr((void* volatile*)&pPage->pOwner, pCache, OSAL_MO_RELEASE);
+    }
+  }
+  pBin->pCur = pPage;
+  return nullptr != pPage;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static uint8_t* mempools_TCacheAlloc(MemTCache* const pCache, const uint8_t cls) {
+  const MemSlabClass* const pClass = &mempools_slabClasses[ cls ];
+  MemTCacheBin* const pBin         = &pCache->bins[ cls ];
+  uint8_t* pBlock                  = nullptr;
+  if (pBin->pCur) {
+    pBlock = mempools_SlabPagePop(pBin->pCur, pClass);
+    if ((nullptr == pBlock) && (mempools_SlabPageCollect(pBin->pCur))) {
+      pBlock = mempools_SlabPagePop(pBin->pCur, pClass);
+    }
+  }
+  if ((nullptr == pBlock) && (mempools_TCacheRefill(pCache, cls))) {
+    pBlock = mempools_SlabPagePop(pBin->pCur, pClass);
+  }
+  return pBlock;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Frees onto a page the thread owns.
+static void mempools_TCacheFree(MemTCache* const pCache, MemSlabPage* const pPage, void* const pVoid) {
+  const MemSlabClass* const pClass = &mempools_slabClasses[ pPage->cls ];
+  MemTCacheBin* const pBin         = &pCache->bins[ pPage->cls ];
+  const bool wasFull               = mempools_SlabPageIsFull(pPage, pClass);
+  LOG_ASSERT(pPage->used > 0);
+  *(void**)pVoid = pPage->pFree;
+  pPage->pFree   = pVoid;
+  pPage->used--;
+  if (pPage != pBin->pCur) {
+    if (0 == pPage->used) {
+      DLL_NodeUnlist(&pPage->listNode);
+      mempools_SlabPagePut(pPage);
+    } else if (wasFull) {
+      DLL_NodeUnlist(&pPage->listNode);
+      DLL_PushBack(&pBin->room, &pPage->listNode);
+    }
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Frees onto a page another thread owns, for the owner to collect.
+static void mempools_TCacheRemoteFree(MemSlabPage* const pPage, void* const pVoid) {
+  // Once the block is on the list the page can be collected, emptied and
+  // reused, so read its class first.
+  const uint8_t cls          = pPage->cls;
+  MemSlabClass* const pClass = &mempools_slabClasses[ cls ];
+  void* pHead                = OSALAtomicLoadPtr(&pPage->pRemoteFree, OSAL_MO_RELAXED);
+  do {
+    *(void**)pVoid = pHead;
+  } while (!OSALAtomicCasPtr(&pPage->pRemoteFree, &pHead, pVoid, OSAL_MO_SEQ_CST));
+
+  for (;;) {
+    MemTCache* const pOwner = mempools_SlabPageOwner(pPage, OSAL_MO_SEQ_CST);
+    if (nullptr == pOwner) {
+      // The owner exited, so nobody will collect the block.  Do it here.
+      bool release = false;
+      OSALCsEnter(&pClass->cs);
+      if ((cls == pPage->cls) && (nullptr == pPage->pOwner) && (mempools_SlabPageCollect(pPage))) {
+        release = mempools_SlabRelist(pClass, pPage);
+      }
+      OSALCsExit(&pClass->cs);
+      if (release) {
+        mempools_SlabPagePut(pPage);
+      }
+      break;
+    }
+    // Tell the owner to look at its full pages.
+    (void)OSALAtomicFetchOrU32(&pOwner->remotePending, 1u << cls, OSAL_MO_RELEASE);
+    if (pOwner == mempools_SlabPageOwner(pPage, OSAL_MO_SEQ_CST)) {
+      break;
+    }
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Called when a thread that had a cache exits.
+static void mempools_TCacheRelease(void* const pArg) {
+  MemTCache* const pCache = (MemTCache*)pArg;
+  // Frees from here on, e.g. from other destructors, use the shared pages.
+  mempools_pTCache = MEMPOOLS_TCACHE_NONE;
+  for (size_t c = 0; c < MEMPOOLS_SLAB_CLASSES; c++) {
+    MemTCacheBin* const pBin = &pCache->bins[ c ];
+    if (pBin->pCur) {
+      mempools_TCacheDisown(pBin->pCur);
+      pBin->pCur = nullptr;
+    }
+    MemSlabPage* pPage;
+    while (nullptr != (pPage = (MemSlabPage*)DLL_PopFront(&pBin->room))) {
+      mempools_TCacheDisown(pPage);
+    }
+    while (nullptr != (pPage = (MemSlabPage*)DLL_PopFront(&pBin->full))) {
+      mempools_TCacheDisown(pPage);
+    }
+  }
+  mempools_SlabCount((int32_t)pCache->deltaUsed, (int32_t)pCache->deltaBlocks);
+  OSALAtomicStoreU32(&pCache->deltaUsed, 0, OSAL_MO_RELAXED);
+  OSALAtomicStoreU32(&pCache->deltaBlocks, 0, OSAL_MO_RELAXED);
+  OSALAtomicStoreU32(&pCache->remotePending, 0, OSAL_MO_RELAXED);
+  OSALClearFlag((bool*)&pCache->inUse);
+}
+#endif // #if (MEMPOOLS_TCACHE > 0)
+
+// ////////////////////////////////////////////////////////////////////////////
+// Returns a block of at least sz bytes, zeroed if zero is set, or nullptr if
+// sz is too large for the slabs or they are full.
+static void* mempools_SlabAlloc(const size_t sz, const bool zero) {
+  if (sz > MEMPOOLS_SLAB_MAX) {
+    return nullptr;
+  }
+  const uint8_t cls = mempools_slabClassOf[ (sz + MEMPOOLS_SLAB_QUANTUM - 1) / MEMPOOLS_SLAB_QUANTUM ];
+  const int32_t size = mempools_slabClasses[ cls ].size;
+  uint8_t* pBlock;
+#if (MEMPOOLS_TCACHE > 0)
+  MemTCache* const pCache = mempools_TCache();
+  if (MEMPOOLS_TCACHE_NONE != pCache) {
+    pBlock = mempools_TCacheAlloc(pCache, cls);
+  } else {
+    pBlock = mempools_SlabSharedAlloc(cls);
+  }
+  if (pBlock) {
+    mempools_TCacheCount(pCache, size, 1);
+  }
+#else
+  pBlock = mempools_SlabSharedAlloc(cls);
+  if (pBlock) {
+    mempools_SlabCount(size, 1);
+  }
+#endif
+  if ((pBlock) && (zero)) {
+    memset(pBlock, 0, sz);
+  }
+  return pBlock;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static void mempools_SlabFree(MemSlabArena* const pArena, void* const pVoid) {
+  MemSlabPage* const pPage = mempools_SlabPageOf(pArena, pVoid);
+  const int32_t size       = mempools_slabClasses[ pPage->cls ].size;
+#if (MEMPOOLS_TCACHE > 0)
+  MemTCache* const pCache = mempools_TCache();
+  MemTCache* const pOwner = mempools_SlabPageOwner(pPage, OSAL_MO_ACQUIRE);
+  if (pOwner == pCache) {
+    mempools_TCacheFree(pCache, pPage, pVoid);
+  } else if ((pOwner) || (!mempools_SlabSharedFree(pPage, pVoid))) {
+    mempools_TCacheRemoteFree(pPage, pVoid);
+  }
+  mempools_TCacheCount(pCache, -size, -1);
+#else
+  (void)mempools_SlabSharedFree(pPage, pVoid);
+  mempools_SlabCount(-size, -1);
+#endif
+}
+#endif // #if (MEMPOOLS_SLAB_BYTES > 0)
+
+// Blocks from the buffer allocator start with their size, so that
+// MemPoolsRealloc() knows how much can be used in place.
+#define MEMPOOLS_BIG_HDR sizeof(align_mask_t)
+
+// ////////////////////////////////////////////////////////////////////////////
+// A block from the slabs if it fits, otherwise from the buffer allocator.
+// The buffer allocator always zeroes; slab blocks are zeroed only if zero is
+// set.
+static void* mempools_Alloc(const size_t sz, const bool zero) {
+#if (MEMPOOLS_SLAB_BYTES > 0)
+  void* const pMem = mempools_SlabAlloc(sz, zero);
+  if (pMem) {
+    return pMem;
+  }
+#else
+  (void)zero;
+#endif
+  align_mask_t* const pBig = (align_mask_t*)mbedtls_calloc(1, sz + MEMPOOLS_BIG_HDR);
+  if (nullptr == pBig) {
+    return nullptr;
+  }
+  *pBig = (align_mask_t)sz;
+  return &pBig[ 1 ];
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Free a block from mempools_Alloc().
+static void mempools_Release(void* const pVoid) {
+#if (MEMPOOLS_SLAB_BYTES > 0)
+  MemSlabArena* const pArena = mempools_SlabArenaOf(pVoid);
+  if (pArena) {
+    mempools_SlabFree(pArena, pVoid);
+    return;
+  }
+#endif
+  mbedtls_free((uint8_t*)pVoid - MEMPOOLS_BIG_HDR);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Bytes of a block from mempools_Alloc() that can be used.
+static size_t mempools_UsableSize(const void* const pVoid) {
+#if (MEMPOOLS_SLAB_BYTES > 0)
+  MemSlabArena* const pArena = mempools_SlabArenaOf(pVoid);
+  if (pArena) {
+    return mempools_slabClasses[ mempools_SlabPageOf(pArena, pVoid)->cls ].size;
+  }
+#endif
+  return (size_t)((const align_mask_t*)pVoid)[ -1 ];
+}
+
 extern "C" {
 
 // ////////////////////////////////////////////////////////////////////////////
-void MemPoolsInitialize(void) {
+void MemPoolsInitialize(const size_t heapBytes) {
   if (!mInitialized) {
     mInitialized = true;
     MbedInitThreadingAlt();
-    mbedtls_memory_buffer_alloc_init(mempools_buf, sizeof(mempools_buf));
+#if (MEMPOOLS_SLAB_BYTES > 0)
+    mempools_SlabInit();
+#endif
+    mempools_heapBytes = (heapBytes) ? heapBytes : MEMPOOLS_HEAP_BYTES;
+#if (MEMPOOLS_MMAP > 0)
+    mempools_buf = (uint8_t *)mmap(
+      nullptr, mempools_heapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    LOG_ASSERT(MAP_FAILED != (void *)mempools_buf);
+#else
+    LOG_ASSERT_WARN(mempools_heapBytes <= sizeof(mempools_heapBuf));
+    mempools_heapBytes = MIN(mempools_heapBytes, sizeof(mempools_heapBuf));
+#endif
+    mempools_buf_start = (align_mask_t)&mempools_buf[0];
+    mempools_buf_end = (align_mask_t)&mempools_buf[mempools_heapBytes];
+    mbedtls_memory_buffer_alloc_init(mempools_buf, mempools_heapBytes);
     (void)MEMPOOLS_MAGIC;
   }
 }
 
+// ////////////////////////////////////////////////////////////////////////////
+size_t MemPoolsTrim(void) {
+  size_t released = 0;
+#if (MEMPOOLS_SLAB_BYTES > 0) && (MEMPOOLS_MMAP > 0)
+  OSALCsEnter(&mempools_slabPagesCs);
+  for (uint32_t i = 0; i < mempools_slabNumArenas; i++) {
+    MemSlabArena* const pArena = &mempools_slabArenas[ i ];
+    if ((0 == pArena->pagesUsed) && (pArena->pagesCarved > mempools_slabHdrPages)) {
+      // Every page carved from the arena is on the free pages.  Take them
+      // off, and carve them afresh when they are needed again.
+      for (uint32_t pg = mempools_slabHdrPages; pg < pArena->pagesCarved; pg++) {
+        DLL_NodeUnlist(&pArena->pPages[ pg ].listNode);
+      }
+      const size_t bytes = (size_t)(pArena->pagesCarved - mempools_slabHdrPages) * MEMPOOLS_SLAB_PAGE;
+      (void)madvise(&pArena->pBase[ mempools_slabHdrPages * MEMPOOLS_SLAB_PAGE ], bytes, MADV_DONTNEED);
+      pArena->pagesCarved = mempools_slabHdrPages;
+      released += bytes;
+    }
+  }
+  OSALCsExit(&mempools_slabPagesCs);
+#endif
+  return released;
+}
+
 // ////////////////////////////////////////////////////////////////////////////
 static void mempools_DynamicInit(){
   LOG_WARNING(("Your test case has forgotten to initialize osal. I am doing it for you.\r\n"));
   OSALInit();
   if (!mInitialized){
     LOG_WARNING(("Your OSAL has forgotten to initialize mempools. I am doing it for you.\r\n"));
-    MemPoolsInitialize();
+    MemPoolsInitialize(0);
   }
 }
 
@@ -120,6 +973,11 @@ static bool mempools_IsWithinPool(void *pVoid) {
     {
       isWithinPool = true;
     }
+#if (MEMPOOLS_SLAB_BYTES > 0)
+    else if (mempools_SlabArenaOf(pVoid)) {
+      isWithinPool = true;
+    }
+#endif
   }
   return isWithinPool;
 }
@@ -138,64 +996,112 @@ static Mem * mempools_GetHdr(void *pVoid) {
 }
 #endif
 
+// ////////////////////////////////////////////////////////////////////////////
+// Passes an allocation, free or realloc to the trace hook, if any.
+// See MemPoolsTraceFnT.
+static inline void mempools_Trace(const void * const pOld, const void * const pVoid, const size_t sz) {
+  const MemPoolsTraceFnT pFn = (MemPoolsTraceFnT)OSALAtomicLoadPtr(
+    (void * const volatile *)&mempools_pTraceFn, OSAL_MO_ACQUIRE);
+  if ((pFn) && (pVoid)) {
+    pFn(mempools_pTraceData, pOld, pVoid, sz);
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Moves the sampler's record of the block at oldAddr to pNew, which may be
+// the same block, with its new size.  oldAddr is only a key; the block may
+// already be gone.
+static inline void mempools_SampleRealloc(
+  const uintptr_t oldAddr,
+  void * const pNew,
+  const size_t sz,
+  const uint8_t id,
+  const char * const pF,
+  const int line,
+  const void * const pCaller)
+{
+#if (MEMPOOLS_SAMPLE > 0)
+  mempools_SampleFree((void *)oldAddr);
+  mempools_SampleAlloc(pNew, sz, id, pF, line, pCaller);
+#else
+  (void)oldAddr;
+  (void)pNew;
+  (void)sz;
+  (void)id;
+  (void)pF;
+  (void)line;
+  (void)pCaller;
+#endif
+}
+
 // ////////////////////////////////////////////////////////////////////////////
 #if (!MEMPOOLS_DEBUG)
-// Debug disabled.
-void *MemPoolsMallocWithId(
+// Debug disabled.  Not traced, see mempools_Malloc().
+static void *mempools_MallocUntraced(
   const size_t sz,
   const uint8_t id,
-  const bool useHeap)
+  const bool useHeap,
+  const bool zero,
+  const char * const pF,
+  const int line,
+  const void * const pCaller)
 {
   MP_INIT();
   (void)useHeap;
   (void)id;
+  (void)pF;
+  (void)line;
+  (void)pCaller;
   // Cannot assign ID if MEMPOOLS_DEBUG is disabled.
-  void * const pMem = mbedtls_calloc(1, sz);
-  if (pMem) {
-    return pMem;
-  }
-  else {
+  void * pMem = mempools_Alloc(sz, zero);
+  if (nullptr == pMem) {
     static int heapAllocs = 0;
     if (1 == (++heapAllocs & 0xff)) {
       LOG_WARNING(("%d heap allocations!\r\n", heapAllocs));
     }
-    return calloc(1, sz);
+    pMem = (zero) ? calloc(1, sz) : malloc(sz);
+  }
+#if (MEMPOOLS_SAMPLE > 0)
+  if (pMem) {
+    mempools_SampleAlloc(pMem, sz, id, pF, line, pCaller);
   }
+#endif
+  return pMem;
 }
 #endif
 
 #if (MEMPOOLS_DEBUG > 0)
-// Debug enabled
+// Debug enabled.  Not traced, see mempools_Malloc().
 // ////////////////////////////////////////////////////////////////////////////
-#if (MEMPOOLS_DEBUG_FILETRACE > 0)
-void *_MemPoolsMallocWithId(
-#else // #if (MEMPOOLS_DEBUG_FILETRACE > 0)
-void *MemPoolsMallocWithId(
-#endif
+static void *mempools_MallocUntraced(
   const size_t sz,
   const uint8_t id,
-  const bool useHeap
-#if (MEMPOOLS_DEBUG_FILETRACE > 0)
-  ,const char * const pF,
-  const int line
-#endif
-)
+  const bool useHeap,
+  const bool zero,
+  const char * const pF,
+  const int line,
+  const void * const pCaller)
 {
   MP_INIT();
   void *pRval = 0;
   if (!useHeap) {
     const size_t szWithMagic = sz + sizeof(MemChkHdr);
     Mem * const pMem = (Mem *)
-      mbedtls_calloc(1, szWithMagic);
+      mempools_Alloc(szWithMagic, zero);
     if (pMem) {
       LOG_ASSERT(mempools_IsWithinPool(pMem));
       memcpy(&pMem->hdr.magic, &MEMPOOLS_MAGIC, sizeof(pMem->hdr.magic));
+      // The block may not be zeroed, and DLL_NodeInit() checks the links.
+      pMem->hdr.listNode.pNext = pMem->hdr.listNode.pPrev = NULL;
       DLL_NodeInit(&pMem->hdr.listNode);
       pMem->hdr.id = id;
 #if (MEMPOOLS_DEBUG_FILETRACE > 0)
       pMem->hdr.pFile = pF;
       pMem->hdr.line = line;
       pMem->hdr.ts = OSALGetMS();
+#else
+      (void)pF;
+      (void)line;
 #endif
       {
         CSTaskLocker cs;
@@ -213,13 +1119,126 @@ void *MemPoolsMallocWithId(
   if (nullptr == pRval) {
     // Cannot assign ID to heap objects.
     LOG_ASSERT(0 == id);
-    pRval = calloc(1, sz);
+    pRval = (zero) ? calloc(1, sz) : malloc(sz);
   }
   LOG_ASSERT(pRval);
+#if (MEMPOOLS_SAMPLE > 0)
+  if (pRval) {
+    mempools_SampleAlloc(pRval, sz, id, pF, line, pCaller);
+  }
+#else
+  (void)pCaller;
+#endif
   return pRval;
 }
 #endif // MEMPOOLS_DEBUG
 
+// ////////////////////////////////////////////////////////////////////////////
+static inline void *mempools_Malloc(
+  const size_t sz,
+  const uint8_t id,
+  const bool useHeap,
+  const bool zero,
+  const char * const pF,
+  const int line,
+  const void * const pCaller)
+{
+  void * const pRval = mempools_MallocUntraced(sz, id, useHeap, zero, pF, line, pCaller);
+  mempools_Trace(nullptr, pRval, sz);
+  return pRval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+#if (MEMPOOLS_DEBUG_FILETRACE > 0)
+void *_MemPoolsMallocWithId(
+  const size_t sz,
+  const uint8_t id,
+  const bool useHeap,
+  const char * const pF,
+  const int line)
+{
+  return mempools_Malloc(sz, id, useHeap, true, pF, line, MEMPOOLS_CALLER());
+}
+#else // #if (MEMPOOLS_DEBUG_FILETRACE > 0)
+void *MemPoolsMallocWithId(
+  const size_t sz,
+  const uint8_t id,
+  const bool useHeap)
+{
+  return mempools_Malloc(sz, id, useHeap, true, "", -1, MEMPOOLS_CALLER());
+}
+#endif
+
+// ////////////////////////////////////////////////////////////////////////////
+#if (MEMPOOLS_DEBUG_FILETRACE > 0)
+void *_MemPoolsMallocNoZero(
+  const size_t sz,
+  const char * const pF,
+  const int line)
+{
+  return mempools_Malloc(sz, 0, false, false, pF, line, MEMPOOLS_CALLER());
+}
+#else // #if (MEMPOOLS_DEBUG_FILETRACE > 0)
+void *MemPoolsMallocNoZero(const size_t sz) {
+  return mempools_Malloc(sz, 0, false, false, "", -1, MEMPOOLS_CALLER());
+}
+#endif
+
+static void mempools_Free(void *pVoid, const char * const pFile, const int line);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Grows or shrinks in place if the block already has room, otherwise moves.
+#if (MEMPOOLS_DEBUG_FILETRACE > 0)
+void *_MemPoolsRealloc(
+  void *pVoid,
+  const size_t sz,
+  const char * const pF,
+  const int line)
+{
+#else // #if (MEMPOOLS_DEBUG_FILETRACE > 0)
+void *MemPoolsRealloc(void *pVoid, const size_t sz) {
+  const char * const pF = "";
+  const int line = -1;
+#endif
+  MP_INIT();
+  const void * const pCaller = MEMPOOLS_CALLER();
+  if (nullptr == pVoid) {
+    return mempools_Malloc(sz, 0, false, false, pF, line, pCaller);
+  }
+  if (!mempools_IsWithinPool(pVoid)) {
+    // Only the old address is sampled and traced, never read, once realloc()
+    // has freed it.
+    const volatile uintptr_t oldAddr = (uintptr_t)pVoid;
+    void * const pNew = realloc(pVoid, sz);
+    if (pNew) {
+      mempools_SampleRealloc(oldAddr, pNew, sz, 0, pF, line, pCaller);
+    }
+    mempools_Trace((const void *)oldAddr, pNew, sz);
+    return pNew;
+  }
+#if (MEMPOOLS_DEBUG > 0)
+  Mem * const pMem = mempools_GetHdr(pVoid);
+  LOG_ASSERT((pMem) && (MEMPOOLS_MAGIC == pMem->hdr.magic));
+  const size_t usable = mempools_UsableSize(pMem) - sizeof(MemChkHdr);
+  const uint8_t id = (uint8_t)pMem->hdr.id;
+#else
+  const size_t usable = mempools_UsableSize(pVoid);
+  const uint8_t id = 0;
+#endif
+  if (sz <= usable) {
+    mempools_SampleRealloc((uintptr_t)pVoid, pVoid, sz, id, pF, line, pCaller);
+    mempools_Trace(pVoid, pVoid, sz);
+    return pVoid;
+  }
+  void * const pNew = mempools_MallocUntraced(sz, id, false, false, pF, line, pCaller);
+  if (pNew) {
+    memcpy(pNew, pVoid, usable);
+    mempools_Free(pVoid, pF, line);
+    mempools_Trace(pVoid, pNew, sz);
+  }
+  return pNew;
+}
+
 #if (MEMPOOLS_DEBUG > 0)
 // ////////////////////////////////////////////////////////////////////////////
 // With debugging enabled, checks that the memory hasn't been corrupted.
@@ -283,11 +1302,31 @@ void _MemPoolsFree(
 ) {
 #else
 void MemPoolsFree(void *pVoid) {
+  const char * const pFile = "";
+  const int line = -1;
 #endif
   MP_INIT();
+  mempools_Trace(nullptr, pVoid, 0);
+  mempools_Free(pVoid, pFile, line);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// MemPoolsFree(), but not traced.
+static void mempools_Free(
+  void *pVoid,
+  const char * const pFile,
+  const int line
+) {
+  (void)pFile;
+  (void)line;
+#if (MEMPOOLS_SAMPLE > 0)
+  if (pVoid) {
+    mempools_SampleFree(pVoid);
+  }
+#endif
   if (mempools_IsWithinPool(pVoid)){
 #if (!MEMPOOLS_DEBUG)
-    mbedtls_free(pVoid);
+    mempools_Release(pVoid);
 #else
     Mem * const pMem = mempools_GetHdr(pVoid);
     if (pMem){
@@ -315,7 +1354,7 @@ void MemPoolsFree(void *pVoid) {
           pMem->hdr.ts = OSALGetMS();
 #endif
         }
-        mbedtls_free(pMem);
+        mempools_Release(pMem);
       }
     }
 #endif
@@ -371,18 +1410,40 @@ void MemPoolsPrintUsage(void) {
     mbedtls_memory_buffer_alloc_cur_get(&cur_used, &cur_blocks);
     LOG_TRACE(("MemPools: Current: %u/%u (%u pct), Blocks: %u\r\n",
       cur_used,
-      MEMPOOLS_HEAP_BYTES,
-      (int)(0.5f + (100.0f * cur_used) / ((float)MEMPOOLS_HEAP_BYTES)),
+      (unsigned)mempools_heapBytes,
+      (int)(0.5f + (100.0f * cur_used) / ((float)mempools_heapBytes)),
       cur_blocks));
 
     mbedtls_memory_buffer_alloc_max_get(&cur_used, &cur_blocks);
     LOG_TRACE(("MemPools: Maximum: %u/%u (%u pct), Blocks: %u\r\n",
       cur_used,
-      MEMPOOLS_HEAP_BYTES,
-      (int)(0.5f + (100.0f * cur_used) / ((float)MEMPOOLS_HEAP_BYTES)),
+      (unsigned)mempools_heapBytes,
+      (int)(0.5f + (100.0f * cur_used) / ((float)mempools_heapBytes)),
       cur_blocks));
   }
 #endif
+#if (MEMPOOLS_SLAB_BYTES > 0)
+  uint32_t slabUsed, slabBlocks, slabMaxUsed, slabMaxBlocks;
+  mempools_SlabGetUsage(&slabUsed, &slabBlocks, &slabMaxUsed, &slabMaxBlocks);
+  uint32_t pagesUsed = 0;
+  uint32_t numArenas;
+  {
+    OSALCsEnter(&mempools_slabPagesCs);
+    numArenas = mempools_slabNumArenas;
+    for (uint32_t i = 0; i < numArenas; i++) {
+      pagesUsed += mempools_slabArenas[ i ].pagesUsed;
+    }
+    OSALCsExit(&mempools_slabPagesCs);
+  }
+  LOG_TRACE(("MemPools: Slabs: %u/%u bytes in %u blocks, max %u bytes in %u blocks, %u pages used in %u arenas\r\n",
+    slabUsed,
+    (unsigned)(numArenas * (MEMPOOLS_SLAB_PAGES - mempools_slabHdrPages) * MEMPOOLS_SLAB_PAGE),
+    slabBlocks,
+    slabMaxUsed,
+    slabMaxBlocks,
+    pagesUsed,
+    numArenas));
+#endif
 }
 
 // ////////////////////////////////////////////////////////////////////////////
@@ -399,6 +1460,17 @@ void MemPoolsGetUsage(
   CSTaskLocker cs;
   mbedtls_memory_buffer_alloc_cur_get(&cur_used, &cur_blocks);
   mbedtls_memory_buffer_alloc_max_get(&max_used, &max_blocks);
+#endif
+#if (MEMPOOLS_SLAB_BYTES > 0)
+  // Both allocators together.  The maxima are the sums of each one's maximum.
+  // Threads add their slab usage to the maxima in MEMPOOLS_TCACHE_FLUSH_BYTES
+  // steps, so those can be low by that much per thread.
+  uint32_t slabUsed, slabBlocks, slabMaxUsed, slabMaxBlocks;
+  mempools_SlabGetUsage(&slabUsed, &slabBlocks, &slabMaxUsed, &slabMaxBlocks);
+  cur_used += slabUsed;
+  cur_blocks += slabBlocks;
+  max_used += slabMaxUsed;
+  max_blocks += slabMaxBlocks;
 #endif
   if (pcur_used) *pcur_used = cur_used;
   if (pcur_blocks) *pcur_blocks = cur_blocks;
@@ -406,6 +1478,14 @@ void MemPoolsGetUsage(
   if (pmax_blocks) *pmax_blocks = max_blocks;
 }
 
+// ////////////////////////////////////////////////////////////////////////////
+// Calls pFn for every allocation and free from now on, or stops if NULL.
+void MemPoolsSetTraceHook(MemPoolsTraceFnT pFn, void *pUserData) {
+  OSALAtomicStorePtr((void * volatile *)&mempools_pTraceFn, nullptr, OSAL_MO_RELEASE);
+  mempools_pTraceData = pUserData;
+  OSALAtomicStorePtr((void * volatile *)&mempools_pTraceFn, (void *)pFn, OSAL_MO_RELEASE);
+}
+
 // ////////////////////////////////////////////////////////////////////////////
 // Override new/delete
 // Enable this after platform startup on an embedded system so that strings, etc, will use mempools
@@ -486,7 +1566,12 @@ void  operator delete[](void* ptr) {
 
 #else // #if (!NO_MEMPOOLS)
 extern "C" {
-void MemPoolsInitialize() {
+void MemPoolsInitialize(const size_t heapBytes) {
+  (void)heapBytes;
+}
+
+size_t MemPoolsTrim(void) {
+  return 0;
 }
 
 }
@@ -24,6 +24,26 @@
 #define NO_MEMPOOLS 0
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sets up the pools.  heapBytes sizes the pool for blocks too big for the
+// slabs, or 0 for MEMPOOLS_HEAP_BYTES.  On hosts it is mapped here rather
+// than reserved in BSS; embedded builds cannot go above MEMPOOLS_HEAP_BYTES.
+// OSALInit() calls this with 0, so call it before OSALInit() to choose the
+// size.  Only the first call has any effect.
+void MemPoolsInitialize(const size_t heapBytes);
+
+// Gives the memory of slab arenas that have no blocks in use back to the OS
+// (madvise(MADV_DONTNEED)), keeping the address ranges for later.  Returns
+// how many bytes were given back.
+size_t MemPoolsTrim(void);
+
+#ifdef __cplusplus
+}
+#endif
+
 #if (NO_MEMPOOLS > 0)
 #undef MEMPOOLS_DEBUG
 #define MEMPOOLS_DEBUG 0
@@ -35,6 +55,8 @@
 #define _MemPoolsMallocWithId(sz, id, ...) calloc(1, sz)
 
 #define MemPoolsMallocWithId(sz, id, ...) calloc(1, sz)
+#define MemPoolsMallocNoZero(sz) malloc(sz)
+#define MemPoolsRealloc(pVoid, sz) realloc((pVoid), (sz))
 #define MemPoolsFree(pVoid) free(pVoid)
 #define _MemPoolsFree(pVoid) free(pVoid)
 #define MemPoolsHeapMalloc(sz) calloc(1, (sz))
@@ -55,6 +77,30 @@
   do {                                      \
     ;                                       \
   } while (0)
+#undef MEMPOOLS_SAMPLE
+#define MEMPOOLS_SAMPLE 0
+#define MemPoolsSampleStart(rate) \
+  do {                            \
+    ;                             \
+  } while (0)
+#define MemPoolsSampleStop() \
+  do {                       \
+    ;                        \
+  } while (0)
+#define MemPoolsSampleGetSites(p, n, ...) (0)
+#define MemPoolsSamplePrint() \
+  do {                        \
+    ;                         \
+  } while (0)
+#define MemPoolsSetTraceHook(fn, pUserData) \
+  do {                                      \
+    ;                                       \
+  } while (0)
+#define MemPoolsTraceRecordStart(szPath) (false)
+#define MemPoolsTraceRecordStop() \
+  do {                            \
+    ;                             \
+  } while (0)
 
 #else // #if (NO_MEMPOOLS > 0)
 
@@ -74,6 +120,16 @@
 #endif // #if ((PLATFORM_FULL_OS > 0) && (MEMPOOLS_DEBUG > 0))
 #endif // #ifndef MEMPOOLS_DEBUG_FILETRACE
 
+// Sampling heap profiler.  Cheap enough to leave built in; it does nothing
+// until MemPoolsSampleStart() is called.
+#ifndef MEMPOOLS_SAMPLE
+#if (PLATFORM_FULL_OS > 0)
+#define MEMPOOLS_SAMPLE 1
+#else // #if (PLATFORM_FULL_OS > 0)
+#define MEMPOOLS_SAMPLE 0
+#endif // #if (PLATFORM_FULL_OS > 0)
+#endif // #ifndef MEMPOOLS_SAMPLE
+
 #ifndef __cplusplus
 #define MP_DEFAULT(x)
 #else
@@ -105,6 +161,25 @@ void* _MemPoolsMallocWithId(
 #define MemPoolsHeapMalloc(sz) \
   _MemPoolsMallocWithId((sz), 0, true, dbgModId, __LINE__)
 
+void* _MemPoolsMallocNoZero(
+  const size_t sz,
+  const char* const MP_DEFAULT(""),
+  const int line MP_DEFAULT(-1));
+
+// Like MemPoolsMalloc(), but the memory is not necessarily zeroed.
+#define MemPoolsMallocNoZero(sz) \
+  _MemPoolsMallocNoZero((sz), dbgModId, __LINE__)
+
+void* _MemPoolsRealloc(
+  void* pVoid,
+  const size_t sz,
+  const char* const MP_DEFAULT(""),
+  const int line MP_DEFAULT(-1));
+
+// Resizes pVoid, keeping its contents, in place if its block has room.
+#define MemPoolsRealloc(ptr, sz) \
+  _MemPoolsRealloc((ptr), (sz), dbgModId, __LINE__)
+
 void _MemPoolsFree(
   void* pVoid,
   const char* const MP_DEFAULT(""),
@@ -127,6 +202,14 @@ void* MemPoolsMallocWithId(
 #define MemPoolsHeapMalloc(sz) \
   MemPoolsMallocWithId((sz), 0, true)
 
+// Like MemPoolsMalloc(), but the memory is not necessarily zeroed.
+void* MemPoolsMallocNoZero(const size_t sz);
+
+// Resizes pVoid, keeping its contents, in place if its block has room.  Any
+// new bytes are not necessarily zeroed.  Returns NULL, leaving pVoid alone,
+// if there is no memory.
+void* MemPoolsRealloc(void* pVoid, const size_t sz);
+
 // Free the memory allocated in pVoid.
 void MemPoolsFree(void* pVoid);
 
@@ -166,6 +249,81 @@ void MemPoolsGetUsage(
   size_t* pmax_used MP_DEFAULT(nullptr),
   size_t* pmax_blocks MP_DEFAULT(nullptr));
 
+#if (MEMPOOLS_SAMPLE > 0)
+
+// Estimated usage from one call site, from MemPoolsSampleGetSites().
+typedef struct MemPoolsSampleSiteTag {
+  // File and line of the call, or "" and -1 without MEMPOOLS_DEBUG_FILETRACE.
+  const char* pFile;
+  int line;
+  // Return address of the mempools call.
+  const void* pCaller;
+  uint8_t id;
+  uint32_t liveBytes;
+  uint32_t liveBlocks;
+  // Since MemPoolsSampleStart().  Wraps at 4 GiB.
+  uint32_t allocBytes;
+  uint32_t allocs;
+} MemPoolsSampleSiteT;
+
+// Starts recording about one allocation per rateBytes bytes allocated (0 for
+// 512 KiB), clearing anything recorded before.  The chance of an allocation
+// being recorded goes up with its size, and the reports scale the samples
+// back up, so the numbers are estimates.  Call it when the sites being
+// recorded are quiet, e.g. at startup.
+void MemPoolsSampleStart(const uint32_t rateBytes);
+
+// Stops recording new allocations.  Sampled blocks still being freed are
+// still counted, so live bytes stay correct.
+void MemPoolsSampleStop(void);
+
+// Copies up to maxSites sites into pSites and returns how many were copied.
+// *pElapsedMs, if not NULL, gets the time since MemPoolsSampleStart().
+int MemPoolsSampleGetSites(
+  MemPoolsSampleSiteT* pSites,
+  const int maxSites,
+  uint32_t* pElapsedMs MP_DEFAULT(nullptr));
+
+// Prints live bytes and allocation rate by call site and by allocation ID.
+void MemPoolsSamplePrint(void);
+
+#else // #if (MEMPOOLS_SAMPLE > 0)
+
+#define MemPoolsSampleStart(rate) \
+  do {                            \
+    ;                             \
+  } while (0)
+#define MemPoolsSampleStop() \
+  do {                       \
+    ;                        \
+  } while (0)
+#define MemPoolsSampleGetSites(p, n, ...) (0)
+#define MemPoolsSamplePrint() \
+  do {                        \
+    ;                         \
+  } while (0)
+
+#endif // #if (MEMPOOLS_SAMPLE > 0)
+
+// Called with each block allocated (pOld NULL, sz > 0), freed (pOld NULL,
+// sz == 0) and reallocated (pOld is the old block, pVoid the new one, which
+// is pOld itself if it was resized in place, and sz the new size.)
+typedef void (*MemPoolsTraceFnT)(
+  void* pUserData, const void* const pOld, const void* const pVoid, const size_t sz);
+
+// Calls pFn for every allocation and free from now on, or stops if pFn is
+// NULL.  pFn must not allocate from mempools.
+void MemPoolsSetTraceHook(MemPoolsTraceFnT pFn, void* pUserData);
+
+#if (PLATFORM_FULL_OS > 0)
+// Writes every allocation and free to the file at szPath, for replaying
+// with mempools_bench.  Returns false if the file could not be opened.
+bool MemPoolsTraceRecordStart(const char* const szPath);
+
+// Stops recording and closes the file.
+void MemPoolsTraceRecordStop(void);
+#endif
+
 // Override new/delete
 // Enable this after platform startup on an embedded system
 // so that strings, etc, will use mempools instead of the
@@ -0,0 +1,159 @@
+#ifndef MEMPOOLS_ALLOCATOR_HPP
+#define MEMPOOLS_ALLOCATOR_HPP
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        mempools_allocator.hpp
+ * @brief       STL allocators and memory resources over mempools.
+ *
+ * MemPoolsEnableNewOverride() moves all of new and delete onto mempools at
+ * once.  These put one container at a time on mempools instead, so that it
+ * shows up in MemPoolsGetUsage(), and, with an allocation ID, in
+ * MemPoolsGetAllocationsWithAllocId() and the sampling profiler.
+ *
+ *   std::vector<int, MemPoolsAllocator<int>> v(MemPoolsAllocator<int>(MY_ID));
+ *   MemPoolsString s;
+ *
+ * With C++17, MemPoolsMemoryResource and RegionMemoryResource do the same
+ * for std::pmr containers, e.g.
+ *
+ *   MemPoolsMemoryResource res(MY_ID);
+ *   std::pmr::map<int, int> m(&res);
+ */
+
+#ifdef __cplusplus
+
+#include "osal/osal.h"
+#include "utils/platform_log.h"
+#include "utils/region_alloc.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#if (__cplusplus >= 201703L) && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define MEMPOOLS_PMR 1
+#endif
+#endif
+#ifndef MEMPOOLS_PMR
+#define MEMPOOLS_PMR 0
+#endif
+
+// Mempools blocks are aligned to at least this.
+#define MEMPOOLS_ALLOCATOR_ALIGN sizeof(void*)
+
+// ////////////////////////////////////////////////////////////////////////////
+// Allocate bytes from mempools, aligned to align (a power of two), tagged
+// with id.  The memory is not necessarily zeroed.  Free it with
+// MemPoolsAlignedFree() and the same align.
+static inline void* MemPoolsAlignedMalloc(const size_t bytes, const size_t align, const uint8_t id) {
+  if (align <= MEMPOOLS_ALLOCATOR_ALIGN) {
+    return (id) ? MemPoolsMallocWithId(bytes, id) : MemPoolsMallocNoZero(bytes);
+  }
+  // Room to align, with the block's own address kept just before the result.
+  const size_t total = bytes + align + sizeof(void*);
+  void* const pBlock = (id) ? MemPoolsMallocWithId(total, id) : MemPoolsMallocNoZero(total);
+  if (nullptr == pBlock) {
+    return nullptr;
+  }
+  const uintptr_t aligned = ((uintptr_t)pBlock + sizeof(void*) + align - 1) & ~(uintptr_t)(align - 1);
+  ((void**)aligned)[ -1 ] = pBlock;
+  return (void*)aligned;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Free memory from MemPoolsAlignedMalloc().
+static inline void MemPoolsAlignedFree(void* const p, const size_t align) {
+  if (p) {
+    OSALFREE((align <= MEMPOOLS_ALLOCATOR_ALIGN) ? p : ((void**)p)[ -1 ]);
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// An STL allocator that allocates from mempools, with an optional
+// allocation ID.  Any two can free each other's memory.
+template <typename T> class MemPoolsAllocator {
+public:
+  typedef T value_type;
+
+  explicit MemPoolsAllocator(const uint8_t id = 0) : mId(id) {}
+
+  template <typename U>
+  MemPoolsAllocator(const MemPoolsAllocator<U> &rhs) : mId(rhs.mId) {}
+
+  T *allocate(const size_t n) {
+    T *const p = (T *)MemPoolsAlignedMalloc(n * sizeof(T), alignof(T), mId);
+    LOG_ASSERT(p);
+    return p;
+  }
+
+  void deallocate(T *const p, const size_t) { MemPoolsAlignedFree(p, alignof(T)); }
+
+  template <typename U> bool operator==(const MemPoolsAllocator<U> &) const {
+    return true;
+  }
+
+  template <typename U> bool operator!=(const MemPoolsAllocator<U> &) const {
+    return false;
+  }
+
+  uint8_t mId;
+};
+
+// A std::string in mempools.
+typedef std::basic_string<char, std::char_traits<char>, MemPoolsAllocator<char>> MemPoolsString;
+
+#if (MEMPOOLS_PMR > 0)
+
+// ////////////////////////////////////////////////////////////////////////////
+// A memory resource that allocates from mempools, with an optional
+// allocation ID.
+class MemPoolsMemoryResource : public std::pmr::memory_resource {
+public:
+  explicit MemPoolsMemoryResource(const uint8_t id = 0) : mId(id) {}
+
+private:
+  void *do_allocate(const size_t bytes, const size_t align) override {
+    void *const p = MemPoolsAlignedMalloc(bytes, align, mId);
+    LOG_ASSERT(p);
+    return p;
+  }
+
+  void do_deallocate(void *const p, const size_t, const size_t align) override {
+    MemPoolsAlignedFree(p, align);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  const uint8_t mId;
+};
+
+// ////////////////////////////////////////////////////////////////////////////
+// A memory resource that allocates from a region.  Deallocation does
+// nothing; the memory goes when the region is rewound.
+class RegionMemoryResource : public std::pmr::memory_resource {
+public:
+  explicit RegionMemoryResource(RegionAllocator &region) : mRegion(region) {}
+
+private:
+  void *do_allocate(const size_t bytes, const size_t align) override {
+    return mRegion.Malloc(bytes, align);
+  }
+
+  void do_deallocate(void *const, const size_t, const size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  RegionAllocator &mRegion;
+};
+
+#endif // #if (MEMPOOLS_PMR > 0)
+
+#endif // #ifdef __cplusplus
+
+#endif
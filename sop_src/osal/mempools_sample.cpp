@@ -0,0 +1,356 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        mempools_sample.cpp
+ * @brief       Sampling heap profiler for mempools.
+ *
+ * Each thread counts down a random number of bytes, with a mean of the
+ * sampling rate, and records the allocation that takes the count past zero.
+ * So an allocation of sz bytes is recorded with probability
+ * 1 - exp(-sz / rate), and stands for sz / that probability bytes.
+ *
+ * Recorded allocations go into two fixed tables, updated with atomics only:
+ * the call sites, and the live sampled blocks so that frees can be matched.
+ * A counting filter over the live blocks lets most frees of unsampled blocks
+ * get away with one load.
+ */
+
+#include "osal/mempools.h"
+#include "utils/platform_log.h"
+
+#if (!(NO_MEMPOOLS > 0)) && (MEMPOOLS_SAMPLE > 0)
+
+#include "osal/osal.h"
+#include "osal/osal_atomic.h"
+#include "utils/helper_macros.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+LOG_MODNAME("mempools_sample.cpp");
+
+// Call sites that can be told apart.  A power of two.
+#ifndef MEMPOOLS_SAMPLE_SITES
+#define MEMPOOLS_SAMPLE_SITES 512
+#endif
+
+// Sampled blocks that can be live at once.  A power of two.
+#ifndef MEMPOOLS_SAMPLE_LIVE
+#define MEMPOOLS_SAMPLE_LIVE 8192
+#endif
+
+// Counters in the filter in front of the live table.  A power of two.
+#define MEMPOOLS_SAMPLE_FILTER 16384
+
+// Slots looked at before giving up on a table.
+#define MEMPOOLS_SAMPLE_PROBES 32
+
+#define MEMPOOLS_SAMPLE_DEFAULT_RATE (512 * 1024)
+
+static_assert(0 == (MEMPOOLS_SAMPLE_SITES & (MEMPOOLS_SAMPLE_SITES - 1)), "MEMPOOLS_SAMPLE_SITES must be a power of two");
+static_assert(0 == (MEMPOOLS_SAMPLE_LIVE & (MEMPOOLS_SAMPLE_LIVE - 1)), "MEMPOOLS_SAMPLE_LIVE must be a power of two");
+
+// MemSampleSite.state
+enum {
+  MEMPOOLS_SITE_EMPTY = 0,
+  MEMPOOLS_SITE_CLAIMED,
+  MEMPOOLS_SITE_READY
+};
+
+typedef struct MemSampleSiteTag {
+  volatile uint32_t state;
+  // Set once, before state becomes MEMPOOLS_SITE_READY.
+  const char* pFile;
+  int line;
+  const void* pCaller;
+  uint8_t id;
+  volatile uint32_t liveBytes;
+  volatile uint32_t liveBlocks;
+  volatile uint32_t allocBytes;
+  volatile uint32_t allocs;
+} MemSampleSite;
+
+// A sampled block that has not been freed yet.
+typedef struct MemSampleLiveTag {
+  // nullptr if never used, MEMPOOLS_LIVE_GONE once freed.
+  void* volatile pVoid;
+  uint32_t site;
+  uint32_t bytes;
+  uint32_t blocks;
+} MemSampleLive;
+
+#define MEMPOOLS_LIVE_GONE ((void*)1)
+
+// Per thread countdown.
+typedef struct MemSampleTlsTag {
+  // Rate the countdown was picked for.
+  uint32_t rate;
+  uint32_t rand;
+  int64_t left;
+} MemSampleTls;
+
+static MemSampleSite mempools_sampleSites[ MEMPOOLS_SAMPLE_SITES ];
+static MemSampleLive mempools_sampleLive[ MEMPOOLS_SAMPLE_LIVE ];
+
+// 0 when stopped.
+static volatile uint32_t mempools_sampleRate = 0;
+// Live sampled blocks by hash, so that most frees can skip the probe.
+static volatile uint32_t mempools_sampleFilter[ MEMPOOLS_SAMPLE_FILTER ];
+// Samples lost because a table was full.
+static volatile uint32_t mempools_sampleDropped = 0;
+static uint32_t mempools_sampleStartMs = 0;
+
+static thread_local MemSampleTls mempools_sampleTls = { 0, 0, 0 };
+
+// ////////////////////////////////////////////////////////////////////////////
+// Bytes to the next sample: exponentially distributed with a mean of rate.
+static int64_t mempools_SampleNextInterval(MemSampleTls& tls, const uint32_t rate) {
+  // xorshift32
+  uint32_t x = tls.rand;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  tls.rand = x;
+  // Uniform in (0, 1]
+  const double u = ((double)(x >> 8) + 1.0) / (double)(1u << 24);
+  return (int64_t)(-log(u) * (double)rate) + 1;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline uint32_t mempools_SampleHash(uintptr_t v) {
+  v ^= v >> 16;
+  v *= (uintptr_t)0x45d9f3b;
+  v ^= v >> 16;
+  return (uint32_t)v;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Finds or adds the site.  Returns MEMPOOLS_SAMPLE_SITES if the table is full.
+static uint32_t mempools_SampleSiteOf(
+  const char* const pF, const int line, const void* const pCaller, const uint8_t id)
+{
+  const uint32_t h = mempools_SampleHash(
+    (uintptr_t)pF ^ (uintptr_t)pCaller ^ ((uintptr_t)line << 8) ^ id);
+  for (uint32_t i = 0; i < MEMPOOLS_SAMPLE_PROBES; i++) {
+    const uint32_t idx = (h + i) & (MEMPOOLS_SAMPLE_SITES - 1);
+    MemSampleSite* const pSite = &mempools_sampleSites[ idx ];
+    uint32_t state = OSALAtomicLoadU32(&pSite->state, OSAL_MO_ACQUIRE);
+    if (MEMPOOLS_SITE_EMPTY == state) {
+      uint32_t expected = MEMPOOLS_SITE_EMPTY;
+      if (OSALAtomicCasU32(&pSite->state, &expected, MEMPOOLS_SITE_CLAIMED, OSAL_MO_ACQUIRE)) {
+        pSite->pFile   = pF;
+        pSite->line    = line;
+        pSite->pCaller = pCaller;
+        pSite->id      = id;
+        OSALAtomicStoreU32(&pSite->state, MEMPOOLS_SITE_READY, OSAL_MO_RELEASE);
+        return idx;
+      }
+      state = expected;
+    }
+    // Another thread is filling it in.
+    while (MEMPOOLS_SITE_CLAIMED == state) {
+      state = OSALAtomicLoadU32(&pSite->state, OSAL_MO_ACQUIRE);
+    }
+    if ((pSite->pFile == pF) && (pSite->line == line) &&
+        (pSite->pCaller == pCaller) && (pSite->id == id)) {
+      return idx;
+    }
+  }
+  return MEMPOOLS_SAMPLE_SITES;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Remembers pVoid so that its free can be taken off the site.
+static bool mempools_SampleLiveAdd(
+  void* const pVoid, const uint32_t site, const uint32_t bytes, const uint32_t blocks)
+{
+  const uint32_t h = mempools_SampleHash((uintptr_t)pVoid >> 4);
+  volatile uint32_t* const pFilter = &mempools_sampleFilter[ (h >> 16) & (MEMPOOLS_SAMPLE_FILTER - 1) ];
+  for (uint32_t i = 0; i < MEMPOOLS_SAMPLE_PROBES; i++) {
+    MemSampleLive* const pLive = &mempools_sampleLive[ (h + i) & (MEMPOOLS_SAMPLE_LIVE - 1) ];
+    void* cur = OSALAtomicLoadPtr(&pLive->pVoid, OSAL_MO_RELAXED);
+    if (((nullptr == cur) || (MEMPOOLS_LIVE_GONE == cur)) &&
+        (OSALAtomicCasPtr(&pLive->pVoid, &cur, pVoid, OSAL_MO_ACQUIRE))) {
+      // Nobody else looks at these until pVoid is freed, which happens after
+      // it has been returned from the allocation.
+      pLive->site   = site;
+      pLive->bytes  = bytes;
+      pLive->blocks = blocks;
+      OSALAtomicFetchAddU32(pFilter, 1, OSAL_MO_RELEASE);
+      return true;
+    }
+  }
+  return false;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Called for every allocation.
+void mempools_SampleAlloc(
+  void* const pVoid, const size_t sz, const uint8_t id,
+  const char* const pF, const int line, const void* const pCaller)
+{
+  const uint32_t rate = OSALAtomicLoadU32(&mempools_sampleRate, OSAL_MO_RELAXED);
+  if (0 == rate) {
+    return;
+  }
+  MemSampleTls& tls = mempools_sampleTls;
+  if (tls.rate != rate) {
+    tls.rate = rate;
+    if (0 == tls.rand) {
+      tls.rand = mempools_SampleHash((uintptr_t)&tls) | 1;
+    }
+    tls.left = mempools_SampleNextInterval(tls, rate);
+  }
+  tls.left -= (int64_t)sz;
+  if (tls.left > 0) {
+    return;
+  }
+  tls.left = mempools_SampleNextInterval(tls, rate);
+
+  // Scale back up by the chance of having been picked.
+  const double p = 1.0 - exp(-(double)MAX(sz, (size_t)1) / (double)rate);
+  const double bytes = MIN((double)sz / p, (double)UINT32_MAX);
+  const double blocks = MIN(1.0 / p, (double)UINT32_MAX);
+  const uint32_t estBytes = (uint32_t)(bytes + 0.5);
+  const uint32_t estBlocks = (uint32_t)(blocks + 0.5);
+
+  const uint32_t site = mempools_SampleSiteOf(pF, line, pCaller, id);
+  if (site >= MEMPOOLS_SAMPLE_SITES) {
+    OSALAtomicFetchAddU32(&mempools_sampleDropped, 1, OSAL_MO_RELAXED);
+    return;
+  }
+  MemSampleSite* const pSite = &mempools_sampleSites[ site ];
+  OSALAtomicFetchAddU32(&pSite->allocBytes, estBytes, OSAL_MO_RELAXED);
+  OSALAtomicFetchAddU32(&pSite->allocs, estBlocks, OSAL_MO_RELAXED);
+  if (mempools_SampleLiveAdd(pVoid, site, estBytes, estBlocks)) {
+    OSALAtomicFetchAddU32(&pSite->liveBytes, estBytes, OSAL_MO_RELAXED);
+    OSALAtomicFetchAddU32(&pSite->liveBlocks, estBlocks, OSAL_MO_RELAXED);
+  }
+  else {
+    OSALAtomicFetchAddU32(&mempools_sampleDropped, 1, OSAL_MO_RELAXED);
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Called for every free, before the memory is given back.
+void mempools_SampleFree(void* const pVoid) {
+  const uint32_t h = mempools_SampleHash((uintptr_t)pVoid >> 4);
+  volatile uint32_t* const pFilter = &mempools_sampleFilter[ (h >> 16) & (MEMPOOLS_SAMPLE_FILTER - 1) ];
+  if (0 == OSALAtomicLoadU32(pFilter, OSAL_MO_ACQUIRE)) {
+    return;
+  }
+  for (uint32_t i = 0; i < MEMPOOLS_SAMPLE_PROBES; i++) {
+    MemSampleLive* const pLive = &mempools_sampleLive[ (h + i) & (MEMPOOLS_SAMPLE_LIVE - 1) ];
+    void* const cur = OSALAtomicLoadPtr(&pLive->pVoid, OSAL_MO_ACQUIRE);
+    if (nullptr == cur) {
+      break;
+    }
+    if (cur == pVoid) {
+      // Read before letting the slot go.
+      const uint32_t site   = pLive->site;
+      const uint32_t bytes  = pLive->bytes;
+      const uint32_t blocks = pLive->blocks;
+      OSALAtomicStorePtr(&pLive->pVoid, MEMPOOLS_LIVE_GONE, OSAL_MO_RELEASE);
+      OSALAtomicFetchAddU32(pFilter, (uint32_t)-1, OSAL_MO_RELAXED);
+      MemSampleSite* const pSite = &mempools_sampleSites[ site ];
+      OSALAtomicFetchAddU32(&pSite->liveBytes, (uint32_t)-(int32_t)bytes, OSAL_MO_RELAXED);
+      OSALAtomicFetchAddU32(&pSite->liveBlocks, (uint32_t)-(int32_t)blocks, OSAL_MO_RELAXED);
+      break;
+    }
+  }
+}
+
+extern "C" {
+
+// ////////////////////////////////////////////////////////////////////////////
+// Starts recording, clearing anything recorded before.
+void MemPoolsSampleStart(const uint32_t rateBytes) {
+  OSALAtomicStoreU32(&mempools_sampleRate, 0, OSAL_MO_SEQ_CST);
+  memset((void*)mempools_sampleSites, 0, sizeof(mempools_sampleSites));
+  memset((void*)mempools_sampleLive, 0, sizeof(mempools_sampleLive));
+  memset((void*)mempools_sampleFilter, 0, sizeof(mempools_sampleFilter));
+  OSALAtomicStoreU32(&mempools_sampleDropped, 0, OSAL_MO_RELAXED);
+  mempools_sampleStartMs = OSALGetMS();
+  const uint32_t rate = (rateBytes) ? rateBytes : MEMPOOLS_SAMPLE_DEFAULT_RATE;
+  OSALAtomicStoreU32(&mempools_sampleRate, rate, OSAL_MO_SEQ_CST);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Stops recording new allocations.
+void MemPoolsSampleStop(void) {
+  OSALAtomicStoreU32(&mempools_sampleRate, 0, OSAL_MO_SEQ_CST);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Copies up to maxSites sites into pSites.
+int MemPoolsSampleGetSites(
+  MemPoolsSampleSiteT* pSites,
+  const int maxSites,
+  uint32_t* pElapsedMs)
+{
+  int n = 0;
+  for (int i = 0; (i < MEMPOOLS_SAMPLE_SITES) && (n < maxSites); i++) {
+    MemSampleSite* const pSite = &mempools_sampleSites[ i ];
+    if (MEMPOOLS_SITE_READY == OSALAtomicLoadU32(&pSite->state, OSAL_MO_ACQUIRE)) {
+      MemPoolsSampleSiteT* const pOut = &pSites[ n++ ];
+      pOut->pFile      = pSite->pFile;
+      pOut->line       = pSite->line;
+      pOut->pCaller    = pSite->pCaller;
+      pOut->id         = pSite->id;
+      pOut->liveBytes  = OSALAtomicLoadU32(&pSite->liveBytes, OSAL_MO_RELAXED);
+      pOut->liveBlocks = OSALAtomicLoadU32(&pSite->liveBlocks, OSAL_MO_RELAXED);
+      pOut->allocBytes = OSALAtomicLoadU32(&pSite->allocBytes, OSAL_MO_RELAXED);
+      pOut->allocs     = OSALAtomicLoadU32(&pSite->allocs, OSAL_MO_RELAXED);
+    }
+  }
+  if (pElapsedMs) {
+    *pElapsedMs = OSALGetMS() - mempools_sampleStartMs;
+  }
+  return n;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Biggest live bytes first.
+static int mempools_SampleCmpLive(const void* pA, const void* pB) {
+  const MemPoolsSampleSiteT* const pSiteA = (const MemPoolsSampleSiteT*)pA;
+  const MemPoolsSampleSiteT* const pSiteB = (const MemPoolsSampleSiteT*)pB;
+  if (pSiteA->liveBytes != pSiteB->liveBytes) {
+    return (pSiteA->liveBytes > pSiteB->liveBytes) ? -1 : 1;
+  }
+  return (pSiteA->allocBytes > pSiteB->allocBytes) ? -1 : (pSiteA->allocBytes < pSiteB->allocBytes);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Prints live bytes and allocation rate by call site and by allocation ID.
+void MemPoolsSamplePrint(void) {
+  static MemPoolsSampleSiteT sites[ MEMPOOLS_SAMPLE_SITES ];
+  uint32_t elapsedMs = 0;
+  const int n = MemPoolsSampleGetSites(sites, ARRSZ(sites), &elapsedMs);
+  const uint32_t ms = MAX(elapsedMs, 1u);
+  qsort(sites, n, sizeof(sites[ 0 ]), mempools_SampleCmpLive);
+
+  LOG_TRACE(("Sampled heap over %u ms, %u samples dropped:\r\n",
+    elapsedMs, OSALAtomicLoadU32(&mempools_sampleDropped, OSAL_MO_RELAXED)));
+  uint32_t idLive[ 256 ] = { 0 };
+  uint32_t idAlloc[ 256 ] = { 0 };
+  for (int i = 0; i < n; i++) {
+    const MemPoolsSampleSiteT* const pSite = &sites[ i ];
+    LOG_TRACE(("\t%s(%d) %p id:%u live %u bytes in %u blocks, %u bytes/s in %u allocs/s\r\n",
+      pSite->pFile, pSite->line, pSite->pCaller, pSite->id,
+      pSite->liveBytes, pSite->liveBlocks,
+      (uint32_t)(((uint64_t)pSite->allocBytes * 1000) / ms),
+      (uint32_t)(((uint64_t)pSite->allocs * 1000) / ms)));
+    idLive[ pSite->id ] += pSite->liveBytes;
+    idAlloc[ pSite->id ] += pSite->allocBytes;
+  }
+  for (int id = 0; id < 256; id++) {
+    if ((idLive[ id ]) || (idAlloc[ id ])) {
+      LOG_TRACE(("\tid:%d live %u bytes, %u bytes/s\r\n",
+        id, idLive[ id ], (uint32_t)(((uint64_t)idAlloc[ id ] * 1000) / ms)));
+    }
+  }
+}
+
+} // extern "C"
+
+#endif // #if (!(NO_MEMPOOLS > 0)) && (MEMPOOLS_SAMPLE > 0)
@@ -0,0 +1,81 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        mempools_trace.cpp
+ * @brief       Records mempools allocations and frees to a file.
+ *
+ * One line per call, replayed by mempools_bench --trace:
+ *   a <address> <bytes>
+ *   f <address>
+ *   r <old address> <new address> <bytes>
+ */
+
+#include "osal/mempools.h"
+#include "utils/platform_log.h"
+
+#if (!(NO_MEMPOOLS > 0)) && (PLATFORM_FULL_OS > 0)
+
+#include "osal/osal.h"
+
+#include <stdio.h>
+
+LOG_MODNAME("mempools_trace.cpp");
+
+static OSALCsT mempools_traceCs = OSAL_CS_INIT(false, OSAL_CS_LEVEL_MEMPOOLS_TRACE);
+static FILE* mempools_pTraceFile = nullptr;
+// Given to stdio, so that it does not allocate a buffer of its own.
+static char mempools_traceBuf[ 64 * 1024 ];
+
+// ////////////////////////////////////////////////////////////////////////////
+static void mempools_TraceRecord(
+  void* pUserData, const void* const pOld, const void* const pVoid, const size_t sz) {
+  (void)pUserData;
+  OSALCsEnter(&mempools_traceCs);
+  if (mempools_pTraceFile) {
+    if (pOld) {
+      fprintf(mempools_pTraceFile, "r %p %p %lu\n", pOld, pVoid, (unsigned long)sz);
+    }
+    else if (sz) {
+      fprintf(mempools_pTraceFile, "a %p %lu\n", pVoid, (unsigned long)sz);
+    }
+    else {
+      fprintf(mempools_pTraceFile, "f %p\n", pVoid);
+    }
+  }
+  OSALCsExit(&mempools_traceCs);
+}
+
+extern "C" {
+
+// ////////////////////////////////////////////////////////////////////////////
+// Writes every allocation and free to the file at szPath.
+bool MemPoolsTraceRecordStart(const char* const szPath) {
+  MemPoolsTraceRecordStop();
+  FILE* const pFile = fopen(szPath, "w");
+  if (nullptr == pFile) {
+    LOG_WARNING(("Cannot open %s for the allocation trace\r\n", szPath));
+    return false;
+  }
+  setvbuf(pFile, mempools_traceBuf, _IOFBF, sizeof(mempools_traceBuf));
+  OSALCsEnter(&mempools_traceCs);
+  mempools_pTraceFile = pFile;
+  OSALCsExit(&mempools_traceCs);
+  MemPoolsSetTraceHook(mempools_TraceRecord, nullptr);
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Stops recording and closes the file.
+void MemPoolsTraceRecordStop(void) {
+  MemPoolsSetTraceHook(nullptr, nullptr);
+  OSALCsEnter(&mempools_traceCs);
+  FILE* const pFile = mempools_pTraceFile;
+  mempools_pTraceFile = nullptr;
+  OSALCsExit(&mempools_traceCs);
+  if (pFile) {
+    fclose(pFile);
+  }
+}
+
+} // extern "C"
+
+#endif // #if (!(NO_MEMPOOLS > 0)) && (PLATFORM_FULL_OS > 0)
@@ -1,11 +1,14 @@
 #include "osal.h"
+#include "osal_atomic.h"
 
 #include "mempools.h"
 #include "utils/platform_log.h"
+#include "utils/helper_macros.h"
 #include "osal_random.hpp"
 #include "utils/simple_string.hpp"
 //#include "rtc/rtc.h"
 #include "mbedtls/config.h"
+#include <string.h>
 
 LOG_MODNAME("osal.cpp")
 
@@ -46,11 +49,7 @@ bool OSALTestAndSet(volatile bool * const pBoolToTestAndSet) {
   bool rval = false;
   if (pBoolToTestAndSet) {
     if (false == *pBoolToTestAndSet){
-      OSALEnterCritical();
-      if (false == *pBoolToTestAndSet) {
-        *pBoolToTestAndSet = rval = true;
-      }
-      OSALExitCritical();
+      rval = !OSALAtomicExchangeBool(pBoolToTestAndSet, true, OSAL_MO_ACQ_REL);
     }
   }
   return rval;
@@ -59,12 +58,337 @@ bool OSALTestAndSet(volatile bool * const pBoolToTestAndSet) {
 // ////////////////////////////////////////////////////////////////////////////
 void OSALClearFlag(bool * const pBoolToClear){
   if (pBoolToClear) {
+    (void)OSALAtomicExchangeBool(pBoolToClear, false, OSAL_MO_RELEASE);
+  }
+}
+
+#if !(defined(__linux__) || defined(__APPLE__))
+// Ports without native per-object locks fall back on the global critical
+// sections.  See osal_posix.cpp for the POSIX implementation.
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALCsInit(OSALCsT* const pCs, const bool isrSafe, const OSALCsLevelT level) {
+  LOG_ASSERT(pCs);
+  memset(pCs, 0, sizeof(*pCs));
+  pCs->isrSafe = isrSafe;
+  pCs->level   = (uint8_t)level;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALCsEnter(OSALCsT* const pCs) {
+  if ((nullptr == pCs) || (pCs->isrSafe)) {
     OSALEnterCritical();
-    *pBoolToClear = false;
+  } else {
+    OSALEnterTaskCritical();
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALCsExit(OSALCsT* const pCs) {
+  if ((nullptr == pCs) || (pCs->isrSafe)) {
     OSALExitCritical();
+  } else {
+    OSALExitTaskCritical();
   }
 }
 
+// ////////////////////////////////////////////////////////////////////////////
+void OSALDumpLockStats(void) {
+  LOG_TRACE(("Lock statistics are not available on this port.\r\n"));
+}
+
+// Finer clocks are only as good as the port's millisecond counter.
+
+// ////////////////////////////////////////////////////////////////////////////
+uint64_t OSALGetUS(void) {
+  return (uint64_t)OSALGetMS() * 1000u;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+uint64_t OSALGetNS(void) {
+  return (uint64_t)OSALGetMS() * 1000000u;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+uint64_t OSALGetTicks(void) {
+  return OSALGetNS();
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+uint64_t OSALTicksToNS(const uint64_t ticks) {
+  return ticks;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALSleepUs(const uint64_t us) {
+  OSALSleep((uint32_t)((us + 999u) / 1000u));
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALSleepUntil(const uint64_t deadlineUs) {
+  const uint64_t now = OSALGetUS();
+  if (deadlineUs > now) {
+    OSALSleepUs(deadlineUs - now);
+  }
+}
+#endif
+
+#if !(defined(__linux__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+// Generic reader/writer locks and event groups for the RTOS and Win32 ports,
+// built on the port's critical sections and semaphores.
+
+// The state lives under the global critical section.  Readers and writers
+// that cannot have the lock sleep on a semaphore and recheck when woken; a
+// stale wakeup left by one that timed out only costs a recheck.  Readers do
+// not pass waiting writers.
+typedef struct osal_RwLockTag {
+  uint32_t readers;         ///< Readers holding the lock
+  uint32_t writer;          ///< 1 while a writer holds the lock
+  uint32_t writersWaiting;  ///< Writers waiting for the lock
+  uint32_t readersWaiting;  ///< Reader sleeps not yet woken
+  OSALSemaphorePtrT readSem;
+  OSALSemaphorePtrT writeSem;
+} osal_RwLockT;
+
+// ////////////////////////////////////////////////////////////////////////////
+OSALRwLockPtrT OSALRwLockCreate(void) {
+  osal_RwLockT* const pRw = (osal_RwLockT*)OSALMALLOC(sizeof(osal_RwLockT));
+  LOG_ASSERT(pRw);
+  if (pRw) {
+    pRw->readers        = 0;
+    pRw->writer         = 0;
+    pRw->writersWaiting = 0;
+    pRw->readersWaiting = 0;
+    pRw->readSem        = OSALSemaphoreCreate(0, OSAL_COUNT_INFINITE);
+    pRw->writeSem       = OSALSemaphoreCreate(0, OSAL_COUNT_INFINITE);
+  }
+  return (OSALRwLockPtrT)pRw;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALRwLockDelete(OSALRwLockPtrT* const ppRwLock) {
+  LOG_ASSERT(ppRwLock);
+  osal_RwLockT* const pRw = (osal_RwLockT*)*ppRwLock;
+  if (pRw) {
+    LOG_ASSERT((0 == pRw->readers) && (0 == pRw->writer));
+    (void)OSALSemaphoreDelete(&pRw->readSem);
+    (void)OSALSemaphoreDelete(&pRw->writeSem);
+    OSALFREE(pRw);
+  }
+  *ppRwLock = nullptr;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALRwLockReadLock(OSALRwLockPtrT const pRwLock, const uint32_t timeoutMs) {
+  osal_RwLockT* const pRw = (osal_RwLockT*)pRwLock;
+  LOG_ASSERT(pRw);
+  const uint32_t startTime = OSALGetMS();
+  bool ok                  = false;
+  bool done                = false;
+  while (!done) {
+    OSALEnterCritical();
+    ok = (0 == pRw->writer) && (0 == pRw->writersWaiting);
+    if (ok) {
+      pRw->readers++;
+    }
+    const uint32_t elapsed = OSALGetMS() - startTime;
+    done                   = ok || (elapsed >= timeoutMs);
+    if (!done) {
+      pRw->readersWaiting++;
+    }
+    OSALExitCritical();
+    if (!done) {
+      const uint32_t remaining =
+        (OSAL_WAIT_INFINITE == timeoutMs) ? OSAL_WAIT_INFINITE : (timeoutMs - elapsed);
+      (void)OSALSemaphoreWait(pRw->readSem, remaining);
+    }
+  }
+  return ok;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALRwLockReadUnlock(OSALRwLockPtrT const pRwLock) {
+  osal_RwLockT* const pRw = (osal_RwLockT*)pRwLock;
+  LOG_ASSERT(pRw);
+  OSALEnterCritical();
+  const bool ok = (pRw->readers > 0);
+  LOG_ASSERT(ok);
+  if (ok) {
+    pRw->readers--;
+  }
+  const bool wakeWriter = (0 == pRw->readers) && (pRw->writersWaiting > 0);
+  OSALExitCritical();
+  if (wakeWriter) {
+    (void)OSALSemaphoreSignal(pRw->writeSem, 1);
+  }
+  return ok;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALRwLockWriteLock(OSALRwLockPtrT const pRwLock, const uint32_t timeoutMs) {
+  osal_RwLockT* const pRw = (osal_RwLockT*)pRwLock;
+  LOG_ASSERT(pRw);
+  const uint32_t startTime = OSALGetMS();
+  bool ok                  = false;
+  bool done                = false;
+  bool waiting             = false;
+  while (!done) {
+    uint32_t wakeReaders = 0;
+    OSALEnterCritical();
+    ok = (0 == pRw->writer) && (0 == pRw->readers);
+    if (ok) {
+      pRw->writer = 1;
+    }
+    const uint32_t elapsed = OSALGetMS() - startTime;
+    done                   = ok || (elapsed >= timeoutMs);
+    if ((done) && (waiting)) {
+      pRw->writersWaiting--;
+      // The readers held back for this writer may go now.
+      if ((!ok) && (0 == pRw->writersWaiting) && (0 == pRw->writer)) {
+        wakeReaders         = pRw->readersWaiting;
+        pRw->readersWaiting = 0;
+      }
+    } else if ((!done) && (!waiting)) {
+      pRw->writersWaiting++;
+      waiting = true;
+    }
+    OSALExitCritical();
+    if (wakeReaders > 0) {
+      (void)OSALSemaphoreSignal(pRw->readSem, wakeReaders);
+    }
+    if (!done) {
+      const uint32_t remaining =
+        (OSAL_WAIT_INFINITE == timeoutMs) ? OSAL_WAIT_INFINITE : (timeoutMs - elapsed);
+      (void)OSALSemaphoreWait(pRw->writeSem, remaining);
+    }
+  }
+  return ok;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALRwLockWriteUnlock(OSALRwLockPtrT const pRwLock) {
+  osal_RwLockT* const pRw = (osal_RwLockT*)pRwLock;
+  LOG_ASSERT(pRw);
+  uint32_t wakeReaders = 0;
+  OSALEnterCritical();
+  const bool ok = (0 != pRw->writer);
+  LOG_ASSERT(ok);
+  pRw->writer           = 0;
+  const bool wakeWriter = (pRw->writersWaiting > 0);
+  if (!wakeWriter) {
+    wakeReaders         = pRw->readersWaiting;
+    pRw->readersWaiting = 0;
+  }
+  OSALExitCritical();
+  if (wakeWriter) {
+    (void)OSALSemaphoreSignal(pRw->writeSem, 1);
+  } else if (wakeReaders > 0) {
+    (void)OSALSemaphoreSignal(pRw->readSem, wakeReaders);
+  }
+  return ok;
+}
+
+typedef struct osal_EventGroupTag {
+  uint32_t bits;
+  uint32_t waiters;
+  OSALSemaphorePtrT sem;
+} osal_EventGroupT;
+
+// ////////////////////////////////////////////////////////////////////////////
+OSALEventGroupPtrT OSALEventGroupCreate(void) {
+  osal_EventGroupT* const pEg = (osal_EventGroupT*)OSALMALLOC(sizeof(osal_EventGroupT));
+  LOG_ASSERT(pEg);
+  if (pEg) {
+    pEg->bits    = 0;
+    pEg->waiters = 0;
+    pEg->sem     = OSALSemaphoreCreate(0, OSAL_COUNT_INFINITE);
+  }
+  return (OSALEventGroupPtrT)pEg;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALEventGroupDelete(OSALEventGroupPtrT* const ppGroup) {
+  LOG_ASSERT(ppGroup);
+  osal_EventGroupT* const pEg = (osal_EventGroupT*)*ppGroup;
+  if (pEg) {
+    (void)OSALSemaphoreDelete(&pEg->sem);
+    OSALFREE(pEg);
+  }
+  *ppGroup = nullptr;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEventGroupSet(OSALEventGroupPtrT const pGroup, const uint32_t bits) {
+  osal_EventGroupT* const pEg = (osal_EventGroupT*)pGroup;
+  LOG_ASSERT(pEg);
+  OSALEnterCritical();
+  pEg->bits |= bits;
+  const uint32_t rval    = pEg->bits;
+  const uint32_t waiters = pEg->waiters;
+  pEg->waiters           = 0;
+  OSALExitCritical();
+  // Wake everyone; each waiter rechecks its own condition.
+  if (waiters > 0) {
+    (void)OSALSemaphoreSignal(pEg->sem, waiters);
+  }
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEventGroupClear(OSALEventGroupPtrT const pGroup, const uint32_t bits) {
+  osal_EventGroupT* const pEg = (osal_EventGroupT*)pGroup;
+  LOG_ASSERT(pEg);
+  OSALEnterCritical();
+  const uint32_t rval = pEg->bits;
+  pEg->bits &= ~bits;
+  OSALExitCritical();
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEventGroupGet(OSALEventGroupPtrT const pGroup) {
+  osal_EventGroupT* const pEg = (osal_EventGroupT*)pGroup;
+  LOG_ASSERT(pEg);
+  return OSALAtomicLoadU32(&pEg->bits, OSAL_MO_ACQUIRE);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEventGroupWait(
+  OSALEventGroupPtrT const pGroup,
+  const uint32_t bitsToWaitFor,
+  const bool waitForAll,
+  const bool clearOnExit,
+  const uint32_t timeoutMs) {
+  osal_EventGroupT* const pEg = (osal_EventGroupT*)pGroup;
+  LOG_ASSERT(pEg);
+  const uint32_t startTime = OSALGetMS();
+  uint32_t rval            = 0;
+  bool done                = false;
+  while (!done) {
+    OSALEnterCritical();
+    rval          = pEg->bits;
+    const bool ok = (waitForAll) ? ((rval & bitsToWaitFor) == bitsToWaitFor)
+                                 : (0 != (rval & bitsToWaitFor));
+    if (ok && clearOnExit) {
+      pEg->bits &= ~bitsToWaitFor;
+    }
+    const uint32_t elapsed = OSALGetMS() - startTime;
+    done                   = ok || (elapsed >= timeoutMs);
+    if (!done) {
+      pEg->waiters++;
+    }
+    OSALExitCritical();
+    if (!done) {
+      const uint32_t remaining =
+        (OSAL_WAIT_INFINITE == timeoutMs) ? OSAL_WAIT_INFINITE : (timeoutMs - elapsed);
+      // A stale wakeup left by a timed out waiter only costs a recheck.
+      (void)OSALSemaphoreWait(pEg->sem, remaining);
+    }
+  }
+  return rval;
+}
+#endif
+
 #if (PLATFORM_EMBEDDED > 0) && defined(__EMBEDDED_MCU_BE__)
 #define STUB_RANDOMBYTES
 #endif
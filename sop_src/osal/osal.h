@@ -22,7 +22,33 @@
 #endif
 #endif
 
+// Set OSAL_LOCK_PROFILE to 1 to count and time every mutex, semaphore and
+// critical section, see OSALDumpLockStats().  POSIX only.
+#ifndef OSAL_LOCK_PROFILE
+#define OSAL_LOCK_PROFILE 0
+#endif
+#if (OSAL_LOCK_PROFILE > 0) && !(defined(__linux__) || defined(__APPLE__))
+#undef OSAL_LOCK_PROFILE
+#define OSAL_LOCK_PROFILE 0
+#endif
+
+// Set OSAL_CS_CHECK_ORDER to 1 to assert that per-object critical sections
+// are entered in OSALCsLevelT order.  POSIX only; on by default in DEBUG.
+#ifndef OSAL_CS_CHECK_ORDER
+#if defined(DEBUG)
+#define OSAL_CS_CHECK_ORDER 1
+#else
+#define OSAL_CS_CHECK_ORDER 0
+#endif
+#endif
+#if (OSAL_CS_CHECK_ORDER > 0) && !(defined(__linux__) || defined(__APPLE__))
+#undef OSAL_CS_CHECK_ORDER
+#define OSAL_CS_CHECK_ORDER 0
+#endif
+
 #define OSALMALLOC(sz) MemPoolsMalloc(sz)
+#define OSALMALLOC_NOZERO(sz) MemPoolsMallocNoZero(sz)
+#define OSALREALLOC(p, sz) MemPoolsRealloc((p), (sz))
 #define OSALFREE(p) MemPoolsFree(p)
 
 #ifdef __cplusplus
@@ -32,6 +58,9 @@ extern "C" {
 typedef void* OSALMutexPtrT;
 typedef void* OSALSemaphorePtrT;
 typedef void* OSALTaskPtrT;
+typedef void* OSALRwLockPtrT;
+typedef void* OSALEventGroupPtrT;
+typedef void* OSALThreadPoolPtrT;
 
 typedef enum OSALPrioTag {
   OSAL_PRIO_CRITICAL = 1, ///< Use only for hardware interfaces (uart, etc.)
@@ -68,6 +97,90 @@ void OSALEnterTaskCritical(void);
 // void OSALExitTaskCritical(void)
 void OSALExitTaskCritical(void);
 
+// ////////////////////////////////////////////////////////////////////////////
+// Critical section that may be taken from a task or from an interrupt
+// handler (OSALEnterCritical() may not be on all ports, FreeRTOS for one.)
+// Masks interrupts on embedded ports.  Returns the previous interrupt state,
+// which must be passed to OSALExitCriticalFromIsr().  Keep it very short.
+uint32_t OSALEnterCriticalFromIsr(void);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Leave the critical section taken by OSALEnterCriticalFromIsr().
+void OSALExitCriticalFromIsr(const uint32_t state);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Lock order of the per-object critical sections.  A thread that holds one may
+// only enter others of the same or a higher level, so paths that nest (the
+// scheduler allocating, the allocator logging an assert) always take them in
+// the same order.  Same level locks are the owning module's business.  Locks
+// of OSAL_CS_LEVEL_NONE are not checked; enter no ranked lock while holding
+// one.  The global critical section comes before all of them: a thread may
+// enter them while in it, but must not enter it while holding a ranked one.
+typedef enum {
+  OSAL_CS_LEVEL_NONE = 0,        ///< Not ranked
+  OSAL_CS_LEVEL_TASKSCHED,       ///< Task scheduler lists
+  OSAL_CS_LEVEL_BUFIO,           ///< BufIOQueue transactions
+  OSAL_CS_LEVEL_BYTEQ,           ///< ByteQ counts
+  OSAL_CS_LEVEL_MBEDTLS,         ///< mbedtls mutexes
+  OSAL_CS_LEVEL_MEMPOOLS,        ///< Memory pool size classes
+  OSAL_CS_LEVEL_MEMPOOLS_PAGES,  ///< Memory pool free pages and arenas
+  OSAL_CS_LEVEL_MEMPOOLS_TRACE,  ///< Allocation trace file
+  OSAL_CS_LEVEL_LOG,             ///< Logger; last, since anything may assert
+  OSAL_CS_NUM_LEVELS
+} OSALCsLevelT;
+
+// ////////////////////////////////////////////////////////////////////////////
+// Per-object critical section (lock domain.)  Embed one in the object it
+// protects so that unrelated objects do not serialize on the global critical
+// section.  Recursive.  Keep the protected regions short, and only enter other
+// locks inside them in OSALCsLevelT order.  On embedded ports these map to
+// OSALEnterCritical() if isrSafe, otherwise to OSALEnterTaskCritical().
+typedef struct OSALCsTag {
+  volatile uint32_t lock;  ///< Port specific lock word
+  volatile uint32_t owner; ///< Port specific owner token, 0 if free
+  uint32_t recurse;        ///< Recursion depth of the owner
+  bool isrSafe;            ///< Also lock out interrupts on embedded ports
+  uint8_t level;           ///< OSALCsLevelT
+#if (OSAL_LOCK_PROFILE > 0)
+  void* pProfSite;         ///< Call site statistics of the owner
+  uint64_t profLockedNs;   ///< When the owner took it
+#endif
+} OSALCsT;
+
+// For statically initializing an OSALCsT.
+#if (OSAL_LOCK_PROFILE > 0)
+#define OSAL_CS_INIT(isrSafe, level) { 0, 0, 0, (isrSafe), (level), 0, 0 }
+#else
+#define OSAL_CS_INIT(isrSafe, level) { 0, 0, 0, (isrSafe), (level) }
+#endif
+
+// ////////////////////////////////////////////////////////////////////////////
+// Initialize a per-object critical section at the given OSALCsLevelT.
+void OSALCsInit(OSALCsT* const pCs, const bool isrSafe, const OSALCsLevelT level);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Enter a per-object critical section.  NULL means the global critical section.
+void OSALCsEnter(OSALCsT* const pCs);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Exit a per-object critical section.  NULL means the global critical section.
+void OSALCsExit(OSALCsT* const pCs);
+
+#if (OSAL_LOCK_PROFILE > 0)
+// The profiler records critical sections by call site.
+void _OSALEnterCritical(const char* const pFile, const int line);
+void _OSALCsEnter(OSALCsT* const pCs, const char* const pFile, const int line);
+#define OSALEnterCritical() _OSALEnterCritical(__FILE__, __LINE__)
+#define OSALEnterTaskCritical() _OSALEnterCritical(__FILE__, __LINE__)
+#define OSALCsEnter(pCs) _OSALCsEnter((pCs), __FILE__, __LINE__)
+#endif
+
+// ////////////////////////////////////////////////////////////////////////////
+// Print the locks with the most waiting: acquisitions, how many had to wait,
+// and wait and hold time histograms for each mutex, semaphore and critical
+// section call site.  Needs OSAL_LOCK_PROFILE.
+void OSALDumpLockStats(void);
+
 #if !defined(__FREERTOS__) && !defined(ccs)
 #else
 
@@ -77,13 +190,39 @@ extern void OSALFreertosSwitchToMempools(const bool pakmkey_PowerIsEnabled);
 #endif
 
 // ////////////////////////////////////////////////////////////////////////////
-// Get the millisecond counter.
+// Get the monotonic millisecond counter.
 uint32_t OSALGetMS(void);
 
+// ////////////////////////////////////////////////////////////////////////////
+// Get the monotonic microsecond counter.
+uint64_t OSALGetUS(void);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Get the monotonic nanosecond counter.
+uint64_t OSALGetNS(void);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Get a cheap, high resolution tick counter for hot path time stamps.
+// Convert differences between ticks with OSALTicksToNS().
+uint64_t OSALGetTicks(void);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Convert a number of ticks from OSALGetTicks() to nanoseconds.
+uint64_t OSALTicksToNS(const uint64_t ticks);
+
 // ////////////////////////////////////////////////////////////////////////////
 // Sleep for ms milliseconds.
 void OSALSleep(const uint32_t ms);
 
+// ////////////////////////////////////////////////////////////////////////////
+// Sleep for us microseconds.
+void OSALSleepUs(const uint64_t us);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Sleep until OSALGetUS() reaches deadlineUs.  Advance the deadline by a fixed
+// period each time round a loop to run it at a fixed rate without drift.
+void OSALSleepUntil(const uint64_t deadlineUs);
+
 // ////////////////////////////////////////////////////////////////////////////
 // For testbenches, unhooking from hardware will make the OSAL go into simulated mode.
 void OSALMSHookToHardware(const bool hookToHardware);
@@ -130,6 +269,63 @@ bool OSALSemaphoreSignalFromIsr(OSALSemaphorePtrT const pPortSem, const uint32_t
 // Wait for a counting semaphore.
 bool OSALSemaphoreWait(OSALSemaphorePtrT const pPortSem, const uint32_t timeoutMs);
 
+// ////////////////////////////////////////////////////////////////////////////
+// Create a reader/writer lock.  Many readers or one writer.  Not recursive;
+// writers are preferred where the port supports it.
+OSALRwLockPtrT OSALRwLockCreate(void);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Delete a reader/writer lock.
+void OSALRwLockDelete(OSALRwLockPtrT* const ppRwLock);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Lock for reading.  Returns false on timeout.
+bool OSALRwLockReadLock(OSALRwLockPtrT const pRwLock, const uint32_t timeoutMs);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Unlock after OSALRwLockReadLock().
+bool OSALRwLockReadUnlock(OSALRwLockPtrT const pRwLock);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Lock for writing.  Returns false on timeout.
+bool OSALRwLockWriteLock(OSALRwLockPtrT const pRwLock, const uint32_t timeoutMs);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Unlock after OSALRwLockWriteLock().
+bool OSALRwLockWriteUnlock(OSALRwLockPtrT const pRwLock);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Create an event group: 32 event bits that tasks can set, clear and wait on.
+OSALEventGroupPtrT OSALEventGroupCreate(void);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Delete an event group.
+void OSALEventGroupDelete(OSALEventGroupPtrT* const ppGroup);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Set bits and wake any waiters.  Returns the bits after setting.
+uint32_t OSALEventGroupSet(OSALEventGroupPtrT const pGroup, const uint32_t bits);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Clear bits.  Returns the bits before clearing.
+uint32_t OSALEventGroupClear(OSALEventGroupPtrT const pGroup, const uint32_t bits);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Get the current bits.
+uint32_t OSALEventGroupGet(OSALEventGroupPtrT const pGroup);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Wait until any (or, if waitForAll, all) of bitsToWaitFor are set.
+// If clearOnExit, the bits waited for are cleared on success.
+// Returns the bits at the time the wait ended; check them against
+// bitsToWaitFor to tell success from timeout.
+uint32_t OSALEventGroupWait(
+  OSALEventGroupPtrT const pGroup,
+  const uint32_t bitsToWaitFor,
+  const bool waitForAll,
+  const bool clearOnExit,
+  const uint32_t timeoutMs);
+
 
 // ////////////////////////////////////////////////////////////////////////////
 void OSALRandomInit(const char* const szName, const int len);
@@ -191,6 +387,52 @@ bool OSALTaskDelete(OSALTaskPtrT* const ppTaskPtr);
 // Gets the current task ID.  (Task ID is set in OSALTaskStructT)
 uint32_t OSALGetCurrentTaskID(void);
 
+// ////////////////////////////////////////////////////////////////////////////
+// What OSALThreadCtxT::pLane points to.  Check laneType before casting pLane.
+typedef enum {
+  OSAL_LANE_NONE = 0,   ///< pLane is NULL
+  OSAL_LANE_TASKSCHED   ///< pLane is the task scheduler priority run by the thread
+} OSALLaneTypeT;
+
+// ////////////////////////////////////////////////////////////////////////////
+// Per-thread context block.  The OSAL fills in taskId when the task starts;
+// the other fields belong to whichever subsystem runs the thread.
+typedef struct OSALThreadCtxTag {
+  uint32_t taskId;         ///< Task ID from OSALTaskStructT, 0 if not an OSAL task
+  const char* pName;       ///< Thread name, or NULL
+  OSALLaneTypeT laneType;  ///< What pLane points to
+  void* pLane;             ///< Lane run by the thread, or NULL
+  void* pStats;            ///< Per-thread statistics, or NULL
+} OSALThreadCtxT;
+
+// ////////////////////////////////////////////////////////////////////////////
+// Gets the calling thread's context block from the port's thread local
+// storage.  Never NULL.  Call from tasks only, not from interrupts.
+OSALThreadCtxT* OSALGetThreadCtx(void);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Creates a pool of numThreads tasks that run jobs from a queue holding at
+// least queueDepth jobs.  Use instead of spawning a thread per job.
+OSALThreadPoolPtrT OSALThreadPoolCreate(
+  const uint32_t numThreads,
+  const uint32_t queueDepth,
+  const OSALPrioT prio,
+  const uint32_t stackSize);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Queues pFn(pArg) to run on the pool.  Never blocks; returns false if the
+// queue is full or the pool is being deleted.
+bool OSALThreadPoolSubmit(OSALThreadPoolPtrT const pThreadPool, OSALTaskFuncPtrT pFn, void* const pArg);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Waits until every submitted job has finished.  Returns false on timeout.
+bool OSALThreadPoolDrain(OSALThreadPoolPtrT const pThreadPool, const uint32_t timeoutMs);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Finishes the queued jobs, stops the tasks and frees the pool.
+// Do not submit to the pool while it is being deleted.
+void OSALThreadPoolDelete(OSALThreadPoolPtrT* const ppThreadPool);
+
 // ////////////////////////////////////////////////////////////////////////////
 // Returns TRUE if the boolean was FALSE and is now TRUE.
 bool OSALTestAndSet(volatile bool* const pBoolToTestAndSet);
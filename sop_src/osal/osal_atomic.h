@@ -0,0 +1,285 @@
+/*
+ * osal_atomic.h
+ *
+ * Portable atomic operations on plain words.
+ * With GCC or clang, when the target has lock free word and pointer atomics
+ * (any Cortex-M3 and up, x86, ...), these map to the compiler's C11/C++11
+ * atomic builtins, and are safe to use from threads and interrupts alike.
+ * Otherwise (MSVC, Cortex-M0, TI's compiler) stores and read-modify-writes
+ * run inside OSALEnterCriticalFromIsr(), and loads are plain word reads with
+ * a barrier for the requested memory order.  On embedded ports that critical
+ * section masks interrupts (so it is ISR safe, but assumes a single core), on
+ * Win32 it is the global lock.
+ */
+
+#ifndef OSAL_ATOMIC_H__
+#define OSAL_ATOMIC_H__
+
+#include "osal/osal.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__GCC_ATOMIC_INT_LOCK_FREE) && \
+  (__GCC_ATOMIC_INT_LOCK_FREE == 2) && (__GCC_ATOMIC_POINTER_LOCK_FREE == 2) && \
+  (__GCC_ATOMIC_BOOL_LOCK_FREE == 2)
+#define OSAL_ATOMIC_NATIVE 1
+#else
+#define OSAL_ATOMIC_NATIVE 0
+#endif
+
+#if (OSAL_ATOMIC_NATIVE == 0) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Memory orders, with the same values as the C11 memory_order constants.
+typedef enum OSALMemOrderTag {
+  OSAL_MO_RELAXED = 0,
+  OSAL_MO_ACQUIRE = 2,
+  OSAL_MO_RELEASE = 3,
+  OSAL_MO_ACQ_REL = 4,
+  OSAL_MO_SEQ_CST = 5
+} OSALMemOrderT;
+
+#if (OSAL_ATOMIC_NATIVE > 0)
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically read *p.
+static inline uint32_t OSALAtomicLoadU32(const volatile uint32_t* const p, const OSALMemOrderT mo) {
+  return __atomic_load_n(p, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically write v to *p.
+static inline void OSALAtomicStoreU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  __atomic_store_n(p, v, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically add v to *p.  Returns the previous value.
+static inline uint32_t OSALAtomicFetchAddU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  return __atomic_fetch_add(p, v, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically OR v into *p.  Returns the previous value.
+static inline uint32_t OSALAtomicFetchOrU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  return __atomic_fetch_or(p, v, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically AND v into *p.  Returns the previous value.
+static inline uint32_t OSALAtomicFetchAndU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  return __atomic_fetch_and(p, v, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically write v to *p.  Returns the previous value.
+static inline uint32_t OSALAtomicExchangeU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  return __atomic_exchange_n(p, v, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// If *p == *pExpected, write desired to *p and return true.
+// Otherwise copy *p to *pExpected and return false.
+static inline bool OSALAtomicCasU32(
+  volatile uint32_t* const p, uint32_t* const pExpected, const uint32_t desired, const OSALMemOrderT mo) {
+  const OSALMemOrderT failMo =
+    (OSAL_MO_RELEASE == mo) ? OSAL_MO_RELAXED : (OSAL_MO_ACQ_REL == mo) ? OSAL_MO_ACQUIRE : mo;
+  return __atomic_compare_exchange_n(p, pExpected, desired, false, mo, failMo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically read a pointer.
+static inline void* OSALAtomicLoadPtr(void* const volatile* const pp, const OSALMemOrderT mo) {
+  return __atomic_load_n(pp, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically write a pointer.
+static inline void OSALAtomicStorePtr(void* volatile* const pp, void* const v, const OSALMemOrderT mo) {
+  __atomic_store_n(pp, v, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Pointer compare and swap, see OSALAtomicCasU32().
+static inline bool OSALAtomicCasPtr(
+  void* volatile* const pp, void** const pExpected, void* const desired, const OSALMemOrderT mo) {
+  const OSALMemOrderT failMo =
+    (OSAL_MO_RELEASE == mo) ? OSAL_MO_RELAXED : (OSAL_MO_ACQ_REL == mo) ? OSAL_MO_ACQUIRE : mo;
+  return __atomic_compare_exchange_n(pp, pExpected, desired, false, mo, failMo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Atomically write v to a flag.  Returns the previous value.
+static inline bool OSALAtomicExchangeBool(volatile bool* const p, const bool v, const OSALMemOrderT mo) {
+  return __atomic_exchange_n(p, v, mo);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Memory fence with the given order.
+static inline void OSALAtomicFence(const OSALMemOrderT mo) {
+  __atomic_thread_fence(mo);
+}
+
+#else // #if (OSAL_ATOMIC_NATIVE > 0)
+
+// Stores and read-modify-writes take OSALEnterCriticalFromIsr(), so a store
+// can not land in the middle of another thread's read-modify-write, and the
+// lock orders it.  Aligned word loads are atomic by themselves, but need a
+// barrier (compiler and CPU) for anything stronger than OSAL_MO_RELAXED.
+
+// ////////////////////////////////////////////////////////////////////////////
+// Compiler and CPU barrier for the non-native loads and fences.
+static inline void OSALAtomicBarrier(const OSALMemOrderT mo) {
+#if defined(__GNUC__)
+  __atomic_thread_fence(mo);
+#elif defined(_MSC_VER)
+  _ReadWriteBarrier();
+#if defined(_M_ARM) || defined(_M_ARM64)
+  (void)mo;
+  __dmb(0xB); // ISH
+#else
+  // x86 only reorders a later load before an earlier store.
+  if (OSAL_MO_SEQ_CST == mo) {
+    _mm_mfence();
+  }
+#endif
+  _ReadWriteBarrier();
+#else
+  // A call into the port masks interrupts, which is a barrier on one core.
+  (void)mo;
+  OSALExitCriticalFromIsr(OSALEnterCriticalFromIsr());
+#endif
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline uint32_t OSALAtomicLoadU32(const volatile uint32_t* const p, const OSALMemOrderT mo) {
+  const uint32_t rval = *p;
+  if (OSAL_MO_RELAXED != mo) {
+    OSALAtomicBarrier(mo);
+  }
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline void OSALAtomicStoreU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  *p = v;
+  OSALExitCriticalFromIsr(state);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline uint32_t OSALAtomicFetchAddU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  const uint32_t rval = *p;
+  *p = rval + v;
+  OSALExitCriticalFromIsr(state);
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline uint32_t OSALAtomicFetchOrU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  const uint32_t rval = *p;
+  *p = rval | v;
+  OSALExitCriticalFromIsr(state);
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline uint32_t OSALAtomicFetchAndU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  const uint32_t rval = *p;
+  *p = rval & v;
+  OSALExitCriticalFromIsr(state);
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline uint32_t OSALAtomicExchangeU32(volatile uint32_t* const p, const uint32_t v, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  const uint32_t rval = *p;
+  *p = v;
+  OSALExitCriticalFromIsr(state);
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline bool OSALAtomicCasU32(
+  volatile uint32_t* const p, uint32_t* const pExpected, const uint32_t desired, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  const bool rval = (*p == *pExpected);
+  if (rval) {
+    *p = desired;
+  } else {
+    *pExpected = *p;
+  }
+  OSALExitCriticalFromIsr(state);
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline void* OSALAtomicLoadPtr(void* const volatile* const pp, const OSALMemOrderT mo) {
+  void* const rval = *pp;
+  if (OSAL_MO_RELAXED != mo) {
+    OSALAtomicBarrier(mo);
+  }
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline void OSALAtomicStorePtr(void* volatile* const pp, void* const v, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  *pp = v;
+  OSALExitCriticalFromIsr(state);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline bool OSALAtomicCasPtr(
+  void* volatile* const pp, void** const pExpected, void* const desired, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  const bool rval = (*pp == *pExpected);
+  if (rval) {
+    *pp = desired;
+  } else {
+    *pExpected = *pp;
+  }
+  OSALExitCriticalFromIsr(state);
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline bool OSALAtomicExchangeBool(volatile bool* const p, const bool v, const OSALMemOrderT mo) {
+  (void)mo;
+  const uint32_t state = OSALEnterCriticalFromIsr();
+  const bool rval = *p;
+  *p = v;
+  OSALExitCriticalFromIsr(state);
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static inline void OSALAtomicFence(const OSALMemOrderT mo) {
+  OSALAtomicBarrier(mo);
+}
+
+#endif // #if (OSAL_ATOMIC_NATIVE > 0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OSAL_ATOMIC_H__
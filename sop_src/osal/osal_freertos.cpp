@@ -66,7 +66,7 @@ static bool osal_getStackGrowthDir(){
 }
 
 
-extern void MemPoolsInitialize();
+extern void MemPoolsInitialize(const size_t heapBytes);
 
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 // Description - see the header file.
@@ -77,7 +77,7 @@ void OSALInit(void) {
   static bool init = false;
   if (!init) {
     init = true;
-    MemPoolsInitialize();
+    MemPoolsInitialize(0);
     LCAL_Init();
     DLL_Init( &osal.osalTaskList );
     osal.stackGrowthUp = osal_getStackGrowthDir();
@@ -100,6 +100,21 @@ void OSALExitCritical(void) {
   portEXIT_CRITICAL();
 }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEnterCriticalFromIsr(void) {
+  return (uint32_t)portSET_INTERRUPT_MASK_FROM_ISR();
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALExitCriticalFromIsr(const uint32_t state) {
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+  (void)state;
+}
+
 
 // ////////////////////////////////////////////////////////////////////////////
 // Disable critical section (disable task scheduler)
@@ -311,6 +326,14 @@ static const portBASE_TYPE osalPrioMap[] = {
     1   // OSAL_PRIO_BACKGND
 };
 
+// Thread local storage pointer that holds each task's OSALThreadCtxT.
+#ifndef OSAL_FREERTOS_TLS_IDX
+#define OSAL_FREERTOS_TLS_IDX 0
+#endif
+
+#if (configNUM_THREAD_LOCAL_STORAGE_POINTERS <= OSAL_FREERTOS_TLS_IDX)
+#error "OSALGetThreadCtx() needs configNUM_THREAD_LOCAL_STORAGE_POINTERS > OSAL_FREERTOS_TLS_IDX"
+#endif
 
 
 typedef struct osal_NewTaskDataTag {
@@ -321,6 +344,7 @@ typedef struct osal_NewTaskDataTag {
   uint32_t taskId;
   portSTACK_TYPE *pStack;
   uint32_t stackSize;
+  OSALThreadCtxT ctx;
 } osal_NewTaskDataT;
 
 // ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -348,9 +372,15 @@ static void OSALTaskCreateTaskCb(void *p) {
 
   LOG_ASSERT( local.taskId == OSALGetCurrentTaskID() );
 
+  memset(&local.ctx, 0, sizeof(local.ctx));
+  local.ctx.taskId = local.taskId;
+  vTaskSetThreadLocalStoragePointer(NULL, OSAL_FREERTOS_TLS_IDX, &local.ctx);
+
   // Call the function.
   local.pTaskFunc(local.pParam);
 
+  vTaskSetThreadLocalStoragePointer(NULL, OSAL_FREERTOS_TLS_IDX, NULL);
+
   OSALEnterCritical();
   DLL_NodeUnlist(&local.listNode);
   OSALExitCritical();
@@ -390,6 +420,23 @@ uint32_t OSALGetCurrentTaskID(void) {
   return (pTask) ? pTask->taskId : 0;
 }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+OSALThreadCtxT *OSALGetThreadCtx(void) {
+  OSALThreadCtxT *pCtx =
+    (OSALThreadCtxT *)pvTaskGetThreadLocalStoragePointer(NULL, OSAL_FREERTOS_TLS_IDX);
+  if (NULL == pCtx) {
+    // Not started by OSALTaskCreate().  The block lives as long as the task;
+    // such tasks are not expected to be deleted.
+    pCtx = (OSALThreadCtxT *)pvPortMalloc(sizeof(OSALThreadCtxT));
+    LOG_ASSERT(NULL != pCtx);
+    memset(pCtx, 0, sizeof(*pCtx));
+    vTaskSetThreadLocalStoragePointer(NULL, OSAL_FREERTOS_TLS_IDX, pCtx);
+  }
+  return pCtx;
+}
+
 #define OSAL_EXTRA_STACK_BYTES_JUST_IN_CASE 16
 
 // ////////////////////////////////////////////////////////////////////////////////////////////////
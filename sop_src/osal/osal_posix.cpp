@@ -17,11 +17,13 @@
 #include "utils/helper_utils.h"
 #include "utils/helper_macros.h"
 #include "osal/cs_task_locker.hpp"
-#include <map>
 #include <stdint.h>
 #include <string.h>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 
 #ifndef EOK
 #define EOK 0
@@ -35,6 +37,9 @@ LOG_MODNAME("osal.cpp");
 #include <pthread.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/mman.h>
 //#define PRIO_IN_THREAD
 #include <errno.h>
 #include <cstdlib>
@@ -55,6 +60,9 @@ LOG_MODNAME("osal.cpp");
 
 
 static int posix_mutexCount = 0;
+#if (OSAL_LOCK_PROFILE > 0)
+static std::atomic<int> posix_semCount(0);
+#endif
 static uint32_t mInitializedTag = 0;
 class OSAL;
 
@@ -78,32 +86,228 @@ public:
   }
 };
 
+// Use the calibrated time stamp counter for OSALGetTicks() on x86.
+// Otherwise OSALGetTicks() counts nanoseconds.
+#ifndef OSAL_USE_TSC
+#define OSAL_USE_TSC 0
+#endif
+#if (OSAL_USE_TSC > 0) && !(defined(__x86_64__) || defined(__i386__))
+#undef OSAL_USE_TSC
+#define OSAL_USE_TSC 0
+#endif
+#if (OSAL_USE_TSC > 0)
+#include <x86intrin.h>
+#endif
+
+// //////////////////////////////////////////////
+// Nanoseconds from clk.  clock_gettime() is a vDSO call on Linux.
+static inline uint64_t posix_ReadNs(const clockid_t clk) {
+  struct timespec ts;
+  clock_gettime(clk, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+// //////////////////////////////////////////////
+// The coarse clock is cheaper, but use it for OSALGetMS() only if it ticks at
+// least once per millisecond.
+static clockid_t posix_MsClock(void) {
+#if defined(CLOCK_MONOTONIC_COARSE)
+  struct timespec res;
+  if ((0 == clock_getres(CLOCK_MONOTONIC_COARSE, &res)) &&
+      (0 == res.tv_sec) && (res.tv_nsec <= 1000000)) {
+    return CLOCK_MONOTONIC_COARSE;
+  }
+#endif
+  return CLOCK_MONOTONIC;
+}
+
+typedef struct posix_ClockTag {
+  clockid_t msClk;  ///< Clock used by OSALGetMS()
+  uint64_t baseNs;  ///< CLOCK_MONOTONIC at startup, so that the OSAL clocks start near 0.
+} posix_ClockT;
+
+// //////////////////////////////////////////////
+// Initialized once, thread safe.
+static const posix_ClockT &posix_Clock(void) {
+  static const posix_ClockT clk = { posix_MsClock(), posix_ReadNs(CLOCK_MONOTONIC) };
+  return clk;
+}
+
 // //////////////////////////////////////////////
 // Get milliseconds without any critical sections.
 static uint32_t getMS(void) {
-  static uint32_t firstMs = 0;
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  uint32_t rval = ((uint32_t)(tv.tv_sec * 1000 + tv.tv_usec / 1000)) - firstMs;
-  if (0 == firstMs){
-    firstMs = rval;
-    rval = 0;
+  const posix_ClockT &clk = posix_Clock();
+  // Signed, because the coarse clock may lag the base by less than a tick.
+  return (uint32_t)(((int64_t)(posix_ReadNs(clk.msClk) - clk.baseNs)) / 1000000);
+}
+
+#if (OSAL_USE_TSC > 0)
+// //////////////////////////////////////////////
+// Measure the TSC against the raw (not NTP slewed) monotonic clock.
+static double posix_CalibrateTsc(void) {
+#if defined(CLOCK_MONOTONIC_RAW)
+  const clockid_t clk = CLOCK_MONOTONIC_RAW;
+#else
+  const clockid_t clk = CLOCK_MONOTONIC;
+#endif
+  const uint64_t ns0  = posix_ReadNs(clk);
+  const uint64_t tsc0 = __rdtsc();
+  const struct timespec ts = {0, 20000000};
+  nanosleep(&ts, NULL);
+  const uint64_t ns1  = posix_ReadNs(clk);
+  const uint64_t tsc1 = __rdtsc();
+  LOG_ASSERT(tsc1 > tsc0);
+  return (double)(ns1 - ns0) / (double)(tsc1 - tsc0);
+}
+
+// //////////////////////////////////////////////
+static double posix_TscNsPerTick(void) {
+  static const double nsPerTick = posix_CalibrateTsc();
+  return nsPerTick;
+}
+#endif
+
+
+#if (OSAL_LOCK_PROFILE > 0)
+#include <algorithm>
+
+// The plain entry points below are for callers built without the macros.
+#undef OSALEnterCritical
+#undef OSALEnterTaskCritical
+#undef OSALCsEnter
+
+// Distinct locks and call sites tracked; the rest are pooled in one slot.
+#ifndef OSAL_LOCK_PROFILE_SLOTS
+#define OSAL_LOCK_PROFILE_SLOTS 512
+#endif
+
+// Histogram bucket i counts times below 256 << i ns; the last one the rest.
+#define POSIX_LOCKPROF_BUCKETS 16
+
+// Number of locks printed by OSALDumpLockStats().
+#define POSIX_LOCKPROF_TOP 20
+
+static const char posix_kLockCrit[]  = "crit";
+static const char posix_kLockCs[]    = "cs";
+static const char posix_kLockMutex[] = "mutex";
+static const char posix_kLockSem[]   = "sem";
+
+// //////////////////////////////////////////////
+// Statistics for one mutex, semaphore or critical section call site.
+// Zero initialized as a static, and updated without locks.
+typedef struct posix_LockStatTag {
+  std::atomic<uint32_t> state; ///< 0 free, 1 being claimed, 2 in use
+  const char* pKind;
+  const char* pFile;           ///< Call site, or nullptr for an object
+  int line;                    ///< Call site line, or the object's number
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> contended;
+  std::atomic<uint64_t> waitNs;
+  std::atomic<uint64_t> maxWaitNs;
+  std::atomic<uint64_t> holdNs;
+  std::atomic<uint32_t> waitHist[ POSIX_LOCKPROF_BUCKETS ];
+  std::atomic<uint32_t> holdHist[ POSIX_LOCKPROF_BUCKETS ];
+} posix_LockStatT;
+
+static posix_LockStatT posix_LockStats[ OSAL_LOCK_PROFILE_SLOTS + 1 ];
+
+// //////////////////////////////////////////////
+// Find, or claim, the statistics for a lock or call site.
+static posix_LockStatT* posix_LockStat(const char* const pKind, const char* const pFile, const int line) {
+  const uintptr_t hash = ((uintptr_t)pFile * 31u) + ((uintptr_t)pKind * 7u) + (uintptr_t)line;
+  for (int i = 0; i < OSAL_LOCK_PROFILE_SLOTS; i++) {
+    posix_LockStatT* const p = &posix_LockStats[ (hash + i) % OSAL_LOCK_PROFILE_SLOTS ];
+    uint32_t state = p->state.load(std::memory_order_acquire);
+    if (0 == state) {
+      if (p->state.compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+        p->pKind = pKind;
+        p->pFile = pFile;
+        p->line  = line;
+        p->state.store(2, std::memory_order_release);
+        return p;
+      }
+    }
+    while (1 == state) {
+      state = p->state.load(std::memory_order_acquire);
+    }
+    if ((p->pKind == pKind) && (p->pFile == pFile) && (p->line == line)) {
+      return p;
+    }
   }
-  return rval;
+  posix_LockStatT* const pOthers = &posix_LockStats[ OSAL_LOCK_PROFILE_SLOTS ];
+  pOthers->pKind = "others";
+  return pOthers;
+}
+
+// //////////////////////////////////////////////
+static inline int posix_LockBucket(const uint64_t ns) {
+  int b = 0;
+  while ((b < (POSIX_LOCKPROF_BUCKETS - 1)) && (ns >= (256ull << b))) {
+    b++;
+  }
+  return b;
+}
+
+// //////////////////////////////////////////////
+static void posix_LockAcquired(posix_LockStatT* const p, const bool contended, const uint64_t waitNs) {
+  p->count.fetch_add(1, std::memory_order_relaxed);
+  if (contended) {
+    p->contended.fetch_add(1, std::memory_order_relaxed);
+    p->waitNs.fetch_add(waitNs, std::memory_order_relaxed);
+    uint64_t worst = p->maxWaitNs.load(std::memory_order_relaxed);
+    while ((waitNs > worst) &&
+           (!p->maxWaitNs.compare_exchange_weak(worst, waitNs, std::memory_order_relaxed))) {
+    }
+  }
+  p->waitHist[ posix_LockBucket(waitNs) ].fetch_add(1, std::memory_order_relaxed);
+}
+
+// //////////////////////////////////////////////
+static void posix_LockReleased(posix_LockStatT* const p, const uint64_t holdNs) {
+  p->holdNs.fetch_add(holdNs, std::memory_order_relaxed);
+  p->holdHist[ posix_LockBucket(holdNs) ].fetch_add(1, std::memory_order_relaxed);
 }
+#endif // #if (OSAL_LOCK_PROFILE > 0)
 
+// Optional adaptive spin before a contended mutex blocks in the kernel.
+// 0 disables spinning; otherwise it is the maximum number of try_lock() spins.
+#ifndef OSAL_MUTEX_SPIN_MAX
+#define OSAL_MUTEX_SPIN_MAX 0
+#endif
 
 // //////////////////////////////////////////////
 class posix_OsalMutex : public posix_OsalBase {
 protected:
-  std::recursive_mutex mMutex;
+  std::recursive_timed_mutex mMutex;
   const int mMutexCnt;
+#if (OSAL_MUTEX_SPIN_MAX > 0)
+  // Running estimate of how many spins it takes to acquire this mutex.
+  std::atomic<int> mSpins;
+#endif
+#if (OSAL_LOCK_PROFILE > 0)
+  // This mutex's statistics, found on first use.
+  posix_LockStatT* mpOwnStat;
+  // Where the holder's time goes, when it took the mutex, and its recursion.
+  posix_LockStatT* mpHoldStat;
+  uint64_t mLockedNs;
+  int mDepth;
+#endif
 
 public:
   posix_OsalMutex()
   : posix_OsalBase()
   , mMutex()
-  , mMutexCnt(posix_mutexCount++){
+  , mMutexCnt(posix_mutexCount++)
+#if (OSAL_MUTEX_SPIN_MAX > 0)
+  , mSpins(0)
+#endif
+#if (OSAL_LOCK_PROFILE > 0)
+  , mpOwnStat(nullptr)
+  , mpHoldStat(nullptr)
+  , mLockedNs(0)
+  , mDepth(0)
+#endif
+  {
   }
 
   virtual ~posix_OsalMutex() {
@@ -118,37 +322,93 @@ public:
     
   }
 
+#if (OSAL_LOCK_PROFILE > 0)
+  bool lock(const uint32_t timeoutMs) {
+    if (nullptr == mpOwnStat) {
+      mpOwnStat = posix_LockStat(posix_kLockMutex, nullptr, mMutexCnt);
+    }
+    return lock(timeoutMs, mpOwnStat);
+  }
+
+  // Lock, charging the wait and hold times to pStat.
+  bool lock(const uint32_t timeoutMs, posix_LockStatT* const pStat) {
+    const uint64_t t0    = posix_ReadNs(CLOCK_MONOTONIC);
+    const bool contended = !mMutex.try_lock();
+    const bool rval      = (!contended) || lockImpl(timeoutMs);
+    if (rval) {
+      const uint64_t t1 = posix_ReadNs(CLOCK_MONOTONIC);
+      posix_LockAcquired(pStat, contended, t1 - t0);
+      if (1 == ++mDepth) {
+        mpHoldStat = pStat;
+        mLockedNs  = t1;
+      }
+    }
+    return rval;
+  }
+
+  bool unlock() {
+    check();
+    if (0 == --mDepth) {
+      posix_LockReleased(mpHoldStat, posix_ReadNs(CLOCK_MONOTONIC) - mLockedNs);
+    }
+    mMutex.unlock();
+    return true;
+  }
+
+private:
+  bool lockImpl(const uint32_t timeoutMs) {
+#else
   bool lock(const uint32_t timeoutMs) {
+#endif
     check();
     bool rval = false;
+#if (OSAL_MUTEX_SPIN_MAX > 0)
+    rval = spin();
+    if (rval) {
+      return rval;
+    }
+#endif
     if (timeoutMs == OSAL_WAIT_INFINITE) {
       // If no timeout specified, then just do a normal wait
       mMutex.lock();
       rval = true;
     } else {
-      bool gotSem = false;
-      uint32_t currentTime = getMS();
-      const uint32_t timeOut = currentTime + (0x7fffffff & timeoutMs);
-      int32_t timeRemaining = timeOut - currentTime;
-      while ((!gotSem) && (timeRemaining > 0)) {
-        const bool gotIt = mMutex.try_lock();
-        gotSem = gotIt;
-        if (!gotSem) {
-          usleep(2000);
-          currentTime = getMS();
-          timeRemaining = timeOut - currentTime;
-        }
-      }
-      rval = gotSem;
+      // Block until the deadline, no polling.
+      const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(0x7fffffff & timeoutMs);
+      rval = mMutex.try_lock_until(deadline);
     }
     return rval;
   }
 
+#if (OSAL_LOCK_PROFILE == 0)
   bool unlock() {
     check();
     mMutex.unlock();
     return true;
   }
+#endif
+
+#if (OSAL_MUTEX_SPIN_MAX > 0)
+private:
+  // Spin for up to twice the running estimate (like glibc's adaptive
+  // mutexes), then let the caller block.
+  bool spin() {
+    const int spins = mSpins.load(std::memory_order_relaxed);
+    const int maxSpins = MIN(OSAL_MUTEX_SPIN_MAX, (spins * 2) + 10);
+    int cnt = 0;
+    bool gotIt = mMutex.try_lock();
+    while ((!gotIt) && (cnt < maxSpins)) {
+      cnt++;
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+      gotIt = mMutex.try_lock();
+    }
+    mSpins.store(spins + ((cnt - spins) / 8), std::memory_order_relaxed);
+    return gotIt;
+  }
+#endif
 };
 
 
@@ -169,9 +429,18 @@ public:
   }
   
 #ifndef ccs
+#if (OSAL_LOCK_PROFILE > 0)
+  void EnterCritical(const char* const pFile = __FILE__, const int line = __LINE__) {
+#else
   void EnterCritical() {
+#endif
     if (0x99999999 == mInitializedTag) {
-      if (!mMutex.lock(OSAL_WAIT_INFINITE)) {
+#if (OSAL_LOCK_PROFILE > 0)
+      const bool locked = mMutex.lock(OSAL_WAIT_INFINITE, posix_LockStat(posix_kLockCrit, pFile, line));
+#else
+      const bool locked = mMutex.lock(OSAL_WAIT_INFINITE);
+#endif
+      if (!locked) {
         LOG_ASSERT(false);
         exit(-1);
       }
@@ -213,9 +482,6 @@ public:
 
   static int mMissedCriticals;
 
-  typedef std::map<pthread_t, uint32_t> IdMapT;
-  IdMapT *psosal_IdMap;
-  IdMapT &osal_IdMap;
 #ifdef CHECK_CS
   uint64_t mOwnerThreadId;
   int mRecurse;
@@ -225,13 +491,12 @@ private:
   posix_OsalMutex mMutex;
   
   OSAL()
-  : psosal_IdMap(new IdMapT)
-  , osal_IdMap(*psosal_IdMap)
+  :
 #ifdef CHECK_CS
-  , mOwnerThreadId(0)
-  , mRecurse(0)
+    mOwnerThreadId(0)
+  , mRecurse(0),
 #endif
-  , mMutex()
+    mMutex()
   {
     LOG_ASSERT(mInitializedTag == 0);
     mInitializedTag = 0x99999999;
@@ -245,19 +510,256 @@ private:
 int OSAL::mMissedCriticals = 0;
 
 
+#if (OSAL_CS_CHECK_ORDER > 0)
+// How many of each level of per-object critical section this thread holds.
+static thread_local uint8_t posix_CsHeld[ OSAL_CS_NUM_LEVELS ];
+// How deep this thread is in the global critical section.
+static thread_local uint32_t posix_CritDepth = 0;
+
+// //////////////////////////////////////////////
+// Asserts that the thread holds no lock of a higher level than pCs, and counts
+// it as held.
+static void posix_CsOrderEnter(const OSALCsT* const pCs) {
+  if (OSAL_CS_LEVEL_NONE != pCs->level) {
+    for (int level = pCs->level + 1; level < OSAL_CS_NUM_LEVELS; level++) {
+      LOG_ASSERT(0 == posix_CsHeld[ level ]);
+    }
+    posix_CsHeld[ pCs->level ]++;
+  }
+}
+
+// //////////////////////////////////////////////
+static void posix_CsOrderExit(const OSALCsT* const pCs) {
+  if (OSAL_CS_LEVEL_NONE != pCs->level) {
+    LOG_ASSERT(posix_CsHeld[ pCs->level ] > 0);
+    posix_CsHeld[ pCs->level ]--;
+  }
+}
+#endif
+
+// //////////////////////////////////////////////
+// The global critical section comes before the ranked per-object ones.
+static inline void posix_CritOrderEnter(void) {
+#if (OSAL_CS_CHECK_ORDER > 0)
+  if (0 == posix_CritDepth++) {
+    for (int level = OSAL_CS_LEVEL_NONE + 1; level < OSAL_CS_NUM_LEVELS; level++) {
+      LOG_ASSERT(0 == posix_CsHeld[ level ]);
+    }
+  }
+#endif
+}
+
+// //////////////////////////////////////////////
+static inline void posix_CritOrderExit(void) {
+#if (OSAL_CS_CHECK_ORDER > 0)
+  posix_CritDepth--;
+#endif
+}
+
+extern "C" {
+void OSALEnterCritical(void) {
+  posix_CritOrderEnter();
+  OSAL::inst().EnterCritical();
+}
+void OSALExitCritical(void) {
+  OSAL::inst().ExitCritical();
+  posix_CritOrderExit();
+}
+void OSALEnterTaskCritical(void) {
+  posix_CritOrderEnter();
+  OSAL::inst().EnterCritical();
+}
+void OSALExitTaskCritical(void) {
+  OSAL::inst().ExitCritical();
+  posix_CritOrderExit();
+}
+// No interrupts here (signal handlers must not use these), so the global critical section.
+uint32_t OSALEnterCriticalFromIsr(void) {
+  OSAL::inst().EnterCritical();
+  return 0;
+}
+void OSALExitCriticalFromIsr(const uint32_t state) {
+  (void)state;
+  OSAL::inst().ExitCritical();
+}
+#if (OSAL_LOCK_PROFILE > 0)
+void _OSALEnterCritical(const char* const pFile, const int line) {
+  posix_CritOrderEnter();
+  OSAL::inst().EnterCritical(pFile, line);
+}
+#endif
+}
+#endif
+
+// Number of uncontended retries before a per-object critical section sleeps.
+#ifndef OSAL_CS_SPIN_MAX
+#define OSAL_CS_SPIN_MAX 100
+#endif
+
+// //////////////////////////////////////////////
+// Per thread nonzero token identifying the owner of an OSALCsT.
+static uint32_t posix_CsToken(void) {
+  static std::atomic<uint32_t> nextToken(0);
+  static thread_local uint32_t token = 0;
+  if (0 == token) {
+    token = ++nextToken;
+  }
+  return token;
+}
+
+// //////////////////////////////////////////////
+// Pause briefly while spinning on a lock word.
+static inline void posix_CpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// //////////////////////////////////////////////
+// Sleep while *pWord == val.
+static void posix_CsWait(volatile uint32_t* const pWord, const uint32_t val) {
+  syscall(SYS_futex, pWord, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+// //////////////////////////////////////////////
+// Wake one waiter sleeping on pWord.
+static void posix_CsWake(volatile uint32_t* const pWord) {
+  syscall(SYS_futex, pWord, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#else
+// //////////////////////////////////////////////
+// No futex: back off for a short while instead.
+static void posix_CsWait(volatile uint32_t* const pWord, const uint32_t val) {
+  if (val == __atomic_load_n(pWord, __ATOMIC_RELAXED)) {
+    const struct timespec ts = {0, 50000};
+    nanosleep(&ts, NULL);
+  }
+}
+
+// //////////////////////////////////////////////
+static void posix_CsWake(volatile uint32_t* const pWord) { (void)pWord; }
+#endif
+
 extern "C" {
-void OSALEnterCritical(void) { OSAL::inst().EnterCritical(); }
-void OSALExitCritical(void) { OSAL::inst().ExitCritical(); }
-void OSALEnterTaskCritical(void) { OSAL::inst().EnterCritical(); }
-void OSALExitTaskCritical(void) { OSAL::inst().ExitCritical(); }
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALCsInit(OSALCsT* const pCs, const bool isrSafe, const OSALCsLevelT level) {
+  LOG_ASSERT(pCs);
+  memset(pCs, 0, sizeof(*pCs));
+  pCs->isrSafe = isrSafe;
+  pCs->level   = (uint8_t)level;
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// The lock word is 0 when free, 1 when locked and 2 when locked with waiters.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+#if (OSAL_LOCK_PROFILE > 0)
+void OSALCsEnter(OSALCsT* const pCs) {
+  _OSALCsEnter(pCs, __FILE__, __LINE__);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void _OSALCsEnter(OSALCsT* const pCs, const char* const pFile, const int line) {
+  if (nullptr == pCs) {
+    _OSALEnterCritical(pFile, line);
+    return;
+  }
+  posix_LockStatT* const pStat = posix_LockStat(posix_kLockCs, pFile, line);
+#else
+void OSALCsEnter(OSALCsT* const pCs) {
+  if (nullptr == pCs) {
+    OSALEnterCritical();
+    return;
+  }
+#endif
+  const uint32_t me = posix_CsToken();
+  if (me == __atomic_load_n(&pCs->owner, __ATOMIC_RELAXED)) {
+    pCs->recurse++;
+#if (OSAL_LOCK_PROFILE > 0)
+    posix_LockAcquired(pStat, false, 0);
+#endif
+    return;
+  }
+#if (OSAL_CS_CHECK_ORDER > 0)
+  posix_CsOrderEnter(pCs);
+#endif
+#if (OSAL_LOCK_PROFILE > 0)
+  const uint64_t t0 = posix_ReadNs(CLOCK_MONOTONIC);
+#endif
+  uint32_t c = 0;
+  bool gotIt = __atomic_compare_exchange_n(
+    &pCs->lock, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+#if (OSAL_LOCK_PROFILE > 0)
+  const bool contended = !gotIt;
+#endif
+  for (int spin = 0; (!gotIt) && (spin < OSAL_CS_SPIN_MAX); spin++) {
+    posix_CpuRelax();
+    c     = 0;
+    gotIt = (0 == __atomic_load_n(&pCs->lock, __ATOMIC_RELAXED)) &&
+            __atomic_compare_exchange_n(
+              &pCs->lock, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+  }
+  if (!gotIt) {
+    c = __atomic_exchange_n(&pCs->lock, 2, __ATOMIC_ACQUIRE);
+    while (c != 0) {
+      posix_CsWait(&pCs->lock, 2);
+      c = __atomic_exchange_n(&pCs->lock, 2, __ATOMIC_ACQUIRE);
+    }
+  }
+  __atomic_store_n(&pCs->owner, me, __ATOMIC_RELAXED);
+  pCs->recurse = 1;
+#if (OSAL_LOCK_PROFILE > 0)
+  const uint64_t t1 = posix_ReadNs(CLOCK_MONOTONIC);
+  posix_LockAcquired(pStat, contended, t1 - t0);
+  pCs->pProfSite    = pStat;
+  pCs->profLockedNs = t1;
+#endif
 }
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALCsExit(OSALCsT* const pCs) {
+  if (nullptr == pCs) {
+    OSALExitCritical();
+    return;
+  }
+  LOG_ASSERT(posix_CsToken() == pCs->owner);
+  LOG_ASSERT(pCs->recurse > 0);
+  if (0 == --pCs->recurse) {
+#if (OSAL_LOCK_PROFILE > 0)
+    posix_LockReleased(
+      (posix_LockStatT*)pCs->pProfSite, posix_ReadNs(CLOCK_MONOTONIC) - pCs->profLockedNs);
+#endif
+    __atomic_store_n(&pCs->owner, 0, __ATOMIC_RELAXED);
+    if (2 == __atomic_exchange_n(&pCs->lock, 0, __ATOMIC_RELEASE)) {
+      posix_CsWake(&pCs->lock);
+    }
+#if (OSAL_CS_CHECK_ORDER > 0)
+    posix_CsOrderExit(pCs);
 #endif
+  }
+}
+
+} // extern "C"
 
 
 
+// This thread's context block.  Zero initialized, so access is a plain TLS load.
+static thread_local OSALThreadCtxT posix_ThreadCtx = { 0, nullptr, OSAL_LANE_NONE, nullptr, nullptr };
+
 extern "C" {
 
-  extern void MemPoolsInitialize();
+  extern void MemPoolsInitialize(const size_t heapBytes);
   
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 // Description - see the header file.
@@ -279,7 +781,9 @@ void OSALInit(void) {
 #endif
     init = true;
     (void)OSAL::inst();
-    MemPoolsInitialize();
+    // Latch the clock base, and calibrate OSALGetTicks() if it needs it.
+    (void)OSALTicksToNS(OSALGetTicks());
+    MemPoolsInitialize(0);
     //OSALRandomInit("posix", 5);
   }
 }
@@ -338,27 +842,94 @@ bool OSALUnlockMutex(void *const pPortMutex) {
 // Description - see the header file.
 // ///////////////////////////////////////////////////////////////////////////////
 uint32_t OSALGetMS(void) {
-#if (TARGET_OS_OSX > 0)
-  CSTaskLocker lock;
+  return getMS();
+}
+
+// ///////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ///////////////////////////////////////////////////////////////////////////////
+uint64_t OSALGetUS(void) {
+  return OSALGetNS() / 1000;
+}
+
+// ///////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ///////////////////////////////////////////////////////////////////////////////
+uint64_t OSALGetNS(void) {
+  return posix_ReadNs(CLOCK_MONOTONIC) - posix_Clock().baseNs;
+}
+
+// ///////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ///////////////////////////////////////////////////////////////////////////////
+uint64_t OSALGetTicks(void) {
+#if (OSAL_USE_TSC > 0)
+  return __rdtsc();
+#else
+  return OSALGetNS();
+#endif
+}
+
+// ///////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ///////////////////////////////////////////////////////////////////////////////
+uint64_t OSALTicksToNS(const uint64_t ticks) {
+#if (OSAL_USE_TSC > 0)
+  return (uint64_t)((double)ticks * posix_TscNsPerTick());
+#else
+  return ticks;
 #endif
-  const uint32_t ms = getMS();
-  return ms;
 }
 
 } // extern "C" {
 
+#ifndef GCDSEM
+// sem_clockwait() arrived in glibc 2.30; older libraries only have the
+// CLOCK_REALTIME based sem_timedwait().
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 30)))
+#define POSIX_HAS_SEM_CLOCKWAIT
+#define POSIX_SEM_CLOCK CLOCK_MONOTONIC
+#else
+#define POSIX_SEM_CLOCK CLOCK_REALTIME
+#endif
+
+// //////////////////////////////////////////////
+// Get an absolute deadline timeoutMs milliseconds from now on clock clk.
+static void getDeadline(const clockid_t clk, const uint32_t timeoutMs, struct timespec &ts) {
+  LOG_ASSERT_FN(EOK == clock_gettime(clk, &ts));
+  ts.tv_sec += (time_t)(timeoutMs / 1000);
+  ts.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+}
+#endif // GCDSEM
+
 class posix_OsalCntSem : public posix_OsalBase {
 protected:
-  int mMaxCnt;
-  int mCnt;
+  const int mMaxCnt;
+  // Shadow of the semaphore's count, used only to enforce mMaxCnt.
+  // It is incremented before posting and decremented after a successful wait,
+  // so it never drops below the real count and needs no critical section.
+  std::atomic<int> mCnt;
 #ifdef GCDSEM
   dispatch_semaphore_t mSem;
 #else
   sem_t mSem;
 #endif
+#if (OSAL_LOCK_PROFILE > 0)
+  const int mSemCnt;
+  // This semaphore's statistics, found on first use.
+  posix_LockStatT* mpStat;
+#endif
 public:
   posix_OsalCntSem(const int initValue, const int maxValue)
-      : posix_OsalBase(), mMaxCnt(maxValue), mCnt(initValue) {
+      : posix_OsalBase(), mMaxCnt(maxValue), mCnt(initValue)
+#if (OSAL_LOCK_PROFILE > 0)
+      , mSemCnt(posix_semCount++), mpStat(nullptr)
+#endif
+  {
 
 #ifdef GCDSEM
     mSem = dispatch_semaphore_create(initValue);
@@ -377,7 +948,25 @@ public:
 #endif
   }
 
+#if (OSAL_LOCK_PROFILE > 0)
+  // Waits that were not satisfied at once count as contended.
+  bool wait(const uint32_t timeoutMs) {
+    if (nullptr == mpStat) {
+      mpStat = posix_LockStat(posix_kLockSem, nullptr, mSemCnt);
+    }
+    const uint64_t t0    = posix_ReadNs(CLOCK_MONOTONIC);
+    const bool contended = !waitImpl(0);
+    const bool rval      = (!contended) || ((0 != timeoutMs) && waitImpl(timeoutMs));
+    if (rval) {
+      posix_LockAcquired(mpStat, contended, posix_ReadNs(CLOCK_MONOTONIC) - t0);
+    }
+    return rval;
+  }
+
+  bool waitImpl(const uint32_t timeoutMs) {
+#else
   bool wait(const uint32_t timeoutMs) {
+#endif
     check();
     bool rval = false;
 #ifdef GCDSEM
@@ -391,35 +980,35 @@ public:
       rval = (EOK == dispatch_semaphore_wait(mSem, timeoutTime));
     }
 #else
+    int status;
     if (timeoutMs == OSAL_WAIT_INFINITE) {
       // If no timeout specified, then just do a normal wait
-      LOG_ASSERT_FN(EOK == sem_wait(&mSem));
-      rval = true;
+      do {
+        status = sem_wait(&mSem);
+      } while ((EOK != status) && (EINTR == errno));
+      LOG_ASSERT(EOK == status);
+    } else if (0 == timeoutMs) {
+      status = sem_trywait(&mSem);
     } else {
-      bool gotSem = false;
-      uint32_t currentTime = OSALGetMS();
-      const uint32_t timeOut = currentTime + (0x7fffffff & timeoutMs);
-      while ((!gotSem) && (currentTime < timeOut)) {
-        const int status = sem_trywait(&mSem);
-        gotSem = (EOK == status);
-        if (!gotSem) {
-#ifdef EBUSY
-          // LOG_TRACE(("Could not get sem due to code %d\r\n", status));
-          LOG_ASSERT(
-              (-1 == status) || (EAGAIN == status) ||
-              (EBUSY == status)); // Check that the wait failed due to business.
-#endif
-          usleep(2000);
-          currentTime = OSALGetMS();
-        }
-      }
-      rval = gotSem;
+      // Block until posted or until the absolute deadline, no polling.
+      struct timespec deadline;
+      getDeadline(POSIX_SEM_CLOCK, 0x7fffffff & timeoutMs, deadline);
+      do {
+#ifdef POSIX_HAS_SEM_CLOCKWAIT
+        status = sem_clockwait(&mSem, POSIX_SEM_CLOCK, &deadline);
+#else
+        status = sem_timedwait(&mSem, &deadline);
+#endif
+      } while ((EOK != status) && (EINTR == errno));
+    }
+    rval = (EOK == status);
+    if (!rval) {
+      // Check that the wait failed due to a timeout or business.
+      LOG_ASSERT((ETIMEDOUT == errno) || (EAGAIN == errno));
     }
 #endif // GCDSEM
     if (rval) {
-      OSALEnterTaskCritical();
-      const bool isGteZero = (--mCnt >= 0);
-      OSALExitTaskCritical();
+      const bool isGteZero = (mCnt.fetch_sub(1) > 0);
       LOG_ASSERT_FN(isGteZero);
     }
     return rval;
@@ -427,23 +1016,175 @@ public:
 
   bool signal(const int inc) {
     check();
-    OSALEnterTaskCritical();
-    const int finalCnt = mCnt + inc;
-    const int endCnt = MIN(finalCnt, mMaxCnt);
+    // Reserve the increment against mMaxCnt, then post outside of any lock.
+    int cnt = mCnt.load();
+    int endCnt = (int)MIN((int64_t)cnt + inc, (int64_t)mMaxCnt);
+    while ((cnt < endCnt) && (!mCnt.compare_exchange_weak(cnt, endCnt))) {
+      endCnt = (int)MIN((int64_t)cnt + inc, (int64_t)mMaxCnt);
+    }
+    const bool capped = (endCnt != ((int64_t)cnt + inc));
 #ifdef GCDSEM
-    for (; mCnt < endCnt; mCnt++) {
+    for (; cnt < endCnt; cnt++) {
       dispatch_semaphore_signal(mSem);
     }
-    OSALExitTaskCritical();
-    return (endCnt == finalCnt);
+    return !capped;
 #else
     int status = EOK;
-    for (; (status == EOK) && (mCnt < endCnt); mCnt++) {
+    for (; (status == EOK) && (cnt < endCnt); cnt++) {
       status = sem_post(&mSem);
     }
-    OSALExitTaskCritical();
-    return ((endCnt == finalCnt) && (EOK == status));
+    return ((!capped) && (EOK == status));
+#endif
+  }
+};
+
+// pthread_rwlock_clockrdlock()/clockwrlock() also arrived in glibc 2.30.
+#ifdef POSIX_HAS_SEM_CLOCKWAIT
+#define POSIX_HAS_RWLOCK_CLOCKLOCK
+#endif
+
+class posix_OsalRwLock : public posix_OsalBase {
+private:
+  pthread_rwlock_t mLock;
+#if defined(__APPLE__)
+  // Darwin has no timed rwlock, so timed waiters sleep on mTimedCond, which
+  // unlock() signals while there are any.
+  std::mutex mTimedMutex;
+  std::condition_variable mTimedCond;
+  std::atomic<uint32_t> mTimedWaiters;
+#endif
+
+  int tryLock(const bool write) {
+    return (write) ? pthread_rwlock_trywrlock(&mLock) : pthread_rwlock_tryrdlock(&mLock);
+  }
+
+public:
+#if defined(__APPLE__)
+  posix_OsalRwLock() : mTimedWaiters(0) {
+#else
+  posix_OsalRwLock() {
+#endif
+    pthread_rwlockattr_t attr;
+    LOG_ASSERT_FN(EOK == pthread_rwlockattr_init(&attr));
+#if defined(__GLIBC__)
+    // glibc prefers readers by default, which lets a busy read side starve writers.
+    LOG_ASSERT_WARN_FN(
+        EOK == pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP));
+#endif
+    LOG_ASSERT_FN(EOK == pthread_rwlock_init(&mLock, &attr));
+    pthread_rwlockattr_destroy(&attr);
+  }
+
+  ~posix_OsalRwLock() {
+    pthread_rwlock_destroy(&mLock);
+  }
+
+  bool lock(const bool write, const uint32_t timeoutMs) {
+    int status;
+    if (OSAL_WAIT_INFINITE == timeoutMs) {
+      status = (write) ? pthread_rwlock_wrlock(&mLock) : pthread_rwlock_rdlock(&mLock);
+    } else if (0 == timeoutMs) {
+      status = tryLock(write);
+    } else {
+#if defined(POSIX_HAS_RWLOCK_CLOCKLOCK)
+      struct timespec deadline;
+      getDeadline(CLOCK_MONOTONIC, timeoutMs, deadline);
+      status = (write) ? pthread_rwlock_clockwrlock(&mLock, CLOCK_MONOTONIC, &deadline)
+                       : pthread_rwlock_clockrdlock(&mLock, CLOCK_MONOTONIC, &deadline);
+#elif !defined(__APPLE__)
+      struct timespec deadline;
+      getDeadline(CLOCK_REALTIME, timeoutMs, deadline);
+      status = (write) ? pthread_rwlock_timedwrlock(&mLock, &deadline)
+                       : pthread_rwlock_timedrdlock(&mLock, &deadline);
+#else
+      // Count this waiter before trying, so that an unlock() after a failed
+      // try is sure to wake it.  It cannot signal before the wait, since it
+      // needs mTimedMutex.
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+      std::unique_lock<std::mutex> lock(mTimedMutex);
+      mTimedWaiters.fetch_add(1, std::memory_order_seq_cst);
+      status = tryLock(write);
+      while ((EBUSY == status) &&
+             (std::cv_status::timeout != mTimedCond.wait_until(lock, deadline))) {
+        status = tryLock(write);
+      }
+      mTimedWaiters.fetch_sub(1, std::memory_order_relaxed);
+#endif
+    }
+    if (EOK != status) {
+      LOG_ASSERT((ETIMEDOUT == status) || (EBUSY == status));
+    }
+    return (EOK == status);
+  }
+
+  bool unlock() {
+    const bool rval = (EOK == pthread_rwlock_unlock(&mLock));
+#if defined(__APPLE__)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mTimedWaiters.load(std::memory_order_relaxed) > 0) {
+      {
+        std::lock_guard<std::mutex> lock(mTimedMutex);
+      }
+      mTimedCond.notify_all();
+    }
 #endif
+    return rval;
+  }
+};
+
+class posix_OsalEventGroup : public posix_OsalBase {
+private:
+  std::mutex mMutex;
+  std::condition_variable mCond;
+  uint32_t mBits;
+
+  static bool isSatisfied(const uint32_t bits, const uint32_t waitBits, const bool waitForAll) {
+    return (waitForAll) ? ((bits & waitBits) == waitBits) : (0 != (bits & waitBits));
+  }
+
+public:
+  posix_OsalEventGroup() : mBits(0) {}
+
+  uint32_t set(const uint32_t bits) {
+    uint32_t rval;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mBits |= bits;
+      rval = mBits;
+    }
+    // Waiters may want different bits, so wake all of them.
+    mCond.notify_all();
+    return rval;
+  }
+
+  uint32_t clear(const uint32_t bits) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const uint32_t rval = mBits;
+    mBits &= ~bits;
+    return rval;
+  }
+
+  uint32_t get() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBits;
+  }
+
+  uint32_t wait(const uint32_t waitBits, const bool waitForAll, const bool clearOnExit, const uint32_t timeoutMs) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto pred = [&] { return isSatisfied(mBits, waitBits, waitForAll); };
+    bool ok;
+    if (OSAL_WAIT_INFINITE == timeoutMs) {
+      mCond.wait(lock, pred);
+      ok = true;
+    } else {
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+      ok = mCond.wait_until(lock, deadline, pred);
+    }
+    const uint32_t rval = mBits;
+    if (ok && clearOnExit) {
+      mBits &= ~waitBits;
+    }
+    return rval;
   }
 };
 
@@ -521,29 +1262,273 @@ bool OSALSemaphoreWait(OSALSemaphorePtrT const pPortSem,
   }
 }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALDumpLockStats(void) {
+#if (OSAL_LOCK_PROFILE > 0)
+  static const char* const bucketNames[ POSIX_LOCKPROF_BUCKETS ] = {
+    "<256n", "<512n", "<1u", "<2u", "<4u", "<8u", "<16u", "<32u",
+    "<65u", "<131u", "<262u", "<524u", "<1m", "<2m", "<4m", ">=4m" };
+  posix_LockStatT* locks[ OSAL_LOCK_PROFILE_SLOTS + 1 ];
+  int numLocks = 0;
+  for (int i = 0; i <= OSAL_LOCK_PROFILE_SLOTS; i++) {
+    posix_LockStatT* const p = &posix_LockStats[ i ];
+    if (p->count.load(std::memory_order_relaxed) > 0) {
+      locks[ numLocks++ ] = p;
+    }
+  }
+  std::sort(locks, locks + numLocks, [](const posix_LockStatT* a, const posix_LockStatT* b) {
+    return (a->waitNs.load() != b->waitNs.load()) ? (a->waitNs.load() > b->waitNs.load())
+                                                  : (a->count.load() > b->count.load());
+  });
+
+  LOG_TRACE(("Lock statistics for %d locks, most time waiting first (times in us):\r\n", numLocks));
+  LOG_TRACE(("%-6s %-32s %10s %10s %9s %9s %9s\r\n",
+    "kind", "lock", "count", "contended", "wait avg", "wait max", "hold avg"));
+  char hist[ POSIX_LOCKPROF_BUCKETS * 20 ];
+  for (int i = 0; i < MIN(numLocks, POSIX_LOCKPROF_TOP); i++) {
+    const posix_LockStatT* const p = locks[ i ];
+    char name[ 40 ];
+    if (p->pFile) {
+      const char* const pSlash = strrchr(p->pFile, '/');
+      snprintf(name, sizeof(name), "%s:%d", pSlash ? pSlash + 1 : p->pFile, p->line);
+    } else {
+      snprintf(name, sizeof(name), "#%d", p->line);
+    }
+    uint64_t holds = 0;
+    for (int b = 0; b < POSIX_LOCKPROF_BUCKETS; b++) {
+      holds += p->holdHist[ b ].load(std::memory_order_relaxed);
+    }
+    const uint64_t count     = p->count.load(std::memory_order_relaxed);
+    const uint64_t contended = p->contended.load(std::memory_order_relaxed);
+    LOG_TRACE(("%-6s %-32s %10llu %10llu %9u %9u %9u\r\n",
+      p->pKind, name, (unsigned long long)count, (unsigned long long)contended,
+      (unsigned)(contended ? (p->waitNs.load(std::memory_order_relaxed) / contended / 1000) : 0),
+      (unsigned)(p->maxWaitNs.load(std::memory_order_relaxed) / 1000),
+      (unsigned)(holds ? (p->holdNs.load(std::memory_order_relaxed) / holds / 1000) : 0)));
+
+    // Non-empty histogram buckets.
+    for (int h = 0; h < 2; h++) {
+      const std::atomic<uint32_t>* const pHist = (0 == h) ? p->waitHist : p->holdHist;
+      int len = 0;
+      for (int b = 0; b < POSIX_LOCKPROF_BUCKETS; b++) {
+        const uint32_t n = pHist[ b ].load(std::memory_order_relaxed);
+        if (n) {
+          len += snprintf(&hist[ len ], sizeof(hist) - len, " %s:%u", bucketNames[ b ], n);
+        }
+      }
+      if (len) {
+        LOG_TRACE(("       %s%s\r\n", (0 == h) ? "wait" : "hold", hist));
+      }
+    }
+  }
+#else
+  LOG_TRACE(("Build with OSAL_LOCK_PROFILE=1 to collect lock statistics.\r\n"));
+#endif
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+OSALRwLockPtrT OSALRwLockCreate(void) {
+  posix_OsalRwLock *const pLock = new posix_OsalRwLock();
+  LOG_ASSERT(pLock);
+  return (OSALRwLockPtrT)pLock;
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALRwLockDelete(OSALRwLockPtrT *const ppRwLock) {
+  LOG_ASSERT(ppRwLock);
+  posix_OsalRwLock *const pLock = (posix_OsalRwLock *)*ppRwLock;
+  if (pLock) {
+    pLock->check();
+    delete pLock;
+  }
+  *ppRwLock = NULL;
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+bool OSALRwLockReadLock(OSALRwLockPtrT const pRwLock, const uint32_t timeoutMs) {
+  posix_OsalRwLock *const pLock = (posix_OsalRwLock *)pRwLock;
+  LOG_ASSERT(pLock && pLock->check());
+  return pLock->lock(false, timeoutMs);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+bool OSALRwLockReadUnlock(OSALRwLockPtrT const pRwLock) {
+  posix_OsalRwLock *const pLock = (posix_OsalRwLock *)pRwLock;
+  LOG_ASSERT(pLock && pLock->check());
+  return pLock->unlock();
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+bool OSALRwLockWriteLock(OSALRwLockPtrT const pRwLock, const uint32_t timeoutMs) {
+  posix_OsalRwLock *const pLock = (posix_OsalRwLock *)pRwLock;
+  LOG_ASSERT(pLock && pLock->check());
+  return pLock->lock(true, timeoutMs);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+bool OSALRwLockWriteUnlock(OSALRwLockPtrT const pRwLock) {
+  posix_OsalRwLock *const pLock = (posix_OsalRwLock *)pRwLock;
+  LOG_ASSERT(pLock && pLock->check());
+  return pLock->unlock();
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+OSALEventGroupPtrT OSALEventGroupCreate(void) {
+  posix_OsalEventGroup *const pGroup = new posix_OsalEventGroup();
+  LOG_ASSERT(pGroup);
+  return (OSALEventGroupPtrT)pGroup;
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALEventGroupDelete(OSALEventGroupPtrT *const ppGroup) {
+  LOG_ASSERT(ppGroup);
+  posix_OsalEventGroup *const pGroup = (posix_OsalEventGroup *)*ppGroup;
+  if (pGroup) {
+    pGroup->check();
+    delete pGroup;
+  }
+  *ppGroup = NULL;
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEventGroupSet(OSALEventGroupPtrT const pGroup, const uint32_t bits) {
+  posix_OsalEventGroup *const pEg = (posix_OsalEventGroup *)pGroup;
+  LOG_ASSERT(pEg && pEg->check());
+  return pEg->set(bits);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEventGroupClear(OSALEventGroupPtrT const pGroup, const uint32_t bits) {
+  posix_OsalEventGroup *const pEg = (posix_OsalEventGroup *)pGroup;
+  LOG_ASSERT(pEg && pEg->check());
+  return pEg->clear(bits);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEventGroupGet(OSALEventGroupPtrT const pGroup) {
+  posix_OsalEventGroup *const pEg = (posix_OsalEventGroup *)pGroup;
+  LOG_ASSERT(pEg && pEg->check());
+  return pEg->get();
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEventGroupWait(
+    OSALEventGroupPtrT const pGroup,
+    const uint32_t bitsToWaitFor,
+    const bool waitForAll,
+    const bool clearOnExit,
+    const uint32_t timeoutMs) {
+  posix_OsalEventGroup *const pEg = (posix_OsalEventGroup *)pGroup;
+  LOG_ASSERT(pEg && pEg->check());
+  return pEg->wait(bitsToWaitFor, waitForAll, clearOnExit, timeoutMs);
+}
+
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 // Description - see the header file.
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 void OSALSleep(const uint32_t ms) {
-#if 1 // ndef OSAL_SINGLE_TASK
-  const uint32_t startTime = OSALGetMS();
-  uint32_t now = startTime;
-  uint32_t elapsed = (now - startTime);
-  while (elapsed < ms) {
-    uint32_t remaining = ms - elapsed;
-    usleep((uint32_t)((uint64_t)remaining * (uint64_t)1000u));
-    elapsed = (now - OSALGetMS());
+  OSALSleepUs((uint64_t)ms * 1000u);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALSleepUs(const uint64_t us) {
+  OSALSleepUntil(OSALGetUS() + us);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALSleepUntil(const uint64_t deadlineUs) {
+#if defined(__APPLE__)
+  // No clock_nanosleep() on Darwin; sleep relative to the deadline until it passes.
+  uint64_t now = OSALGetUS();
+  while (now < deadlineUs) {
+    const uint64_t remainingUs = deadlineUs - now;
+    struct timespec ts;
+    ts.tv_sec  = (time_t)(remainingUs / 1000000u);
+    ts.tv_nsec = (long)(remainingUs % 1000000u) * 1000L;
+    (void)nanosleep(&ts, nullptr);
+    now = OSALGetUS();
   }
 #else
-  (void)ms;
-  LOG_VERBOSE(("Attempted to sleep %d ms from a single task!\r\n", ms));
+  // OSALGetUS() counts from posix_Clock().baseNs on CLOCK_MONOTONIC.
+  const uint64_t absNs = (deadlineUs * 1000u) + posix_Clock().baseNs;
+  struct timespec ts;
+  ts.tv_sec  = (time_t)(absNs / 1000000000u);
+  ts.tv_nsec = (long)(absNs % 1000000000u);
+  while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)) {
+  }
 #endif
 }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+OSALThreadCtxT *OSALGetThreadCtx(void) {
+  return &posix_ThreadCtx;
+}
+
 } // extern "C" {
 
 #ifndef OSAL_SINGLE_TASK
 
+// OSALTaskStructT stack sizes are budgets for embedded targets, too small for
+// libc on a full OS, so tasks never get less than this.  0 keeps the
+// pthread default for every task.
+#ifndef OSAL_POSIX_MIN_STACK_SIZE
+#define OSAL_POSIX_MIN_STACK_SIZE (256 * 1024)
+#endif
+
+// Run tasks on the OSALTaskStructT stack buffer when it is big enough.
+#ifndef OSAL_POSIX_USE_TASK_STACK
+#define OSAL_POSIX_USE_TASK_STACK 0
+#endif
+
+// Map task stacks with all pages faulted in, so that real time tasks do not
+// take page faults the first time they go deep.
+#ifndef OSAL_POSIX_PREFAULT_STACKS
+#define OSAL_POSIX_PREFAULT_STACKS 0
+#endif
+
+// Back mapped task stacks with transparent huge pages (Linux only.)  Stacks
+// are rounded up to POSIX_HUGEPAGE_SIZE.
+#ifndef OSAL_POSIX_HUGEPAGE_STACKS
+#define OSAL_POSIX_HUGEPAGE_STACKS 0
+#endif
+#if (OSAL_POSIX_HUGEPAGE_STACKS > 0) && !defined(MADV_HUGEPAGE)
+#undef OSAL_POSIX_HUGEPAGE_STACKS
+#define OSAL_POSIX_HUGEPAGE_STACKS 0
+#endif
+#define POSIX_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
 // Prio map
 static const int osalPrioMap[] = {
     0,
@@ -569,10 +1554,9 @@ private:
       return nullptr;
     };
 
-    pthread_t me = pthread_self();
-
 #ifdef PRIO_IN_THREAD
     {
+      pthread_t me = pthread_self();
       int policy;
       struct sched_param param;
 
@@ -583,14 +1567,7 @@ private:
     }
 #endif
 
-    {
-      OSALEnterTaskCritical();
-      auto &idmap = OSAL::inst().osal_IdMap;
-      const OSAL::IdMapT::iterator f = idmap.find(me);
-      LOG_ASSERT(f == idmap.end());
-      idmap[me] = pTask->mTaskId;
-      OSALExitTaskCritical();
-    }
+    OSALGetThreadCtx()->taskId = pTask->mTaskId;
 
     pTask->mFnPtr(pTask->mParamPtr);
     return NULL;
@@ -603,7 +1580,83 @@ private:
   pthread_attr_t mAttr;
   int mPriority;
   uint32_t mTaskId;
-  
+  void *mpStack;     // Stack for pthread_attr_setstack(), or NULL
+  size_t mStackSz;   // Stack size, or 0 for the pthread default
+  void *mpMapped;    // Mapping holding mpStack, if we mapped it
+  size_t mMappedSz;
+
+  static size_t roundUp(const size_t sz, const size_t align) {
+    return (sz + align - 1) & ~(align - 1);
+  }
+
+#if (OSAL_POSIX_PREFAULT_STACKS > 0) || (OSAL_POSIX_HUGEPAGE_STACKS > 0)
+  // Map a stack of mStackSz bytes with a guard page below it.
+  bool mapStack(const size_t page) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_STACK
+    flags |= MAP_STACK;
+#endif
+#if (OSAL_POSIX_HUGEPAGE_STACKS > 0)
+    // Huge pages need an aligned range; over-map and align inside it.
+    mStackSz = roundUp(mStackSz, POSIX_HUGEPAGE_SIZE);
+    const size_t align = POSIX_HUGEPAGE_SIZE;
+#else
+    const size_t align = page;
+#if defined(MAP_POPULATE)
+    flags |= MAP_POPULATE;
+#endif
+#endif
+    const size_t mapSz = mStackSz + page + ((align > page) ? align : 0);
+    void *const pMap = mmap(NULL, mapSz, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (MAP_FAILED == pMap) {
+      LOG_TRACE(("Got %d when mapping a %d byte stack.\r\n", errno, (int)mapSz));
+      return false;
+    }
+    uint8_t *const pStack = (uint8_t *)roundUp((uintptr_t)pMap + page, align);
+    LOG_ASSERT_WARN_FN(EOK == mprotect(pStack - page, page, PROT_NONE));
+#if (OSAL_POSIX_HUGEPAGE_STACKS > 0)
+    LOG_ASSERT_WARN_FN(EOK == madvise(pStack, mStackSz, MADV_HUGEPAGE));
+#endif
+#if (OSAL_POSIX_PREFAULT_STACKS > 0) && ((OSAL_POSIX_HUGEPAGE_STACKS > 0) || !defined(MAP_POPULATE))
+    // Touch after madvise() so that the faults allocate huge pages.
+    for (size_t i = 0; i < mStackSz; i += page) {
+      pStack[ i ] = 0;
+    }
+#endif
+    mpMapped  = pMap;
+    mMappedSz = mapSz;
+    mpStack   = pStack;
+    return true;
+  }
+#endif
+
+  // Choose the task's stack.  Sets mStackSz and, if the stack is supplied
+  // rather than allocated by pthreads, mpStack.
+  void initStack(const OSALTaskStructT *const pTaskStruct) {
+    if ((0 == OSAL_POSIX_MIN_STACK_SIZE) || (0 == pTaskStruct->stackSize)) {
+      return;
+    }
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t minSz = MAX((size_t)OSAL_POSIX_MIN_STACK_SIZE, (size_t)PTHREAD_STACK_MIN);
+    mStackSz = roundUp(MAX((size_t)pTaskStruct->stackSize, minSz), page);
+#if (OSAL_POSIX_USE_TASK_STACK > 0)
+    const uintptr_t stackAddr = (uintptr_t)pTaskStruct->pStack;
+    if ((0 != stackAddr) && (pTaskStruct->stackSize >= minSz)) {
+      // Trim to 16 byte alignment at both ends.
+      const uintptr_t lo = roundUp(stackAddr, 16);
+      const uintptr_t hi = (stackAddr + pTaskStruct->stackSize) & ~(uintptr_t)15;
+      if ((hi - lo) >= minSz) {
+        mpStack  = (void *)lo;
+        mStackSz = hi - lo;
+        return;
+      }
+    }
+#endif
+#if (OSAL_POSIX_PREFAULT_STACKS > 0) || (OSAL_POSIX_HUGEPAGE_STACKS > 0)
+    (void)mapStack(page);
+#endif
+  }
+
 public:
   OSALTaskFuncPtrT mFnPtr;
   void *mParamPtr;
@@ -630,6 +1683,12 @@ public:
       }
     }
 #endif
+
+    if (mpStack) {
+      LOG_ASSERT_WARN_FN(EOK == pthread_attr_setstack(&mAttr, mpStack, mStackSz));
+    } else if (mStackSz > 0) {
+      LOG_ASSERT_WARN_FN(EOK == pthread_attr_setstacksize(&mAttr, mStackSz));
+    }
   }
 
   // //////////////////////
@@ -641,21 +1700,25 @@ public:
     , mAttr()
     , mPriority(0)
     , mTaskId(pTaskStruct->taskId)
+    , mpStack(nullptr)
+    , mStackSz(0)
+    , mpMapped(nullptr)
+    , mMappedSz(0)
     , mFnPtr(pFn)
     , mParamPtr(pParam)
   {
 
     mPriority = osalPrioMap[prio];
 
-    initAttr(mSafeMode);
-
 #ifdef __QNX__
-    LOG_ASSERT_FN(EOK ==
-                  pthread_attr_setstackaddr(&mAttr, pTaskStruct->pStack));
-    LOG_ASSERT_FN(EOK ==
-                  pthread_attr_setstacksize(&mAttr, pTaskStruct->stackSize));
+    mpStack  = pTaskStruct->pStack;
+    mStackSz = pTaskStruct->stackSize;
+#else
+    initStack(pTaskStruct);
 #endif // #ifdef __QNX__
 
+    initAttr(mSafeMode);
+
     const int threadStatus =
         pthread_create(&mhThread, &mAttr, &osalTaskFxn, (void *)this);
     if (EOK != threadStatus) {
@@ -684,6 +1747,9 @@ public:
     LOG_ASSERT_WARN_FN(EOK == pthread_cancel(mhThread));
 #endif
     LOG_ASSERT_FN(EOK == pthread_attr_destroy(&mAttr));
+    if (mpMapped) {
+      LOG_ASSERT_WARN_FN(EOK == munmap(mpMapped, mMappedSz));
+    }
   }
 };
 
@@ -723,17 +1789,7 @@ bool OSALTaskDelete(OSALTaskPtrT *const ppTaskPtr) {
 // Description - see the header file.
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 uint32_t OSALGetCurrentTaskID(void) {
-  uint32_t rval = 0;
-  if (0x99999999 == mInitializedTag) {
-    pthread_t pt = pthread_self();
-    auto &idmap = OSAL::inst().osal_IdMap;
-    const OSAL::IdMapT::iterator f = idmap.find(pt);
-    if (f != idmap.end()) {
-      rval = f->second;
-    }
-  }
-  return rval;
-
+  return posix_ThreadCtx.taskId;
 }
 
 } // Extern "C"
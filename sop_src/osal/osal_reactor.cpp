@@ -0,0 +1,287 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        osal_reactor.cpp
+ * @brief       Runs task scheduler callbacks when file descriptors are ready.
+ */
+
+#include "osal/osal_reactor.h"
+#include "osal/osal_atomic.h"
+#include "osal/singleton_defs.hpp"
+#include "utils/platform_log.h"
+
+LOG_MODNAME("osal_reactor.cpp")
+
+#if defined(__linux__) && !defined(OSAL_SINGLE_TASK)
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Descriptors handled per epoll_wait().
+#define OSAL_REACTOR_BATCH 32
+
+#define OSAL_REACTOR_TASK_ID 0x07a60000
+
+OSAL_INSTANTIATE_STACK(reactor_Stack, 16384, OSAL_REACTOR_TASK_ID);
+
+class OSALReactor {
+public:
+  SINGLETON_DECLARATIONS(OSALReactor);
+
+  bool Add(OSALReactorSrcT* const pSrc, const uint32_t interest);
+  bool Remove(OSALReactorSrcT* const pSrc);
+  static void Stop();
+
+private:
+  OSALReactor();
+  ~OSALReactor();
+
+  static void ReactorTask(void* const pParam);
+  static void SrcCb(void* pCallbackData, uint32_t ts);
+  void Run();
+  void Wake();
+  void Dispatch(OSALReactorSrcT* const pSrc, const uint32_t epEvents);
+
+private:
+  int mEpollFd;
+  // Wakes the reactor task from another thread.
+  int mWakeFd;
+  // Set by Remove(); the reactor task clears it and signals mpPassedSem once
+  // it has finished with the descriptors from its last epoll_wait().
+  volatile uint32_t mPassReq;
+  OSALSemaphorePtrT mpPassedSem;
+  // One Remove() at a time, so each request gets its own signal.
+  OSALMutexPtrT mpRemoveLock;
+  volatile uint32_t mStop;
+  OSALTaskPtrT mpTask;
+};
+
+SINGLETON_INSTANTIATIONS(OSALReactor);
+
+// ////////////////////////////////////////////////////////////////////////////
+OSALReactor::OSALReactor()
+  : mEpollFd(epoll_create1(EPOLL_CLOEXEC))
+  , mWakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  , mPassReq(0)
+  , mpPassedSem(OSALSemaphoreCreate(0, 1))
+  , mpRemoveLock(OSALCreateMutex())
+  , mStop(0)
+  , mpTask(nullptr) {
+  LOG_ASSERT((mEpollFd >= 0) && (mWakeFd >= 0));
+  LOG_ASSERT((mpPassedSem) && (mpRemoveLock));
+  struct epoll_event ev;
+  ev.events   = EPOLLIN | EPOLLET;
+  ev.data.ptr = nullptr;
+  LOG_ASSERT_FN(0 == epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &ev));
+  mpTask = OSALTaskCreate(ReactorTask, this, OSAL_PRIO_HIGH, &reactor_Stack);
+  LOG_ASSERT(mpTask);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Stops and joins the reactor task, then closes its descriptors.
+OSALReactor::~OSALReactor() {
+  LOG_ASSERT(OSAL_REACTOR_TASK_ID != OSALGetCurrentTaskID());
+  OSALAtomicStoreU32(&mStop, 1, OSAL_MO_RELEASE);
+  Wake();
+  (void)OSALTaskDelete(&mpTask);
+  (void)close(mWakeFd);
+  (void)close(mEpollFd);
+  OSALDeleteMutex(&mpRemoveLock);
+  (void)OSALSemaphoreDelete(&mpPassedSem);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALReactor::Stop() {
+  OSALEnterTaskCritical();
+  OSALReactor* const pInst = mInst;
+  mInst = nullptr;
+  OSALExitTaskCritical();
+  if (pInst) {
+    pInst->~OSALReactor();
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALReactor::Wake() {
+  const uint64_t one = 1;
+  (void)write(mWakeFd, &one, sizeof(one));
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALReactor::ReactorTask(void* const pParam) {
+  OSALGetThreadCtx()->pName = "OSALReactor";
+  ((OSALReactor*)pParam)->Run();
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALReactor::Run() {
+  struct epoll_event events[ OSAL_REACTOR_BATCH ];
+  while (0 == OSALAtomicLoadU32(&mStop, OSAL_MO_ACQUIRE)) {
+    // Done with the last batch, so let a waiting Remove() return.
+    if (OSALAtomicExchangeU32(&mPassReq, 0, OSAL_MO_ACQ_REL)) {
+      (void)OSALSemaphoreSignal(mpPassedSem, 1);
+    }
+    const int n = epoll_wait(mEpollFd, events, OSAL_REACTOR_BATCH, -1);
+    if (n < 0) {
+      LOG_ASSERT(EINTR == errno);
+      continue;
+    }
+    for (int i = 0; i < n; i++) {
+      OSALReactorSrcT* const pSrc = (OSALReactorSrcT*)events[ i ].data.ptr;
+      if (nullptr == pSrc) {
+        uint64_t cnt;
+        (void)read(mWakeFd, &cnt, sizeof(cnt));
+      } else {
+        Dispatch(pSrc, events[ i ].events);
+      }
+    }
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Record the readiness and, unless the callback is already waiting to run,
+// schedule it.  The scheduler coalesces bursts of edges into one call.
+void OSALReactor::Dispatch(OSALReactorSrcT* const pSrc, const uint32_t epEvents) {
+  uint32_t ready = 0;
+  if (epEvents & (EPOLLIN | EPOLLRDHUP)) {
+    ready |= OSAL_REACTOR_READ;
+  }
+  if (epEvents & EPOLLOUT) {
+    ready |= OSAL_REACTOR_WRITE;
+  }
+  if (epEvents & (EPOLLERR | EPOLLHUP)) {
+    ready |= OSAL_REACTOR_ERROR;
+  }
+  (void)OSALAtomicFetchOrU32(&pSrc->ready, ready, OSAL_MO_RELEASE);
+  if (OSALTestAndSet(&pSrc->queued)) {
+    TaskSchedAddTimerFn(pSrc->prio, &pSrc->sched, 0, 0);
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALReactor::SrcCb(void* pCallbackData, uint32_t ts) {
+  (void)ts;
+  OSALReactorSrcT* const pSrc = (OSALReactorSrcT*)pCallbackData;
+  // Clear first, so that an edge arriving during the callback reschedules it.
+  OSALClearFlag((bool*)&pSrc->queued);
+  const uint32_t ready = OSALAtomicExchangeU32(&pSrc->ready, 0, OSAL_MO_ACQUIRE);
+  OSALReactorFnT const pFn = pSrc->pFn;
+  if ((ready) && (pFn)) {
+    pFn(pSrc->pUserData, pSrc->fd, ready);
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALReactor::Add(OSALReactorSrcT* const pSrc, const uint32_t interest) {
+  TaskSchedInitSched(&pSrc->sched, SrcCb, pSrc);
+  struct epoll_event ev;
+  ev.events = EPOLLET;
+  if (interest & OSAL_REACTOR_READ) {
+    ev.events |= EPOLLIN | EPOLLRDHUP;
+  }
+  if (interest & OSAL_REACTOR_WRITE) {
+    ev.events |= EPOLLOUT;
+  }
+  ev.data.ptr = pSrc;
+  const bool rval = (0 == epoll_ctl(mEpollFd, EPOLL_CTL_ADD, pSrc->fd, &ev));
+  if (!rval) {
+    LOG_TRACE(("Got %d when adding fd %d to the reactor.\r\n", errno, pSrc->fd));
+  }
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALReactor::Remove(OSALReactorSrcT* const pSrc) {
+  // The reactor task would wait for itself.
+  LOG_ASSERT(OSAL_REACTOR_TASK_ID != OSALGetCurrentTaskID());
+  const bool rval = (0 == epoll_ctl(mEpollFd, EPOLL_CTL_DEL, pSrc->fd, nullptr));
+
+  // The reactor task may still hold pSrc from an earlier epoll_wait().  Once
+  // it is back at the top of its loop it has finished with it.
+  (void)OSALLockMutex(mpRemoveLock, OSAL_WAIT_INFINITE);
+  OSALAtomicStoreU32(&mPassReq, 1, OSAL_MO_RELEASE);
+  Wake();
+  (void)OSALSemaphoreWait(mpPassedSem, OSAL_WAIT_INFINITE);
+  (void)OSALUnlockMutex(mpRemoveLock);
+
+  pSrc->pFn = nullptr;
+  (void)TaskSchedCancel(&pSrc->sched);
+  OSALClearFlag((bool*)&pSrc->queued);
+  OSALAtomicStoreU32(&pSrc->ready, 0, OSAL_MO_RELAXED);
+  return rval;
+}
+
+extern "C" {
+
+// ////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALReactorAdd(
+  OSALReactorSrcT* const pSrc,
+  const int fd,
+  const uint32_t interest,
+  const TaskSchedPriority prio,
+  OSALReactorFnT pFn,
+  void* const pUserData) {
+  LOG_ASSERT(pSrc && pFn && (fd >= 0));
+  pSrc->fd        = fd;
+  pSrc->prio      = prio;
+  pSrc->pFn       = pFn;
+  pSrc->pUserData = pUserData;
+  pSrc->ready     = 0;
+  pSrc->queued    = false;
+  return OSALReactor::inst().Add(pSrc, interest);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALReactorRemove(OSALReactorSrcT* const pSrc) {
+  LOG_ASSERT(pSrc);
+  return OSALReactor::inst().Remove(pSrc);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////
+void OSALReactorStop(void) {
+  OSALReactor::Stop();
+}
+
+} // extern "C"
+
+#else // #if defined(__linux__) && !defined(OSAL_SINGLE_TASK)
+
+extern "C" {
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALReactorAdd(
+  OSALReactorSrcT* const pSrc,
+  const int fd,
+  const uint32_t interest,
+  const TaskSchedPriority prio,
+  OSALReactorFnT pFn,
+  void* const pUserData) {
+  (void)pSrc;
+  (void)fd;
+  (void)interest;
+  (void)prio;
+  (void)pFn;
+  (void)pUserData;
+  return false;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALReactorRemove(OSALReactorSrcT* const pSrc) {
+  (void)pSrc;
+  return false;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALReactorStop(void) {
+}
+
+} // extern "C"
+
+#endif // #if defined(__linux__) && !defined(OSAL_SINGLE_TASK)
@@ -0,0 +1,78 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        osal_reactor.h
+ * @brief       Runs task scheduler callbacks when file descriptors are ready.
+ *
+ * One reactor task waits on all registered descriptors (epoll, edge
+ * triggered) and hands readiness to the task scheduler, so the callbacks
+ * run as normal schedulables in the priority each source chose.  Because
+ * descriptors are edge triggered, a callback must read or write until the
+ * call would block (EAGAIN), otherwise it will not be called again.
+ *
+ * Linux only; elsewhere OSALReactorAdd() returns false.
+ */
+
+#ifndef OSAL_REACTOR_H__
+#define OSAL_REACTOR_H__
+
+#include "osal/osal.h"
+#include "task_sched/task_sched.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Readiness bits, for the interest mask and the callback.
+#define OSAL_REACTOR_READ 0x1u  ///< Readable, or the peer closed
+#define OSAL_REACTOR_WRITE 0x2u ///< Writable
+#define OSAL_REACTOR_ERROR 0x4u ///< Error or hang up; always reported
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ////////////////////////////////////////////////////////////////////////////
+// Called from the source's priority with the readiness seen since the last
+// call (OSAL_REACTOR_* bits.)
+typedef void (*OSALReactorFnT)(void* const pUserData, const int fd, const uint32_t events);
+
+// ////////////////////////////////////////////////////////////////////////////
+// A registered descriptor.  Owned by the caller; must stay valid until
+// OSALReactorRemove() returns.  The fields are private.
+typedef struct OSALReactorSrcTag {
+  TaskSchedulable sched;   ///< Runs the callback in prio
+  int fd;
+  TaskSchedPriority prio;
+  OSALReactorFnT pFn;
+  void* pUserData;
+  volatile uint32_t ready; ///< Readiness since the callback last ran
+  volatile bool queued;    ///< sched is on the scheduler's list
+} OSALReactorSrcT;
+
+// ////////////////////////////////////////////////////////////////////////////
+// Registers fd (ideally non-blocking) for the OSAL_REACTOR_* bits in
+// interest.  pFn runs in prio when fd becomes ready.
+bool OSALReactorAdd(
+  OSALReactorSrcT* const pSrc,
+  const int fd,
+  const uint32_t interest,
+  const TaskSchedPriority prio,
+  OSALReactorFnT pFn,
+  void* const pUserData);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Unregisters a source.  Call from the source's priority: on return the
+// callback is neither running nor scheduled, and will not run again.  Waits
+// for the reactor task to finish with the source, so never call it from
+// the reactor task.
+bool OSALReactorRemove(OSALReactorSrcT* const pSrc);
+
+// ////////////////////////////////////////////////////////////////////////////
+// Stops the reactor task and closes its epoll and wake descriptors.  Remove
+// every source first.  The next OSALReactorAdd() starts a new reactor.
+void OSALReactorStop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OSAL_REACTOR_H__
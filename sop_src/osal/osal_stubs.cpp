@@ -32,6 +32,18 @@ void OSALEnterCritical(void){
 void OSALExitCritical(void){
 }
 
+// ////////////////////////////////////////////////////////////////////////////
+// Critical section that may be taken from a task or an interrupt.
+uint32_t OSALEnterCriticalFromIsr(void){
+  return 0;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Leave the critical section taken by OSALEnterCriticalFromIsr().
+void OSALExitCriticalFromIsr(const uint32_t state){
+  (void)state;
+}
+
 // ////////////////////////////////////////////////////////////////////////////
 // Enter critical section (disable task scheduler)
 void OSALEnterTaskCritical(void) {  }
@@ -115,6 +127,103 @@ bool OSALSemaphoreWait(OSALSemaphorePtrT const pPortSem,
   return true;
 }
 
+// ////////////////////////////////////////////////////////////////////////////
+// Create a reader/writer lock.
+OSALRwLockPtrT OSALRwLockCreate(void){
+  return (void *)&dummyUInt;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Delete a reader/writer lock.
+void OSALRwLockDelete(OSALRwLockPtrT *const ppRwLock){
+  if (ppRwLock){
+    *ppRwLock = (void *)NULL;
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Lock for reading.
+bool OSALRwLockReadLock(OSALRwLockPtrT const pRwLock, const uint32_t timeoutMs){
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Unlock after reading.
+bool OSALRwLockReadUnlock(OSALRwLockPtrT const pRwLock){
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Lock for writing.
+bool OSALRwLockWriteLock(OSALRwLockPtrT const pRwLock, const uint32_t timeoutMs){
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Unlock after writing.
+bool OSALRwLockWriteUnlock(OSALRwLockPtrT const pRwLock){
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Create an event group.  Single task, so it is only the bits.
+OSALEventGroupPtrT OSALEventGroupCreate(void){
+  uint32_t *const pBits = (uint32_t *)OSALMALLOC(sizeof(uint32_t));
+  if (pBits){
+    *pBits = 0;
+  }
+  return (OSALEventGroupPtrT)pBits;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Delete an event group.
+void OSALEventGroupDelete(OSALEventGroupPtrT *const ppGroup){
+  if (ppGroup && *ppGroup){
+    OSALFREE(*ppGroup);
+    *ppGroup = (void *)NULL;
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Set event bits.
+uint32_t OSALEventGroupSet(OSALEventGroupPtrT const pGroup, const uint32_t bits){
+  uint32_t *const pBits = (uint32_t *)pGroup;
+  *pBits |= bits;
+  return *pBits;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Clear event bits.
+uint32_t OSALEventGroupClear(OSALEventGroupPtrT const pGroup, const uint32_t bits){
+  uint32_t *const pBits = (uint32_t *)pGroup;
+  const uint32_t rval = *pBits;
+  *pBits &= ~bits;
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Get event bits.
+uint32_t OSALEventGroupGet(OSALEventGroupPtrT const pGroup){
+  return *(uint32_t *)pGroup;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Wait for event bits.  Nothing else can run to set them, so never blocks.
+uint32_t OSALEventGroupWait(OSALEventGroupPtrT const pGroup,
+                            const uint32_t bitsToWaitFor,
+                            const bool waitForAll,
+                            const bool clearOnExit,
+                            const uint32_t timeoutMs){
+  uint32_t *const pBits = (uint32_t *)pGroup;
+  const uint32_t rval = *pBits;
+  const bool ok = (waitForAll) ? ((rval & bitsToWaitFor) == bitsToWaitFor)
+                               : (0 != (rval & bitsToWaitFor));
+  if (ok && clearOnExit){
+    *pBits &= ~bitsToWaitFor;
+  }
+  return rval;
+}
+
 OSALTaskPtrT OSALTaskCreate(OSALTaskFuncPtrT pTaskFunc, void *const pParam,
                             const OSALPrioT prio,
                             const OSALTaskStructT *const pPlatform){
@@ -124,5 +233,12 @@ OSALTaskPtrT OSALTaskCreate(OSALTaskFuncPtrT pTaskFunc, void *const pParam,
 bool OSALTaskDelete(OSALTaskPtrT *const ppTaskPtr){
   return false;
 }
+
+// ////////////////////////////////////////////////////////////////////////////
+// Only one thread, so only one context block.
+OSALThreadCtxT* OSALGetThreadCtx(void){
+  static OSALThreadCtxT ctx = { 0, NULL, OSAL_LANE_NONE, NULL, NULL };
+  return &ctx;
+}
 }
 #endif
@@ -0,0 +1,296 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        osal_thread_pool.cpp
+ * @brief       Fixed pool of OSAL tasks running submitted jobs.
+ *
+ * Built on the OSAL primitives, so it runs on every multitasking port.
+ * Jobs go through a bounded lock-free MPMC ring (D. Vyukov's sequence
+ * numbered slots), so submitting never takes a lock.  Single task builds
+ * run each job inline.
+ */
+
+#include "osal/osal.h"
+#include "osal/osal_atomic.h"
+#include "utils/helper_macros.h"
+#include "utils/platform_log.h"
+
+#include <string.h>
+
+LOG_MODNAME("osal_thread_pool.cpp")
+
+#if !defined(OSAL_SINGLE_TASK)
+
+// Set in pIdle whenever the last pending job finishes.
+#define OSAL_THREADPOOL_IDLE 0x1u
+
+// Keeps the producer and consumer indices on separate cache lines.
+#define OSAL_THREADPOOL_PAD 64
+
+typedef struct osal_PoolJobTag {
+  volatile uint32_t seq; ///< Ring position this slot is ready for
+  OSALTaskFuncPtrT pFn;
+  void* pArg;
+} osal_PoolJobT;
+
+typedef struct osal_ThreadPoolTag {
+  osal_PoolJobT* pJobs;
+  uint32_t mask;
+  uint8_t pad0[ OSAL_THREADPOOL_PAD ];
+  volatile uint32_t enqPos;
+  uint8_t pad1[ OSAL_THREADPOOL_PAD ];
+  volatile uint32_t deqPos;
+  uint8_t pad2[ OSAL_THREADPOOL_PAD ];
+  volatile uint32_t pending;  ///< Jobs submitted and not yet finished
+  volatile uint32_t running;  ///< Worker tasks that have not exited
+  volatile uint32_t shutdown;
+  OSALSemaphorePtrT pJobsSem; ///< Signalled once per submitted job
+  OSALEventGroupPtrT pIdle;
+  uint32_t numThreads;
+  OSALTaskPtrT* pTasks;
+  char** ppStacks;
+} osal_ThreadPoolT;
+
+// ////////////////////////////////////////////////////////////////////////////
+static bool osal_PoolPush(osal_ThreadPoolT* const pPool, OSALTaskFuncPtrT pFn, void* const pArg) {
+  osal_PoolJobT* pJob;
+  uint32_t pos = OSALAtomicLoadU32(&pPool->enqPos, OSAL_MO_RELAXED);
+  for (;;) {
+    pJob               = &pPool->pJobs[ pos & pPool->mask ];
+    const int32_t diff = (int32_t)(OSALAtomicLoadU32(&pJob->seq, OSAL_MO_ACQUIRE) - pos);
+    if (0 == diff) {
+      if (OSALAtomicCasU32(&pPool->enqPos, &pos, pos + 1, OSAL_MO_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; // Full
+    } else {
+      pos = OSALAtomicLoadU32(&pPool->enqPos, OSAL_MO_RELAXED);
+    }
+  }
+  pJob->pFn  = pFn;
+  pJob->pArg = pArg;
+  OSALAtomicStoreU32(&pJob->seq, pos + 1, OSAL_MO_RELEASE);
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static bool osal_PoolPop(osal_ThreadPoolT* const pPool, OSALTaskFuncPtrT& pFn, void*& pArg) {
+  osal_PoolJobT* pJob;
+  uint32_t pos = OSALAtomicLoadU32(&pPool->deqPos, OSAL_MO_RELAXED);
+  for (;;) {
+    pJob               = &pPool->pJobs[ pos & pPool->mask ];
+    const int32_t diff = (int32_t)(OSALAtomicLoadU32(&pJob->seq, OSAL_MO_ACQUIRE) - (pos + 1));
+    if (0 == diff) {
+      if (OSALAtomicCasU32(&pPool->deqPos, &pos, pos + 1, OSAL_MO_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; // Empty, or the next job is not published yet
+    } else {
+      pos = OSALAtomicLoadU32(&pPool->deqPos, OSAL_MO_RELAXED);
+    }
+  }
+  pFn  = pJob->pFn;
+  pArg = pJob->pArg;
+  OSALAtomicStoreU32(&pJob->seq, pos + pPool->mask + 1, OSAL_MO_RELEASE);
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+static void osal_PoolWorker(void* const pParam) {
+  osal_ThreadPoolT* const pPool = (osal_ThreadPoolT*)pParam;
+  OSALGetThreadCtx()->pName     = "OSALThreadPool";
+  bool exit                     = false;
+  while (!exit) {
+    (void)OSALSemaphoreWait(pPool->pJobsSem, OSAL_WAIT_INFINITE);
+    // A wakeup can find its job not yet published behind an earlier
+    // submitter, so always run everything that is there.
+    OSALTaskFuncPtrT pFn;
+    void* pArg;
+    while (osal_PoolPop(pPool, pFn, pArg)) {
+      pFn(pArg);
+      if (1 == OSALAtomicFetchAddU32(&pPool->pending, (uint32_t)-1, OSAL_MO_ACQ_REL)) {
+        (void)OSALEventGroupSet(pPool->pIdle, OSAL_THREADPOOL_IDLE);
+      }
+    }
+    exit = (0 != OSALAtomicLoadU32(&pPool->shutdown, OSAL_MO_ACQUIRE));
+  }
+  (void)OSALAtomicFetchAddU32(&pPool->running, (uint32_t)-1, OSAL_MO_RELEASE);
+}
+
+extern "C" {
+
+// ////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////
+OSALThreadPoolPtrT OSALThreadPoolCreate(
+  const uint32_t numThreads,
+  const uint32_t queueDepth,
+  const OSALPrioT prio,
+  const uint32_t stackSize) {
+  LOG_ASSERT((numThreads > 0) && (queueDepth > 0));
+  osal_ThreadPoolT* const pPool = (osal_ThreadPoolT*)OSALMALLOC(sizeof(osal_ThreadPoolT));
+  LOG_ASSERT(pPool);
+  memset(pPool, 0, sizeof(*pPool));
+
+  uint32_t cap = 2;
+  while (cap < queueDepth) {
+    cap <<= 1;
+  }
+  pPool->mask  = cap - 1;
+  pPool->pJobs = (osal_PoolJobT*)OSALMALLOC(cap * sizeof(osal_PoolJobT));
+  LOG_ASSERT(pPool->pJobs);
+  for (uint32_t i = 0; i < cap; i++) {
+    pPool->pJobs[ i ].seq = i;
+  }
+
+  pPool->pJobsSem   = OSALSemaphoreCreate(0, OSAL_COUNT_INFINITE);
+  pPool->pIdle      = OSALEventGroupCreate();
+  (void)OSALEventGroupSet(pPool->pIdle, OSAL_THREADPOOL_IDLE);
+  pPool->numThreads = numThreads;
+  pPool->running    = numThreads;
+  pPool->pTasks     = (OSALTaskPtrT*)OSALMALLOC(numThreads * sizeof(OSALTaskPtrT));
+  pPool->ppStacks   = (char**)OSALMALLOC(numThreads * sizeof(char*));
+  LOG_ASSERT(pPool->pTasks && pPool->ppStacks);
+
+  for (uint32_t i = 0; i < numThreads; i++) {
+#if defined(__linux__) || defined(__APPLE__)
+    // pthreads allocates the stack.
+    pPool->ppStacks[ i ] = nullptr;
+#else
+    pPool->ppStacks[ i ] = (char*)OSALMALLOC(stackSize);
+    LOG_ASSERT(pPool->ppStacks[ i ]);
+#endif
+    const OSALTaskStructT taskStruct = { pPool->ppStacks[ i ], stackSize, 0 };
+    pPool->pTasks[ i ] = OSALTaskCreate(osal_PoolWorker, pPool, prio, &taskStruct);
+    LOG_ASSERT(pPool->pTasks[ i ]);
+  }
+  return (OSALThreadPoolPtrT)pPool;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALThreadPoolSubmit(OSALThreadPoolPtrT const pThreadPool, OSALTaskFuncPtrT pFn, void* const pArg) {
+  osal_ThreadPoolT* const pPool = (osal_ThreadPoolT*)pThreadPool;
+  LOG_ASSERT(pPool && pFn);
+  if (0 != OSALAtomicLoadU32(&pPool->shutdown, OSAL_MO_RELAXED)) {
+    return false;
+  }
+  (void)OSALAtomicFetchAddU32(&pPool->pending, 1, OSAL_MO_ACQ_REL);
+  const bool rval = osal_PoolPush(pPool, pFn, pArg);
+  if (rval) {
+    (void)OSALSemaphoreSignal(pPool->pJobsSem, 1);
+  } else if (1 == OSALAtomicFetchAddU32(&pPool->pending, (uint32_t)-1, OSAL_MO_ACQ_REL)) {
+    (void)OSALEventGroupSet(pPool->pIdle, OSAL_THREADPOOL_IDLE);
+  }
+  return rval;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALThreadPoolDrain(OSALThreadPoolPtrT const pThreadPool, const uint32_t timeoutMs) {
+  osal_ThreadPoolT* const pPool = (osal_ThreadPoolT*)pThreadPool;
+  LOG_ASSERT(pPool);
+  const uint32_t startTime = OSALGetMS();
+  while (0 != OSALAtomicLoadU32(&pPool->pending, OSAL_MO_ACQUIRE)) {
+    uint32_t remaining = timeoutMs;
+    if (OSAL_WAIT_INFINITE != timeoutMs) {
+      const uint32_t elapsed = OSALGetMS() - startTime;
+      if (elapsed >= timeoutMs) {
+        return false;
+      }
+      remaining = timeoutMs - elapsed;
+    }
+    const uint32_t bits =
+      OSALEventGroupWait(pPool->pIdle, OSAL_THREADPOOL_IDLE, false, false, remaining);
+    if (0 == (bits & OSAL_THREADPOOL_IDLE)) {
+      return false;
+    }
+    // The idle bit can be stale if more work came in after it was set.
+    if (0 != OSALAtomicLoadU32(&pPool->pending, OSAL_MO_ACQUIRE)) {
+      (void)OSALEventGroupClear(pPool->pIdle, OSAL_THREADPOOL_IDLE);
+    }
+  }
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////
+void OSALThreadPoolDelete(OSALThreadPoolPtrT* const ppThreadPool) {
+  LOG_ASSERT(ppThreadPool);
+  osal_ThreadPoolT* const pPool = (osal_ThreadPoolT*)*ppThreadPool;
+  if (nullptr == pPool) {
+    return;
+  }
+  (void)OSALThreadPoolDrain(pPool, OSAL_WAIT_INFINITE);
+  OSALAtomicStoreU32(&pPool->shutdown, 1, OSAL_MO_RELEASE);
+  (void)OSALSemaphoreSignal(pPool->pJobsSem, pPool->numThreads);
+  // Let the workers return before their tasks are deleted.
+  while (0 != OSALAtomicLoadU32(&pPool->running, OSAL_MO_ACQUIRE)) {
+    OSALSleep(1);
+  }
+  for (uint32_t i = 0; i < pPool->numThreads; i++) {
+    (void)OSALTaskDelete(&pPool->pTasks[ i ]);
+    if (pPool->ppStacks[ i ]) {
+      OSALFREE(pPool->ppStacks[ i ]);
+    }
+  }
+  OSALFREE(pPool->ppStacks);
+  OSALFREE(pPool->pTasks);
+  OSALEventGroupDelete(&pPool->pIdle);
+  (void)OSALSemaphoreDelete(&pPool->pJobsSem);
+  OSALFREE(pPool->pJobs);
+  OSALFREE(pPool);
+  *ppThreadPool = nullptr;
+}
+
+} // extern "C"
+
+#else // #if !defined(OSAL_SINGLE_TASK)
+
+// With a single task there is nothing to hand jobs to, so they run inline.
+
+extern "C" {
+
+// ////////////////////////////////////////////////////////////////////////////
+OSALThreadPoolPtrT OSALThreadPoolCreate(
+  const uint32_t numThreads,
+  const uint32_t queueDepth,
+  const OSALPrioT prio,
+  const uint32_t stackSize) {
+  (void)numThreads;
+  (void)queueDepth;
+  (void)prio;
+  (void)stackSize;
+  return (OSALThreadPoolPtrT)OSALMALLOC(sizeof(uint32_t));
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALThreadPoolSubmit(OSALThreadPoolPtrT const pThreadPool, OSALTaskFuncPtrT pFn, void* const pArg) {
+  LOG_ASSERT(pThreadPool && pFn);
+  pFn(pArg);
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+bool OSALThreadPoolDrain(OSALThreadPoolPtrT const pThreadPool, const uint32_t timeoutMs) {
+  (void)pThreadPool;
+  (void)timeoutMs;
+  return true;
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+void OSALThreadPoolDelete(OSALThreadPoolPtrT* const ppThreadPool) {
+  LOG_ASSERT(ppThreadPool);
+  if (*ppThreadPool) {
+    OSALFREE(*ppThreadPool);
+    *ppThreadPool = nullptr;
+  }
+}
+
+} // extern "C"
+
+#endif // #if !defined(OSAL_SINGLE_TASK)
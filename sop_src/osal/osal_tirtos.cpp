@@ -95,6 +95,20 @@ void OSALExitCritical(void) {
   LOG_ASSERT(disableCnt >= 0);
 }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEnterCriticalFromIsr(void) {
+  return (uint32_t)Hwi_disable();
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALExitCriticalFromIsr(const uint32_t state) {
+  Hwi_restore((unsigned int)state);
+}
+
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 // Description - see the header file.
 // ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -372,7 +386,9 @@ class osal_Task : public msp_OsalBase{
   static void osalTaskFxn(UArg a0, UArg a1) {
     osal_Task *pTask = (osal_Task *)(void *)a0;
     pTask->check();
+    Task_setEnv(Task_self(), &pTask->mCtx);
     pTask->mFnPtr(pTask->mParamPtr);
+    Task_setEnv(Task_self(), NULL);
   }
 
 
@@ -380,6 +396,7 @@ public:
 
   OSALTaskFuncPtrT  mFnPtr;
   void             *mParamPtr;
+  OSALThreadCtxT    mCtx;
     
   // //////////////////////
   osal_Task(
@@ -387,7 +404,8 @@ public:
       void *pParam,
       const OSALTaskStructT *const pOsalTaskParams,
       const OSALPrioT prio)
-      : msp_OsalBase(), mFnPtr(pFn), mParamPtr(pParam) {
+      : msp_OsalBase(), mFnPtr(pFn), mParamPtr(pParam), mCtx() {
+    mCtx.taskId = pOsalTaskParams->taskId;
     
     Task_Params task_params;
     Task_Params_init(&task_params);
@@ -445,6 +463,22 @@ bool OSALTaskDelete(OSALTaskPtrT *const ppTaskPtr) {
   return true;
 }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.  The block lives in the task's environment
+// pointer, which the OSAL reserves for itself.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+OSALThreadCtxT *OSALGetThreadCtx(void) {
+  Task_Handle me = Task_self();
+  OSALThreadCtxT *pCtx = (OSALThreadCtxT *)Task_getEnv(me);
+  if (NULL == pCtx) {
+    // Not started by OSALTaskCreate(); lives as long as the task.
+    pCtx = new OSALThreadCtxT();
+    LOG_ASSERT(NULL != pCtx);
+    Task_setEnv(me, pCtx);
+  }
+  return pCtx;
+}
+
 #ifndef PAK_ECU_HAS_NO_SAP
 // This uses the CC2650 to generate real random numbers using the built in HW RNG.
 #include <ti/sysbios/knl/Task.h>
@@ -502,6 +536,7 @@ static int entropy_gen( void *data, unsigned char *x, size_t xlen ){
 #include "utils/helper_utils.h"
 #include "utils/helper_macros.h"
 #include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Task.h>
 #include "platform/osal.h"
 
 extern "C" {
@@ -596,6 +631,20 @@ void OSALExitCritical( void ) {
     Hwi_restore(state);
 }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEnterCriticalFromIsr( void ) {
+    return (uint32_t)Hwi_disable();
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALExitCriticalFromIsr( const uint32_t state ) {
+    Hwi_restore((unsigned int)state);
+}
+
 // ////////////////////////////////////////////////////////////////////////////
 // Enter critical section (disable task scheduler)
 void OSALEnterTaskCritical(void) { OSALEnterCritical() }
@@ -652,6 +701,22 @@ bool OSALTaskDelete(OSALTaskPtrT *const ppTaskPtr){
     return false;
 }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.  The block lives in the task's environment
+// pointer, which the OSAL reserves for itself.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+OSALThreadCtxT *OSALGetThreadCtx(void) {
+  Task_Handle me = Task_self();
+  OSALThreadCtxT *pCtx = (OSALThreadCtxT *)Task_getEnv(me);
+  if (NULL == pCtx) {
+    // Not started by OSALTaskCreate(); lives as long as the task.
+    pCtx = new OSALThreadCtxT();
+    LOG_ASSERT(NULL != pCtx);
+    Task_setEnv(me, pCtx);
+  }
+  return pCtx;
+}
+
 
 } // extern "C" {
 
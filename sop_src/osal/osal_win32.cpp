@@ -68,6 +68,9 @@ public:
 
   uint32_t GetStartMS(void) { return m_startMs; }
 
+  // Fiber local storage slot holding each thread's OSALThreadCtxT.
+  DWORD GetThreadCtxIdx(void) { return m_threadCtxIdx; }
+
   static bool mInitialized;
 private:
   CRITICAL_SECTION m_CS;
@@ -76,14 +79,23 @@ public:
 private:
   int   m_CSRecursion;
   uint32_t m_startMs;
+  DWORD m_threadCtxIdx;
+
+  // Frees the context blocks of threads that OSALTaskCreate() did not start.
+  static void WINAPI FreeThreadCtx(void *p) {
+    delete (OSALThreadCtxT *)p;
+  }
 
   OSAL() 
     :  m_CS()
     , m_CSThreadId((DWORD)-1)
     , m_startMs(0)
     , m_CSRecursion(0)
+    , m_threadCtxIdx(FLS_OUT_OF_INDEXES)
   {
     InitializeCriticalSection(&m_CS);
+    m_threadCtxIdx = FlsAlloc(FreeThreadCtx);
+    LOG_ASSERT(m_threadCtxIdx != FLS_OUT_OF_INDEXES);
     m_startMs = OSALGetMS();
     mInitialized = true;
   }
@@ -107,6 +119,22 @@ void OSALEnterCritical(void) { OSAL::inst().EnterCritical(); }
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 void OSALExitCritical(void) { OSAL::inst().ExitCritical(); }
 
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.  No interrupts here, so the global critical section.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t OSALEnterCriticalFromIsr(void) {
+  OSAL::inst().EnterCritical();
+  return 0;
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void OSALExitCriticalFromIsr(const uint32_t state) {
+  (void)state;
+  OSAL::inst().ExitCritical();
+}
+
 int osal_criticalTaskCount = 0;
 // ////////////////////////////////////////////////////////////////////////////
 // Disable critical section (disable task scheduler)
@@ -494,6 +522,7 @@ public:
   HANDLE hThread;
   DWORD dwThread;
   uint32_t taskId;
+  OSALThreadCtxT ctx;
   static IdMapT osal_IdMap;
 
   OSALTask(OSALTaskFuncPtrT pFn, void *pParam, const uint32_t taskId)
@@ -503,7 +532,9 @@ public:
     , hThread(INVALID_HANDLE_VALUE)
     , dwThread(0)
     , taskId(taskId)
+    , ctx()
   {
+    ctx.taskId = taskId;
     check();
   }
   
@@ -527,9 +558,14 @@ public:
       LOG_ASSERT(f == OSALTask::osal_IdMap.end());
       osal_IdMap[dw] = pTaskSlot->taskId;
     }
+    const DWORD ctxIdx = OSAL::inst().GetThreadCtxIdx();
+    (void)FlsSetValue(ctxIdx, &pTaskSlot->ctx);
     
     pTaskSlot->pFn(pTaskSlot->pParam);
 
+    // The context block belongs to the task slot, not to FreeThreadCtx().
+    (void)FlsSetValue(ctxIdx, NULL);
+
     return 0;
   }
 };
@@ -550,7 +586,7 @@ static const int osalPrioMap[] = {
 
 extern "C" {
 
-extern void MemPoolsInitialize();
+extern void MemPoolsInitialize(const size_t heapBytes);
 
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 // Description - see the header file.
@@ -560,7 +596,7 @@ void OSALInit(void) {
   if (!init) {
     init = true;
     // Constructor
-    MemPoolsInitialize();
+    MemPoolsInitialize(0);
     OSAL::inst();
     std::string str = "WIN32";
     //OSALRandomInit(str.c_str(), str.length());
@@ -623,6 +659,21 @@ uint32_t OSALGetCurrentTaskID(void) {
   }
   return rval;
 }
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Description - see the header file.
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+OSALThreadCtxT *OSALGetThreadCtx(void) {
+  const DWORD ctxIdx = OSAL::inst().GetThreadCtxIdx();
+  OSALThreadCtxT *pCtx = (OSALThreadCtxT *)FlsGetValue(ctxIdx);
+  if (NULL == pCtx) {
+    // Not started by OSALTaskCreate(); freed when the thread exits.
+    pCtx = new OSALThreadCtxT();
+    pCtx->taskId = OSALGetCurrentTaskID();
+    (void)FlsSetValue(ctxIdx, pCtx);
+  }
+  return pCtx;
+}
 } // extern "C"
 
 #endif
@@ -1,6 +1,8 @@
 
 #include "osal/mempools.h"
+#include "osal/mempools_allocator.hpp"
 #include "gtest/gtest.h"
+#include "utils/helper_macros.h"
 #include "utils/platform_log.h"
 
 LOG_MODNAME("test_mempools")
@@ -17,7 +19,349 @@ TEST(MemPools, TestHeap) {
 }
 
 #if !defined(__EMBEDDED_MCU_BE__)
+#include <atomic>
+#include <map>
 #include <string>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+TEST(MemPools, TestSmallBlocks) {
+  // Every size up to and past the largest small block comes back zeroed,
+  // holds its contents, and is fully returned.
+  size_t curUsed0, curBlocks0;
+  MemPoolsGetUsage(&curUsed0, &curBlocks0);
+  static uint8_t* blocks[ 1100 ];
+  for (size_t sz = 1; sz < ARRSZ(blocks); sz++) {
+    uint8_t* const p = (uint8_t*)MemPoolsMalloc(sz);
+    ASSERT_TRUE(NULL != p);
+    for (size_t i = 0; i < sz; i++) {
+      ASSERT_EQ(0, p[ i ]);
+    }
+    memset(p, (uint8_t)sz, sz);
+    blocks[ sz ] = p;
+  }
+  for (size_t sz = 1; sz < ARRSZ(blocks); sz++) {
+    for (size_t i = 0; i < sz; i++) {
+      ASSERT_EQ((uint8_t)sz, blocks[ sz ][ i ]);
+    }
+    MemPoolsFree(blocks[ sz ]);
+  }
+  size_t curUsed1, curBlocks1;
+  MemPoolsGetUsage(&curUsed1, &curBlocks1);
+  EXPECT_EQ(curUsed0, curUsed1);
+  EXPECT_EQ(curBlocks0, curBlocks1);
+}
+
+TEST(MemPools, TestSlabArenasGrowAndTrim) {
+  // More small blocks than one slab arena holds.  They should all come from
+  // the pools, with new arenas mapped as needed.
+  static void* blocks[ 8000 ];
+  const size_t sz = 900;
+  size_t curUsed0;
+  MemPoolsGetUsage(&curUsed0);
+  for (size_t i = 0; i < ARRSZ(blocks); i++) {
+    blocks[ i ] = MemPoolsMalloc(sz);
+    ASSERT_TRUE(NULL != blocks[ i ]);
+  }
+  size_t curUsed1;
+  MemPoolsGetUsage(&curUsed1);
+  EXPECT_GE(curUsed1 - curUsed0, ARRSZ(blocks) * sz);
+  MemPoolsPrintUsage();
+
+  for (size_t i = 0; i < ARRSZ(blocks); i++) {
+    MemPoolsFree(blocks[ i ]);
+  }
+  const size_t trimmed = MemPoolsTrim();
+  LOG_TRACE(("Trimmed %u bytes\r\n", (unsigned)trimmed));
+#if defined(__linux__) || defined(__APPLE__)
+  EXPECT_GT(trimmed, 0u);
+#endif
+
+  // Trimmed arenas are used again.
+  for (size_t i = 0; i < ARRSZ(blocks); i++) {
+    blocks[ i ] = MemPoolsMalloc(sz);
+    ASSERT_TRUE(NULL != blocks[ i ]);
+  }
+  for (size_t i = 0; i < ARRSZ(blocks); i++) {
+    MemPoolsFree(blocks[ i ]);
+  }
+  size_t curUsed2;
+  MemPoolsGetUsage(&curUsed2);
+  EXPECT_EQ(curUsed0, curUsed2);
+}
+
+// Pointers from one thread to another.
+typedef struct {
+  std::atomic<uint32_t> wr;
+  uint8_t pad0[ 60 ];
+  std::atomic<uint32_t> rd;
+  uint8_t pad1[ 60 ];
+  void* slots[ 256 ];
+} mempoolstest_Ring;
+
+TEST(MemPools, TestCrossThreadFree) {
+  // Pairs of threads: one allocates, the other frees what it allocated, so
+  // most frees go back to another thread's pages.  Each block is stamped
+  // with its sequence number, which the freeing thread checks.
+  const int pairs     = 2;
+  const int perThread = 20000;
+  size_t curUsed0, curBlocks0;
+  MemPoolsGetUsage(&curUsed0, &curBlocks0);
+
+  static mempoolstest_Ring rings[ pairs ];
+  std::atomic<bool> failed(false);
+  std::atomic<int> freed(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < pairs; i++) {
+    mempoolstest_Ring* const pRing = &rings[ i ];
+    pRing->wr = 0;
+    pRing->rd = 0;
+    threads.push_back(std::thread([pRing, perThread, &failed]() {
+      uint32_t seed = (uint32_t)(uintptr_t)pRing;
+      for (int n = 0; n < perThread; n++) {
+        seed = (seed * 1103515245u) + 12345u;
+        uint32_t* const p = (uint32_t*)MemPoolsMalloc(16 + ((seed >> 8) % 496));
+        if (NULL == p) {
+          failed = true;
+        } else {
+          *p = (uint32_t)n;
+        }
+        // Passed on even if NULL, so the freeing thread doesn't wait forever.
+        const uint32_t wr = pRing->wr.load(std::memory_order_relaxed);
+        while ((wr - pRing->rd.load(std::memory_order_acquire)) >= ARRSZ(pRing->slots)) {
+          std::this_thread::yield();
+        }
+        pRing->slots[ wr % ARRSZ(pRing->slots) ] = p;
+        pRing->wr.store(wr + 1, std::memory_order_release);
+      }
+    }));
+    threads.push_back(std::thread([pRing, perThread, &failed, &freed]() {
+      for (int n = 0; n < perThread; n++) {
+        const uint32_t rd = pRing->rd.load(std::memory_order_relaxed);
+        while (rd == pRing->wr.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+        uint32_t* const p = (uint32_t*)pRing->slots[ rd % ARRSZ(pRing->slots) ];
+        pRing->rd.store(rd + 1, std::memory_order_release);
+        if (p) {
+          if (*p != (uint32_t)n) {
+            failed = true;
+          }
+          MemPoolsFree(p);
+          freed++;
+        }
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_FALSE(failed.load());
+  EXPECT_EQ(pairs * perThread, freed.load());
+
+  // The threads have exited and handed back their pages.
+  size_t curUsed1, curBlocks1;
+  MemPoolsGetUsage(&curUsed1, &curBlocks1);
+  EXPECT_EQ(curUsed0, curUsed1);
+  EXPECT_EQ(curBlocks0, curBlocks1);
+}
+
+TEST(MemPools, TestMallocNoZeroAndRealloc) {
+  size_t curUsed0, curBlocks0;
+  MemPoolsGetUsage(&curUsed0, &curBlocks0);
+
+  uint8_t* p = (uint8_t*)MemPoolsRealloc(NULL, 40);
+  ASSERT_TRUE(NULL != p);
+  memset(p, 0x5a, 40);
+
+  // Shrinking, and growing back within the block, stay in place.
+  ASSERT_EQ(p, MemPoolsRealloc(p, 20));
+  ASSERT_EQ(p, MemPoolsRealloc(p, 40));
+
+  // Past the block moves it, small to large.
+  p = (uint8_t*)MemPoolsRealloc(p, 5000);
+  ASSERT_TRUE(NULL != p);
+  for (int i = 0; i < 40; i++) {
+    ASSERT_EQ(0x5a, p[ i ]);
+  }
+  memset(p, 0x3c, 5000);
+  ASSERT_EQ(p, MemPoolsRealloc(p, 4000));
+  ASSERT_EQ(p, MemPoolsRealloc(p, 5000));
+
+  // Large to larger.
+  p = (uint8_t*)MemPoolsRealloc(p, 20000);
+  ASSERT_TRUE(NULL != p);
+  for (int i = 0; i < 5000; i++) {
+    ASSERT_EQ(0x3c, p[ i ]);
+  }
+  MemPoolsFree(p);
+
+  for (size_t sz = 1; sz < 3000; sz += 97) {
+    uint8_t* const pNz = (uint8_t*)MemPoolsMallocNoZero(sz);
+    ASSERT_TRUE(NULL != pNz);
+    memset(pNz, 0xff, sz);
+    MemPoolsFree(pNz);
+  }
+
+  size_t curUsed1, curBlocks1;
+  MemPoolsGetUsage(&curUsed1, &curBlocks1);
+  EXPECT_EQ(curUsed0, curUsed1);
+  EXPECT_EQ(curBlocks0, curBlocks1);
+}
+
+#if (MEMPOOLS_SAMPLE > 0)
+// Sums the sampled sites with allocation ID id.
+static void mempoolstest_SampleById(const uint8_t id, uint32_t* pLive, uint32_t* pAlloc) {
+  static MemPoolsSampleSiteT sites[ 512 ];
+  const int n = MemPoolsSampleGetSites(sites, ARRSZ(sites));
+  *pLive  = 0;
+  *pAlloc = 0;
+  for (int i = 0; i < n; i++) {
+    if (sites[ i ].id == id) {
+      *pLive  += sites[ i ].liveBytes;
+      *pAlloc += sites[ i ].allocBytes;
+    }
+  }
+}
+
+TEST(MemPools, TestSampling) {
+  static void* kept[ 2000 ];
+  const uint8_t keptId  = 0x71;
+  const uint8_t churnId = 0x72;
+  MemPoolsSampleStart(4096);
+  for (size_t i = 0; i < ARRSZ(kept); i++) {
+    kept[ i ] = MemPoolsMallocWithId(1000, keptId);
+    void* const p = MemPoolsMallocWithId(500, churnId);
+    MemPoolsFree(p);
+  }
+  MemPoolsSampleStop();
+  MemPoolsSamplePrint();
+
+  // About 500 and 250 samples, so well within 20%.
+  uint32_t live, alloc;
+  mempoolstest_SampleById(keptId, &live, &alloc);
+  EXPECT_NEAR(2000000.0, live, 400000.0);
+  EXPECT_EQ(live, alloc);
+  mempoolstest_SampleById(churnId, &live, &alloc);
+  EXPECT_EQ(0u, live);
+  EXPECT_NEAR(1000000.0, alloc, 200000.0);
+
+  // Frees after stopping still come off.
+  for (size_t i = 0; i < ARRSZ(kept); i++) {
+    MemPoolsFree(kept[ i ]);
+  }
+  mempoolstest_SampleById(keptId, &live, &alloc);
+  EXPECT_EQ(0u, live);
+}
+
+// Reallocs move the sampled block, whether in place or on the heap.
+TEST(MemPools, TestSamplingRealloc) {
+  const uint8_t id = 0x74;
+  uint32_t live, live0, alloc;
+  // Rate 1 samples every block at its own size.
+  MemPoolsSampleStart(1);
+  void* p = MemPoolsMallocWithId(1000, id);
+  p = MemPoolsRealloc(p, 500);
+  mempoolstest_SampleById(id, &live, &alloc);
+  EXPECT_EQ(500u, live);
+  MemPoolsFree(p);
+  mempoolstest_SampleById(id, &live, &alloc);
+  EXPECT_EQ(0u, live);
+
+  // Heap blocks can not have an ID, so compare with the other ID 0 blocks.
+  void* pHeap = MemPoolsHeapMalloc(3000);
+  mempoolstest_SampleById(0, &live0, &alloc);
+  pHeap = MemPoolsRealloc(pHeap, 6000);
+  mempoolstest_SampleById(0, &live, &alloc);
+  EXPECT_EQ(live0 + 3000, live);
+  MemPoolsFree(pHeap);
+  mempoolstest_SampleById(0, &live, &alloc);
+  EXPECT_EQ(live0 - 3000, live);
+  MemPoolsSampleStop();
+}
+#endif
+
+TEST(MemPools, TestTraceHook) {
+  typedef struct {
+    const void* pLast;
+    const void* pLastOld;
+    size_t allocBytes;
+    int frees;
+    int reallocs;
+  } CountsT;
+  CountsT counts = { nullptr, nullptr, 0, 0, 0 };
+  auto fn = [](void* pUserData, const void* const pOld, const void* const pVoid, const size_t sz) {
+    CountsT* const pCounts = (CountsT*)pUserData;
+    pCounts->pLast = pVoid;
+    if (pOld) {
+      pCounts->pLastOld = pOld;
+      pCounts->reallocs++;
+    } else if (sz) {
+      pCounts->allocBytes += sz;
+    } else {
+      pCounts->frees++;
+    }
+  };
+  MemPoolsSetTraceHook(fn, &counts);
+  void* const p0 = MemPoolsMalloc(100);
+  EXPECT_EQ(p0, counts.pLast);
+  void* const p1 = MemPoolsMallocNoZero(2000);
+  EXPECT_EQ(p1, counts.pLast);
+  MemPoolsFree(p0);
+  EXPECT_EQ(p0, counts.pLast);
+
+  // Shrinking is in place, growing by a lot moves; each is one record.
+  void* p2 = MemPoolsRealloc(p1, 1000);
+  EXPECT_EQ(p1, p2);
+  EXPECT_EQ(p1, counts.pLastOld);
+  EXPECT_EQ(p1, counts.pLast);
+  void* const p3 = MemPoolsRealloc(p2, 20000);
+  EXPECT_EQ(p2, counts.pLastOld);
+  EXPECT_EQ(p3, counts.pLast);
+  EXPECT_EQ(2, counts.reallocs);
+  MemPoolsSetTraceHook(nullptr, nullptr);
+  MemPoolsFree(p3);
+  EXPECT_EQ(2100u, counts.allocBytes);
+  EXPECT_EQ(1, counts.frees);
+}
+
+TEST(MemPools, TestStlAllocator) {
+  const uint8_t id = 0x73;
+  size_t used0, used1;
+  MemPoolsGetUsage(&used0);
+  {
+    typedef MemPoolsAllocator<int> IntAlloc;
+    std::vector<int, IntAlloc> v{ IntAlloc(id) };
+    typedef std::pair<const int, double> PairT;
+    std::map<int, double, std::less<int>, MemPoolsAllocator<PairT>> m{
+      std::less<int>(), MemPoolsAllocator<PairT>(id) };
+    MemPoolsString str;
+    for (int i = 0; i < 1000; i++) {
+      v.push_back(i);
+      m[ i ] = i / 2.0;
+      str += "!";
+    }
+    MemPoolsGetUsage(&used1);
+    EXPECT_GE(used1, used0 + (1000 * sizeof(int)) + (1000 * sizeof(PairT)) + 1000);
+#if (MEMPOOLS_DEBUG > 0)
+    EXPECT_EQ(1001, MemPoolsGetAllocationsWithAllocId(id));
+#endif
+    EXPECT_EQ(999, v[ 999 ]);
+    EXPECT_EQ(499.5, m[ 999 ]);
+    EXPECT_EQ(1000u, str.length());
+
+    // Over-aligned.
+    struct alignas(64) Line {
+      uint8_t b[ 64 ];
+    };
+    std::vector<Line, MemPoolsAllocator<Line>> lines(3);
+    EXPECT_EQ(0u, (uintptr_t)lines.data() % 64);
+  }
+  MemPoolsGetUsage(&used1);
+  EXPECT_EQ(used0, used1);
+}
+
 static void stringMallocTest() {
   std::string s = "Hi";
   for (int i = 0; i < 256; i++) {
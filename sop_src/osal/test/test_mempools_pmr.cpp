@@ -0,0 +1,56 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        test_mempools_pmr.cpp
+ * @brief       Tests the std::pmr memory resources in mempools_allocator.hpp.
+ *
+ * They need C++17, so CMakeLists.txt builds this file with it while the rest
+ * of the tests stay on C++11.  Where the library has <memory_resource> the
+ * build fails if the resources are not there.
+ */
+
+#include "osal/mempools.h"
+#include "osal/mempools_allocator.hpp"
+#include "gtest/gtest.h"
+#include "utils/region_alloc.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#if (__cplusplus < 201703L)
+#error "Build test_mempools_pmr.cpp as C++17, see CMakeLists.txt"
+#elif defined(__has_include)
+#if __has_include(<memory_resource>) && !(MEMPOOLS_PMR > 0)
+#error "mempools_allocator.hpp did not enable MEMPOOLS_PMR"
+#endif
+#endif
+
+#if (MEMPOOLS_PMR > 0)
+TEST(MemPools, TestMemoryResource) {
+  size_t used0, used1;
+  MemPoolsGetUsage(&used0);
+  {
+    MemPoolsMemoryResource res(0x74);
+    std::pmr::map<int, std::pmr::string> m(&res);
+    for (int i = 0; i < 100; i++) {
+      m[ i ] = std::pmr::string(100, 'x');
+    }
+    MemPoolsGetUsage(&used1);
+    EXPECT_GE(used1, used0 + (100 * 100));
+    EXPECT_EQ(&res, m[ 5 ].get_allocator().resource());
+    void* const p = res.allocate(100, 128);
+    EXPECT_EQ(0u, (uintptr_t)p % 128);
+    res.deallocate(p, 100, 128);
+
+    RegionAllocator region;
+    RegionMemoryResource regionRes(region);
+    std::pmr::vector<int> v(&regionRes);
+    for (int i = 0; i < 1000; i++) {
+      v.push_back(i);
+    }
+    EXPECT_GE(region.BytesUsed(), 1000 * sizeof(int));
+  }
+  MemPoolsGetUsage(&used1);
+  EXPECT_EQ(used0, used1);
+}
+#endif // #if (MEMPOOLS_PMR > 0)
@@ -1,5 +1,7 @@
 
 #include "osal/osal.h"
+#include "osal/osal_atomic.h"
+#include "osal/osal_reactor.h"
 #include <stdlib.h>
 #include <string.h>
 #include "gtest/gtest.h"
@@ -10,6 +12,16 @@
 #include "utils/platform_log.h"
 #include "utils/helper_macros.h"
 #include "tests/gtest_test_wrapper.hpp"
+#include "utils/byteq.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
 LOG_MODNAME("osaltest.cpp");
 
@@ -22,6 +34,12 @@ public:
   ~OSALTest(){}
 };
 
+// Microseconds from a monotonic clock, for the benchmarks below.
+static int64_t osaltest_NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 
 #if !defined(OSAL_SINGLE_TASK)
 typedef struct CSTaskLockerTaskTag {
@@ -282,6 +300,49 @@ TEST_F(OSALTest, osal_TestSleep) {
   OSALSleep(1);
 }
 
+// ////////////////////////////////////////////////////////////////////////////
+// Jitter benchmark for a 1 kHz loop.  Sleeping to absolute deadlines keeps
+// the loop on its schedule; sleeping relative periods drifts by the wakeup
+// latency every time round.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, osal_TestSleepUntil) {
+  const uint64_t periodUs = 1000;
+  const int iterations = 1000;
+
+  {
+    const uint64_t t0 = OSALGetUS();
+    OSALSleepUs(2000);
+    EXPECT_GE(OSALGetUS() - t0, 2000u);
+  }
+
+  for (int absolute = 1; absolute >= 0; absolute--) {
+    const uint64_t start = OSALGetUS();
+    uint64_t deadline = start;
+    int64_t totalLateUs = 0;
+    int64_t worstLateUs = 0;
+    for (int i = 0; i < iterations; i++) {
+      deadline += periodUs;
+      if (absolute) {
+        OSALSleepUntil(deadline);
+      } else {
+        OSALSleepUs(periodUs);
+      }
+      const int64_t lateUs = (int64_t)(OSALGetUS() - deadline);
+      totalLateUs += lateUs;
+      worstLateUs = MAX(worstLateUs, lateUs);
+    }
+    const int64_t driftUs = (int64_t)(OSALGetUS() - start) - (int64_t)(periodUs * iterations);
+    LOG_TRACE(("1 kHz loop, %s: avg late %d us, worst %d us, drift after %d periods %d us\r\n",
+      (absolute) ? "OSALSleepUntil" : "OSALSleepUs", (int)(totalLateUs / iterations),
+      (int)worstLateUs, iterations, (int)driftUs));
+    // Absolute deadlines never finish early.  How far behind they end up
+    // depends on the machine, so the drift is only logged above.
+    if (absolute) {
+      EXPECT_GE(driftUs, 0);
+    }
+  }
+}
+
 #endif // OSAL_SINGLE_TASK
 
 #if !defined(OSAL_SINGLE_TASK)
@@ -370,8 +431,643 @@ TEST_F(OSALTest, TestMutex) {
 
   OSALDeleteMutex(&mId);
 }
+
+// ////////////////////////////////////////////////////////////////////////////
+// Contended lock microbenchmark: several threads hammer one OSAL mutex with
+// both infinite and finite timeouts.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestMutexContended) {
+  typedef struct _osaltest_ContendedT {
+    OSALMutexPtrT mId;
+    uint32_t timeoutMs;
+    volatile int counter;
+  } osaltest_ContendedT;
+
+  const int numThreads = 4;
+  const int iterations = 20000;
+  const uint32_t timeouts[] = { OSAL_WAIT_INFINITE, 1000 };
+
+  for (size_t t = 0; t < ARRSZ(timeouts); t++) {
+    osaltest_ContendedT data;
+    data.mId = OSALCreateMutex();
+    data.timeoutMs = timeouts[t];
+    data.counter = 0;
+
+    auto worker = [](osaltest_ContendedT *pData) {
+      for (int i = 0; i < iterations; i++) {
+        EXPECT_TRUE(OSALLockMutex(pData->mId, pData->timeoutMs));
+        pData->counter = pData->counter + 1;
+        EXPECT_TRUE(OSALUnlockMutex(pData->mId));
+      }
+    };
+
+    const int64_t t0 = osaltest_NowUs();
+    std::thread threads[numThreads];
+    for (int i = 0; i < numThreads; i++) {
+      threads[i] = std::thread(worker, &data);
+    }
+    for (int i = 0; i < numThreads; i++) {
+      threads[i].join();
+    }
+    const int64_t elapsedUs = osaltest_NowUs() - t0;
+
+    EXPECT_EQ(data.counter, numThreads * iterations);
+    LOG_TRACE(("Contended mutex, %d threads, timeout %u: %d ns/lock\r\n",
+      numThreads, timeouts[t], (int)((elapsedUs * 1000) / (numThreads * iterations))));
+    OSALDeleteMutex(&data.mId);
+  }
+}
+
+TEST_F(OSALTest, TestLockStats) {
+  // Contend the global critical section, a mutex and a semaphore, then print
+  // the statistics (only collected with OSAL_LOCK_PROFILE.)
+  static OSALMutexPtrT pMutex;
+  static OSALSemaphorePtrT pSem;
+  static volatile int counter;
+  const int numThreads = 4;
+  const int iterations = 5000;
+  pMutex  = OSALCreateMutex();
+  pSem    = OSALSemaphoreCreate(0, OSAL_COUNT_INFINITE);
+  counter = 0;
+
+  auto worker = []() {
+    for (int i = 0; i < iterations; i++) {
+      OSALEnterCritical();
+      counter = counter + 1;
+      OSALExitCritical();
+      EXPECT_TRUE(OSALLockMutex(pMutex, OSAL_WAIT_INFINITE));
+      counter = counter + 1;
+      EXPECT_TRUE(OSALUnlockMutex(pMutex));
+      EXPECT_TRUE(OSALSemaphoreSignal(pSem, 1));
+      EXPECT_TRUE(OSALSemaphoreWait(pSem, 1000));
+    }
+  };
+  std::thread threads[ numThreads ];
+  for (int i = 0; i < numThreads; i++) {
+    threads[ i ] = std::thread(worker);
+  }
+  for (int i = 0; i < numThreads; i++) {
+    threads[ i ].join();
+  }
+  EXPECT_EQ(counter, 2 * numThreads * iterations);
+
+  // On few cores the threads above may never collide, so make sure of one
+  // wait: hold the mutex while another thread tries to take it.
+  EXPECT_TRUE(OSALLockMutex(pMutex, OSAL_WAIT_INFINITE));
+  std::thread waiter([]() {
+    EXPECT_TRUE(OSALLockMutex(pMutex, OSAL_WAIT_INFINITE));
+    EXPECT_TRUE(OSALUnlockMutex(pMutex));
+  });
+  OSALSleep(20);
+  EXPECT_TRUE(OSALUnlockMutex(pMutex));
+  waiter.join();
+
+#if (OSAL_LOCK_PROFILE > 0)
+  // Catch the printout; the mutex should be on it, with waits.  Nothing that
+  // allocates runs in the sink, which is called inside the log lock.
+  static char dump[ 16384 ];
+  static size_t dumpLen;
+  dumpLen = 0;
+  LOG_Init([](void*, const uint32_t, const char* szLine, const int len) {
+    const size_t n = MIN((size_t)len, sizeof(dump) - 1 - dumpLen);
+    memcpy(&dump[ dumpLen ], szLine, n);
+    dumpLen += n;
+  }, nullptr);
+  OSALDumpLockStats();
+  LOG_Init(nullptr, nullptr);
+  dump[ dumpLen ] = 0;
+  bool mutexWaited = false;
+  for (char* pLine = strtok(dump, "\r\n"); pLine; pLine = strtok(nullptr, "\r\n")) {
+    char kind[ 16 ];
+    char name[ 48 ];
+    unsigned long long count;
+    unsigned long long contended;
+    if ((4 == sscanf(pLine, "%15s %47s %llu %llu", kind, name, &count, &contended)) &&
+        (0 == strcmp(kind, "mutex")) && (contended > 0)) {
+      mutexWaited = true;
+    }
+  }
+  EXPECT_TRUE(mutexWaited);
+#else
+  OSALDumpLockStats();
+#endif
+  OSALSemaphoreDelete(&pSem);
+  OSALDeleteMutex(&pMutex);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Critical section domains: threads using the legacy global critical section
+// serialize on each other; threads using their own OSALCsT do not.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestCsDomains) {
+  // Cache line aligned so that per object locks do not false share.
+  typedef struct alignas(64) _osaltest_CsWorkerT {
+    OSALCsT ownCs;
+    OSALCsT* pCs;
+    volatile int counter;
+    ByteQ_t q;
+    bq_t qBuf[ 64 ];
+    bool qOk;
+  } osaltest_CsWorkerT;
+
+  const int numThreads = 4;
+  const int iterations = 100000;
+  enum { CS_GLOBAL, CS_SHARED, CS_PER_OBJECT, CS_NUM_MODES };
+  const char* const modeNames[ CS_NUM_MODES ] = { "global", "shared object", "per object" };
+
+  OSALCsT sharedCs;
+  OSALCsInit(&sharedCs, false, OSAL_CS_LEVEL_NONE);
+  static osaltest_CsWorkerT workers[ numThreads ];
+
+  // Recursion on a single thread.
+  OSALCsEnter(&sharedCs);
+  OSALCsEnter(&sharedCs);
+  OSALCsExit(&sharedCs);
+  OSALCsExit(&sharedCs);
+
+  for (int mode = 0; mode < CS_NUM_MODES; mode++) {
+    volatile int sharedCounter = 0;
+    for (int i = 0; i < numThreads; i++) {
+      OSALCsInit(&workers[ i ].ownCs, false, OSAL_CS_LEVEL_NONE);
+      workers[ i ].pCs = (mode == CS_GLOBAL) ? nullptr : (mode == CS_SHARED) ? &sharedCs : &workers[ i ].ownCs;
+      workers[ i ].counter = 0;
+    }
+
+    auto worker = [](osaltest_CsWorkerT* pW, volatile int* pCounter) {
+      for (int i = 0; i < iterations; i++) {
+        OSALCsEnter(pW->pCs);
+        *pCounter = *pCounter + 1;
+        OSALCsExit(pW->pCs);
+      }
+    };
+
+    const int64_t t0 = osaltest_NowUs();
+    std::thread threads[ numThreads ];
+    for (int i = 0; i < numThreads; i++) {
+      volatile int* const pCounter = (mode == CS_PER_OBJECT) ? &workers[ i ].counter : &sharedCounter;
+      threads[ i ] = std::thread(worker, &workers[ i ], pCounter);
+    }
+    for (int i = 0; i < numThreads; i++) {
+      threads[ i ].join();
+    }
+    const int64_t elapsedUs = osaltest_NowUs() - t0;
+
+    int total = sharedCounter;
+    for (int i = 0; i < numThreads; i++) {
+      total += workers[ i ].counter;
+    }
+    EXPECT_EQ(total, numThreads * iterations);
+    LOG_TRACE(("Critical section, %s, %d threads: %d ns/op\r\n", modeNames[ mode ],
+      numThreads, (int)((elapsedUs * 1000) / (numThreads * iterations))));
+  }
+
+  // Locked ByteQs, one per thread, no longer contend with each other.
+  for (int i = 0; i < numThreads; i++) {
+    ByteQCreate(&workers[ i ].q, workers[ i ].qBuf, sizeof(workers[ i ].qBuf), true, true);
+    workers[ i ].qOk = true;
+  }
+  auto qWorker = [](osaltest_CsWorkerT* pW) {
+    bq_t wr[ 16 ];
+    bq_t rd[ 16 ];
+    for (int i = 0; i < iterations; i++) {
+      memset(wr, i, sizeof(wr));
+      pW->qOk &= (sizeof(wr) == ByteQWrite(&pW->q, wr, sizeof(wr)));
+      pW->qOk &= (sizeof(rd) == ByteQRead(&pW->q, rd, sizeof(rd)));
+      pW->qOk &= (0 == memcmp(wr, rd, sizeof(rd)));
+    }
+  };
+  const int64_t t0 = osaltest_NowUs();
+  std::thread threads[ numThreads ];
+  for (int i = 0; i < numThreads; i++) {
+    threads[ i ] = std::thread(qWorker, &workers[ i ]);
+  }
+  for (int i = 0; i < numThreads; i++) {
+    threads[ i ].join();
+  }
+  const int64_t elapsedUs = osaltest_NowUs() - t0;
+  for (int i = 0; i < numThreads; i++) {
+    EXPECT_TRUE(workers[ i ].qOk);
+    ByteQDestroy(&workers[ i ].q);
+  }
+  LOG_TRACE(("Locked ByteQ per thread, %d threads: %d ns/write+read\r\n",
+    numThreads, (int)((elapsedUs * 1000) / (numThreads * iterations))));
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// SPSC ByteQ: the count comes from the two indices, and one writer and one
+// reader pass 1-4 KB bursts through it intact.  Reports the throughput
+// compared to a ByteQ that locks on reads and writes.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestByteQSpsc) {
+  typedef struct _osaltest_SpscT {
+    ByteQ_t q;
+    bq_t qBuf[ 16 * 1024 ];
+    bq_t pattern[ 4096 + 256 ];
+    bool ok;
+  } osaltest_SpscT;
+
+  static osaltest_SpscT data;
+  for (unsigned int i = 0; i < sizeof(data.pattern); i++) {
+    data.pattern[ i ] = (bq_t)i;
+  }
+
+  // Single threaded: one byte is kept free, and the indices wrap.
+  {
+    bq_t buf[ 8 ];
+    bq_t rd[ 8 ];
+    ByteQ_t q;
+    ByteQCreateSpsc(&q, buf, sizeof(buf));
+    EXPECT_EQ(ByteQGetWriteReady(&q), 7u);
+    EXPECT_EQ(ByteQWrite(&q, data.pattern, 8), 0u);
+    EXPECT_EQ(ByteQWrite(&q, data.pattern, 5), 5u);
+    EXPECT_EQ(ByteQGetReadReady(&q), 5u);
+    EXPECT_EQ(ByteQRead(&q, rd, 4), 4u);
+    EXPECT_EQ(0, memcmp(rd, data.pattern, 4));
+    EXPECT_EQ(ByteQGetContiguousWriteReady(&q), 3u);
+    EXPECT_EQ(ByteQWrite(&q, &data.pattern[ 5 ], 6), 6u);
+    EXPECT_EQ(ByteQGetWriteReady(&q), 0u);
+    EXPECT_EQ(ByteQGetContiguousReadReady(&q), 4u);
+    EXPECT_EQ(ByteQPeek(&q, rd, 8), 7u);
+    EXPECT_EQ(0, memcmp(rd, &data.pattern[ 4 ], 7));
+    EXPECT_EQ(ByteQCommitRead(&q, 2), 2u);
+    EXPECT_EQ(ByteQRead(&q, rd, 8), 5u);
+    EXPECT_EQ(0, memcmp(rd, &data.pattern[ 6 ], 5));
+    EXPECT_EQ(ByteQCommitWrite(&q, 3), 3u);
+    ByteQFlush(&q);
+    EXPECT_EQ(ByteQGetReadReady(&q), 0u);
+    EXPECT_EQ(ByteQGetWriteReady(&q), 7u);
+  }
+
+  // Two threads, locked and not.  byteq_bench compares their throughput.
+  const unsigned int totalBytes = 4 * 1024 * 1024;
+  for (int spsc = 0; spsc < 2; spsc++) {
+    if (spsc) {
+      ByteQCreateSpsc(&data.q, data.qBuf, sizeof(data.qBuf));
+    }
+    else {
+      ByteQCreate(&data.q, data.qBuf, sizeof(data.qBuf), true, true);
+    }
+    data.ok = true;
+
+    // Writes bursts of 1, 2, 3 and 4 KB in turn.
+    auto writer = [](osaltest_SpscT* pData) {
+      unsigned int pos   = 0;
+      unsigned int burst = 0;
+      while (pos < totalBytes) {
+        const unsigned int len = MIN(1024 * (1 + (burst & 3)), totalBytes - pos);
+        if (ByteQWrite(&pData->q, &pData->pattern[ pos & 0xff ], len)) {
+          pos += len;
+          burst++;
+        }
+        else {
+          std::this_thread::yield();
+        }
+      }
+    };
+
+    // Reads whatever is there and checks it.
+    auto reader = [](osaltest_SpscT* pData) {
+      bq_t rd[ 4096 ];
+      unsigned int pos = 0;
+      while (pos < totalBytes) {
+        const unsigned int len = ByteQRead(&pData->q, rd, sizeof(rd));
+        if (len) {
+          pData->ok &= (0 == memcmp(rd, &pData->pattern[ pos & 0xff ], len));
+          pos += len;
+        }
+        else {
+          std::this_thread::yield();
+        }
+      }
+    };
+
+    std::thread wrThread(writer, &data);
+    std::thread rdThread(reader, &data);
+    wrThread.join();
+    rdThread.join();
+
+    EXPECT_TRUE(data.ok);
+    EXPECT_EQ(ByteQGetReadReady(&data.q), 0u);
+    ByteQDestroy(&data.q);
+  }
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Each thread has its own context block; OSAL tasks and scheduler lanes fill
+// theirs in when they start.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestThreadCtx) {
+  typedef struct _osaltest_ThreadCtxT {
+    TaskSchedulable sched;
+    OSALThreadCtxT* volatile pCtx;
+    volatile uint32_t taskId;
+    volatile TaskSchedPriority prio;
+    OSALSemaphorePtrT pDone;
+  } osaltest_ThreadCtxT;
+
+  osaltest_ThreadCtxT data = osaltest_ThreadCtxT();
+  data.pDone = OSALSemaphoreCreate(0, 1);
+
+  // A plain OSAL task.
+  auto taskFn = [](void* const p) {
+    osaltest_ThreadCtxT* const pData = (osaltest_ThreadCtxT*)p;
+    pData->pCtx   = OSALGetThreadCtx();
+    pData->taskId = OSALGetCurrentTaskID();
+    EXPECT_EQ(OSAL_LANE_NONE, pData->pCtx->laneType);
+    OSALSemaphoreSignal(pData->pDone, 1);
+  };
+  OSAL_ALLOC_STACK(ctxTask, 16384, 1234);
+  OSALTaskPtrT pTask = OSALTaskCreate(taskFn, &data, OSAL_PRIO_LOW, &ctxTask);
+  EXPECT_TRUE(OSALSemaphoreWait(data.pDone, 1000));
+  OSALTaskDelete(&pTask);
+  OSAL_FREE_STACK(ctxTask);
+  EXPECT_EQ(data.taskId, 1234u);
+  EXPECT_TRUE(data.pCtx != OSALGetThreadCtx());
+  EXPECT_EQ(OSALGetThreadCtx()->taskId, OSALGetCurrentTaskID());
+
+  // A scheduler lane.
+  auto schedFn = [](void* p, uint32_t) {
+    osaltest_ThreadCtxT* const pData = (osaltest_ThreadCtxT*)p;
+    pData->pCtx = OSALGetThreadCtx();
+    pData->prio = TaskSched_GetCurrentPriority();
+    OSALSemaphoreSignal(pData->pDone, 1);
+  };
+  TaskSchedInitSched(&data.sched, schedFn, &data);
+  TaskSchedAddTimerFn(TS_PRIO_APP, &data.sched, 0, 0);
+  EXPECT_TRUE(OSALSemaphoreWait(data.pDone, 1000));
+  EXPECT_EQ(data.prio, TS_PRIO_APP);
+  EXPECT_EQ(OSAL_LANE_TASKSCHED, data.pCtx->laneType);
+  EXPECT_TRUE(data.pCtx->pLane != nullptr);
+  EXPECT_TRUE(data.pCtx->pName != nullptr);
+  OSALSemaphoreDelete(&data.pDone);
+
+  const int iterations = 1000000;
+  uint32_t sum = 0;
+  const int64_t t0 = osaltest_NowUs();
+  for (int i = 0; i < iterations; i++) {
+    sum += OSALGetCurrentTaskID();
+  }
+  const int64_t elapsedUs = osaltest_NowUs() - t0;
+  EXPECT_EQ(sum, 0u);
+  LOG_TRACE(("OSALGetCurrentTaskID: %d ns/call\r\n", (int)((elapsedUs * 1000) / iterations)));
+}
+
+#if defined(__linux__)
+// ////////////////////////////////////////////////////////////////////////////
+// OSAL tasks get the stack size from their OSALTaskStructT (within the
+// port's minimum), not the 8 MB pthread default.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestTaskStack) {
+  typedef struct _osaltest_TaskStackT {
+    volatile size_t stackSz;
+    OSALSemaphorePtrT pDone;
+  } osaltest_TaskStackT;
+
+  osaltest_TaskStackT data;
+  data.pDone = OSALSemaphoreCreate(0, 1);
+
+  auto taskFn = [](void* const p) {
+    osaltest_TaskStackT* const pData = (osaltest_TaskStackT*)p;
+    pthread_attr_t attr;
+    void* pStack = nullptr;
+    size_t stackSz = 0;
+    if (0 == pthread_getattr_np(pthread_self(), &attr)) {
+      pthread_attr_getstack(&attr, &pStack, &stackSz);
+      pthread_attr_destroy(&attr);
+    }
+    // Use a good part of the stack.
+    volatile uint8_t deep[ 128 * 1024 ];
+    memset((void*)deep, 0xa5, sizeof(deep));
+    pData->stackSz = stackSz + deep[ 1000 ] - 0xa5;
+    OSALSemaphoreSignal(pData->pDone, 1);
+  };
+
+  const uint32_t sizes[] = { 4096, 1024 * 1024 };
+  for (size_t i = 0; i < ARRSZ(sizes); i++) {
+    data.stackSz = 0;
+    OSAL_ALLOC_STACK(stackTask, sizes[ i ], 77);
+    const int64_t t0 = osaltest_NowUs();
+    OSALTaskPtrT pTask = OSALTaskCreate(taskFn, &data, OSAL_PRIO_LOW, &stackTask);
+    EXPECT_TRUE(OSALSemaphoreWait(data.pDone, 1000));
+    OSALTaskDelete(&pTask);
+    const int64_t elapsedUs = osaltest_NowUs() - t0;
+    OSAL_FREE_STACK(stackTask);
+    EXPECT_GE(data.stackSz, (size_t)sizes[ i ]);
+    EXPECT_LT(data.stackSz, (size_t)(8 * 1024 * 1024));
+    LOG_TRACE(("Asked for a %d byte stack, got %d bytes; create+join %d us\r\n",
+      (int)sizes[ i ], (int)data.stackSz, (int)elapsedUs));
+  }
+  OSALSemaphoreDelete(&data.pDone);
+}
+#endif
+
+// ////////////////////////////////////////////////////////////////////////////
+// Thread pool: every job runs, the queue is bounded, drain waits for running
+// jobs.  Compares the cost per job with starting a thread per job.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestThreadPool) {
+  typedef struct _osaltest_ThreadPoolT {
+    std::atomic<uint32_t> count;
+    std::atomic<bool> started;
+    OSALSemaphorePtrT pRelease;
+  } osaltest_ThreadPoolT;
+
+  osaltest_ThreadPoolT data;
+  data.count    = 0;
+  data.started  = false;
+  data.pRelease = OSALSemaphoreCreate(0, 1);
+
+  auto countFn = [](void* const p) { ((osaltest_ThreadPoolT*)p)->count++; };
+  auto blockFn = [](void* const p) {
+    osaltest_ThreadPoolT* const pData = (osaltest_ThreadPoolT*)p;
+    pData->started = true;
+    OSALSemaphoreWait(pData->pRelease, OSAL_WAIT_INFINITE);
+    pData->count++;
+  };
+
+  // One worker blocked in a job: the queue fills, and drain times out.
+  OSALThreadPoolPtrT pPool = OSALThreadPoolCreate(1, 4, OSAL_PRIO_MEDIUM, 16384);
+  ASSERT_TRUE(pPool != NULL);
+  EXPECT_TRUE(OSALThreadPoolSubmit(pPool, blockFn, &data));
+  while (!data.started) {
+    OSALSleep(1);
+  }
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(OSALThreadPoolSubmit(pPool, countFn, &data));
+  }
+  EXPECT_FALSE(OSALThreadPoolSubmit(pPool, countFn, &data));
+  EXPECT_FALSE(OSALThreadPoolDrain(pPool, 10));
+  OSALSemaphoreSignal(data.pRelease, 1);
+  EXPECT_TRUE(OSALThreadPoolDrain(pPool, 1000));
+  EXPECT_EQ(data.count.load(), 5u);
+  OSALThreadPoolDelete(&pPool);
+  EXPECT_TRUE(pPool == NULL);
+
+  // Many producers, many workers.
+  const int numThreads = 4;
+  const int jobsPerProducer = 20000;
+  pPool = OSALThreadPoolCreate(numThreads, 256, OSAL_PRIO_MEDIUM, 16384);
+  data.count = 0;
+  const int64_t t0 = osaltest_NowUs();
+  std::thread producers[ numThreads ];
+  for (int i = 0; i < numThreads; i++) {
+    producers[ i ] = std::thread([&] {
+      for (int j = 0; j < jobsPerProducer; j++) {
+        while (!OSALThreadPoolSubmit(pPool, countFn, &data)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (int i = 0; i < numThreads; i++) {
+    producers[ i ].join();
+  }
+  EXPECT_TRUE(OSALThreadPoolDrain(pPool, 5000));
+  const int64_t poolUs = osaltest_NowUs() - t0;
+  EXPECT_EQ(data.count.load(), (uint32_t)(numThreads * jobsPerProducer));
+  // Delete finishes anything still queued.
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE(OSALThreadPoolSubmit(pPool, countFn, &data));
+  }
+  OSALThreadPoolDelete(&pPool);
+  EXPECT_EQ(data.count.load(), (uint32_t)(numThreads * jobsPerProducer + 100));
+
+  // A thread per job, as the pool replaces.
+  const int threadJobs = 1000;
+  const int64_t t1 = osaltest_NowUs();
+  for (int i = 0; i < threadJobs; i++) {
+    std::thread t(countFn, &data);
+    t.join();
+  }
+  const int64_t threadUs = osaltest_NowUs() - t1;
+  LOG_TRACE(("OSALThreadPool, %d producers/%d workers: %d ns/job; thread per job: %d ns/job\r\n",
+    numThreads, numThreads, (int)((poolUs * 1000) / (numThreads * jobsPerProducer)),
+    (int)((threadUs * 1000) / threadJobs)));
+
+  OSALSemaphoreDelete(&data.pRelease);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// osal_atomic.h operations are atomic across threads, and OSALTestAndSet()
+// and OSALClearFlag() work as a lock.  Reports the cost of each compared to
+// the global critical section.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestAtomics) {
+  typedef struct _osaltest_AtomicsT {
+    volatile uint32_t counter;
+    volatile bool flag;
+    int mode;
+  } osaltest_AtomicsT;
+
+  const int numThreads = 4;
+  const int iterations = 100000;
+  enum { AT_FETCH_ADD, AT_CAS, AT_TEST_AND_SET, AT_CRITICAL, AT_NUM_MODES };
+  const char* const modeNames[ AT_NUM_MODES ] = {
+    "OSALAtomicFetchAddU32", "OSALAtomicCasU32", "OSALTestAndSet", "OSALEnterCritical" };
+
+  uint32_t expected = 5;
+  volatile uint32_t word = 5;
+  EXPECT_TRUE(OSALAtomicCasU32(&word, &expected, 6, OSAL_MO_ACQ_REL));
+  EXPECT_FALSE(OSALAtomicCasU32(&word, &expected, 7, OSAL_MO_ACQ_REL));
+  EXPECT_EQ(expected, 6u);
+  EXPECT_EQ(OSALAtomicExchangeU32(&word, 1, OSAL_MO_SEQ_CST), 6u);
+  EXPECT_EQ(OSALAtomicFetchOrU32(&word, 2, OSAL_MO_RELAXED), 1u);
+  EXPECT_EQ(OSALAtomicFetchAndU32(&word, 2, OSAL_MO_RELAXED), 3u);
+  EXPECT_EQ(OSALAtomicLoadU32(&word, OSAL_MO_ACQUIRE), 2u);
+
+  for (int mode = 0; mode < AT_NUM_MODES; mode++) {
+    osaltest_AtomicsT data;
+    data.counter = 0;
+    data.flag    = false;
+    data.mode    = mode;
+
+    auto worker = [](osaltest_AtomicsT* pData) {
+      for (int i = 0; i < iterations; i++) {
+        switch (pData->mode) {
+        case AT_FETCH_ADD:
+          OSALAtomicFetchAddU32(&pData->counter, 1, OSAL_MO_RELAXED);
+          break;
+        case AT_CAS: {
+          uint32_t cur = OSALAtomicLoadU32(&pData->counter, OSAL_MO_RELAXED);
+          while (!OSALAtomicCasU32(&pData->counter, &cur, cur + 1, OSAL_MO_RELAXED)) {
+          }
+        } break;
+        case AT_TEST_AND_SET:
+          while (!OSALTestAndSet(&pData->flag)) {
+            std::this_thread::yield();
+          }
+          pData->counter = pData->counter + 1;
+          OSALClearFlag((bool*)&pData->flag);
+          break;
+        default:
+          OSALEnterCritical();
+          pData->counter = pData->counter + 1;
+          OSALExitCritical();
+          break;
+        }
+      }
+    };
+
+    const int64_t t0 = osaltest_NowUs();
+    std::thread threads[ numThreads ];
+    for (int i = 0; i < numThreads; i++) {
+      threads[ i ] = std::thread(worker, &data);
+    }
+    for (int i = 0; i < numThreads; i++) {
+      threads[ i ].join();
+    }
+    const int64_t elapsedUs = osaltest_NowUs() - t0;
+
+    EXPECT_EQ(data.counter, (uint32_t)(numThreads * iterations));
+    LOG_TRACE(("%s, %d threads: %d ns/op\r\n", modeNames[ mode ], numThreads,
+      (int)((elapsedUs * 1000) / (numThreads * iterations))));
+  }
+}
 #endif // OSAL_SINGLE_TASK
 
+// ////////////////////////////////////////////////////////////////////////////
+// The OSAL clocks are monotonic and agree with each other.  Also reports the
+// cost per call of each clock.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestClocks) {
+  const uint64_t ms0 = OSALGetMS();
+  const uint64_t us0 = OSALGetUS();
+  const uint64_t t0  = OSALGetTicks();
+  OSALSleep(50);
+  const uint64_t dMs = OSALGetMS() - ms0;
+  const uint64_t dUs = OSALGetUS() - us0;
+  const uint64_t dNs = OSALTicksToNS(OSALGetTicks() - t0);
+  // OSALGetMS() may read the coarse clock, which can be a tick or so behind
+  // the others at either end, so it only has to agree to within 10 ms.
+  const uint64_t msSlack = 10;
+  EXPECT_GE(dUs, 50000u);
+  EXPECT_GE(dMs + msSlack, 50u);
+  EXPECT_LT(dMs, 150u);
+  EXPECT_GE(dUs + (msSlack * 1000), dMs * 1000);
+  EXPECT_LE(dUs, (dMs + msSlack) * 1000);
+  EXPECT_GE(dNs / 1000, dUs * 9 / 10);
+  EXPECT_LE(dNs / 1000, dUs * 11 / 10);
+
+  const int iterations = 1000000;
+  typedef uint64_t (*osaltest_ClockFnT)(void);
+  auto getMs = []() -> uint64_t { return OSALGetMS(); };
+  const osaltest_ClockFnT clocks[] = { getMs, OSALGetUS, OSALGetNS, OSALGetTicks };
+  const char* const names[] = { "OSALGetMS", "OSALGetUS", "OSALGetNS", "OSALGetTicks" };
+  for (size_t c = 0; c < ARRSZ(clocks); c++) {
+    bool monotonic = true;
+    uint64_t last  = clocks[ c ]();
+    const int64_t start = osaltest_NowUs();
+    for (int i = 0; i < iterations; i++) {
+      const uint64_t now = clocks[ c ]();
+      monotonic &= (now >= last);
+      last = now;
+    }
+    const int64_t elapsedUs = osaltest_NowUs() - start;
+    EXPECT_TRUE(monotonic);
+    LOG_TRACE(("%s: %d ns/call\r\n", names[ c ], (int)((elapsedUs * 1000) / iterations)));
+  }
+}
+
 #if !defined(OSAL_SINGLE_TASK)
 
 TEST_F(OSALTest, TestSemaphore1) {
@@ -536,6 +1232,255 @@ TEST_F(OSALTest, TestSemaphoreMaxValue) {
 // END Test of Semaphore Max Value
 // ////////////////////////////////////////////////////////////////////////////
 
+// ////////////////////////////////////////////////////////////////////////////
+// Wake latency benchmark: how late does a timed wait return after its
+// deadline, and how long from a signal until a timed waiter runs.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestSemaphoreWakeLatency) {
+  typedef struct _osaltest_WakeLatencyT {
+    OSALSemaphorePtrT pSem;
+    std::atomic<int64_t> signalUs;
+    std::atomic<bool> done;
+  } osaltest_WakeLatencyT;
+
+  osaltest_WakeLatencyT data;
+  data.pSem = OSALSemaphoreCreate(0, OSAL_COUNT_INFINITE);
+  data.signalUs = 0;
+  data.done = false;
+  const int iterations = 100;
+  const int timeoutMs = 5;
+
+  // Timeout overshoot.
+  int64_t totalUs = 0;
+  int64_t worstUs = 0;
+  for (int i = 0; i < iterations; i++) {
+    const int64_t t0 = osaltest_NowUs();
+    EXPECT_FALSE(OSALSemaphoreWait(data.pSem, timeoutMs));
+    const int64_t lateUs = osaltest_NowUs() - t0 - (timeoutMs * 1000);
+    // Never early.  How late depends on the machine, so it is only logged.
+    EXPECT_GE(lateUs, 0);
+    totalUs += lateUs;
+    worstUs = MAX(worstUs, lateUs);
+  }
+  LOG_TRACE(("Timed wait of %d ms: avg overshoot %d us, worst %d us\r\n",
+    timeoutMs, (int)(totalUs / iterations), (int)worstUs));
+
+  // Signal to wake.
+  auto osal_WakeLatency_SignalTask = [](void *pParam, uint32_t) {
+    osaltest_WakeLatencyT *pData = (osaltest_WakeLatencyT *)pParam;
+    for (int i = 0; i < iterations; i++) {
+      OSALSleep(2);
+      pData->signalUs = osaltest_NowUs();
+      OSALSemaphoreSignal(pData->pSem, 1);
+    }
+    pData->done = true;
+  };
+  TaskSchedScheduleFn(TS_PRIO_APP_EVENTS, osal_WakeLatency_SignalTask, &data, 0);
+
+  totalUs = 0;
+  worstUs = 0;
+  int wakes = 0;
+  while (wakes < iterations) {
+    if (OSALSemaphoreWait(data.pSem, 1000)) {
+      const int64_t latencyUs = osaltest_NowUs() - data.signalUs;
+      totalUs += latencyUs;
+      worstUs = MAX(worstUs, latencyUs);
+      wakes++;
+    }
+    else {
+      break;
+    }
+  }
+  EXPECT_EQ(wakes, iterations);
+  LOG_TRACE(("Signal to timed-wait wake: avg %d us, worst %d us\r\n",
+    (int)(totalUs / MAX(wakes, 1)), (int)worstUs));
+
+  while (!data.done) {
+    OSALSleep(5);
+  }
+  EXPECT_TRUE(OSALSemaphoreDelete(&data.pSem));
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Reader/writer lock: readers share, a writer excludes everyone, and timed
+// locks give up.  Then compares read-mostly throughput against a mutex.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestRwLock) {
+  OSALRwLockPtrT pLock = OSALRwLockCreate();
+  ASSERT_TRUE(pLock != NULL);
+
+  // Two readers at once, no writer while reading.
+  EXPECT_TRUE(OSALRwLockReadLock(pLock, 0));
+  EXPECT_TRUE(OSALRwLockReadLock(pLock, 0));
+  EXPECT_FALSE(OSALRwLockWriteLock(pLock, 0));
+  const int64_t t0 = osaltest_NowUs();
+  EXPECT_FALSE(OSALRwLockWriteLock(pLock, 20));
+  EXPECT_GE(osaltest_NowUs() - t0, 19000);
+  EXPECT_TRUE(OSALRwLockReadUnlock(pLock));
+  EXPECT_TRUE(OSALRwLockReadUnlock(pLock));
+
+  // No readers or other writers while writing, from another thread either.
+  EXPECT_TRUE(OSALRwLockWriteLock(pLock, OSAL_WAIT_INFINITE));
+  bool otherGotRead = true;
+  std::thread other([&] { otherGotRead = OSALRwLockReadLock(pLock, 10); });
+  other.join();
+  EXPECT_FALSE(otherGotRead);
+  EXPECT_TRUE(OSALRwLockWriteUnlock(pLock));
+  EXPECT_TRUE(OSALRwLockWriteLock(pLock, 0));
+  EXPECT_TRUE(OSALRwLockWriteUnlock(pLock));
+
+  // Read-mostly benchmark: 1 write per 100 reads.
+  typedef struct _osaltest_RwBenchT {
+    OSALRwLockPtrT pLock;
+    OSALMutexPtrT pMutex;
+    bool useRw;
+    volatile uint32_t shared[ 4 ];
+    std::atomic<int> errors;
+  } osaltest_RwBenchT;
+
+  const int numThreads = 4;
+  const int iterations = 50000;
+  osaltest_RwBenchT data;
+  data.pLock  = pLock;
+  data.pMutex = OSALCreateMutex();
+  data.errors = 0;
+
+  auto worker = [](osaltest_RwBenchT* pData) {
+    for (int i = 0; i < iterations; i++) {
+      const bool write = (0 == (i % 100));
+      if (pData->useRw) {
+        if (write) {
+          OSALRwLockWriteLock(pData->pLock, OSAL_WAIT_INFINITE);
+        } else {
+          OSALRwLockReadLock(pData->pLock, OSAL_WAIT_INFINITE);
+        }
+      } else {
+        OSALLockMutex(pData->pMutex, OSAL_WAIT_INFINITE);
+      }
+      if (write) {
+        for (int j = 0; j < 4; j++) {
+          pData->shared[ j ] = pData->shared[ j ] + 1;
+        }
+      } else if ((pData->shared[ 0 ] != pData->shared[ 3 ])) {
+        pData->errors++;
+      }
+      if (pData->useRw) {
+        if (write) {
+          OSALRwLockWriteUnlock(pData->pLock);
+        } else {
+          OSALRwLockReadUnlock(pData->pLock);
+        }
+      } else {
+        OSALUnlockMutex(pData->pMutex);
+      }
+    }
+  };
+
+  for (int useRw = 0; useRw < 2; useRw++) {
+    data.useRw = (useRw > 0);
+    memset((void*)data.shared, 0, sizeof(data.shared));
+    const int64_t start = osaltest_NowUs();
+    std::thread threads[ numThreads ];
+    for (int i = 0; i < numThreads; i++) {
+      threads[ i ] = std::thread(worker, &data);
+    }
+    for (int i = 0; i < numThreads; i++) {
+      threads[ i ].join();
+    }
+    const int64_t elapsedUs = osaltest_NowUs() - start;
+    EXPECT_EQ(data.shared[ 3 ], (uint32_t)(numThreads * iterations / 100));
+    LOG_TRACE(("%s, %d threads, 1%% writes: %d ns/op\r\n",
+      (useRw) ? "OSALRwLock" : "OSALMutex", numThreads,
+      (int)((elapsedUs * 1000) / (numThreads * iterations))));
+  }
+  EXPECT_EQ(data.errors.load(), 0);
+
+  OSALDeleteMutex(&data.pMutex);
+  OSALRwLockDelete(&pLock);
+  EXPECT_TRUE(pLock == NULL);
+}
+
+// ////////////////////////////////////////////////////////////////////////////
+// Event groups: wait for any/all bits, clear on exit, timeouts, and setting
+// from another thread.  Also measures set to wake latency.
+// ////////////////////////////////////////////////////////////////////////////
+TEST_F(OSALTest, TestEventGroup) {
+  OSALEventGroupPtrT pGroup = OSALEventGroupCreate();
+  ASSERT_TRUE(pGroup != NULL);
+
+  EXPECT_EQ(OSALEventGroupSet(pGroup, 0x01), 0x01u);
+  EXPECT_EQ(OSALEventGroupSet(pGroup, 0x04), 0x05u);
+  EXPECT_EQ(OSALEventGroupGet(pGroup), 0x05u);
+
+  // Any: satisfied by 0x01, not cleared.
+  EXPECT_EQ(OSALEventGroupWait(pGroup, 0x03, false, false, 0), 0x05u);
+  EXPECT_EQ(OSALEventGroupGet(pGroup), 0x05u);
+
+  // All: 0x02 is missing, so this times out and leaves the bits alone.
+  int64_t t0 = osaltest_NowUs();
+  EXPECT_EQ(OSALEventGroupWait(pGroup, 0x03, true, true, 20), 0x05u);
+  EXPECT_GE(osaltest_NowUs() - t0, 19000);
+  EXPECT_EQ(OSALEventGroupGet(pGroup), 0x05u);
+
+  // All with clear on exit only clears the bits waited for.
+  EXPECT_EQ(OSALEventGroupWait(pGroup, 0x05, true, true, 0), 0x05u);
+  EXPECT_EQ(OSALEventGroupGet(pGroup), 0x00u);
+  EXPECT_EQ(OSALEventGroupSet(pGroup, 0x18), 0x18u);
+  EXPECT_EQ(OSALEventGroupClear(pGroup, 0x08), 0x18u);
+  EXPECT_EQ(OSALEventGroupGet(pGroup), 0x10u);
+  OSALEventGroupClear(pGroup, 0xffffffff);
+
+  // Another thread sets the bits one at a time.
+  std::thread setter([&] {
+    OSALSleep(5);
+    OSALEventGroupSet(pGroup, 0x100);
+    OSALSleep(5);
+    OSALEventGroupSet(pGroup, 0x200);
+  });
+  const uint32_t bits = OSALEventGroupWait(pGroup, 0x300, true, true, 1000);
+  setter.join();
+  EXPECT_EQ(bits & 0x300, 0x300u);
+  EXPECT_EQ(OSALEventGroupGet(pGroup), 0x00u);
+
+  // Set to wake latency.
+  typedef struct _osaltest_EgLatencyT {
+    OSALEventGroupPtrT pGroup;
+    std::atomic<int64_t> setUs;
+  } osaltest_EgLatencyT;
+  const int iterations = 100;
+  osaltest_EgLatencyT data;
+  data.pGroup = pGroup;
+  data.setUs  = 0;
+  std::thread waker([&data] {
+    for (int i = 0; i < iterations; i++) {
+      OSALSleep(2);
+      data.setUs = osaltest_NowUs();
+      OSALEventGroupSet(data.pGroup, 0x1);
+    }
+  });
+  int64_t totalUs = 0;
+  int64_t worstUs = 0;
+  int wakes = 0;
+  while (wakes < iterations) {
+    if (OSALEventGroupWait(pGroup, 0x1, false, true, 1000) & 0x1) {
+      const int64_t latencyUs = osaltest_NowUs() - data.setUs;
+      totalUs += latencyUs;
+      worstUs = MAX(worstUs, latencyUs);
+      wakes++;
+    }
+    else {
+      break;
+    }
+  }
+  waker.join();
+  EXPECT_EQ(wakes, iterations);
+  LOG_TRACE(("Event group set to wake: avg %d us, worst %d us\r\n",
+    (int)(totalUs / MAX(wakes, 1)), (int)worstUs));
+
+  OSALEventGroupDelete(&pGroup);
+  EXPECT_TRUE(pGroup == NULL);
+}
+
 #endif // OSAL_SINGLE_TASK
 
 #if !defined(OSAL_SINGLE_TASK)
@@ -733,3 +1678,200 @@ TEST_F(OSALTest, scheduler_events) {
 }
 #endif // OSAL_SINGLE_TASK
 
+
+#if defined(__linux__) && !defined(OSAL_SINGLE_TASK)
+
+typedef struct {
+  int fds[ 2 ];
+  volatile uint32_t calls;
+  volatile uint32_t bytes;
+  volatile uint32_t events;
+  volatile bool wrongLane;
+  volatile uint64_t lastUs;
+} test_reactor_data;
+
+static void test_reactor_cb(void* const pUserData, const int fd, const uint32_t events) {
+  test_reactor_data* const pData = (test_reactor_data*)pUserData;
+  pData->lastUs = osaltest_NowUs();
+  if (TS_PRIO_APP != TaskSched_GetCurrentPriority()) {
+    pData->wrongLane = true;
+  }
+  pData->events |= events;
+  // Edge triggered: read until the pipe is empty.
+  uint8_t buf[ 64 ];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    pData->bytes += (uint32_t)n;
+  }
+  EXPECT_TRUE((n < 0) && (EAGAIN == errno));
+  OSALAtomicFetchAddU32(&pData->calls, 1, OSAL_MO_RELEASE);
+}
+
+TEST_F(OSALTest, TestReactor) {
+  test_reactor_data data;
+  memset(&data, 0, sizeof(data));
+  ASSERT_EQ(0, pipe2(data.fds, O_NONBLOCK | O_CLOEXEC));
+
+  OSALReactorSrcT src;
+  ASSERT_TRUE(OSALReactorAdd(&src, data.fds[ 0 ], OSAL_REACTOR_READ, TS_PRIO_APP, test_reactor_cb, &data));
+
+  const int iterations = 200;
+  uint64_t totalUs = 0;
+  uint64_t worstUs = 0;
+  for (int i = 0; i < iterations; i++) {
+    const uint32_t calls = OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE);
+    const uint64_t t0 = osaltest_NowUs();
+    ASSERT_EQ(1, write(data.fds[ 1 ], "x", 1));
+    const uint64_t giveUpUs = t0 + 1000000;
+    while ((calls == OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE)) && (osaltest_NowUs() < giveUpUs)) {
+      OSALSleepUs(10);
+    }
+    ASSERT_NE(calls, OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE));
+    const uint64_t us = data.lastUs - t0;
+    totalUs += us;
+    worstUs = MAX(worstUs, us);
+  }
+  EXPECT_EQ((uint32_t)iterations, data.bytes);
+  EXPECT_TRUE(OSAL_REACTOR_READ & data.events);
+  EXPECT_FALSE(data.wrongLane);
+  LOG_TRACE(("Reactor write to callback: avg %d us, worst %d us\r\n",
+    (int)(totalUs / iterations), (int)worstUs));
+
+  // Remove from the source's own lane, then nothing more may be delivered.
+  static OSALReactorSrcT* pRemoveSrc;
+  static volatile bool removed;
+  pRemoveSrc = &src;
+  removed = false;
+  TaskSchedulable removeSched;
+  TaskSchedInitSched(&removeSched, [](void*, uint32_t) {
+    EXPECT_TRUE(OSALReactorRemove(pRemoveSrc));
+    removed = true;
+  }, nullptr);
+  TaskSchedAddTimerFn(TS_PRIO_APP, &removeSched, 0, 0);
+  for (int i = 0; (i < 1000) && (!removed); i++) {
+    OSALSleep(1);
+  }
+  ASSERT_TRUE(removed);
+
+  const uint32_t calls = OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE);
+  ASSERT_EQ(1, write(data.fds[ 1 ], "x", 1));
+  OSALSleep(50);
+  EXPECT_EQ(calls, OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE));
+
+  // Stopping closes the reactor; the next add starts a new one.
+  OSALReactorStop();
+  char drain[ 8 ];
+  (void)read(data.fds[ 0 ], drain, sizeof(drain));
+  ASSERT_TRUE(OSALReactorAdd(&src, data.fds[ 0 ], OSAL_REACTOR_READ, TS_PRIO_APP, test_reactor_cb, &data));
+  ASSERT_EQ(1, write(data.fds[ 1 ], "x", 1));
+  for (int i = 0; (i < 1000) && (calls == OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE)); i++) {
+    OSALSleep(1);
+  }
+  EXPECT_NE(calls, OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE));
+  removed = false;
+  TaskSchedAddTimerFn(TS_PRIO_APP, &removeSched, 0, 0);
+  for (int i = 0; (i < 1000) && (!removed); i++) {
+    OSALSleep(1);
+  }
+  ASSERT_TRUE(removed);
+  OSALReactorStop();
+
+  close(data.fds[ 0 ]);
+  close(data.fds[ 1 ]);
+}
+
+#endif // #if defined(__linux__) && !defined(OSAL_SINGLE_TASK)
+
+#if defined(__linux__) && !defined(OSAL_SINGLE_TASK)
+
+typedef struct {
+  TaskSchedulable sched;
+  int fds[ 2 ];
+  volatile uint64_t dueUs;
+  volatile uint64_t firedUs;
+  volatile uint32_t calls;
+  volatile uint32_t events;
+  volatile bool wrongLane;
+} test_sched_fd_data;
+
+TEST_F(OSALTest, scheduler_timer_and_fds) {
+  static test_sched_fd_data data;
+  data = test_sched_fd_data();
+
+  // How late do one-shot timers fire?
+  auto timerCb = [](void* p, uint32_t) {
+    test_sched_fd_data* const pData = (test_sched_fd_data*)p;
+    pData->firedUs = OSALGetUS();
+    OSALAtomicFetchAddU32(&pData->calls, 1, OSAL_MO_RELEASE);
+  };
+  TaskSchedInitSched(&data.sched, timerCb, &data);
+  const int iterations = 50;
+  uint64_t totalUs = 0;
+  uint64_t worstUs = 0;
+  for (int i = 0; i < iterations; i++) {
+    const uint32_t calls = data.calls;
+    // Deadlines are whole milliseconds.
+    data.dueUs = ((OSALGetUS() / 1000) + 3) * 1000;
+    TaskSchedAddTimerFn(TS_PRIO_APP, &data.sched, 0, 3);
+    for (int j = 0; (j < 1000) && (calls == OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE)); j++) {
+      OSALSleep(1);
+    }
+    ASSERT_NE(calls, OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE));
+    const int64_t lateUs = (int64_t)(data.firedUs - data.dueUs);
+    totalUs += MAX(lateUs, 0);
+    worstUs = MAX(worstUs, (uint64_t)MAX(lateUs, 0));
+  }
+  LOG_TRACE(("3 ms one-shot lateness: avg %d us, worst %d us\r\n",
+    (int)(totalUs / iterations), (int)worstUs));
+
+  // Descriptors serviced by the lane's own thread, if the epoll backend is built.
+  auto fdCb = [](void* p, uint32_t epollEvents) {
+    test_sched_fd_data* const pData = (test_sched_fd_data*)p;
+    if (TS_PRIO_APP != TaskSched_GetCurrentPriority()) {
+      pData->wrongLane = true;
+    }
+    pData->events |= epollEvents;
+    uint8_t buf[ 16 ];
+    while (read(pData->fds[ 0 ], buf, sizeof(buf)) > 0) {
+    }
+    OSALAtomicFetchAddU32(&pData->calls, 1, OSAL_MO_RELEASE);
+  };
+  ASSERT_EQ(0, pipe2(data.fds, O_NONBLOCK | O_CLOEXEC));
+  TaskSchedInitSched(&data.sched, fdCb, &data);
+  const bool watched = TaskSchedWatchFd(TS_PRIO_APP, &data.sched, data.fds[ 0 ], EPOLLIN);
+#if (TASKSCHED_EPOLL > 0)
+  // The osal_test_epoll build must not skip the descriptors.
+  EXPECT_TRUE(watched);
+#endif
+  if (!watched) {
+    LOG_TRACE(("TaskSchedWatchFd() needs TASKSCHED_EPOLL, skipping.\r\n"));
+  } else {
+    const uint32_t calls = data.calls;
+    ASSERT_EQ(1, write(data.fds[ 1 ], "x", 1));
+    for (int j = 0; (j < 1000) && (calls == OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE)); j++) {
+      OSALSleep(1);
+    }
+    EXPECT_NE(calls, OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE));
+    EXPECT_TRUE(EPOLLIN & data.events);
+    EXPECT_FALSE(data.wrongLane);
+
+    static volatile bool removed;
+    removed = false;
+    TaskSchedScheduleLambda(TSCHED_F_OCH_L, [](uint32_t) {
+      EXPECT_TRUE(TaskSchedUnwatchFd(TS_PRIO_APP, &data.sched, data.fds[ 0 ]));
+      removed = true;
+    }, 0, TS_PRIO_APP);
+    for (int j = 0; (j < 1000) && (!removed); j++) {
+      OSALSleep(1);
+    }
+    ASSERT_TRUE(removed);
+    const uint32_t callsAfter = OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE);
+    ASSERT_EQ(1, write(data.fds[ 1 ], "x", 1));
+    OSALSleep(20);
+    EXPECT_EQ(callsAfter, OSALAtomicLoadU32(&data.calls, OSAL_MO_ACQUIRE));
+  }
+  close(data.fds[ 0 ]);
+  close(data.fds[ 1 ]);
+}
+
+#endif // #if defined(__linux__) && !defined(OSAL_SINGLE_TASK)
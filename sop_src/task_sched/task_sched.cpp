@@ -8,8 +8,10 @@
 
 #include "task_sched/task_sched.h"
 
+#include "osal/cs_obj_locker.hpp"
 #include "osal/cs_task_locker.hpp"
 #include "osal/osal.h"
+#include "osal/osal_atomic.h"
 #include "osal/singleton_defs.hpp"
 #include "utils/helper_macros.h"
 #include "utils/platform_log.h"
@@ -53,6 +55,42 @@ extern void UiTSchedDoSchedule(const uint32_t delay);
 
 #define MAX_TASKS_PER_EXECUTION 12
 
+// Set TASKSCHED_EPOLL to 1 on Linux to have each priority's thread wait on an
+// epoll set (a timerfd for the next deadline, an eventfd for posts, and any
+// descriptors added with TaskSchedWatchFd()) rather than on a semaphore.
+// Deadlines are still whole milliseconds, as the timed lists and the
+// TaskSched API are; the timerfd only makes a lane wake on the millisecond it
+// is due instead of after epoll_wait()'s rounded up timeout.  For sub
+// millisecond waits use OSALSleepUs() or OSALSleepUntil() on a thread.
+#ifndef TASKSCHED_EPOLL
+#define TASKSCHED_EPOLL 0
+#endif
+
+#if (TASKSCHED_EPOLL > 0) && defined(__linux__) && !defined(TASKSCHED_SINGLETASK)
+#define TASKSCHED_USE_EPOLL 1
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Descriptors handled per epoll_wait().
+#define TASKSCHED_EPOLL_BATCH 16
+#else
+#define TASKSCHED_USE_EPOLL 0
+#endif
+
+// The time the timed lists run against.  With epoll the timerfd fires on the
+// nanosecond clock, so compare against that rather than a coarse OSALGetMS(),
+// otherwise a lane could wake before its deadline and find nothing to do.
+static inline uint32_t tasksched_NowMs(void) {
+#if (TASKSCHED_USE_EPOLL > 0)
+  return (uint32_t)(OSALGetNS() / 1000000);
+#else
+  return OSALGetMS();
+#endif
+}
+
 #if (TARGET_OS_ANDROID > 0) || (TARGET_OS_IOS > 0)
 extern "C" {
 void PAKP_ScheduleTaskSched(uint32_t delay);
@@ -178,6 +216,15 @@ public:
   void Enable();
   void Disable();
 
+#ifndef TASKSCHED_SINGLETASK
+  // Wakes the thread so that it polls again.
+  void Wake();
+
+  // Waits until woken or until the next timed schedulable is due
+  // (timeToNextRun ms, or forever if negative.)
+  void Wait(const int32_t timeToNextRun);
+#endif
+
   const TaskSchedPriority mPriority;
 
   uint32_t mChk;
@@ -201,18 +248,38 @@ public:
   // Current timer time.
   uint32_t mCurrentTime;
 
+  // When the head of mTimerBasedList is due, as of the last DoPoll().
+  uint32_t mNextRunTime;
+
   // These are used by the hardware ISR to awaken tasks from the interrupt.
   // These only run when "awakened" by an trigger from the ISR.
   int mInterruptEventsIdx;
   TaskSchedQueue::Element mInterruptEventsAry[ NUM_ISR_EVENTS ];
-  uint16_t mInterruptEventsPendingMask;
+  volatile uint32_t mInterruptEventsPendingMask;
 
   // "working" queue of tasks to run at the end of a single execution.
   TaskSchedQueue mQtl;
 
 #ifndef TASKSCHED_SINGLETASK
+#if (TASKSCHED_USE_EPOLL > 0)
+  int mEpollFd;
+
+  // Fires at mNextRunTime.
+  int mTimerFd;
+  bool mTimerArmed;
+  uint32_t mTimerDeadline;
+
+  // Wakes up the thread.
+  int mWakeFd;
+
+  // Results of the last epoll_wait(), and the one being dispatched.
+  struct epoll_event mFdEvents[ TASKSCHED_EPOLL_BATCH ];
+  int mNumFdEvents;
+  int mFdEventIdx;
+#else
   // Wakes up the thread.
   OSALSemaphorePtrT mpWakeyWakeySem;
+#endif
 
   OSALMutexPtrT mpMutex;
 
@@ -304,6 +371,9 @@ TaskScheduler* TaskScheduler::mInstPtr;
 // The memory to use for the singleton.
 char TaskScheduler::mInstMemAry[ sizeof(TaskScheduler) ];
 
+// Protects the scheduler lists and pending event masks of all priorities.
+static OSALCsT tasksched_Cs = OSAL_CS_INIT(false, OSAL_CS_LEVEL_TASKSCHED);
+
 #ifndef TASKSCHED_SINGLETASK
 
 OSAL_INSTANTIATE_STACK(ts_stack1, 3100, TASKCHED_BASE_TASK_ID + TS_PRIO_APP_EVENTS);
@@ -340,14 +410,14 @@ volatile bool taskSchedRunMisbehavingFunctionAgain = false;
 //
 int32_t TaskSchedPrio::DoPoll() {
   LOG_ASSERT(++mContexts == 1); // Check that this is only called from one thread.
-  mCurrentTime = OSALGetMS();
+  mCurrentTime = tasksched_NowMs();
   mQtl.clear();
 
   mIterationsCounter++;
 
   // Process the one-shots list.
   // is being accessed or if it needs to be run from the "top" scheduler
-  OSALEnterTaskCritical();
+  OSALCsEnter(&tasksched_Cs);
   DLLNode* pIter      = DLL_BeginFast(&mOneShotsList);
   DLLNode* const pEnd = DLL_EndFast(&mOneShotsList);
   while (pIter != pEnd) {
@@ -386,7 +456,7 @@ int32_t TaskSchedPrio::DoPoll() {
       PollTimed(&mTimerBasedList, mCurrentTime, mCurrentTime);
     }
   }
-  OSALExitTaskCritical();
+  OSALCsExit(&tasksched_Cs);
   LOG_ASSERT(mContexts == 1); // Check that this is only called from one thread.
 
   // Execute all of the queued tasks on this execution.
@@ -419,7 +489,8 @@ int32_t TaskSchedPrio::DoPoll() {
 
   // Return the time to next execution.
   int32_t timeToNextRun = -1;
-  CSTaskLocker cs;
+  const uint32_t now    = tasksched_NowMs();
+  CSObjLocker cs(&tasksched_Cs);
   if (!DLL_IsEmptyFast(&mOneShotsList)) {
     timeToNextRun = 0;
   } else if (!DLL_IsEmptyFast(&mIterationsBasedList)) {
@@ -427,7 +498,8 @@ int32_t TaskSchedPrio::DoPoll() {
   } else if (!DLL_IsEmptyFast(&mTimerBasedList)) {
     TaskSchedulable* const pNext =
       (TaskSchedulable*)DLL_BeginFast(&mTimerBasedList);
-    const int32_t t = pNext->nextExecutionTime - OSALGetMS();
+    const int32_t t = pNext->nextExecutionTime - now;
+    mNextRunTime    = pNext->nextExecutionTime;
     // t = MIN((((int32_t)(1u << 31) - 1)), t);
     timeToNextRun = MAX(0, t);
   }
@@ -440,14 +512,11 @@ int32_t TaskSchedPrio::DoPoll() {
 //
 void TaskSchedPrio::DoPollEvents() {
   // Poll ISR events.
-  uint16_t eventsMask = 0;
-  OSALEnterTaskCritical(); // ISR critical.
-  eventsMask                  = mInterruptEventsPendingMask;
-  mInterruptEventsPendingMask = 0;
-  OSALExitTaskCritical(); // ISR critical.
+  const uint32_t eventsMask =
+    OSALAtomicExchangeU32(&mInterruptEventsPendingMask, 0, OSAL_MO_ACQUIRE);
 
   if (0 != eventsMask) {
-    const uint32_t timestamp = OSALGetMS();
+    const uint32_t timestamp = tasksched_NowMs();
     for (size_t i = 0; i < ARRSZ(mInterruptEventsAry); i++) {
       const uint16_t bitMask = (1u << i);
       if (0 != (bitMask & eventsMask)) {
@@ -554,6 +623,10 @@ void TaskSchedPrio::PollTimed(
 ///////////////////////////////////////////////////////////////////////////////
 void TaskSchedPrio::PollTask(void* const pParam) {
   TaskSchedPrio* const pThis = (TaskSchedPrio*)pParam;
+  OSALThreadCtxT* const pCtx = OSALGetThreadCtx();
+  pCtx->pName                = pThis->mName;
+  pCtx->laneType             = OSAL_LANE_TASKSCHED;
+  pCtx->pLane                = pThis;
   while (TASK_SCHED_CHECK == pThis->mChk) {
     if (pThis->mEnabled) {
       pThis->DoPollEvents();
@@ -561,15 +634,89 @@ void TaskSchedPrio::PollTask(void* const pParam) {
       // Poll Timer events.
       const int32_t nextWaitTime = pThis->DoPoll();
 
-      const uint32_t wait =
-        (nextWaitTime < 0) ? OSAL_WAIT_INFINITE : nextWaitTime;
-      OSALSemaphoreWait(pThis->mpWakeyWakeySem, wait);
+      pThis->Wait(nextWaitTime);
     } else {
-      OSALSemaphoreWait(pThis->mpWakeyWakeySem, OSAL_WAIT_INFINITE);
+      pThis->Wait(-1);
     }
   }
+  pCtx->laneType = OSAL_LANE_NONE;
+  pCtx->pLane    = nullptr;
+}
+
+#if (TASKSCHED_USE_EPOLL > 0)
+///////////////////////////////////////////////////////////////////////////////
+void TaskSchedPrio::Wake() {
+  if (mWakeFd >= 0) {
+    const uint64_t one = 1;
+    (void)write(mWakeFd, &one, sizeof(one));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void TaskSchedPrio::Wait(const int32_t timeToNextRun) {
+  int timeout = -1;
+  if (0 == timeToNextRun) {
+    timeout = 0;
+  } else if (timeToNextRun > 0) {
+    // Arm the timer for the exact deadline, unless it already is.
+    if ((!mTimerArmed) || (mTimerDeadline != mNextRunTime)) {
+      // mNextRunTime is a wrapping millisecond count, so take the difference
+      // in 32 bits, then subtract how far into the current millisecond we are.
+      const uint64_t nowNs  = OSALGetNS();
+      const int32_t aheadMs = (int32_t)(mNextRunTime - (uint32_t)(nowNs / 1000000));
+      const int64_t ns      = ((int64_t)aheadMs * 1000000) - (int64_t)(nowNs % 1000000);
+      if (ns <= 0) {
+        timeout = 0;
+      } else {
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec  = ns / 1000000000;
+        its.it_value.tv_nsec = ns % 1000000000;
+        LOG_ASSERT_FN(0 == timerfd_settime(mTimerFd, 0, &its, NULL));
+        mTimerArmed    = true;
+        mTimerDeadline = mNextRunTime;
+      }
+    }
+  }
+
+  mNumFdEvents = epoll_wait(mEpollFd, mFdEvents, TASKSCHED_EPOLL_BATCH, timeout);
+  if (mNumFdEvents < 0) {
+    LOG_ASSERT(EINTR == errno);
+    mNumFdEvents = 0;
+  }
+  for (mFdEventIdx = 0; mFdEventIdx < mNumFdEvents; mFdEventIdx++) {
+    const struct epoll_event& ev = mFdEvents[ mFdEventIdx ];
+    uint64_t cnt;
+    if (ev.data.ptr == &mWakeFd) {
+      (void)read(mWakeFd, &cnt, sizeof(cnt));
+    } else if (ev.data.ptr == &mTimerFd) {
+      (void)read(mTimerFd, &cnt, sizeof(cnt));
+      mTimerArmed = false;
+    } else if (ev.data.ptr) {
+      // A watched descriptor.  TaskSchedUnwatchFd() clears data.ptr if it
+      // was removed by an earlier callback in this batch.
+      TaskSchedulable* const pSched = (TaskSchedulable*)ev.data.ptr;
+      pSched->pTaskFn(pSched->pUserData, ev.events);
+    }
+  }
+  mNumFdEvents = 0;
+}
+#else
+///////////////////////////////////////////////////////////////////////////////
+void TaskSchedPrio::Wake() {
+  if (mpWakeyWakeySem) {
+    OSALSemaphoreSignal(mpWakeyWakeySem, 1);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void TaskSchedPrio::Wait(const int32_t timeToNextRun) {
+  const uint32_t wait =
+    (timeToNextRun < 0) ? OSAL_WAIT_INFINITE : timeToNextRun;
+  OSALSemaphoreWait(mpWakeyWakeySem, wait);
 }
 #endif
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 void TaskSchedPrio::Enable() {
@@ -577,7 +724,7 @@ void TaskSchedPrio::Enable() {
     return;
   mEnabled = true;
 #ifndef TASKSCHED_SINGLETASK
-  OSALSemaphoreSignal(mpWakeyWakeySem, 1);
+  Wake();
 #endif
 }
 
@@ -596,12 +743,24 @@ TaskSchedPrio::TaskSchedPrio(const TaskSchedPriority prio, const char* const nam
   , mIterationsCounter(0)
   , mLastTimerProcessTime(0)
   , mCurrentTime(0)
+  , mNextRunTime(0)
   , mInterruptEventsIdx(0)
   , mInterruptEventsAry()
-  , mInterruptEventsPendingMask(false)
+  , mInterruptEventsPendingMask(0)
   , mQtl()
 #ifndef TASKSCHED_SINGLETASK
+#if (TASKSCHED_USE_EPOLL > 0)
+  , mEpollFd(-1)
+  , mTimerFd(-1)
+  , mTimerArmed(false)
+  , mTimerDeadline(0)
+  , mWakeFd(-1)
+  , mFdEvents()
+  , mNumFdEvents(0)
+  , mFdEventIdx(0)
+#else
   , mpWakeyWakeySem(NULL)
+#endif
   , mpMutex(NULL)
   , mpPollTask(NULL)
 #endif
@@ -628,9 +787,22 @@ TaskSchedPrio::TaskSchedPrio(const TaskSchedPriority prio, const char* const nam
 void TaskSchedPrio::Start() {
 #ifndef TASKSCHED_SINGLETASK
   // If it's one of the tasks, then create the semaphore and thread.
-  if ((mPriority < TS_PRIO_IDLE_TASK) && (NULL == mpWakeyWakeySem)) {
+  if ((mPriority < TS_PRIO_IDLE_TASK) && (NULL == mpPollTask)) {
     const int taskIdx = (int)mPriority;
+#if (TASKSCHED_USE_EPOLL > 0)
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    mWakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    LOG_ASSERT((mEpollFd >= 0) && (mTimerFd >= 0) && (mWakeFd >= 0));
+    struct epoll_event ev;
+    ev.events   = EPOLLIN;
+    ev.data.ptr = &mTimerFd;
+    LOG_ASSERT_FN(0 == epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTimerFd, &ev));
+    ev.data.ptr = &mWakeFd;
+    LOG_ASSERT_FN(0 == epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &ev));
+#else
     mpWakeyWakeySem   = OSALSemaphoreCreate(0, 1);
+#endif
     mpMutex           = OSALCreateMutex();
     mpPollTask        = OSALTaskCreate(
       TaskSchedPrio::PollTask, this,
@@ -644,9 +816,7 @@ void TaskSchedPrio::dtor() {
   if (TASK_SCHED_CHECK == mChk) {
     mChk = 0;
 #ifndef TASKSCHED_SINGLETASK
-    if (mpWakeyWakeySem) {
-      OSALSemaphoreSignal(mpWakeyWakeySem, 1);
-    }
+    Wake();
 #endif
   }
 }
@@ -659,9 +829,18 @@ TaskSchedPrio::~TaskSchedPrio() {
   if (mpPollTask) {
     OSALTaskDelete(&mpPollTask);
   }
+#if (TASKSCHED_USE_EPOLL > 0)
+  if (mEpollFd >= 0) {
+    close(mEpollFd);
+    close(mTimerFd);
+    close(mWakeFd);
+    mEpollFd = mTimerFd = mWakeFd = -1;
+  }
+#else
   if (mpWakeyWakeySem) {
     OSALSemaphoreDelete(&mpWakeyWakeySem);
   }
+#endif
   if (mpMutex) {
     OSALDeleteMutex(&mpMutex);
   }
@@ -756,21 +935,19 @@ void _TaskSchedAddTimerFn(
     if ((periodMs == 0) && (timeOffsetMs == 0)) {
       // Execute on next scheduler pass
       pSchedulable->executionPeriod = 0;
-      OSALEnterTaskCritical();
+      OSALCsEnter(&tasksched_Cs);
       DLL_PushBack(&sched.mOneShotsList, &pSchedulable->listNode);
       LOG_ASSERT(
         pSchedulable->listNode.pNext != &pSchedulable->listNode);
 
 #ifndef TASKSCHED_SINGLETASK
-      if (sched.mpWakeyWakeySem) {
-        if (&pSchedulable->listNode == DLL_GetFront(&sched.mOneShotsList)) {
-          OSALSemaphoreSignal(sched.mpWakeyWakeySem, 1);
-        }
+      if (&pSchedulable->listNode == DLL_GetFront(&sched.mOneShotsList)) {
+        sched.Wake();
       }
 #elif (TARGET_OS_ANDROID > 0) || (TARGET_OS_IOS > 0)
       UiTSchedDoSchedule(0);
 #endif
-      OSALExitTaskCritical();
+      OSALCsExit(&tasksched_Cs);
 
     } else {
       // Set period and next execution time, then insert on list.
@@ -778,10 +955,10 @@ void _TaskSchedAddTimerFn(
 
       pSchedulable->executionPeriod = periodMs;
 
-      pSchedulable->nextExecutionTime = OSALGetMS() + timeOffsetMs;
+      pSchedulable->nextExecutionTime = tasksched_NowMs() + timeOffsetMs;
 
       if (true) {
-        CSTaskLocker lock;
+        CSObjLocker lock(&tasksched_Cs);
         const bool inserted = DLL_SortedInsert(
           &sched.mTimerBasedList, &pSchedulable->listNode,
           TaskSchedPrio::NodeCompareCb, &sched);
@@ -808,10 +985,8 @@ void _TaskSchedAddTimerFn(
           pSchedulable->listNode.pNext != &pSchedulable->listNode);
 
 #ifndef TASKSCHED_SINGLETASK
-        if (sched.mpWakeyWakeySem) {
-          if (&pSchedulable->listNode == DLL_GetFront(&sched.mTimerBasedList)) {
-            OSALSemaphoreSignal(sched.mpWakeyWakeySem, 1);
-          }
+        if (&pSchedulable->listNode == DLL_GetFront(&sched.mTimerBasedList)) {
+          sched.Wake();
         }
 #elif (TARGET_OS_ANDROID > 0) || (TARGET_OS_IOS > 0)
         UiTSchedDoSchedule(0);
@@ -855,10 +1030,10 @@ bool TaskSchedScheduleFn(
   bool rval                          = false;
   tasksched_OneShotT* const pOneShot = (tasksched_OneShotT*)
 #if (MEMPOOLS_DEBUG_FILETRACE > 0)
-    _MemPoolsMalloc(sizeof(tasksched_OneShotT), pFile, line);
+    _MemPoolsMallocNoZero(sizeof(tasksched_OneShotT), pFile, line);
   // ts_addToMap(pFile, pSchedulable);
 #else
-    OSALMALLOC(sizeof(tasksched_OneShotT));
+    OSALMALLOC_NOZERO(sizeof(tasksched_OneShotT));
 #endif
   if (NULL != pOneShot) {
 #ifdef TASK_SCHED_DBG
@@ -867,6 +1042,8 @@ bool TaskSchedScheduleFn(
 #endif
     pOneShot->pTaskFn   = pTaskFn;
     pOneShot->pUserData = pUserData;
+    // Not zeroed, and TaskSchedInitSched() checks that the node is unlisted.
+    pOneShot->sched.listNode.pNext = pOneShot->sched.listNode.pPrev = NULL;
     TaskSchedInitSched(&pOneShot->sched, tasksched_ScheduleFnCb, pOneShot);
     _TaskSchedAddTimerFn(prio, &pOneShot->sched, 0, timeOffsetMs, pFile, line);
     rval = true;
@@ -934,12 +1111,20 @@ TaskSchedPriority TaskSched_GetCurrentPriority(void) {
   TaskSchedPriority rval = TS_PRIO_IDLE_TASK;
 #ifdef TASKSCHED_SINGLETASK
 #else
-  const uint32_t taskId = OSALGetCurrentTaskID();
-  const int32_t id      = taskId - TASKCHED_BASE_TASK_ID;
-  if ((id >= 0) && (id < TS_PRIO_IDLE_TASK)) {
-    rval = (TaskSchedPriority)id;
+  // Scheduler threads record their lane when they start.
+  const OSALThreadCtxT* const pCtx = OSALGetThreadCtx();
+  if (OSAL_LANE_TASKSCHED == pCtx->laneType) {
+    const TaskSchedPrio* const pLane = (const TaskSchedPrio*)pCtx->pLane;
+    LOG_ASSERT((pLane) && (TASK_SCHED_CHECK == pLane->mChk));
+    rval = pLane->mPriority;
   } else {
-    rval = TS_PRIO_IDLE_TASK;
+    const uint32_t taskId = OSALGetCurrentTaskID();
+    const int32_t id      = taskId - TASKCHED_BASE_TASK_ID;
+    if ((id >= 0) && (id < TS_PRIO_IDLE_TASK)) {
+      rval = (TaskSchedPriority)id;
+    } else {
+      rval = TS_PRIO_IDLE_TASK;
+    }
   }
 #endif
   return rval;
@@ -978,9 +1163,9 @@ void TaskSchedAddIdlePollerFn(TaskSchedulable* const pSchedulable, const uint32_
     LOG_ASSERT(((int)iterationsBetweenPolls) > 0);
     if (iterationsBetweenPolls <= 1) {
       pSchedulable->executionPeriod = 1;
-      OSALEnterTaskCritical();
+      OSALCsEnter(&tasksched_Cs);
       DLL_PushBack(&sched.mOneShotsList, &pSchedulable->listNode);
-      OSALExitTaskCritical();
+      OSALCsExit(&tasksched_Cs);
     } else {
       // Otherwise insert on the iterations list.
       pSchedulable->executionPeriod = iterationsBetweenPolls;
@@ -988,14 +1173,14 @@ void TaskSchedAddIdlePollerFn(TaskSchedulable* const pSchedulable, const uint32_
       pSchedulable->nextExecutionTime =
         sched.mIterationsCounter + iterationsBetweenPolls;
 
-      OSALEnterTaskCritical();
+      OSALCsEnter(&tasksched_Cs);
       DLL_SortedInsert(
         &sched.mIterationsBasedList, &pSchedulable->listNode,
         TaskSchedPrio::NodeCompareCb, &sched);
       LOG_ASSERT(
         pSchedulable->listNode.pNext != &pSchedulable->listNode);
 
-      OSALExitTaskCritical();
+      OSALCsExit(&tasksched_Cs);
     }
   }
 }
@@ -1018,7 +1203,7 @@ TaskSchedEventTrigger _TaskSchedAddEventFn(
   TaskSchedPrio& sched = TaskScheduler::inst().getScheduler(prio);
   TaskSchedEventTrigger evtTrigger = (((uint32_t)prio) << 16) | 0x80000000u;
 
-  OSALEnterTaskCritical(); // ISR Critical!
+  OSALCsEnter(&tasksched_Cs); // ISR Critical!
 
   if (sched.mInterruptEventsIdx < NUM_ISR_EVENTS) {
     TaskSchedQueue::Element* pTs = NULL;
@@ -1051,7 +1236,7 @@ TaskSchedEventTrigger _TaskSchedAddEventFn(
   } else {
     evtTrigger = 0;
   }
-  OSALExitTaskCritical(); // ISR Critical!
+  OSALCsExit(&tasksched_Cs); // ISR Critical!
 
   return evtTrigger;
 }
@@ -1066,10 +1251,8 @@ void TaskSchedTriggerEvent(const TaskSchedEventTrigger evtTrigger) {
   TaskSchedPrio& sched  = inst.getScheduler(prio);
   // evtlog_AllocEvent(inst.mpIsrFact, "evt trigger", "non-isr", 0, prio);
 #ifndef TASKSCHED_SINGLETASK
-  OSALEnterTaskCritical();
-  sched.mInterruptEventsPendingMask |= (1u << evtIdx);
-  OSALSemaphoreSignal(sched.mpWakeyWakeySem, 1);
-  OSALExitTaskCritical();
+  OSALAtomicFetchOrU32(&sched.mInterruptEventsPendingMask, (1u << evtIdx), OSAL_MO_RELEASE);
+  sched.Wake();
 #else
   sched.mInterruptEventsPendingMask |= (1u << evtIdx);
   sched.mInterruptEventsAry[ evtIdx ].pTaskFn(
@@ -1085,8 +1268,10 @@ void TaskSchedTriggerEventFromIsr(const TaskSchedEventTrigger evtTrigger) {
     (TaskSchedPriority)((evtTrigger >> 16) & 0x7fff);
   const uint16_t evtIdx = (evtTrigger >> 0) & 0xffff;
   TaskSchedPrio& sched = TaskScheduler::inst().getScheduler(prio);
-  sched.mInterruptEventsPendingMask |= (1u << evtIdx);
-#ifndef TASKSCHED_SINGLETASK
+  OSALAtomicFetchOrU32(&sched.mInterruptEventsPendingMask, (1u << evtIdx), OSAL_MO_RELEASE);
+#if (TASKSCHED_USE_EPOLL > 0)
+  sched.Wake();
+#elif !defined(TASKSCHED_SINGLETASK)
   OSALSemaphoreSignalFromIsr(sched.mpWakeyWakeySem, 1);
 #endif
   // evtlog_AllocEventFromIsr(inst.mpIsrFact, "isr trigger", 0, prio);
@@ -1098,13 +1283,13 @@ void TaskSchedTriggerEventFromIsr(const TaskSchedEventTrigger evtTrigger) {
 ///////////////////////////////////////////////////////////////////////////////
 //
 bool TaskSchedCancel(TaskSchedulable* const pSchedulable) {
-  OSALEnterTaskCritical();
+  OSALCsEnter(&tasksched_Cs);
   const bool isInAList = TaskSchedIsScheduled(pSchedulable);
   if (isInAList) {
     DLL_NodeUnlist(&pSchedulable->listNode);
   }
   LOG_ASSERT(pSchedulable->listNode.pNext == NULL);
-  OSALExitTaskCritical();
+  OSALCsExit(&tasksched_Cs);
 
   return isInAList;
 }
@@ -1116,7 +1301,7 @@ bool TaskSchedCancelScheduledTask(TaskSchedulable* const pSchedulable) {
   if (
     (pSchedulable) && (pSchedulable->listNode.pPrev) &&
     (pSchedulable->listNode.pNext)) {
-    OSALEnterTaskCritical();
+    OSALCsEnter(&tasksched_Cs);
     if (pSchedulable->listNode.pPrev) {
       DLL_NodeUnlist(&pSchedulable->listNode);
       rval = true;
@@ -1124,8 +1309,55 @@ bool TaskSchedCancelScheduledTask(TaskSchedulable* const pSchedulable) {
     LOG_ASSERT(
       (pSchedulable->listNode.pNext == NULL) ||
       (pSchedulable->listNode.pNext == &pSchedulable->listNode));
-    OSALExitTaskCritical();
+    OSALCsExit(&tasksched_Cs);
+  }
+  return rval;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+bool TaskSchedWatchFd(
+  const TaskSchedPriority prio, TaskSchedulable* const pSchedulable,
+  const int fd, const uint32_t epollEvents) {
+  LOG_ASSERT((NULL != pSchedulable) && (NULL != pSchedulable->pTaskFn));
+  bool rval = false;
+#if (TASKSCHED_USE_EPOLL > 0)
+  TaskSchedPrio& sched = TaskScheduler::inst().getScheduler(prio);
+  if (sched.mEpollFd >= 0) {
+    struct epoll_event ev;
+    ev.events   = epollEvents | EPOLLET;
+    ev.data.ptr = pSchedulable;
+    rval        = (0 == epoll_ctl(sched.mEpollFd, EPOLL_CTL_ADD, fd, &ev));
   }
+#else
+  (void)prio;
+  (void)fd;
+  (void)epollEvents;
+#endif
+  return rval;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+bool TaskSchedUnwatchFd(
+  const TaskSchedPriority prio, TaskSchedulable* const pSchedulable, const int fd) {
+  bool rval = false;
+#if (TASKSCHED_USE_EPOLL > 0)
+  TaskSchedPrio& sched = TaskScheduler::inst().getScheduler(prio);
+  if (sched.mEpollFd >= 0) {
+    rval = (0 == epoll_ctl(sched.mEpollFd, EPOLL_CTL_DEL, fd, NULL));
+    // Drop it from the rest of the batch being dispatched.
+    for (int i = sched.mFdEventIdx + 1; i < sched.mNumFdEvents; i++) {
+      if (sched.mFdEvents[ i ].data.ptr == pSchedulable) {
+        sched.mFdEvents[ i ].data.ptr = NULL;
+      }
+    }
+  }
+#else
+  (void)prio;
+  (void)pSchedulable;
+  (void)fd;
+#endif
   return rval;
 }
 
@@ -1135,7 +1367,7 @@ bool TaskSchedIsScheduled(const TaskSchedulable* const pSchedulable) {
   bool isScheduled = false;
   if (pSchedulable != NULL) {
     TaskScheduler& ts = TaskScheduler::inst();
-    OSALEnterTaskCritical();
+    OSALCsEnter(&tasksched_Cs);
     for (int i = 0; (!isScheduled) && (i < TS_NUM_PRIORITIES); i++) {
       const TaskSchedPriority prio = (TaskSchedPriority)i;
       TaskSchedPrio& sched         = ts.getScheduler(prio);
@@ -1150,7 +1382,7 @@ bool TaskSchedIsScheduled(const TaskSchedulable* const pSchedulable) {
           &sched.mIterationsBasedList, &pSchedulable->listNode);
       }
     }
-    OSALExitTaskCritical();
+    OSALCsExit(&tasksched_Cs);
   }
   return isScheduled;
 }
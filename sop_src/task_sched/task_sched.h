@@ -202,6 +202,24 @@ bool TaskSchedCancel(TaskSchedulable* const pSchedulable);
 */
 bool TaskSchedCancelScheduledTask(TaskSchedulable* const pSchedulable);
 
+/*
+  Runs pSchedulable from prio's own thread whenever fd becomes ready for
+  epollEvents (EPOLLIN, EPOLLOUT, ...) without an extra I/O thread.  The
+  descriptor is edge triggered, and the callback's second argument is the
+  EPOLL* bits seen rather than the time.
+  Needs the Linux epoll backend (TASKSCHED_EPOLL); returns false otherwise.
+*/
+bool TaskSchedWatchFd(
+  const TaskSchedPriority prio, TaskSchedulable* const pSchedulable,
+  const int fd, const uint32_t epollEvents);
+
+/*
+  Stops watching fd.  Call from prio's own context; pSchedulable will not be
+  called again for fd once this returns.
+*/
+bool TaskSchedUnwatchFd(
+  const TaskSchedPriority prio, TaskSchedulable* const pSchedulable, const int fd);
+
 /*
   Returns TRUE if the task is scheduled (a fast function
   that just checks the node pointer.)
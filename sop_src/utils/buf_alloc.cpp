@@ -61,3 +61,40 @@ BufAlloc::ba_t *BufAlloc::MallocWords(const size_t numWords) {
   LOG_ASSERT(rval);
   return rval;
 }
+
+// //////////////////////////////////////////////////////////////////////////
+// Do a MALLOC aligned to align bytes (a power of two.)  Returns NULL,
+// without asserting, if it does not fit.
+void *BufAlloc::TryMalloc(const size_t bytes, const size_t align) {
+  LOG_ASSERT((align > 0) && (0 == (align & (align - 1))));
+  const size_t wordsToAlloc = (bytes + sizeof(ba_t) - 1) / sizeof(ba_t);
+  // Words to skip to reach the alignment.
+  const uintptr_t addr = (uintptr_t)&mpWordBufAry[mBufIdx];
+  const size_t padWords =
+      (((addr + align - 1) & ~(uintptr_t)(align - 1)) - addr) / sizeof(ba_t);
+  void *rval = NULL;
+  if ((padWords + wordsToAlloc) <= AvailWords()) {
+    rval = &mpWordBufAry[mBufIdx + padWords];
+    mBufIdx += (int)(padWords + wordsToAlloc);
+  }
+  return rval;
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Gets the allocation index, for Rewind()
+int BufAlloc::GetIdx() const { return mBufIdx; }
+
+// //////////////////////////////////////////////////////////////////////////
+// Deallocates everything allocated since GetIdx() returned idx.
+void BufAlloc::Rewind(const int idx) {
+  LOG_ASSERT((idx >= 0) && (idx <= mBufIdx));
+  mBufIdx = idx;
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Gets the start of the buffer
+BufAlloc::ba_t *BufAlloc::GetBufPtr() const { return mpWordBufAry; }
+
+// //////////////////////////////////////////////////////////////////////////
+// Gets the size of the buffer in words
+int BufAlloc::GetLenWords() const { return mBufLenWords; }
@@ -50,6 +50,27 @@ public:
   // //////////////////////////////////////////////////////////////////////////
   // Do a MALLOC from the buffer (use number of 64-bit words.)
   ba_t *MallocWords(const size_t numWords);
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Do a MALLOC aligned to align bytes (a power of two.)  Returns NULL,
+  // without asserting, if it does not fit.
+  void *TryMalloc(const size_t bytes, const size_t align = sizeof(ba_t));
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Gets the allocation index, for Rewind()
+  int GetIdx() const;
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Deallocates everything allocated since GetIdx() returned idx.
+  void Rewind(const int idx);
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Gets the start of the buffer
+  ba_t *GetBufPtr() const;
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Gets the size of the buffer in words
+  int GetLenWords() const;
 };
 
 #endif // #ifdef __cplusplus
@@ -9,61 +9,105 @@ without the express written permission of the author.
 #include "byteq.h"
 
 #include "osal/osal.h"
+#include "osal/osal_atomic.h"
 #include "utils/helper_macros.h"
 #include "utils/platform_log.h"
 
 #include <stdint.h>
 #include <string.h>
 
+#if (BYTEQ_MIRROR > 0)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 
 LOG_MODNAME("byteq.cpp")
 
 // Circular buffering. Note, kinda unsafe - don't write more than the buffer size at once.
+// Power of two buffers wrap with a mask.
 template <typename T1, typename T2>
-void inc_buf_idx(T1& idx, const T2 bufSz, const T2 nBytes) {
-  idx += nBytes;
-  if (idx >= bufSz) {
-    idx -= bufSz;
+static inline void inc_buf_idx(const ByteQ_t* const pQ, T1& idx, const T2 nBytes) {
+  if (pQ->nMask) {
+    idx = (idx + nBytes) & pQ->nMask;
+  }
+  else {
+    idx += nBytes;
+    if (idx >= (T1)pQ->nBufSz) {
+      idx -= pQ->nBufSz;
+    }
   }
-  LOG_ASSERT(idx < bufSz);
+  LOG_ASSERT(idx < (T1)pQ->nBufSz);
+}
+
+// Contiguous bytes from idx to the end of the buffer.  A mirrored buffer
+// continues into its second mapping, so a whole buffer's worth always is.
+static inline unsigned int to_end(const ByteQ_t* const pQ, const unsigned int idx) {
+  return (pQ->mirrored) ? pQ->nBufSz : (pQ->nBufSz - idx);
 }
 
 static inline void rd_enter_critical(ByteQ_t* const pQ) {
   if (pQ->rdCntProt) {
-    OSALEnterCritical();
+    OSALCsEnter(&pQ->cs);
   }
 }
 
 static inline void rd_exit_critical(ByteQ_t* const pQ) {
   if (pQ->rdCntProt) {
-    OSALExitCritical();
+    OSALCsExit(&pQ->cs);
   }
 }
 
 static inline void wr_enter_critical(ByteQ_t* const pQ) {
   if (pQ->wrCntProt) {
-    OSALEnterCritical();
+    OSALCsEnter(&pQ->cs);
   }
 }
 
 static inline void wr_exit_critical(ByteQ_t* const pQ) {
   if (pQ->wrCntProt) {
-    OSALExitCritical();
+    OSALCsExit(&pQ->cs);
   }
 }
 
 static inline void rdwr_enter_critical(ByteQ_t* const pQ) {
   if ((pQ->wrCntProt) || (pQ->rdCntProt)) {
-    OSALEnterCritical();
+    OSALCsEnter(&pQ->cs);
   }
 }
 
 static inline void rdwr_exit_critical(ByteQ_t* const pQ) {
   if ((pQ->wrCntProt) || (pQ->rdCntProt)) {
-    OSALExitCritical();
+    OSALCsExit(&pQ->cs);
   }
 }
 
+//-------------------------------------------------------------------------------------------------
+// SPSC mode: each side reads the other side's index with acquire, so that the bytes behind it are
+// visible, and publishes its own index with release once its copy is done.
+static inline unsigned int spsc_load(const unsigned int* const pIdx) {
+  return OSALAtomicLoadU32((const volatile uint32_t*)pIdx, OSAL_MO_ACQUIRE);
+}
+
+static inline void spsc_store(unsigned int* const pIdx, const unsigned int idx) {
+  OSALAtomicStoreU32((volatile uint32_t*)pIdx, idx, OSAL_MO_RELEASE);
+}
+
+static inline unsigned int spsc_count(const ByteQ_t* const pQ, const unsigned int wr, const unsigned int rd) {
+  return (wr >= rd) ? (wr - rd) : (wr + pQ->nBufSz - rd);
+}
+
+// Bytes the reader can read.  Call from the reader.
+static inline unsigned int rd_count(const ByteQ_t* const pQ) {
+  return (pQ->spsc) ? spsc_count(pQ, spsc_load(&pQ->nWrIdx), pQ->nRdIdx) : pQ->nCount;
+}
+
+// Bytes the writer can write.  Call from the writer.
+static inline unsigned int wr_space(const ByteQ_t* const pQ) {
+  return (pQ->spsc) ? (pQ->nBufSz - 1 - spsc_count(pQ, pQ->nWrIdx, spsc_load(&pQ->nRdIdx)))
+                    : (pQ->nBufSz - pQ->nCount);
+}
+
 //-------------------------------------------------------------------------------------------------
 // Public function to initialize the ByteQ_t structure.
 bool ByteQCreate(
@@ -75,17 +119,84 @@ bool ByteQCreate(
 
   pQ->pfBuf  = pBuf;
   pQ->nBufSz = nBufSz;
+  pQ->nMask  = ((nBufSz > 0) && (0 == (nBufSz & (nBufSz - 1)))) ? (nBufSz - 1) : 0;
 
   pQ->wrCntProt = lockOnWrites;
   pQ->rdCntProt = lockOnReads;
+  OSALCsInit(&pQ->cs, true, OSAL_CS_LEVEL_BYTEQ);
+
+  return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Initialize a queue with one writer and one reader and no locks.
+bool ByteQCreateSpsc(ByteQ_t* const pQ, bq_t* pBuf, unsigned int nBufSz) {
+  LOG_ASSERT(sizeof(unsigned int) == sizeof(uint32_t));
+  LOG_ASSERT(nBufSz > 1);
+  ByteQCreate(pQ, pBuf, nBufSz, false, false);
+  pQ->spsc = true;
+  return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Initialize a queue over a memfd that is mapped twice, back to back.
+bool ByteQCreateMirrored(
+  ByteQ_t* const pQ, unsigned int nBufSz,
+  bool lockOnWrites, bool lockOnReads) {
+  LOG_ASSERT(nullptr != pQ);
+#if (BYTEQ_MIRROR > 0)
+  const unsigned int pageSz = (unsigned int)sysconf(_SC_PAGESIZE);
+  nBufSz = ((MAX(nBufSz, 1u) + pageSz - 1) / pageSz) * pageSz;
+
+  const int fd = memfd_create("byteq", MFD_CLOEXEC);
+  if (fd < 0) {
+    LOG_WARNING(("memfd_create failed for a mirrored ByteQ\r\n"));
+    return false;
+  }
+
+  // Reserve both halves, then map the file over each.
+  uint8_t* pMap = (uint8_t*)MAP_FAILED;
+  if (0 == ftruncate(fd, nBufSz)) {
+    pMap = (uint8_t*)mmap(nullptr, 2 * nBufSz, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((uint8_t*)MAP_FAILED != pMap) {
+      const int prot  = PROT_READ | PROT_WRITE;
+      const int flags = MAP_SHARED | MAP_FIXED;
+      if ((pMap != mmap(pMap, nBufSz, prot, flags, fd, 0)) ||
+          (pMap + nBufSz != mmap(pMap + nBufSz, nBufSz, prot, flags, fd, 0))) {
+        munmap(pMap, 2 * nBufSz);
+        pMap = (uint8_t*)MAP_FAILED;
+      }
+    }
+  }
+  close(fd);
+
+  if ((uint8_t*)MAP_FAILED == pMap) {
+    LOG_WARNING(("Cannot map %u bytes twice for a mirrored ByteQ\r\n", nBufSz));
+    return false;
+  }
 
+  ByteQCreate(pQ, pMap, nBufSz, lockOnWrites, lockOnReads);
+  pQ->mirrored = true;
   return true;
+#else
+  (void)nBufSz;
+  (void)lockOnWrites;
+  (void)lockOnReads;
+  return false;
+#endif
 }
 
 //-------------------------------------------------------------------------------------------------
 // Deallocate the things in the Q that were allocated.
 bool ByteQDestroy(ByteQ_t* const pQ) {
   LOG_ASSERT(nullptr != pQ);
+#if (BYTEQ_MIRROR > 0)
+  if (pQ->mirrored) {
+    munmap(pQ->pfBuf, 2 * pQ->nBufSz);
+    pQ->pfBuf    = nullptr;
+    pQ->mirrored = false;
+  }
+#endif
   return true;
 }
 
@@ -105,12 +216,12 @@ static unsigned int ByteQUnprotectedInsert(
 
     auto bytesToWrite = nLen;
     while (bytesToWrite > 0) {
-      auto bytes = MIN(bytesToWrite, (nBufSz - nWrIdx));
+      auto bytes = MIN(bytesToWrite, to_end(pQ, nWrIdx));
 
       memcpy(&pBuf[ nWrIdx ], &pWrBuf[ bytesWritten ], bytes * sizeof(bq_t));
 
       //  Circular buffering. Note, kinda unsafe - don't write more than buffer size.
-      inc_buf_idx(nWrIdx, nBufSz, bytes);
+      inc_buf_idx(pQ, nWrIdx, bytes);
 
       // Increment the number of bytes written.
       bytesWritten += bytes;
@@ -139,33 +250,39 @@ unsigned int
 
     LOG_ASSERT(pQ->nWrIdx < nBufSz);
 
-    auto toWrite = (nLen <= (nBufSz - pQ->nCount)) ? nLen : 0;
+    auto toWrite = (nLen <= wr_space(pQ)) ? nLen : 0;
 
     // We can definitely read BytesToWrite bytes.
     while (toWrite > 0) {
       // Calculate how many contiguous bytes to the end of the buffer
-      auto nBytes = MIN(toWrite, (nBufSz - nWrIdx));
+      auto nBytes = MIN(toWrite, to_end(pQ, nWrIdx));
 
       // Copy that many bytes.
       memcpy(&pBuf[ nWrIdx ], &pWrBuf[ bytesWritten ], nBytes * sizeof(bq_t));
 
       //  Circular buffering. Note, kinda unsafe - don't write more than buffer size.
-      inc_buf_idx(nWrIdx, nBufSz, nBytes);
+      inc_buf_idx(pQ, nWrIdx, nBytes);
 
       // Increment the number of bytes written.
       bytesWritten += nBytes;
       toWrite -= nBytes;
     }
 
-    pQ->nWrIdx = nWrIdx;
-
-    // Increment the count.  (protect with mutex)
-    if (pQ->wrCntProt) {
-      OSALEnterCritical();
+    if (pQ->spsc) {
+      // Publish the bytes to the reader.
+      spsc_store(&pQ->nWrIdx, nWrIdx);
     }
-    pQ->nCount = pQ->nCount + bytesWritten;
-    if (pQ->wrCntProt) {
-      OSALExitCritical();
+    else {
+      pQ->nWrIdx = nWrIdx;
+
+      // Increment the count.  (protect with mutex)
+      if (pQ->wrCntProt) {
+        OSALCsEnter(&pQ->cs);
+      }
+      pQ->nCount = pQ->nCount + bytesWritten;
+      if (pQ->wrCntProt) {
+        OSALCsExit(&pQ->cs);
+      }
     }
   }
   return bytesWritten;
@@ -181,20 +298,28 @@ unsigned int ByteQCommitWrite(ByteQ_t* const pQ, const unsigned int nLen) {
   if (nLen) {
     LOG_ASSERT(pQ->nWrIdx < pQ->nBufSz);
 
+    if (pQ->spsc) {
+      LOG_ASSERT(nLen <= wr_space(pQ));
+      auto nWrIdx = pQ->nWrIdx;
+      inc_buf_idx(pQ, nWrIdx, nLen);
+      spsc_store(&pQ->nWrIdx, nWrIdx);
+      return nLen;
+    }
+
     //  Circular buffering. Note, kinda unsafe - don't write more than buffer size.
-    inc_buf_idx(pQ->nWrIdx, pQ->nBufSz, nLen);
+    inc_buf_idx(pQ, pQ->nWrIdx, nLen);
 
     // Increment the number of bytes written.
     bytesWritten += nLen;
 
     // Increment the count.  (protect with mutex)
     if (pQ->wrCntProt) {
-      OSALEnterCritical();
+      OSALCsEnter(&pQ->cs);
     }
     pQ->nCount = pQ->nCount + nLen;
     LOG_ASSERT(pQ->nCount <= pQ->nBufSz);
     if (pQ->wrCntProt) {
-      OSALExitCritical();
+      OSALCsExit(&pQ->cs);
     }
   }
   return bytesWritten;
@@ -218,30 +343,36 @@ unsigned int ByteQRead(ByteQ_t* const pQ, bq_t* pRdBuf, unsigned int nLen) {
     // No count MUTEX needed because count is native integer (single cycle write
     // or read)
     // and can only get larger if a process writes while we are reading.
-    auto toRead = MIN(pQ->nCount, nLen);
+    auto toRead = MIN(rd_count(pQ), nLen);
 
     // We can definitely read BytesToRead bytes.
     while (toRead > 0) {
       // Calculate how many contiguous bytes to the end of the buffer
-      const auto nBytes = MIN(toRead, (nBufSz - nRdIdx));
+      const auto nBytes = MIN(toRead, to_end(pQ, nRdIdx));
 
       // Copy that many bytes.
       memcpy(&pRdBuf[ bytesRead ], &pBuf[ nRdIdx ], nBytes * sizeof(bq_t));
 
       //  Circular buffering. Note, kinda unsafe - don't write more than buffer size.
-      inc_buf_idx(nRdIdx, nBufSz, nBytes);
+      inc_buf_idx(pQ, nRdIdx, nBytes);
 
       // Increment the number of bytes read.
       bytesRead += nBytes;
       toRead -= nBytes;
     }
 
-    pQ->nRdIdx = nRdIdx;
+    if (pQ->spsc) {
+      // Hand the space back to the writer.
+      spsc_store(&pQ->nRdIdx, nRdIdx);
+    }
+    else {
+      pQ->nRdIdx = nRdIdx;
 
-    // Decrement the count.
-    rd_enter_critical(pQ);
-    pQ->nCount = pQ->nCount - bytesRead;
-    rd_exit_critical(pQ);
+      // Decrement the count.
+      rd_enter_critical(pQ);
+      pQ->nCount = pQ->nCount - bytesRead;
+      rd_exit_critical(pQ);
+    }
   }
   return bytesRead;
 }
@@ -258,10 +389,17 @@ unsigned int ByteQCommitRead(ByteQ_t* const pQ, const unsigned int nLen) {
     // No count MUTEX needed because count is native integer (single cycle write
     // or read)
     // and can only get larger if a process writes while we are reading.
-    const auto nBytes = MIN(pQ->nCount, nLen);
+    const auto nBytes = MIN(rd_count(pQ), nLen);
+
+    if (pQ->spsc) {
+      auto nRdIdx = pQ->nRdIdx;
+      inc_buf_idx(pQ, nRdIdx, nBytes);
+      spsc_store(&pQ->nRdIdx, nRdIdx);
+      return nBytes;
+    }
 
     //  Circular buffering. Note, kinda unsafe - don't write more than buffer size.
-    inc_buf_idx(pQ->nRdIdx, pQ->nBufSz, nBytes);
+    inc_buf_idx(pQ, pQ->nRdIdx, nBytes);
 
     // Increment the number of bytes read.
     bytesRead += nBytes;
@@ -279,13 +417,13 @@ unsigned int ByteQGetWriteReady(ByteQ_t* const pQ) {
   LOG_ASSERT(nullptr != pQ);
 
   if (pQ->wrCntProt) {
-    OSALEnterCritical();
+    OSALCsEnter(&pQ->cs);
   }
 
-  const unsigned int rval = (pQ->nBufSz - pQ->nCount);
+  const unsigned int rval = wr_space(pQ);
 
   if (pQ->wrCntProt) {
-    OSALExitCritical();
+    OSALCsExit(&pQ->cs);
   }
 
   return rval;
@@ -297,8 +435,8 @@ unsigned int ByteQGetContiguousWriteReady(ByteQ_t* const pQ) {
   LOG_ASSERT(nullptr != pQ);
 
   wr_enter_critical(pQ);
-  unsigned int bytesReady = (pQ->nBufSz - pQ->nCount);
-  bytesReady = MIN(bytesReady, pQ->nBufSz - pQ->nWrIdx);
+  unsigned int bytesReady = wr_space(pQ);
+  bytesReady = MIN(bytesReady, to_end(pQ, pQ->nWrIdx));
   wr_exit_critical(pQ);
 
   return bytesReady;
@@ -309,7 +447,7 @@ unsigned int ByteQGetReadReady(ByteQ_t* const pQ) {
   LOG_ASSERT(nullptr != pQ);
 
   rd_enter_critical(pQ);
-  const unsigned int bytesReady = pQ->nCount;
+  const unsigned int bytesReady = rd_count(pQ);
   rd_exit_critical(pQ);
 
   return bytesReady;
@@ -321,7 +459,7 @@ unsigned int ByteQGetContiguousReadReady(ByteQ_t* const pQ) {
 
   rd_enter_critical(pQ);
   const unsigned int bytesReady =
-    MIN(pQ->nCount, pQ->nBufSz - pQ->nRdIdx);
+    MIN(rd_count(pQ), to_end(pQ, pQ->nRdIdx));
   rd_exit_critical(pQ);
 
   return bytesReady;
@@ -334,6 +472,12 @@ void ByteQFlush(ByteQ_t* const pQ) {
 
   LOG_ASSERT(nullptr != pQ);
 
+  if (pQ->spsc) {
+    // The reader discards everything written so far.
+    spsc_store(&pQ->nRdIdx, spsc_load(&pQ->nWrIdx));
+    return;
+  }
+
   rdwr_enter_critical(pQ);
   pQ->nCount = 0;
   pQ->nRdIdx = pQ->nWrIdx = 0;
@@ -350,20 +494,20 @@ unsigned int ByteQPeek(ByteQ_t* const pQ, bq_t* pRdBuf, const unsigned int nLen)
     auto nRdIdx = pQ->nRdIdx;
 
     // Calculate how many bytes can be read from the RdBuffer.
-    auto bytesToRead = MIN(pQ->nCount, nLen);
+    auto bytesToRead = MIN(rd_count(pQ), nLen);
 
     LOG_ASSERT(nRdIdx < pQ->nBufSz);
 
     // We can definitely read BytesToRead bytes.
     while (bytesToRead > 0) {
       // Calculate how many contiguous bytes to the end of the buffer
-      const auto nBytes = MIN(bytesToRead, (pQ->nBufSz - nRdIdx));
+      const auto nBytes = MIN(bytesToRead, to_end(pQ, nRdIdx));
 
       // Copy that many bytes.
       memcpy(&pRdBuf[ bytesRead ], &pQ->pfBuf[ nRdIdx ], nBytes * sizeof(bq_t));
 
       //  Circular buffering. Note, kinda unsafe - don't write more than buffer size.
-      inc_buf_idx(nRdIdx, pQ->nBufSz, nBytes);
+      inc_buf_idx(pQ, nRdIdx, nBytes);
 
       // Increment the number of bytes read.
       bytesRead += nBytes;
@@ -408,12 +552,20 @@ void ByteQSetRdIdxFromPointer(ByteQ_t* const pQ, void* pRdPtr) {
   // Force int here because we want this to be signed.
   intptr_t newRdIdx = pRd8 - pQ->pfBuf;
 
-  // Check for within range.
-  if ((newRdIdx >= 0) && (newRdIdx <= (int)pQ->nBufSz)) {
+  // Check for within range.  A mirrored buffer can be read up to the end
+  // of its second mapping.
+  const intptr_t maxRdIdx = (pQ->mirrored) ? (2 * pQ->nBufSz) : pQ->nBufSz;
+  if ((newRdIdx >= 0) && (newRdIdx <= maxRdIdx)) {
     // If last read advanced pointer to end of buffer,
     // this is OK, just set to beginning.
-    if (newRdIdx == (int)pQ->nBufSz) {
-      newRdIdx = 0;
+    if (newRdIdx >= (int)pQ->nBufSz) {
+      newRdIdx -= pQ->nBufSz;
+    }
+
+    if (pQ->spsc) {
+      spsc_store(&pQ->nRdIdx, (unsigned int)newRdIdx);
+      rd_exit_critical(pQ);
+      return;
     }
 
     // New count is amount write is ahead of read.
@@ -439,6 +591,7 @@ unsigned int
   ByteQForceWrite(ByteQ_t* const pQ, const bq_t* const pWrBuf, unsigned int nLen) {
   unsigned int bytes = 0;
   LOG_ASSERT(nullptr != pQ);
+  LOG_ASSERT(!pQ->spsc);
 
   if (nLen) {
     unsigned int newWrIdx = 0;
@@ -479,6 +632,7 @@ unsigned int
 unsigned int ByteQForceWriteUnprotected(
   ByteQ_t* const pQ, const bq_t* const pWrBuf, const int nLen) {
   LOG_ASSERT(NULL != pQ);
+  LOG_ASSERT(!pQ->spsc);
 
   if (nLen > 0) {
     // Advance read pointer if the buffer is full.
@@ -499,12 +653,12 @@ unsigned int ByteQForceWriteUnprotected(
       int remaining = nLen;
       int written   = 0;
       while (remaining > 0) {
-        const int contig = pQ->nBufSz - pQ->nWrIdx;
+        const int contig = to_end(pQ, pQ->nWrIdx);
         const int bytes  = MIN(remaining, contig);
 
         memcpy(&pQ->pfBuf[ pQ->nWrIdx ], &pWrBuf[ written ], bytes);
 
-        // inc_buf_idx(pQ->nWrIdx, pQ->nBufSz, bytes);
+        // inc_buf_idx(pQ, pQ->nWrIdx, bytes);
         pQ->nWrIdx += bytes;
         if (pQ->nWrIdx >= pQ->nBufSz) {
           pQ->nWrIdx -= pQ->nBufSz;
@@ -523,6 +677,7 @@ unsigned int ByteQForceWriteUnprotected(
 unsigned int ByteQForceCommitWrite(ByteQ_t* const pQ, unsigned int nLen) {
   unsigned int bytes = 0;
   LOG_ASSERT(nullptr != pQ);
+  LOG_ASSERT(!pQ->spsc);
 
   if (nLen) {
     // Calculate the number of bytes that can be written
@@ -543,7 +698,7 @@ unsigned int ByteQForceCommitWrite(ByteQ_t* const pQ, unsigned int nLen) {
     }
 
     // Circular buffering.
-    inc_buf_idx(pQ->nWrIdx, pQ->nBufSz, nLen);
+    inc_buf_idx(pQ, pQ->nWrIdx, nLen);
 
     wr_enter_critical(pQ);
     pQ->nCount += nLen;
@@ -568,7 +723,7 @@ unsigned int ByteQPeekRandom(
     if (nRdIdx >= pQ->nBufSz) {
       nRdIdx -= pQ->nBufSz;
     }
-    int nCount = (pQ->nCount - bytesFromRdIdx); // lint !e713 !e737
+    int nCount = (rd_count(pQ) - bytesFromRdIdx); // lint !e713 !e737
     nCount = (nCount < 0) ? 0 : nCount;
 
     // Calculate how many bytes can be read from the RdBuffer.
@@ -577,13 +732,13 @@ unsigned int ByteQPeekRandom(
     // We can definitely read BytesToRead bytes.
     while (bytesToRead > 0) {
       // Calculate how many contiguous bytes to the end of the buffer
-      unsigned int nBytes = MIN(bytesToRead, (pQ->nBufSz - nRdIdx));
+      unsigned int nBytes = MIN(bytesToRead, to_end(pQ, nRdIdx));
 
       // Copy that many bytes.
       memcpy(&pRdBuf[ bytesRead ], &pQ->pfBuf[ nRdIdx ], nBytes * sizeof(bq_t));
 
       // Circular buffering.
-      inc_buf_idx(nRdIdx, pQ->nBufSz, nBytes);
+      inc_buf_idx(pQ, nRdIdx, nBytes);
 
       // Increment the number of bytes read.
       bytesRead += nBytes;
@@ -602,10 +757,11 @@ unsigned int ByteQPokeRandom(
   unsigned int bytesWritten = 0;
 
   LOG_ASSERT(nullptr != pQ);
+  LOG_ASSERT(!pQ->spsc);
   if (nLen) {
     auto nWrIdx = pQ->nWrIdx;
 
-    inc_buf_idx(nWrIdx, pQ->nBufSz, bytesFromStart);
+    inc_buf_idx(pQ, nWrIdx, bytesFromStart);
 
     // Can only write if it will fit within nCount
     int nCount = pQ->nCount - bytesFromStart; // lint !e713 !e737
@@ -618,13 +774,13 @@ unsigned int ByteQPokeRandom(
     while (bytesToWrite > 0) {
       // Calculate how many contiguous bytes to the end of the buffer
       const unsigned int bytes =
-        MIN(bytesToWrite, (pQ->nBufSz - nWrIdx));
+        MIN(bytesToWrite, to_end(pQ, nWrIdx));
 
       // Copy that many bytes.
       memcpy(&pQ->pfBuf[ nWrIdx ], &pWrBuf[ bytesWritten ], bytes * sizeof(bq_t));
 
       // Circular buffering.
-      inc_buf_idx(nWrIdx, pQ->nBufSz, bytes);
+      inc_buf_idx(pQ, nWrIdx, bytes);
 
       // Increment the number of bytes read.
       bytesWritten += bytes;
@@ -653,13 +809,13 @@ int ByteQDoReadFromEnd(ByteQ_t* const pQ, bq_t* pRdBuf, int nLen) {
     while (bytesToRead > 0) {
       // Calculate how many contiguous shorts to the end of the buffer
       const int bytes =
-        MIN(bytesToRead, (int)((pQ->nBufSz - nRdIdx)));
+        MIN(bytesToRead, (int)(to_end(pQ, nRdIdx)));
 
       // Copy that many shorts.
       memcpy(&pRdBuf[ bytesRead ], &pQ->pfBuf[ nRdIdx ], bytes * sizeof(bq_t));
 
       // Circular buffering.
-      inc_buf_idx(nRdIdx, (int)pQ->nBufSz, bytes);
+      inc_buf_idx(pQ, nRdIdx, bytes);
 
       // Increment the number of shorts read.
       bytesRead += bytes;
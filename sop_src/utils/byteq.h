@@ -10,6 +10,8 @@ without the express written permission of the author.
   @author: chris.fogelklou@gmail.com
 *******************************************************************************/
 
+#include "osal/osal.h"
+
 #include <stdint.h>
 #ifndef __cplusplus
 #include <stdbool.h>
@@ -17,14 +19,40 @@ without the express written permission of the author.
 
 typedef uint8_t bq_t;
 
+// In SPSC mode the two indices may be written from different cores.  Define
+// BYTEQ_SPSC_PAD to 1 to keep them a cache line apart.  Off by default, as it
+// adds 192 bytes to every ByteQ_t, SPSC or not.
+#ifndef BYTEQ_SPSC_PAD
+#define BYTEQ_SPSC_PAD 0
+#endif
+#if (BYTEQ_SPSC_PAD > 0)
+#define BYTEQ_CACHE_PAD(name) uint8_t name[ 64 ];
+#else
+#define BYTEQ_CACHE_PAD(name)
+#endif
+
+// Linux can map a buffer twice back to back.  See ByteQCreateMirrored().
+#if defined(__linux__) && !(PLATFORM_EMBEDDED > 0)
+#define BYTEQ_MIRROR 1
+#else
+#define BYTEQ_MIRROR 0
+#endif
+
 typedef struct _ByteQ_t {
   bq_t* pfBuf;
-  unsigned int nWrIdx;
-  unsigned int nRdIdx;
   unsigned int nCount;
   unsigned int nBufSz;
+  unsigned int nMask; ///< nBufSz - 1 if nBufSz is a power of two, else 0
   bool rdCntProt;
   bool wrCntProt;
+  bool spsc;     ///< Single producer, single consumer.  See ByteQCreateSpsc()
+  bool mirrored; ///< pfBuf is mapped twice.  See ByteQCreateMirrored()
+  OSALCsT cs; ///< Protects nCount when rdCntProt or wrCntProt
+  BYTEQ_CACHE_PAD(wrPad)
+  unsigned int nWrIdx;
+  BYTEQ_CACHE_PAD(rdPad)
+  unsigned int nRdIdx;
+  BYTEQ_CACHE_PAD(endPad)
 } ByteQ_t;
 
 
@@ -33,6 +61,28 @@ bool ByteQCreate(
   ByteQ_t* const pQ, bq_t* pBuf, unsigned int nBufSz,
   bool lockOnWrites, bool lockOnReads);
 
+/** [Declaration] Initialize a lock-free queue for exactly one writer and
+ * one reader, e.g. an ISR and a task, or two scheduler lanes.  The writer
+ * owns nWrIdx and the reader owns nRdIdx; each publishes its own index with
+ * an osal_atomic.h release store and reads the other's with an acquire
+ * load, and the count is derived from the two.  Where the target has no
+ * native atomics the release store masks interrupts for one word write
+ * (see OSALEnterCriticalFromIsr()), which is still ISR safe.  One byte is kept free to tell full from empty, so the
+ * queue holds nBufSz - 1 bytes.  The force and poke functions are not
+ * available in this mode. */
+bool ByteQCreateSpsc(ByteQ_t* const pQ, bq_t* pBuf, unsigned int nBufSz);
+
+/** [Declaration] Initialize a queue whose buffer is mapped twice, back to
+ * back, so that every read or write window is contiguous:
+ * ByteQGetContiguousReadReady() is the whole count, and ByteQGetReadPtr()
+ * with ByteQCommitRead() can parse the full readable span in place.  The
+ * queue allocates its own buffer, nBufSz rounded up to whole pages, and
+ * ByteQDestroy() frees it.  Returns false where this is not supported
+ * (see BYTEQ_MIRROR); use ByteQCreate() there instead. */
+bool ByteQCreateMirrored(
+  ByteQ_t* const pQ, unsigned int nBufSz,
+  bool lockOnWrites, bool lockOnReads);
+
 /** [Declaration] Destroy a queue */
 bool ByteQDestroy(ByteQ_t* const pQ);
 
@@ -59,7 +109,7 @@ unsigned int ByteQGetReadReady(ByteQ_t* const pQ);
  * number of bytes that can be read from the buffer. */
 unsigned int ByteQGetContiguousReadReady(ByteQ_t* const pQ);
 
-/** [Declaration] Flushes the buffer. */
+/** [Declaration] Flushes the buffer.  In SPSC mode, call it from the reader. */
 void ByteQFlush(ByteQ_t* const pQ);
 
 /** [Declaration] Generic queue peek function */
@@ -30,6 +30,19 @@ public:
     ByteQCreate(&mByteQ, pBuf, nBufSz, lockOnWrites, lockOnReads);
   }
 
+  // Lock-free, for exactly one writer and one reader.  See ByteQCreateSpsc().
+  void InitSpsc(bq_t* const pBuf, unsigned int nBufSz) {
+    ByteQCreateSpsc(&mByteQ, pBuf, nBufSz);
+  }
+
+  // Allocates a buffer of at least nBufSz that is mapped twice, so that
+  // reads and writes never wrap.  See ByteQCreateMirrored().
+  bool InitMirrored(
+    unsigned int nBufSz,
+    const bool lockOnWrites = false, bool lockOnReads = false) {
+    return ByteQCreateMirrored(&mByteQ, nBufSz, lockOnWrites, lockOnReads);
+  }
+
   // Destructor
   virtual ~ByteQ() {
     ByteQDestroy(&mByteQ);
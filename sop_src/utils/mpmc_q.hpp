@@ -0,0 +1,360 @@
+#ifndef MPMC_Q_HPP
+#define MPMC_Q_HPP
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        mpmc_q.hpp
+ * @brief       A bounded queue of N objects for many writers and many
+ * readers, without locks on targets with native atomics.
+ *
+ * Q<T> copies raw bytes through a ByteQ, so T must be trivially copyable, and
+ * more than one writer or reader must hold a lock around every call.  MpmcQ
+ * holds N slots of T, each with a sequence number.  A writer claims the next
+ * write position with a compare and swap, constructs T in the slot, then
+ * sets the slot's sequence to say that it is full; a reader does the
+ * opposite.  Writers only contend with writers, and readers with readers,
+ * and neither waits on the other unless the queue is full or empty.  The
+ * batch functions claim a run of slots with one compare and swap.  T is
+ * moved in and out, so it can be a move-only type such as std::unique_ptr.
+ *
+ * The Try functions never block.  Push() and Pop() sleep on an OSAL
+ * semaphore while the queue is full or empty; the semaphores are only
+ * signalled when somebody is asleep.  Where OSAL_ATOMIC_NATIVE, that keeps
+ * the Try path lock free and free of system calls.  Elsewhere every compare
+ * and swap and store goes through OSALEnterCriticalFromIsr() (see
+ * osal_atomic.h), which masks interrupts on the embedded ports and takes the
+ * global lock on Win32, so it is correct but neither.
+ *
+ * mpmc_q_bench in osal/bench compares it with a locked Q<T>.
+ */
+
+#ifdef __cplusplus
+
+#include "osal/osal.h"
+#include "osal/osal_atomic.h"
+#include "utils/platform_log.h"
+
+#include <new>
+#include <stdint.h>
+#include <utility>
+
+// Keeps the write and read positions on separate cache lines.
+#define MPMC_Q_CACHE_LINE 64
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+template <typename T, int N> class MpmcQ {
+  static_assert((N > 1) && (0 == (N & (N - 1))), "N must be a power of two");
+
+public:
+  // //////////////////////////////////////////////////////////////////////////
+  MpmcQ()
+    : mWrPos(0)
+    , mRdPos(0)
+    , mWrWaiters(0)
+    , mRdWaiters(0) {
+    for (uint32_t i = 0; i < (uint32_t)N; i++) {
+      mSlots[ i ].seq = i;
+    }
+    mpNotFull  = OSALSemaphoreCreate(0, OSAL_COUNT_INFINITE);
+    mpNotEmpty = OSALSemaphoreCreate(0, OSAL_COUNT_INFINITE);
+    LOG_ASSERT(mpNotFull && mpNotEmpty);
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Destroys whatever is still queued.
+  ~MpmcQ() {
+    uint32_t pos = mRdPos;
+    for (; pos != mWrPos; pos++) {
+      Item(pos & MASK)->~T();
+    }
+    OSALSemaphoreDelete(&mpNotFull);
+    OSALSemaphoreDelete(&mpNotEmpty);
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Adds v to the queue.  Returns false if the queue is full.
+  bool TryPush(const T& v) {
+    return DoTryPush(v);
+  }
+
+  bool TryPush(T&& v) {
+    return DoTryPush(std::move(v));
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Constructs a T in the queue from args.  Returns false if the queue is
+  // full.
+  template <typename... Args> bool TryEmplace(Args&&... args) {
+    uint32_t pos = 0;
+    if (!ClaimWrite(&pos, 1)) {
+      return false;
+    }
+    new (Item(pos & MASK)) T(std::forward<Args>(args)...);
+    PublishWrite(pos, 1);
+    return true;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Moves the oldest item into v.  Returns false if the queue is empty.
+  bool TryPop(T& v) {
+    uint32_t pos = 0;
+    if (!ClaimRead(&pos, 1)) {
+      return false;
+    }
+    T* const pItem = Item(pos & MASK);
+    v              = std::move(*pItem);
+    pItem->~T();
+    PublishRead(pos, 1);
+    return true;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Moves up to num items from pItems into the queue, with a single claim.
+  // Returns how many were queued; those are moved from, the rest are not.
+  int TryPushBatch(T* const pItems, const int num) {
+    uint32_t pos = 0;
+    const uint32_t cnt = ClaimWrite(&pos, (num > 0) ? (uint32_t)num : 0);
+    for (uint32_t i = 0; i < cnt; i++) {
+      new (Item((pos + i) & MASK)) T(std::move(pItems[ i ]));
+    }
+    PublishWrite(pos, cnt);
+    return (int)cnt;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Moves up to num of the oldest items into pItems, with a single claim.
+  // Returns how many were read.
+  int TryPopBatch(T* const pItems, const int num) {
+    uint32_t pos = 0;
+    const uint32_t cnt = ClaimRead(&pos, (num > 0) ? (uint32_t)num : 0);
+    for (uint32_t i = 0; i < cnt; i++) {
+      T* const pItem = Item((pos + i) & MASK);
+      pItems[ i ]    = std::move(*pItem);
+      pItem->~T();
+    }
+    PublishRead(pos, cnt);
+    return (int)cnt;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Adds v to the queue, waiting up to timeoutMs for space.  Returns false,
+  // and leaves v alone, if the queue stayed full.
+  bool Push(const T& v, const uint32_t timeoutMs = OSAL_WAIT_INFINITE) {
+    return DoPush(v, timeoutMs);
+  }
+
+  bool Push(T&& v, const uint32_t timeoutMs = OSAL_WAIT_INFINITE) {
+    return DoPush(std::move(v), timeoutMs);
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Moves the oldest item into v, waiting up to timeoutMs for one.  Returns
+  // false if the queue stayed empty.
+  bool Pop(T& v, const uint32_t timeoutMs = OSAL_WAIT_INFINITE) {
+    const uint32_t t0 = OSALGetMS();
+    for (;;) {
+      if (TryPop(v)) {
+        return true;
+      }
+      // Register as a sleeper, then look again, so that a writer either sees
+      // the registration or this sees its item.
+      (void)OSALAtomicFetchAddU32(&mRdWaiters, 1, OSAL_MO_SEQ_CST);
+      OSALAtomicFence(OSAL_MO_SEQ_CST);
+      bool rval = TryPop(v);
+      if (!rval) {
+        const uint32_t waitMs = RemainingMs(t0, timeoutMs);
+        if ((0 == waitMs) || (!OSALSemaphoreWait(mpNotEmpty, waitMs))) {
+          rval = TryPop(v);
+          (void)OSALAtomicFetchAddU32(&mRdWaiters, (uint32_t)-1, OSAL_MO_SEQ_CST);
+          return rval;
+        }
+      }
+      (void)OSALAtomicFetchAddU32(&mRdWaiters, (uint32_t)-1, OSAL_MO_SEQ_CST);
+      if (rval) {
+        return true;
+      }
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Number of items queued.  Only a snapshot while others use the queue.
+  int GetReadReady() const {
+    const uint32_t rd = OSALAtomicLoadU32(&mRdPos, OSAL_MO_ACQUIRE);
+    const uint32_t wr = OSALAtomicLoadU32(&mWrPos, OSAL_MO_ACQUIRE);
+    const int32_t cnt = (int32_t)(wr - rd);
+    return (cnt < 0) ? 0 : (cnt > N) ? N : cnt;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Free slots.  Only a snapshot while others use the queue.
+  int GetWriteReady() const {
+    return N - GetReadReady();
+  }
+
+private:
+  MpmcQ(const MpmcQ&);
+  MpmcQ& operator=(const MpmcQ&);
+
+  static const uint32_t MASK = (uint32_t)N - 1;
+
+  // The sequence is pos while the slot is free for the write at pos, and
+  // pos + 1 once that write is done.  The read at pos sets it to pos + N,
+  // freeing it for the next lap.
+  struct Slot {
+    volatile uint32_t seq;
+    alignas(T) uint8_t item[ sizeof(T) ];
+  };
+
+  // //////////////////////////////////////////////////////////////////////////
+  T* Item(const uint32_t idx) {
+    return (T*)mSlots[ idx ].item;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  uint32_t RemainingMs(const uint32_t t0, const uint32_t timeoutMs) const {
+    if (OSAL_WAIT_INFINITE == timeoutMs) {
+      return OSAL_WAIT_INFINITE;
+    }
+    const uint32_t elapsed = OSALGetMS() - t0;
+    return (elapsed < timeoutMs) ? (timeoutMs - elapsed) : 0;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Claims up to num consecutive write positions, starting at *pPos, whose
+  // slots are free.  Returns how many.
+  uint32_t ClaimWrite(uint32_t* const pPos, const uint32_t num) {
+    uint32_t pos = OSALAtomicLoadU32(&mWrPos, OSAL_MO_RELAXED);
+    for (;;) {
+      uint32_t cnt = 0;
+      while ((cnt < num) && (cnt < (uint32_t)N) &&
+             (OSALAtomicLoadU32(&mSlots[ (pos + cnt) & MASK ].seq, OSAL_MO_ACQUIRE) == pos + cnt)) {
+        cnt++;
+      }
+      if (0 == cnt) {
+        const int32_t diff =
+          (int32_t)(OSALAtomicLoadU32(&mSlots[ pos & MASK ].seq, OSAL_MO_ACQUIRE) - pos);
+        if ((num == 0) || (diff < 0)) {
+          // Full: the slot still holds the item from the last lap.
+          return 0;
+        }
+        // Another writer took pos.
+        pos = OSALAtomicLoadU32(&mWrPos, OSAL_MO_RELAXED);
+      }
+      else if (OSALAtomicCasU32(&mWrPos, &pos, pos + cnt, OSAL_MO_RELAXED)) {
+        *pPos = pos;
+        return cnt;
+      }
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Marks cnt slots from pos full, and wakes a sleeping reader.
+  void PublishWrite(const uint32_t pos, const uint32_t cnt) {
+    for (uint32_t i = 0; i < cnt; i++) {
+      OSALAtomicStoreU32(&mSlots[ (pos + i) & MASK ].seq, pos + i + 1, OSAL_MO_RELEASE);
+    }
+    if (cnt) {
+      OSALAtomicFence(OSAL_MO_SEQ_CST);
+      const uint32_t waiters = OSALAtomicLoadU32(&mRdWaiters, OSAL_MO_RELAXED);
+      if (waiters) {
+        OSALSemaphoreSignal(mpNotEmpty, (cnt < waiters) ? cnt : waiters);
+      }
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Claims up to num consecutive read positions, starting at *pPos, whose
+  // slots are full.  Returns how many.
+  uint32_t ClaimRead(uint32_t* const pPos, const uint32_t num) {
+    uint32_t pos = OSALAtomicLoadU32(&mRdPos, OSAL_MO_RELAXED);
+    for (;;) {
+      uint32_t cnt = 0;
+      while ((cnt < num) && (cnt < (uint32_t)N) &&
+             (OSALAtomicLoadU32(&mSlots[ (pos + cnt) & MASK ].seq, OSAL_MO_ACQUIRE) == pos + cnt + 1)) {
+        cnt++;
+      }
+      if (0 == cnt) {
+        const int32_t diff =
+          (int32_t)(OSALAtomicLoadU32(&mSlots[ pos & MASK ].seq, OSAL_MO_ACQUIRE) - (pos + 1));
+        if ((num == 0) || (diff < 0)) {
+          // Empty: the slot has not been written this lap.
+          return 0;
+        }
+        // Another reader took pos.
+        pos = OSALAtomicLoadU32(&mRdPos, OSAL_MO_RELAXED);
+      }
+      else if (OSALAtomicCasU32(&mRdPos, &pos, pos + cnt, OSAL_MO_RELAXED)) {
+        *pPos = pos;
+        return cnt;
+      }
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Marks cnt slots from pos free for the next lap, and wakes a sleeping
+  // writer.
+  void PublishRead(const uint32_t pos, const uint32_t cnt) {
+    for (uint32_t i = 0; i < cnt; i++) {
+      OSALAtomicStoreU32(&mSlots[ (pos + i) & MASK ].seq, pos + i + (uint32_t)N, OSAL_MO_RELEASE);
+    }
+    if (cnt) {
+      OSALAtomicFence(OSAL_MO_SEQ_CST);
+      const uint32_t waiters = OSALAtomicLoadU32(&mWrWaiters, OSAL_MO_RELAXED);
+      if (waiters) {
+        OSALSemaphoreSignal(mpNotFull, (cnt < waiters) ? cnt : waiters);
+      }
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  template <typename U> bool DoTryPush(U&& v) {
+    uint32_t pos = 0;
+    if (!ClaimWrite(&pos, 1)) {
+      return false;
+    }
+    new (Item(pos & MASK)) T(std::forward<U>(v));
+    PublishWrite(pos, 1);
+    return true;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // See Pop().
+  template <typename U> bool DoPush(U&& v, const uint32_t timeoutMs) {
+    const uint32_t t0 = OSALGetMS();
+    for (;;) {
+      if (DoTryPush(std::forward<U>(v))) {
+        return true;
+      }
+      (void)OSALAtomicFetchAddU32(&mWrWaiters, 1, OSAL_MO_SEQ_CST);
+      OSALAtomicFence(OSAL_MO_SEQ_CST);
+      bool rval = DoTryPush(std::forward<U>(v));
+      if (!rval) {
+        const uint32_t waitMs = RemainingMs(t0, timeoutMs);
+        if ((0 == waitMs) || (!OSALSemaphoreWait(mpNotFull, waitMs))) {
+          rval = DoTryPush(std::forward<U>(v));
+          (void)OSALAtomicFetchAddU32(&mWrWaiters, (uint32_t)-1, OSAL_MO_SEQ_CST);
+          return rval;
+        }
+      }
+      (void)OSALAtomicFetchAddU32(&mWrWaiters, (uint32_t)-1, OSAL_MO_SEQ_CST);
+      if (rval) {
+        return true;
+      }
+    }
+  }
+
+private:
+  volatile uint32_t mWrPos;
+  uint8_t mWrPad[ MPMC_Q_CACHE_LINE - sizeof(uint32_t) ];
+  volatile uint32_t mRdPos;
+  uint8_t mRdPad[ MPMC_Q_CACHE_LINE - sizeof(uint32_t) ];
+  volatile uint32_t mWrWaiters;
+  volatile uint32_t mRdWaiters;
+  OSALSemaphorePtrT mpNotFull;
+  OSALSemaphorePtrT mpNotEmpty;
+  Slot mSlots[ N ];
+};
+
+#endif // #ifdef __cplusplus
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        object_pool.hpp
+ * @brief       A pool of fixed size objects, for the framework's intrusive
+ * structures (transactions, schedulables, mutexes) that are otherwise kept on
+ * hand-made free lists.
+ *
+ * Alloc() and Free() are a compare and swap loop on the free list head.  On
+ * targets with native atomics (OSAL_ATOMIC_NATIVE) that is lock free, so they
+ * can be used from any thread or interrupt.  Elsewhere each compare and swap
+ * briefly masks interrupts (see osal_atomic.h), which is still safe from an
+ * interrupt on the embedded ports, but not lock free.  The free list is a stack of slot indices, and the head carries
+ * a tag that changes on every push and pop so that a stale compare and swap
+ * fails (the ABA problem.)  While a slot is free its first word holds the
+ * index of the next free slot, so T must be at least a uint32_t in size and
+ * alignment.  Intrusive structures already start with a list node, which is
+ * not in use while the object is free.
+ *
+ * The pool holds N slots itself, and can take more with Adopt() (e.g. a
+ * static array from the application), or grow from mempools by growBy slots
+ * at a time when it runs out.  Growth is not for interrupts.  In all, a pool
+ * has at most OBJECT_POOL_MAX_SEGS blocks of slots and fewer than 65535
+ * slots; Adopt() and growing fail beyond that.
+ */
+
+#ifdef __cplusplus
+
+#include "osal/osal.h"
+#include "osal/osal_atomic.h"
+#include "utils/platform_log.h"
+
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+// Most blocks of slots a pool can have (its own, adopted and grown.)
+#define OBJECT_POOL_MAX_SEGS 8
+
+// ////////////////////////////////////////////////////////////////////////////
+// Pool statistics.
+typedef struct ObjectPoolStatsTag {
+  uint32_t capacity; ///< Slots in the pool
+  uint32_t inUse;    ///< Slots allocated now
+  uint32_t maxInUse; ///< Most slots ever allocated at once
+  uint32_t allocs;   ///< Successful Alloc() calls
+  uint32_t failures; ///< Alloc() calls that found the pool empty
+  uint32_t grows;    ///< Times the pool grew from mempools
+} ObjectPoolStatsT;
+
+// ////////////////////////////////////////////////////////////////////////////
+// The pool's own slots.  A private base, so that with N == 0 it takes no
+// space at all.
+template <typename T, int N> class ObjectPoolStorage {
+protected:
+  uint8_t* StoragePtr() { return mStorage; }
+
+private:
+  alignas(T) uint8_t mStorage[ N * sizeof(T) ];
+};
+
+template <typename T> class ObjectPoolStorage<T, 0> {
+protected:
+  uint8_t* StoragePtr() { return NULL; }
+};
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+template <typename T, int N> class ObjectPool : private ObjectPoolStorage<T, N> {
+  static_assert(
+    (sizeof(T) >= sizeof(uint32_t)) && (alignof(T) >= alignof(uint32_t)),
+    "free slots hold a uint32_t link");
+  static_assert((N >= 0) && (N < 0xffff), "N must be from 0 to 65534");
+
+public:
+  // //////////////////////////////////////////////////////////////////////////
+  // Construct a pool of N slots, that grows by growBy slots when empty (or
+  // never, if growBy is 0.)
+  explicit ObjectPool(const int growBy = 0)
+    : mNumSegs(0)
+    , mHead(NIL)
+    , mGrowing(false)
+    , mGrowBy(growBy)
+    , mCapacity(0)
+    , mInUse(0)
+    , mMaxInUse(0)
+    , mAllocs(0)
+    , mFailures(0)
+    , mGrows(0) {
+    LOG_ASSERT(growBy >= 0);
+    if (N > 0) {
+      (void)AddSeg(this->StoragePtr(), N, false);
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Gives the grown slots back to mempools.
+  ~ObjectPool() {
+    for (uint32_t i = 0; i < mNumSegs; i++) {
+      if (mSegs[ i ].isOwned) {
+        OSALFREE(mSegs[ i ].pBase);
+      }
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Adds arrLen slots from arr, which must outlive the pool.  Returns false,
+  // adding none of them, if the pool already has OBJECT_POOL_MAX_SEGS blocks
+  // or would reach 65535 slots.
+  bool Adopt(T arr[], const int arrLen) {
+    LOG_ASSERT(arr && (arrLen > 0));
+    while (!OSALTestAndSet(&mGrowing)) {
+      OSALSleep(0);
+    }
+    const bool rval = AddSeg((uint8_t*)arr, (uint32_t)arrLen, false);
+    OSALClearFlag((bool*)&mGrowing);
+    return rval;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Allocates a slot.  Its contents are whatever the last user left there,
+  // except for the first word.  Returns NULL if the pool is empty and can not
+  // grow.
+  T* Alloc() {
+    uint32_t idx = Pop();
+    while (NIL == idx) {
+      if (!Grow()) {
+        (void)OSALAtomicFetchAddU32(&mFailures, 1, OSAL_MO_RELAXED);
+        return NULL;
+      }
+      idx = Pop();
+    }
+    (void)OSALAtomicFetchAddU32(&mAllocs, 1, OSAL_MO_RELAXED);
+    const uint32_t inUse = OSALAtomicFetchAddU32(&mInUse, 1, OSAL_MO_RELAXED) + 1;
+    uint32_t maxInUse    = OSALAtomicLoadU32(&mMaxInUse, OSAL_MO_RELAXED);
+    while ((inUse > maxInUse) &&
+           (!OSALAtomicCasU32(&mMaxInUse, &maxInUse, inUse, OSAL_MO_RELAXED))) {
+    }
+    return (T*)SlotPtr(idx);
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Returns a slot from Alloc() to the pool.  Anything else asserts and is
+  // leaked.
+  void Free(T* const pObj) {
+    const uint32_t idx = IndexOf(pObj);
+    LOG_ASSERT(NIL != idx);
+    if (NIL != idx) {
+      (void)OSALAtomicFetchAddU32(&mInUse, (uint32_t)-1, OSAL_MO_RELAXED);
+      Push(idx);
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Allocates and constructs a T.
+  template <typename... Args> T* New(Args&&... args) {
+    void* const pMem = Alloc();
+    return (pMem) ? new (pMem) T(std::forward<Args>(args)...) : NULL;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Destroys and frees a T from New().
+  void Delete(T* const pObj) {
+    if (pObj) {
+      pObj->~T();
+      Free(pObj);
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // True if pObj is one of the pool's slots.
+  bool Owns(const T* const pObj) const {
+    return (NIL != IndexOf(pObj));
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Gets a snapshot of the statistics.
+  void GetStats(ObjectPoolStatsT* const pStats) const {
+    LOG_ASSERT(pStats);
+    pStats->capacity = OSALAtomicLoadU32(&mCapacity, OSAL_MO_RELAXED);
+    pStats->inUse    = OSALAtomicLoadU32(&mInUse, OSAL_MO_RELAXED);
+    pStats->maxInUse = OSALAtomicLoadU32(&mMaxInUse, OSAL_MO_RELAXED);
+    pStats->allocs   = OSALAtomicLoadU32(&mAllocs, OSAL_MO_RELAXED);
+    pStats->failures = OSALAtomicLoadU32(&mFailures, OSAL_MO_RELAXED);
+    pStats->grows    = OSALAtomicLoadU32(&mGrows, OSAL_MO_RELAXED);
+  }
+
+private:
+  ObjectPool(const ObjectPool&);
+  ObjectPool& operator=(const ObjectPool&);
+
+  // The head is the index of the top slot in the low bits, and a tag above.
+  static const uint32_t NIL      = 0xffffu;
+  static const uint32_t IDX_MASK = 0xffffu;
+  static const uint32_t TAG_ONE  = 0x10000u;
+
+  // A block of contiguous slots, with indices first..first+len-1.
+  struct Seg {
+    uint8_t* pBase;
+    uint32_t first;
+    uint32_t len;
+    bool isOwned;
+  };
+
+  // //////////////////////////////////////////////////////////////////////////
+  uint8_t* SlotPtr(const uint32_t idx) const {
+    const uint32_t numSegs = OSALAtomicLoadU32(&mNumSegs, OSAL_MO_ACQUIRE);
+    for (uint32_t i = 0; i < numSegs; i++) {
+      const Seg& seg = mSegs[ i ];
+      if ((idx - seg.first) < seg.len) {
+        return &seg.pBase[ (idx - seg.first) * sizeof(T) ];
+      }
+    }
+    LOG_ASSERT(false);
+    return NULL;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  uint32_t IndexOf(const T* const pObj) const {
+    const uint8_t* const p = (const uint8_t*)pObj;
+    const uint32_t numSegs = OSALAtomicLoadU32(&mNumSegs, OSAL_MO_ACQUIRE);
+    for (uint32_t i = 0; i < numSegs; i++) {
+      const Seg& seg = mSegs[ i ];
+      if ((p >= seg.pBase) && (p < &seg.pBase[ seg.len * sizeof(T) ])) {
+        const size_t offs = (size_t)(p - seg.pBase);
+        return (0 == (offs % sizeof(T))) ? (seg.first + (uint32_t)(offs / sizeof(T))) : NIL;
+      }
+    }
+    return NIL;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  volatile uint32_t* Link(const uint32_t idx) const {
+    return (volatile uint32_t*)SlotPtr(idx);
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  void Push(const uint32_t idx) {
+    uint32_t head = OSALAtomicLoadU32(&mHead, OSAL_MO_RELAXED);
+    uint32_t desired;
+    do {
+      OSALAtomicStoreU32(Link(idx), head & IDX_MASK, OSAL_MO_RELAXED);
+      desired = ((head + TAG_ONE) & ~IDX_MASK) | idx;
+    } while (!OSALAtomicCasU32(&mHead, &head, desired, OSAL_MO_RELEASE));
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  uint32_t Pop() {
+    uint32_t head = OSALAtomicLoadU32(&mHead, OSAL_MO_ACQUIRE);
+    for (;;) {
+      const uint32_t idx = head & IDX_MASK;
+      if (NIL == idx) {
+        return NIL;
+      }
+      // If another thread pops idx first, this may read a stale link, but
+      // the tag will have changed and the swap will fail.
+      const uint32_t next    = OSALAtomicLoadU32(Link(idx), OSAL_MO_RELAXED);
+      const uint32_t desired = ((head + TAG_ONE) & ~IDX_MASK) | next;
+      if (OSALAtomicCasU32(&mHead, &head, desired, OSAL_MO_ACQUIRE)) {
+        return idx;
+      }
+    }
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Adds growBy slots from mempools.  Returns false if the pool can not grow.
+  bool Grow() {
+    if (0 == mGrowBy) {
+      return false;
+    }
+    if (!OSALTestAndSet(&mGrowing)) {
+      // Another thread is growing the pool; try again after it has.
+      OSALSleep(0);
+      return true;
+    }
+    bool rval = false;
+    if (NIL != (OSALAtomicLoadU32(&mHead, OSAL_MO_ACQUIRE) & IDX_MASK)) {
+      // Something was freed, or another thread grew the pool.
+      rval = true;
+    } else if (CanAddSeg((uint32_t)mGrowBy)) {
+      uint8_t* const pMem = (uint8_t*)OSALMALLOC(mGrowBy * sizeof(T));
+      if (pMem) {
+        LOG_ASSERT(0 == ((uintptr_t)pMem % alignof(T)));
+        rval = AddSeg(pMem, (uint32_t)mGrowBy, true);
+        (void)OSALAtomicFetchAddU32(&mGrows, 1, OSAL_MO_RELAXED);
+      }
+    }
+    OSALClearFlag((bool*)&mGrowing);
+    return rval;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // True if a block of len more slots fits.
+  bool CanAddSeg(const uint32_t len) const {
+    return (mNumSegs < OBJECT_POOL_MAX_SEGS) && (len < NIL) && ((mCapacity + len) < NIL);
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Adds a block of slots and frees them all, or returns false if it does not
+  // fit.  The caller holds mGrowing, or is the constructor.
+  bool AddSeg(uint8_t* const pBase, const uint32_t len, const bool isOwned) {
+    const uint32_t numSegs = mNumSegs;
+    const bool rval        = CanAddSeg(len);
+    if (rval) {
+      Seg& seg    = mSegs[ numSegs ];
+      seg.pBase   = pBase;
+      seg.first   = mCapacity;
+      seg.len     = len;
+      seg.isOwned = isOwned;
+      OSALAtomicStoreU32(&mNumSegs, numSegs + 1, OSAL_MO_RELEASE);
+      OSALAtomicStoreU32(&mCapacity, mCapacity + len, OSAL_MO_RELAXED);
+      // Push in reverse, so that the lowest slot is allocated first.
+      for (uint32_t i = len; i > 0; i--) {
+        Push(seg.first + i - 1);
+      }
+    }
+    return rval;
+  }
+
+private:
+  Seg mSegs[ OBJECT_POOL_MAX_SEGS ];
+  volatile uint32_t mNumSegs;
+  volatile uint32_t mHead;
+  volatile bool mGrowing;
+  const int mGrowBy;
+  volatile uint32_t mCapacity;
+  volatile uint32_t mInUse;
+  volatile uint32_t mMaxInUse;
+  volatile uint32_t mAllocs;
+  volatile uint32_t mFailures;
+  volatile uint32_t mGrows;
+};
+
+#endif // #ifdef __cplusplus
+
+#endif
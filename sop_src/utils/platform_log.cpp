@@ -7,14 +7,14 @@
 #include "platform_log.h"
 
 #include "helper_macros.h"
-#include "osal/cs_task_locker.hpp"
+#include "osal/cs_obj_locker.hpp"
 #include "osal/osal.h"
 #include "osal/platform_type.h"
 #include "osal/singleton_defs.hpp"
 #include "task_sched/task_sched.h"
 #include "utils/cnv_utils.hpp"
 #include "utils/convert_utils.h"
-#include "utils/dl_list.hpp"
+#include "utils/object_pool.hpp"
 #include "utils/simple_string.hpp"
 
 #include <stdarg.h>
@@ -83,6 +83,8 @@ public:
   void InitUI(LOG_LogUIFn logFn, void* const pUserData);
   void AssertionFailed(const char* szFile, const int line);
   void AssertionWarningFailed(const char* szFile, const int line);
+  void GetSink(LOG_LoggingFn& logFn, void*& pUserData);
+  void GetUISink(LOG_LogUIFn& logFn, void*& pUserData);
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
   void ProcessBuf(BleBufHdrT* const pBuf);
   BleBufHdrT* AddBuf(const uint32_t ts, const char* const pBuf, const int len);
@@ -92,6 +94,7 @@ private:
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
   const static int NUM_FREE_EVENTS = 10;
 
+  static void TimerCbC(void* pCallbackData, uint32_t ts);
   void TimerCb(BleBufHdrT* const pBuf);
 #endif
 
@@ -104,18 +107,22 @@ public:
   LOG_LogUIFn mLogUIFn; // = blelog_defaultLogFn;
   void* mLogUIDataPtr;  // = NULL;
 private:
+  // Sinks are read on every log line and written only by LOG_Init*().
+  OSALRwLockPtrT mSinksLock;
   bool mLogAssertionHasFailed; // = false;
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
   ByteQ mByteQ;
 
-  BleBufHdrT mFreeEventsAry[ NUM_FREE_EVENTS ];
+  ObjectPool<BleBufHdrT, NUM_FREE_EVENTS> mFreeEvents;
   bq_t mByteAry[ NUM_FREE_EVENTS * 80 ];
-  dll::list mFreeEventsList;
 #endif
 };
 
 SINGLETON_INSTANTIATIONS(Logger);
 
+// Protects the working buffer and the assert state.
+static OSALCsT log_Cs = OSAL_CS_INIT(false, OSAL_CS_LEVEL_LOG);
+
 
 #define VALID_TAG 0xa55ea7fa
 
@@ -162,55 +169,73 @@ Logger::Logger()
   , mLogDataPtr(NULL)
   , mLogUIFn(blelog_defaultLogUIFn)
   , mLogUIDataPtr(NULL)
+  , mSinksLock(OSALRwLockCreate())
   , mLogAssertionHasFailed(false)
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
   , mByteQ(mByteAry, ARRSZ(mByteAry))
-  , mFreeEventsAry()
+  , mFreeEvents()
   , mByteAry()
-  , mFreeEventsList()
 #endif
 {
   assertWarn = assertFail = { 0, 0, -1 };
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
-  memset(mFreeEventsAry, 0, sizeof(mFreeEventsAry));
   memset(mByteAry, 0, sizeof(mByteAry));
-
-  auto TimerCbC = [](void* pCallbackData, uint32_t) {
-    BleBufHdrT* const pBuf = (BleBufHdrT*)pCallbackData;
-    Logger::inst().TimerCb(pBuf);
-  };
-
-  for (int i = 0; i < NUM_FREE_EVENTS; i++) {
-    BleBufHdrT* const pEvt = &mFreeEventsAry[ i ];
-    TaskSchedInitSched(&pEvt->sched, TimerCbC, pEvt);
-    mFreeEventsList.push_back(&pEvt->sched.listNode);
-  }
 #endif
 }
 
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+void Logger::TimerCbC(void* pCallbackData, uint32_t ts) {
+  (void)ts;
+  Logger::inst().TimerCb((BleBufHdrT*)pCallbackData);
+}
+
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 void Logger::TimerCb(BleBufHdrT* const pBuf) {
-  if (mLogFn) {
-    mLogFn(mLogDataPtr, pBuf->ts, pBuf->pPayload, pBuf->payloadLen);
-  }
-  {
-    CSTaskLocker lock;
-    mFreeEventsList.push_back(&pBuf->sched.listNode);
+  LOG_LoggingFn logFn;
+  void* pUserData;
+  GetSink(logFn, pUserData);
+  if (logFn) {
+    CSObjLocker sinkLock(&log_Cs);
+    logFn(pUserData, pBuf->ts, pBuf->pPayload, pBuf->payloadLen);
   }
+  mFreeEvents.Free(pBuf);
 }
 #endif
 
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 void Logger::Init(LOG_LoggingFn logFn, void* pUserData) {
+  (void)OSALRwLockWriteLock(mSinksLock, OSAL_WAIT_INFINITE);
   mLogFn      = (logFn) ? logFn : blelog_defaultLogFn;
   mLogDataPtr = pUserData;
+  (void)OSALRwLockWriteUnlock(mSinksLock);
 }
 
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 void Logger::InitUI(LOG_LogUIFn logFn, void* pUserData) {
+  (void)OSALRwLockWriteLock(mSinksLock, OSAL_WAIT_INFINITE);
   mLogUIFn      = (logFn) ? logFn : blelog_defaultLogUIFn;
   mLogUIDataPtr = pUserData;
+  (void)OSALRwLockWriteUnlock(mSinksLock);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Snapshot the log sink.  The sink is called outside of the read lock,
+// because sinks may log themselves and the lock is not recursive.
+void Logger::GetSink(LOG_LoggingFn& logFn, void*& pUserData) {
+  (void)OSALRwLockReadLock(mSinksLock, OSAL_WAIT_INFINITE);
+  logFn     = mLogFn;
+  pUserData = mLogDataPtr;
+  (void)OSALRwLockReadUnlock(mSinksLock);
+}
+
+// ////////////////////////////////////////////////////////////////////////////////////////////////
+// Snapshot the UI sink.  See GetSink().
+void Logger::GetUISink(LOG_LogUIFn& logFn, void*& pUserData) {
+  (void)OSALRwLockReadLock(mSinksLock, OSAL_WAIT_INFINITE);
+  logFn     = mLogUIFn;
+  pUserData = mLogUIDataPtr;
+  (void)OSALRwLockReadUnlock(mSinksLock);
 }
 
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
@@ -237,8 +262,11 @@ BleBufHdrT*
   Logger::AddBuf(const uint32_t ts, const char* const pChars, const int len) {
   BleBufHdrT* pEvt = NULL;
   if (len <= ((int)sizeof(mByteAry) / 2)) {
-    pEvt = (BleBufHdrT*)mFreeEventsList.pop_front();
+    pEvt = mFreeEvents.Alloc();
     if (pEvt) {
+      // The pool keeps its free list link in the node, so unlist it first.
+      pEvt->sched.listNode.pNext = pEvt->sched.listNode.pPrev = NULL;
+      TaskSchedInitSched(&pEvt->sched, TimerCbC, pEvt);
       ByteQ_t* const pq = mByteQ.GetByteQPtr();
 
       // If there isn't enough contiguous memory for the buffer, reset to 0.
@@ -299,8 +327,19 @@ void LOG_InitUI(LOG_LogUIFn logUiFn, void* pUserData) {
   inst.InitUI(logUiFn, pUserData);
 }
 
+// On full OSes each thread formats into its own buffer, and only the sink
+// call is serialized under log_Cs so sinks never see concurrent calls.
+// Elsewhere one buffer is shared, and log_Cs covers the formatting too.
+#if (PLATFORM_FULL_OS > 0) && !defined(OSAL_SINGLE_TASK)
+#define LOG_WBUF_SHARED 0
+#define LOG_WBUF_STORAGE static thread_local
+#else
+#define LOG_WBUF_SHARED 1
+#define LOG_WBUF_STORAGE static
+#endif
+
 #define WBUF_LEN 800
-static char log_WorkingBuf[ WBUF_LEN + 1 ];
+LOG_WBUF_STORAGE char log_WorkingBuf[ WBUF_LEN + 1 ];
 
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 int LOG_VPrintf(const char* szFormat, va_list va) {
@@ -310,8 +349,11 @@ int LOG_VPrintf(const char* szFormat, va_list va) {
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
   BleBufHdrT* pbBuf = NULL;
 #endif
+  const uint32_t ts = OSALGetMS();
   {
-    CSTaskLocker lock;
+#if (LOG_WBUF_SHARED > 0)
+    CSObjLocker lock(&log_Cs);
+#endif
     log_WorkingBuf[ WBUF_LEN ] = 'a';
     {
       printed =
@@ -320,10 +362,14 @@ int LOG_VPrintf(const char* szFormat, va_list va) {
       log_WorkingBuf[ printed ] = 0;
 
 #if (USE_BACKGROUND_PROCESS_FOR_PRINTING > 0)
-      pbBuf = inst.AddBuf(OSALGetMS(), log_WorkingBuf, printed + 1);
+      pbBuf = inst.AddBuf(ts, log_WorkingBuf, printed + 1);
 #else
-      if (inst.mLogFn) {
-        inst.mLogFn(inst.mLogDataPtr, OSALGetMS(), log_WorkingBuf, printed);
+      LOG_LoggingFn logFn;
+      void* pUserData;
+      inst.GetSink(logFn, pUserData);
+      if (logFn) {
+        CSObjLocker sinkLock(&log_Cs);
+        logFn(pUserData, ts, log_WorkingBuf, printed);
       }
 #endif
     }
@@ -352,7 +398,9 @@ void LOG_LogUI(const LOG_UIMessageT type, const char* szFormat, ...) {
   Logger& inst = Logger::inst();
 
   {
-    CSTaskLocker lock;
+#if (LOG_WBUF_SHARED > 0)
+    CSObjLocker lock(&log_Cs);
+#endif
     log_WorkingBuf[ WBUF_LEN ] = 'a';
     {
       va_list va;
@@ -364,7 +412,11 @@ void LOG_LogUI(const LOG_UIMessageT type, const char* szFormat, ...) {
       log_WorkingBuf[ printed ] = 0;
     }
     LOG_ASSERT(log_WorkingBuf[ WBUF_LEN ] == 'a');
-    inst.mLogUIFn(inst.mLogUIDataPtr, type, log_WorkingBuf, (int)strlen(log_WorkingBuf));
+    LOG_LogUIFn logUIFn;
+    void* pUserData;
+    inst.GetUISink(logUIFn, pUserData);
+    CSObjLocker sinkLock(&log_Cs);
+    logUIFn(pUserData, type, log_WorkingBuf, (int)strlen(log_WorkingBuf));
   }
 }
 
@@ -562,7 +614,7 @@ void LOG_AssertSetIgnoreWarnings(const int numToAdd) {
 
 // ////////////////////////////////////////////////////////////////////////////////////////////////
 void LOG_AssertionWarningFailed(const char* szFile, const int line) {
-  CSTaskLocker cs;
+  CSObjLocker cs(&log_Cs);
   if (log_ignoreWarnings > 0) {
     --log_ignoreWarnings;
     return;
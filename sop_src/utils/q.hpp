@@ -5,6 +5,7 @@
 #include "utils/byteq.h"
 #include "utils/helper_macros.h"
 #include "utils/platform_log.h"
+#include "utils/region_alloc.hpp"
 
 template <typename T> class Q {
 public:
@@ -26,6 +27,13 @@ public:
     ByteQCreate(&mByteQ, (uint8_t*)pBuf, sizeof(T) * nBufSz, lockOnWrites, lockOnReads);
   }
 
+  // Init with a buffer of nBufSz from region, which must outlive the queue.
+  void Init(
+    RegionAllocator& region, unsigned int nBufSz,
+    const bool lockOnWrites = false, bool lockOnReads = false) {
+    Init(region.MallocArray<T>(nBufSz), nBufSz, lockOnWrites, lockOnReads);
+  }
+
   // Destructor
   virtual ~Q() {
     ByteQDestroy(&mByteQ);
@@ -101,7 +109,12 @@ public:
       if (idx < numEntries) {
         auto newIdx = mByteQ.nRdIdx;
         newIdx += (idx * sizeof(T));
-        newIdx %= mByteQ.nBufSz;
+        // idx is within the count, so this wraps at most once.
+        if (mByteQ.nMask) {
+          newIdx &= mByteQ.nMask;
+        } else if (newIdx >= mByteQ.nBufSz) {
+          newIdx -= mByteQ.nBufSz;
+        }
         pRVal = (T*)&mByteQ.pfBuf[ newIdx ];
       } else {
         LOG_ASSERT_HPP(false);
@@ -0,0 +1,175 @@
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        region_alloc.cpp
+ * @brief       Scratch memory for one message or request.
+ */
+
+#include "region_alloc.hpp"
+#include "osal/osal.h"
+#include "utils/helper_macros.h"
+#include "utils/platform_log.h"
+
+LOG_MODNAME("region_alloc")
+
+// Words at the start of each chunk taken by its header.
+#define REGION_HDR_WORDS                                                       \
+  ((sizeof(Chunk) + sizeof(ba_t) - 1) / sizeof(ba_t))
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+// //////////////////////////////////////////////////////////////////////////
+// Construct a region that takes chunks of chunkBytes from mempools.
+RegionAllocator::RegionAllocator(const size_t chunkBytes)
+    : mChunkBytes(chunkBytes), mpFirst(NULL), mpChunk(NULL), mpSpare(NULL),
+      mpDtors(NULL), mNumChunks(0) {
+  LOG_ASSERT(mChunkBytes > 0);
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Construct a region that uses pWordBufAry first (e.g. on the stack), and
+// then takes chunks from mempools.
+RegionAllocator::RegionAllocator(ba_t *const pWordBufAry,
+                                 const int bufLenWords,
+                                 const size_t chunkBytes)
+    : mChunkBytes(chunkBytes), mpFirst(NULL), mpChunk(NULL), mpSpare(NULL),
+      mpDtors(NULL), mNumChunks(0) {
+  LOG_ASSERT(mChunkBytes > 0);
+  LOG_ASSERT(pWordBufAry && (bufLenWords > (int)REGION_HDR_WORDS));
+  mpFirst = MakeChunk(NULL, false, pWordBufAry, bufLenWords);
+  mpChunk = mpFirst;
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Destroys the registered objects and gives the chunks back.
+RegionAllocator::~RegionAllocator() {
+  Reset();
+  if (mpSpare) {
+    OSALFREE(mpSpare);
+    mpSpare = NULL;
+    mNumChunks--;
+  }
+  LOG_ASSERT(0 == mNumChunks);
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Puts a chunk header at the start of pWords; the rest is for allocations.
+RegionAllocator::Chunk *RegionAllocator::MakeChunk(Chunk *const pPrev,
+                                                   const bool owned,
+                                                   ba_t *const pWords,
+                                                   const int lenWords) {
+  return new (pWords) Chunk(pPrev, owned, &pWords[REGION_HDR_WORDS],
+                            lenWords - (int)REGION_HDR_WORDS);
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Makes a new chunk the current one, big enough for bytes at align.
+// Oversize allocations get a chunk of their own.
+void RegionAllocator::AddChunk(const size_t minBytes, const size_t align) {
+  const size_t needWords = (minBytes + align + sizeof(ba_t) - 1) / sizeof(ba_t);
+  const size_t stdWords = (mChunkBytes + sizeof(ba_t) - 1) / sizeof(ba_t);
+  if ((mpSpare) && (needWords <= stdWords)) {
+    mpSpare->pPrev = mpChunk;
+    mpSpare->alloc.Reset();
+    mpChunk = mpSpare;
+    mpSpare = NULL;
+  } else {
+    const size_t words = REGION_HDR_WORDS + MAX(needWords, stdWords);
+    ba_t *const pWords = (ba_t *)OSALMALLOC(words * sizeof(ba_t));
+    LOG_ASSERT(pWords);
+    mpChunk = MakeChunk(mpChunk, true, pWords, (int)words);
+    mNumChunks++;
+  }
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Gives a chunk back to mempools, or keeps it as the spare.
+void RegionAllocator::FreeChunk(Chunk *const pChunk) {
+  LOG_ASSERT(pChunk->isOwned);
+  const size_t stdWords = (mChunkBytes + sizeof(ba_t) - 1) / sizeof(ba_t);
+  if ((NULL == mpSpare) && ((size_t)pChunk->alloc.GetLenWords() == stdWords)) {
+    mpSpare = pChunk;
+  } else {
+    OSALFREE(pChunk);
+    mNumChunks--;
+  }
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Allocate bytes, aligned to align (a power of two.)  Never returns NULL.
+void *RegionAllocator::Malloc(const size_t bytes, const size_t align) {
+  void *rval = (mpChunk) ? mpChunk->alloc.TryMalloc(bytes, align) : NULL;
+  if (NULL == rval) {
+    AddChunk(bytes, align);
+    rval = mpChunk->alloc.TryMalloc(bytes, align);
+    LOG_ASSERT(rval);
+  }
+  return rval;
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Call pFn(pObj) when the region is rewound past this point.
+void RegionAllocator::OnRewind(DtorFnT pFn, void *const pObj) {
+  LOG_ASSERT(pFn);
+  DtorRec *const pRec = (DtorRec *)Malloc(sizeof(DtorRec), alignof(DtorRec));
+  pRec->pNext = mpDtors;
+  pRec->pFn = pFn;
+  pRec->pObj = pObj;
+  mpDtors = pRec;
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Gets the current position, for Rewind().
+RegionAllocator::Mark RegionAllocator::GetMark() const {
+  Mark mark;
+  mark.pChunk = mpChunk;
+  mark.idx = (mpChunk) ? mpChunk->alloc.GetIdx() : 0;
+  mark.pDtors = mpDtors;
+  return mark;
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Destroys the objects registered since the mark and frees everything
+// allocated since then.
+void RegionAllocator::Rewind(const Mark &mark) {
+  // The records are in the region, so run them before freeing chunks.
+  while (mpDtors != mark.pDtors) {
+    LOG_ASSERT(mpDtors);
+    DtorRec *const pRec = mpDtors;
+    mpDtors = pRec->pNext;
+    pRec->pFn(pRec->pObj);
+  }
+  while (mpChunk != mark.pChunk) {
+    LOG_ASSERT(mpChunk);
+    Chunk *const pChunk = mpChunk;
+    mpChunk = pChunk->pPrev;
+    FreeChunk(pChunk);
+  }
+  if (mpChunk) {
+    mpChunk->alloc.Rewind(mark.idx);
+  }
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Rewinds to the start.
+void RegionAllocator::Reset() {
+  Mark start;
+  start.pChunk = mpFirst;
+  start.idx = 0;
+  start.pDtors = NULL;
+  Rewind(start);
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Bytes allocated, including alignment padding.
+size_t RegionAllocator::BytesUsed() const {
+  size_t words = 0;
+  for (const Chunk *pChunk = mpChunk; pChunk; pChunk = pChunk->pPrev) {
+    words += pChunk->alloc.GetIdx();
+  }
+  return words * sizeof(ba_t);
+}
+
+// //////////////////////////////////////////////////////////////////////////
+// Number of chunks taken from mempools.
+int RegionAllocator::NumChunks() const { return mNumChunks; }
@@ -0,0 +1,206 @@
+#ifndef REGION_ALLOC_HPP
+#define REGION_ALLOC_HPP
+/**
+ * COPYRIGHT    (c)	Applicaudia 2020
+ * @file        region_alloc.hpp
+ * @brief       Scratch memory for one message or request.
+ *
+ * A RegionAllocator hands out memory from chunks, each managed by a
+ * BufAlloc.  When a chunk is used up another is taken from mempools, so
+ * the region never runs out.  Nothing is freed on its own.  GetMark() and
+ * Rewind() free everything allocated after the mark, and the destructor
+ * frees everything.  Marks nest, so a callee can rewind its own scratch
+ * memory without disturbing its caller's.  Objects with destructors can be
+ * registered to be destroyed when the memory holding them is rewound.
+ *
+ * Not thread safe.
+ */
+
+#ifdef __cplusplus
+
+#include "utils/buf_alloc.hpp"
+
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+class RegionAllocator {
+public:
+  typedef BufAlloc::ba_t ba_t;
+
+  // Called for an object being destroyed by Rewind().
+  typedef void (*DtorFnT)(void *const pObj);
+
+  // Default size of the chunks taken from mempools.
+  static const size_t DEFAULT_CHUNK_BYTES = 4096;
+
+private:
+  // A chunk of memory, with this header at the start.  Either taken from
+  // mempools or given by the caller.
+  struct Chunk {
+    Chunk *pPrev;
+    const bool isOwned;
+    BufAlloc alloc;
+    Chunk(Chunk *const pP, const bool owned, ba_t *const pWords,
+          const int lenWords)
+        : pPrev(pP), isOwned(owned), alloc(pWords, lenWords) {}
+  };
+
+  // An object to destroy on Rewind().  Allocated in the region.
+  struct DtorRec {
+    DtorRec *pNext;
+    DtorFnT pFn;
+    void *pObj;
+  };
+
+public:
+  // A point to Rewind() to.
+  class Mark {
+    friend class RegionAllocator;
+    Chunk *pChunk;
+    int idx;
+    DtorRec *pDtors;
+  };
+
+  // Rewinds the region when it goes out of scope.
+  class Scope {
+  public:
+    explicit Scope(RegionAllocator &region)
+        : mRegion(region), mMark(region.GetMark()) {}
+    ~Scope() { mRegion.Rewind(mMark); }
+
+  private:
+    Scope(const Scope &);
+    Scope &operator=(const Scope &);
+    RegionAllocator &mRegion;
+    const Mark mMark;
+  };
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Construct a region that takes chunks of chunkBytes from mempools.
+  explicit RegionAllocator(const size_t chunkBytes = DEFAULT_CHUNK_BYTES);
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Construct a region that uses pWordBufAry first (e.g. on the stack), and
+  // then takes chunks from mempools.
+  RegionAllocator(ba_t *const pWordBufAry, const int bufLenWords,
+                  const size_t chunkBytes = DEFAULT_CHUNK_BYTES);
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Destroys the registered objects and gives the chunks back.
+  ~RegionAllocator();
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Allocate bytes, aligned to align (a power of two.)  Never returns NULL.
+  void *Malloc(const size_t bytes, const size_t align = sizeof(ba_t));
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Allocate an array of num T, aligned for T.  The elements are not
+  // constructed.
+  template <typename T> T *MallocArray(const size_t num) {
+    return (T *)Malloc(num * sizeof(T), alignof(T));
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Construct a T in the region.  Its destructor, if it has one, runs when
+  // the region is rewound past it.
+  template <typename T, typename... Args> T *New(Args &&... args) {
+    void *const pMem = Malloc(sizeof(T), alignof(T));
+    T *const pObj = new (pMem) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      OnRewind(DestroyFn<T>, pObj);
+    }
+    return pObj;
+  }
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Call pFn(pObj) when the region is rewound past this point.  Calls run in
+  // the reverse of the order they were registered in.
+  void OnRewind(DtorFnT pFn, void *const pObj);
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Gets the current position, for Rewind().
+  Mark GetMark() const;
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Destroys the objects registered since the mark and frees everything
+  // allocated since then.  Later marks become invalid.
+  void Rewind(const Mark &mark);
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Rewinds to the start.
+  void Reset();
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Bytes allocated, including alignment padding.
+  size_t BytesUsed() const;
+
+  // //////////////////////////////////////////////////////////////////////////
+  // Number of chunks taken from mempools.
+  int NumChunks() const;
+
+private:
+  RegionAllocator(const RegionAllocator &);
+  RegionAllocator &operator=(const RegionAllocator &);
+
+  template <typename T> static void DestroyFn(void *const pObj) {
+    ((T *)pObj)->~T();
+  }
+
+  static Chunk *MakeChunk(Chunk *const pPrev, const bool owned,
+                          ba_t *const pWords, const int lenWords);
+  void AddChunk(const size_t minBytes, const size_t align);
+  void FreeChunk(Chunk *const pChunk);
+
+private:
+  const size_t mChunkBytes;
+  // Chunk in the memory the caller gave, or NULL.
+  Chunk *mpFirst;
+  // Newest chunk, or NULL.
+  Chunk *mpChunk;
+  // A standard chunk kept back by Rewind(), to save freeing and allocating
+  // it again when the region is used in a loop.
+  Chunk *mpSpare;
+  // Most recently registered destructor.
+  DtorRec *mpDtors;
+  int mNumChunks;
+};
+
+// ////////////////////////////////////////////////////////////////////////////
+// An STL allocator that allocates from a region, e.g.
+//   std::vector<int, RegionStlAllocator<int>> v(RegionStlAllocator<int>(region));
+// Deallocation does nothing; the memory goes when the region is rewound.
+template <typename T> class RegionStlAllocator {
+public:
+  typedef T value_type;
+
+  explicit RegionStlAllocator(RegionAllocator &region) : mpRegion(&region) {}
+
+  template <typename U>
+  RegionStlAllocator(const RegionStlAllocator<U> &rhs)
+      : mpRegion(rhs.mpRegion) {}
+
+  T *allocate(const size_t n) { return mpRegion->MallocArray<T>(n); }
+
+  void deallocate(T *const, const size_t) {}
+
+  template <typename U>
+  bool operator==(const RegionStlAllocator<U> &rhs) const {
+    return mpRegion == rhs.mpRegion;
+  }
+
+  template <typename U>
+  bool operator!=(const RegionStlAllocator<U> &rhs) const {
+    return mpRegion != rhs.mpRegion;
+  }
+
+  RegionAllocator *mpRegion;
+};
+
+#endif // #ifdef __cplusplus
+
+#endif
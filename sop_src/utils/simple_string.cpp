@@ -11,6 +11,7 @@
 #include "osal/osal.h"
 #include "utils/helper_macros.h"
 #include "utils/platform_log.h"
+#include "utils/region_alloc.hpp"
 
 #include <string.h>
 
@@ -35,6 +36,7 @@ sstring::sstring(const sstring& rhs)
 // //////////////////////////////////////////////////////////////////////////
 sstring::sstring()
   : mIsHeap(false)
+  , mpRegion(nullptr)
   , mpBuf(mBufInitial)
   , mMaxSize(SS_INITIAL_STRING_SIZE)
   , mCurSize(0)
@@ -77,6 +79,12 @@ sstring::sstring(const ssize_t size)
   LOG_ASSERT(mCurSize == size);
 }
 
+// //////////////////////////////////////////////////////////////////////////
+sstring::sstring(RegionAllocator& region)
+  : sstring() {
+  mpRegion = &region;
+}
+
 
 // //////////////////////////////////////////////////////////////////////////
 sstring::~sstring() {
@@ -86,7 +94,7 @@ sstring::~sstring() {
 // //////////////////////////////////////////////////////////////////////////
 void sstring::dtor() {
   clear();
-  if (mIsHeap) {
+  if ((mIsHeap) && (!mpRegion)) {
     OSALFREE(mpBuf);
   }
   init();
@@ -415,23 +423,28 @@ void sstring::grow(const ssize_t incomingSize) {
     LOG_ASSERT(isPowerOfTwo(maxSize));
     LOG_ASSERT((maxSize >= allocSize) && (maxSize > mMaxSize));
 
-    // We need to free the old buffer after allocation.
     uint8_t* const pOldBuf = mpBuf;
-    const bool wasHeap     = mIsHeap;
-    mpBuf                  = (uint8_t*)OSALMALLOC(maxSize);
-    LOG_ASSERT(mpBuf);
-    if (mpBuf) {
-      mIsHeap = true;
-      memset(mpBuf, 0, maxSize);
-      mMaxSize = maxSize;
-      LOG_ASSERT(pOldBuf);
-      if (mCurSize > 0) {
-        LOG_ASSERT(mCurSize <= mMaxSize);
-        memcpy(mpBuf, pOldBuf, mCurSize);
-      }
+    uint8_t* pNewBuf       = NULL;
+    if (mpRegion) {
+      pNewBuf = (uint8_t*)mpRegion->Malloc(maxSize);
+    } else if (mIsHeap) {
+      // Moves the contents, unless the block can grow in place.
+      pNewBuf = (uint8_t*)OSALREALLOC(pOldBuf, maxSize);
+    } else {
+      pNewBuf = (uint8_t*)OSALMALLOC_NOZERO(maxSize);
     }
-    if (wasHeap) {
-      OSALFREE(pOldBuf);
+    LOG_ASSERT(pNewBuf);
+    if (pNewBuf) {
+      LOG_ASSERT(mCurSize <= maxSize);
+      const bool reallocated = ((!mpRegion) && (mIsHeap));
+      if ((!reallocated) && (mCurSize > 0)) {
+        memcpy(pNewBuf, pOldBuf, mCurSize);
+      }
+      // Only the bytes past the contents need zeroing.
+      memset(&pNewBuf[ mCurSize ], 0, maxSize - mCurSize);
+      mpBuf    = pNewBuf;
+      mIsHeap  = true;
+      mMaxSize = maxSize;
     }
   }
 }
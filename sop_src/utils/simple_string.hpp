@@ -13,6 +13,8 @@
 #include <cstddef>
 #include <cstdint>
 
+class RegionAllocator;
+
 class sstring {
 private:
   static const int SS_INITIAL_STRING_SIZE = 32 + 1;
@@ -44,6 +46,11 @@ public:
   // //////////////////////////////////////////////////////////////////////////
   sstring(const ssize_t size);
 
+  // //////////////////////////////////////////////////////////////////////////
+  // A string that grows into region instead of mempools.  Its buffers are
+  // freed when the region is rewound, so region must outlive the string.
+  explicit sstring(RegionAllocator& region);
+
   // //////////////////////////////////////////////////////////////////////////
   ~sstring();
 
@@ -205,6 +212,8 @@ public:
 
 private:
   bool mIsHeap;
+  // If set, heap buffers come from here and are never freed by the string.
+  RegionAllocator* mpRegion;
   uint8_t* mpBuf;
   ssize_t mMaxSize;
   ssize_t mCurSize;
@@ -0,0 +1,146 @@
+
+#include "gtest/gtest.h"
+#include "osal/osal.h"
+#include "utils/platform_log.h"
+#include "utils/helper_macros.h"
+#include "utils/mpmc_q.hpp"
+#include "tests/gtest_test_wrapper.hpp"
+#include <memory>
+#include <thread>
+#include <vector>
+
+LOG_MODNAME("test_mpmc_q.cpp");
+
+class TestMpmcQ : public GtestMempoolsWrapper {
+public:
+  TestMpmcQ(){}
+  ~TestMpmcQ() {}
+};
+
+TEST_F(TestMpmcQ, test_try){
+  MpmcQ<uint32_t, 4> q;
+  ASSERT_EQ(0, q.GetReadReady());
+  ASSERT_EQ(4, q.GetWriteReady());
+  for (uint32_t i = 0; i < 4; i++) {
+    ASSERT_TRUE(q.TryPush(i));
+  }
+  ASSERT_FALSE(q.TryPush(4u));
+  ASSERT_EQ(4, q.GetReadReady());
+
+  // Around the end and back, in order.
+  uint32_t v = 0;
+  for (uint32_t i = 0; i < 20; i++) {
+    ASSERT_TRUE(q.TryPop(v));
+    ASSERT_EQ(i, v);
+    ASSERT_TRUE(q.TryPush(i + 4));
+  }
+  for (uint32_t i = 20; i < 24; i++) {
+    ASSERT_TRUE(q.TryPop(v));
+    ASSERT_EQ(i, v);
+  }
+  ASSERT_FALSE(q.TryPop(v));
+}
+
+TEST_F(TestMpmcQ, test_move_only){
+  class Obj {
+  public:
+    explicit Obj(int *const pLive, const int val) : mVal(val), mpLive(pLive) { (*mpLive)++; }
+    ~Obj() { (*mpLive)--; }
+    int mVal;
+  private:
+    int *const mpLive;
+  };
+  int live = 0;
+  {
+    MpmcQ<std::unique_ptr<Obj>, 4> q;
+    std::unique_ptr<Obj> p(new Obj(&live, 1));
+    ASSERT_TRUE(q.TryPush(std::move(p)));
+    ASSERT_TRUE(NULL == p.get());
+    ASSERT_TRUE(q.TryEmplace(new Obj(&live, 2)));
+    ASSERT_EQ(2, live);
+
+    ASSERT_TRUE(q.TryPop(p));
+    ASSERT_EQ(1, p->mVal);
+    p.reset();
+    ASSERT_EQ(1, live);
+
+    // The queue destroys what is left in it.
+    ASSERT_TRUE(q.TryEmplace(new Obj(&live, 3)));
+    ASSERT_EQ(2, live);
+  }
+  ASSERT_EQ(0, live);
+}
+
+TEST_F(TestMpmcQ, test_batch){
+  MpmcQ<uint32_t, 8> q;
+  uint32_t in[ 16 ];
+  uint32_t out[ 16 ];
+  for (uint32_t i = 0; i < ARRSZ(in); i++) {
+    in[ i ] = i;
+  }
+  ASSERT_TRUE(q.TryPush(100u));
+  ASSERT_TRUE(q.TryPush(101u));
+  ASSERT_EQ(6, q.TryPushBatch(in, ARRSZ(in)));
+  ASSERT_EQ(0, q.TryPushBatch(in, ARRSZ(in)));
+  ASSERT_EQ(3, q.TryPopBatch(out, 3));
+  ASSERT_EQ(100u, out[ 0 ]);
+  ASSERT_EQ(101u, out[ 1 ]);
+  ASSERT_EQ(0u, out[ 2 ]);
+
+  // Wraps around the end.
+  ASSERT_EQ(3, q.TryPushBatch(&in[ 6 ], 10));
+  ASSERT_EQ(8, q.TryPopBatch(out, ARRSZ(out)));
+  for (uint32_t i = 0; i < 8; i++) {
+    ASSERT_EQ(i + 1, out[ i ]);
+  }
+  ASSERT_EQ(0, q.TryPopBatch(out, ARRSZ(out)));
+}
+
+TEST_F(TestMpmcQ, test_blocking){
+  static const int NUM_THREADS = 4;
+  static const int ITERATIONS  = 20000;
+  MpmcQ<uint32_t, 8> q;
+
+  // Times out when empty, and when full.
+  uint32_t v = 0;
+  const uint32_t t0 = OSALGetMS();
+  ASSERT_FALSE(q.Pop(v, 20));
+  ASSERT_GE(OSALGetMS() - t0, 15u);
+  for (uint32_t i = 0; i < 8; i++) {
+    ASSERT_TRUE(q.Push(i, 0));
+  }
+  ASSERT_FALSE(q.Push(8u, 20));
+  ASSERT_EQ(8, q.GetReadReady());
+  uint32_t drain[ 8 ];
+  ASSERT_EQ(8, q.TryPopBatch(drain, 8));
+
+  // Writers and readers that sleep on the queue; every item arrives once.
+  std::vector<std::thread> threads;
+  volatile uint32_t sums[ NUM_THREADS ] = { 0 };
+  for (int t = 0; t < NUM_THREADS; t++) {
+    threads.push_back(std::thread([t, &q]() {
+      for (uint32_t i = 0; i < ITERATIONS; i++) {
+        EXPECT_TRUE(q.Push((uint32_t)(t * ITERATIONS) + i));
+      }
+    }));
+    threads.push_back(std::thread([t, &q, &sums]() {
+      uint32_t sum = 0;
+      for (uint32_t i = 0; i < ITERATIONS; i++) {
+        uint32_t x = 0;
+        EXPECT_TRUE(q.Pop(x));
+        sum += x;
+      }
+      sums[ t ] = sum;
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); t++) {
+    threads[ t ].join();
+  }
+  uint32_t sum = 0;
+  for (int t = 0; t < NUM_THREADS; t++) {
+    sum += sums[ t ];
+  }
+  const uint32_t n = NUM_THREADS * ITERATIONS;
+  ASSERT_EQ((uint32_t)(((uint64_t)n * (n - 1)) / 2), sum);
+  ASSERT_EQ(0, q.GetReadReady());
+}
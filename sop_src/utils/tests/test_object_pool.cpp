@@ -0,0 +1,178 @@
+
+#include "gtest/gtest.h"
+#include "osal/osal.h"
+#include "utils/platform_log.h"
+#include "utils/helper_macros.h"
+#include "utils/object_pool.hpp"
+#include "tests/gtest_test_wrapper.hpp"
+#include <set>
+#include <thread>
+#include <vector>
+
+LOG_MODNAME("test_object_pool.cpp");
+
+class TestObjectPool : public GtestMempoolsWrapper {
+public:
+  TestObjectPool(){}
+  ~TestObjectPool() {}
+};
+
+typedef struct PoolItemTag {
+  uint32_t link;
+  uint32_t owner;
+  uint64_t payload;
+} PoolItemT;
+
+TEST_F(TestObjectPool, test_alloc_free){
+  ObjectPool<PoolItemT, 4> pool;
+  PoolItemT *items[ 4 ];
+  for (int i = 0; i < 4; i++) {
+    items[ i ] = pool.Alloc();
+    ASSERT_TRUE(items[ i ] != NULL);
+    ASSERT_TRUE(pool.Owns(items[ i ]));
+    for (int j = 0; j < i; j++) {
+      ASSERT_NE(items[ i ], items[ j ]);
+    }
+  }
+  ASSERT_TRUE(NULL == pool.Alloc());
+
+  PoolItemT other;
+  ASSERT_FALSE(pool.Owns(&other));
+
+  ObjectPoolStatsT stats;
+  pool.GetStats(&stats);
+  ASSERT_EQ(4u, stats.capacity);
+  ASSERT_EQ(4u, stats.inUse);
+  ASSERT_EQ(4u, stats.maxInUse);
+  ASSERT_EQ(4u, stats.allocs);
+  ASSERT_EQ(1u, stats.failures);
+  ASSERT_EQ(0u, stats.grows);
+
+  for (int i = 0; i < 4; i++) {
+    pool.Free(items[ i ]);
+  }
+  pool.GetStats(&stats);
+  ASSERT_EQ(0u, stats.inUse);
+  ASSERT_EQ(4u, stats.maxInUse);
+
+  // Most recently freed first.
+  ASSERT_EQ(items[ 3 ], pool.Alloc());
+}
+
+TEST_F(TestObjectPool, test_adopt){
+  PoolItemT arr[ 3 ];
+  ObjectPool<PoolItemT, 0> pool;
+  ASSERT_TRUE(NULL == pool.Alloc());
+  ASSERT_TRUE(pool.Adopt(arr, ARRSZ(arr)));
+  std::set<PoolItemT *> got;
+  for (int i = 0; i < 3; i++) {
+    PoolItemT *const p = pool.Alloc();
+    ASSERT_TRUE((p >= &arr[ 0 ]) && (p <= &arr[ 2 ]));
+    got.insert(p);
+  }
+  ASSERT_EQ(3u, got.size());
+  ASSERT_TRUE(NULL == pool.Alloc());
+
+  // A pool with no slots of its own holds no storage for them.
+  ASSERT_LT(sizeof(pool), sizeof(ObjectPool<PoolItemT, 1>));
+}
+
+TEST_F(TestObjectPool, test_adopt_limits){
+  static PoolItemT arr[ OBJECT_POOL_MAX_SEGS + 1 ][ 2 ];
+  static PoolItemT big[ 0xffff ];
+  ObjectPool<PoolItemT, 0> pool;
+  for (int i = 0; i < OBJECT_POOL_MAX_SEGS; i++) {
+    ASSERT_TRUE(pool.Adopt(arr[ i ], ARRSZ(arr[ i ])));
+  }
+  ASSERT_FALSE(pool.Adopt(arr[ OBJECT_POOL_MAX_SEGS ], ARRSZ(arr[ OBJECT_POOL_MAX_SEGS ])));
+
+  // Too many slots is refused whole.
+  ObjectPool<PoolItemT, 0> pool2;
+  ASSERT_TRUE(pool2.Adopt(arr[ 0 ], ARRSZ(arr[ 0 ])));
+  ASSERT_FALSE(pool2.Adopt(big, 0xffff - 2));
+  ASSERT_TRUE(pool2.Adopt(big, 0xffff - 3));
+  ObjectPoolStatsT stats;
+  pool2.GetStats(&stats);
+  ASSERT_EQ(0xfffeu, stats.capacity);
+}
+
+TEST_F(TestObjectPool, test_grow){
+  std::vector<PoolItemT *> items;
+  {
+    ObjectPool<PoolItemT, 2> pool(8);
+    for (int i = 0; i < 30; i++) {
+      PoolItemT *const p = pool.Alloc();
+      ASSERT_TRUE(p != NULL);
+      p->payload = i;
+      items.push_back(p);
+    }
+    ObjectPoolStatsT stats;
+    pool.GetStats(&stats);
+    ASSERT_EQ(34u, stats.capacity);
+    ASSERT_EQ(4u, stats.grows);
+    ASSERT_EQ(30u, stats.inUse);
+    for (size_t i = 0; i < items.size(); i++) {
+      ASSERT_EQ(i, items[ i ]->payload);
+      pool.Free(items[ i ]);
+    }
+  }
+}
+
+TEST_F(TestObjectPool, test_new_delete){
+  class Obj {
+  public:
+    explicit Obj(int *const pLive) : mpLive(pLive) { (*mpLive)++; }
+    ~Obj() { (*mpLive)--; }
+  private:
+    int *const mpLive;
+  };
+  int live = 0;
+  ObjectPool<Obj, 2> pool;
+  Obj *const p0 = pool.New(&live);
+  Obj *const p1 = pool.New(&live);
+  ASSERT_TRUE(p0 && p1);
+  ASSERT_TRUE(NULL == pool.New(&live));
+  ASSERT_EQ(2, live);
+  pool.Delete(p0);
+  pool.Delete(p1);
+  ASSERT_EQ(0, live);
+}
+
+// Threads take and give back slots, and check that no slot is given to two
+// threads at once.
+TEST_F(TestObjectPool, test_threads){
+  static const int NUM_THREADS = 4;
+  static const int ITERATIONS  = 100000;
+  ObjectPool<PoolItemT, 16> pool(16);
+  std::vector<std::thread> threads;
+  volatile bool failed = false;
+  for (int t = 0; t < NUM_THREADS; t++) {
+    threads.push_back(std::thread([t, &pool, &failed]() {
+      PoolItemT *held[ 8 ];
+      for (int i = 0; i < ITERATIONS; i++) {
+        const int n = 1 + (i % ARRSZ(held));
+        for (int j = 0; j < n; j++) {
+          held[ j ] = pool.Alloc();
+          held[ j ]->owner = t;
+        }
+        for (int j = 0; j < n; j++) {
+          if (held[ j ]->owner != (uint32_t)t) {
+            failed = true;
+          }
+          pool.Free(held[ j ]);
+        }
+      }
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); t++) {
+    threads[ t ].join();
+  }
+  ASSERT_FALSE(failed);
+  ObjectPoolStatsT stats;
+  pool.GetStats(&stats);
+  ASSERT_EQ(0u, stats.inUse);
+  ASSERT_EQ(0u, stats.failures);
+  ASSERT_LE(stats.maxInUse, stats.capacity);
+  // Each thread holds 1..8 slots at a time, 4.5 on average.
+  ASSERT_EQ((uint32_t)(NUM_THREADS * ITERATIONS * 9 / 2), stats.allocs);
+}
@@ -0,0 +1,193 @@
+
+#include "gtest/gtest.h"
+#include "osal/osal.h"
+#include "utils/platform_log.h"
+#include "utils/helper_macros.h"
+#include "utils/region_alloc.hpp"
+#include "utils/simple_string.hpp"
+#include "utils/q.hpp"
+#include "tests/gtest_test_wrapper.hpp"
+#include <map>
+#include <string.h>
+#include <vector>
+
+LOG_MODNAME("test_region_alloc.cpp");
+
+class TestRegionAlloc : public GtestMempoolsWrapper {
+public:
+  TestRegionAlloc(){}
+  ~TestRegionAlloc() {}
+};
+
+// Counts its own constructions and destructions.
+class Counted {
+public:
+  explicit Counted(int *const pLive, int *const pOrder = nullptr, const int id = 0)
+    : mpLive(pLive), mpOrder(pOrder), mId(id) {
+    (*mpLive)++;
+  }
+  ~Counted() {
+    (*mpLive)--;
+    if (mpOrder) {
+      *mpOrder = (*mpOrder * 10) + mId;
+    }
+  }
+private:
+  int *const mpLive;
+  int *const mpOrder;
+  const int mId;
+};
+
+TEST_F(TestRegionAlloc, test_marks_nest){
+  RegionAllocator region(256);
+  const RegionAllocator::Mark m0 = region.GetMark();
+  uint8_t *const p0 = (uint8_t *)region.Malloc(10);
+  memset(p0, 0xaa, 10);
+  const RegionAllocator::Mark m1 = region.GetMark();
+  uint8_t *const p1 = (uint8_t *)region.Malloc(10);
+  const RegionAllocator::Mark m2 = region.GetMark();
+  void *const p2 = region.Malloc(10);
+  (void)region.Malloc(10);
+  region.Rewind(m2);
+  // Same memory is handed out again after a rewind.
+  ASSERT_EQ(p2, region.Malloc(10));
+  region.Rewind(m1);
+  ASSERT_EQ(p1, region.Malloc(10));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(0xaa, p0[i]);
+  }
+  region.Rewind(m0);
+  ASSERT_EQ(0u, region.BytesUsed());
+}
+
+TEST_F(TestRegionAlloc, test_alignment){
+  RegionAllocator region(1024);
+  (void)region.Malloc(1);
+  for (size_t align = 1; align <= 256; align <<= 1) {
+    const uintptr_t p = (uintptr_t)region.Malloc(3, align);
+    ASSERT_EQ(0u, p & (align - 1));
+  }
+  // Bigger alignment than a chunk can give without padding.
+  const uintptr_t p = (uintptr_t)region.Malloc(2000, 512);
+  ASSERT_EQ(0u, p & 511);
+}
+
+TEST_F(TestRegionAlloc, test_chunks_grow_and_shrink){
+  RegionAllocator region(256);
+  ASSERT_EQ(0, region.NumChunks());
+  const RegionAllocator::Mark m0 = region.GetMark();
+  for (int i = 0; i < 100; i++) {
+    memset(region.Malloc(100), i, 100);
+  }
+  ASSERT_GT(region.NumChunks(), 10);
+  ASSERT_GE(region.BytesUsed(), 100u * 100u);
+
+  // Oversize allocations get their own chunk.
+  const RegionAllocator::Mark m1 = region.GetMark();
+  const int chunks = region.NumChunks();
+  memset(region.Malloc(10000), 0, 10000);
+  ASSERT_EQ(chunks + 1, region.NumChunks());
+  region.Rewind(m1);
+  ASSERT_EQ(chunks, region.NumChunks());
+
+  // One chunk is kept back.
+  region.Rewind(m0);
+  ASSERT_EQ(1, region.NumChunks());
+  for (int i = 0; i < 100; i++) {
+    const RegionAllocator::Scope scope(region);
+    (void)region.Malloc(100);
+    ASSERT_EQ(1, region.NumChunks());
+  }
+}
+
+TEST_F(TestRegionAlloc, test_caller_buffer){
+  RegionAllocator::ba_t buf[ 32 ];
+  RegionAllocator region(buf, ARRSZ(buf), 128);
+  uint8_t *const p = (uint8_t *)region.Malloc(16);
+  ASSERT_TRUE((p > (uint8_t *)buf) && (p < (uint8_t *)&buf[ ARRSZ(buf) ]));
+  ASSERT_EQ(0, region.NumChunks());
+  (void)region.Malloc(1000);
+  ASSERT_EQ(1, region.NumChunks());
+  region.Reset();
+  ASSERT_EQ(p, region.Malloc(16));
+}
+
+TEST_F(TestRegionAlloc, test_destructors){
+  int live = 0;
+  int order = 0;
+  {
+    RegionAllocator region(256);
+    (void)region.New<Counted>(&live, &order, 1);
+    const RegionAllocator::Mark m = region.GetMark();
+    (void)region.New<Counted>(&live, &order, 2);
+    for (int i = 0; i < 50; i++) {
+      (void)region.New<Counted>(&live);
+    }
+    (void)region.New<Counted>(&live, &order, 3);
+    ASSERT_EQ(53, live);
+    region.Rewind(m);
+    // Newest first.
+    ASSERT_EQ(1, live);
+    ASSERT_EQ(32, order);
+
+    int *const pInt = region.New<int>(5);
+    ASSERT_EQ(5, *pInt);
+  }
+  ASSERT_EQ(0, live);
+  ASSERT_EQ(321, order);
+}
+
+TEST_F(TestRegionAlloc, test_sstring){
+  RegionAllocator region(256);
+  {
+    const RegionAllocator::Scope scope(region);
+    sstring *const pStr = region.New<sstring>(region);
+    for (int i = 0; i < 100; i++) {
+      pStr->appendp("0123456789", false);
+    }
+    ASSERT_EQ(1000u, pStr->length());
+    ASSERT_EQ(0, memcmp("0123456789", &pStr->c_str()[ 990 ], 10));
+    ASSERT_GE(region.BytesUsed(), 1000u);
+  }
+  ASSERT_EQ(0u, region.BytesUsed());
+}
+
+TEST_F(TestRegionAlloc, test_q){
+  RegionAllocator region;
+  Q<uint32_t> q;
+  q.Init(region, 16);
+  ASSERT_EQ(16, q.GetWriteReady());
+  for (uint32_t i = 0; i < 16; i++) {
+    ASSERT_EQ(4, q.Write(i));
+  }
+  uint32_t vals[ 16 ];
+  ASSERT_EQ(16, q.Read(vals, 16));
+  for (uint32_t i = 0; i < 16; i++) {
+    ASSERT_EQ(i, vals[ i ]);
+  }
+}
+
+TEST_F(TestRegionAlloc, test_stl_containers){
+  RegionAllocator region(512);
+  {
+    typedef RegionStlAllocator<int> IntAlloc;
+    std::vector<int, IntAlloc> v{ IntAlloc(region) };
+    for (int i = 0; i < 1000; i++) {
+      v.push_back(i);
+    }
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_EQ(i, v[ i ]);
+    }
+
+    typedef std::pair<const int, int> PairT;
+    typedef RegionStlAllocator<PairT> PairAlloc;
+    std::map<int, int, std::less<int>, PairAlloc> m{ std::less<int>(), PairAlloc(region) };
+    for (int i = 0; i < 100; i++) {
+      m[ i ] = i * 2;
+    }
+    ASSERT_EQ(100u, m.size());
+    ASSERT_EQ(198, m[ 99 ]);
+  }
+  region.Reset();
+  ASSERT_EQ(0u, region.BytesUsed());
+}
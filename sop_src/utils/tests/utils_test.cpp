@@ -91,6 +91,78 @@ TEST_F(UtilsTest, Q2) {
   EXPECT_EQ(x, 0x5544);
 }
 
+TEST_F(UtilsTest, QPowerOfTwo) {
+  // Power of two sizes wrap with a mask, others with a compare.
+  uint32_t buf2[ 16 ];
+  uint32_t buf[ 13 ];
+  Q<uint32_t> q2(buf2, ARRSZN(buf2));
+  Q<uint32_t> q(buf, ARRSZN(buf));
+  EXPECT_NE(0u, q2.GetByteQPtr()->nMask);
+  EXPECT_EQ(0u, q.GetByteQPtr()->nMask);
+
+  // An empty queue is not a power of two.
+  ByteQ_t empty;
+  ByteQCreate(&empty, (bq_t*)buf, 0, false, false);
+  EXPECT_EQ(0u, empty.nMask);
+  EXPECT_EQ(0u, ByteQGetWriteReady(&empty));
+  ByteQDestroy(&empty);
+
+  uint32_t rd = 0;
+  for (uint32_t i = 0; i < 100; i++) {
+    q2.Write(i);
+    q.Write(i);
+    if (i >= 10) {
+      EXPECT_EQ(rd, q2[ 0 ]);
+      EXPECT_EQ(rd + 10, q2[ 10 ]);
+      EXPECT_EQ(rd + 10, q[ 10 ]);
+      EXPECT_EQ(i, q[ -1 ]);
+      uint32_t x = 0;
+      EXPECT_EQ(1, q2.Read(&x, 1));
+      EXPECT_EQ(rd, x);
+      EXPECT_EQ(1, q.Read(&x, 1));
+      EXPECT_EQ(rd, x);
+      rd++;
+    }
+  }
+}
+
+#if (BYTEQ_MIRROR > 0)
+TEST_F(UtilsTest, ByteQMirrored) {
+  uint8_t wr[ 8192 ];
+  for (unsigned int i = 0; i < sizeof(wr); i++) {
+    wr[ i ] = (uint8_t)(i * 7);
+  }
+
+  ByteQ q;
+  ASSERT_TRUE(q.InitMirrored(5000));
+  ByteQ_t* const pQ = q.GetByteQPtr();
+  const int sz      = q.GetWriteReady();
+  EXPECT_GE(sz, 5000);
+
+  // Leave the indices near the end, so that the next window wraps.
+  EXPECT_EQ(sz - 100, q.Write(wr, sz - 100));
+  EXPECT_EQ(sz - 100, (int)ByteQCommitRead(pQ, sz - 100));
+  EXPECT_EQ(sz, (int)ByteQGetContiguousWriteReady(pQ));
+
+  // One write, and the whole span reads back in place.
+  EXPECT_EQ(3000, q.Write(wr, 3000));
+  EXPECT_EQ(3000u, ByteQGetContiguousReadReady(pQ));
+  EXPECT_EQ(0, memcmp(ByteQGetReadPtr(pQ), wr, 3000));
+  EXPECT_EQ(0, memcmp(pQ->pfBuf, &wr[ 100 ], 2900));
+  EXPECT_EQ(1000, q.CommitRead(1000));
+  EXPECT_EQ(0, memcmp(ByteQGetReadPtr(pQ), &wr[ 1000 ], 2000));
+
+  // Writing through the write pointer across the end is fine too.
+  EXPECT_EQ((unsigned int)(sz - 2000), ByteQGetContiguousWriteReady(pQ));
+  memcpy(ByteQGetWritePtr(pQ), wr, 2500);
+  EXPECT_EQ(2500, q.CommitWrite(2500));
+  uint8_t rd[ 4500 ];
+  EXPECT_EQ(4500, q.Read(rd, sizeof(rd)));
+  EXPECT_EQ(0, memcmp(rd, &wr[ 1000 ], 2000));
+  EXPECT_EQ(0, memcmp(&rd[ 2000 ], wr, 2500));
+}
+#endif
+
 
 #include "osal/osal.h"
 #include "task_sched/task_sched.h"